@@ -98,6 +98,15 @@ __PRIVILEGED_CODE void init_ap_per_cpu_area(uint8_t cpu_id);
  */
 __PRIVILEGED_CODE void allocate_ap_per_cpu_area(uint8_t cpu_id);
 
+/**
+ * @brief Retrieves the base address of a CPU's per-CPU area.
+ * @param cpu The ID of the CPU.
+ * @return The base address of the per-CPU area, or 0 if the CPU has no area allocated.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE uintptr_t get_per_cpu_area(uint64_t cpu);
+
 /**
  * @brief Deallocates the per-CPU area of an Application Processor (AP).
  * @param cpu_id The ID of the AP to deallocate the per-CPU area for.
@@ -109,4 +118,24 @@ __PRIVILEGED_CODE void allocate_ap_per_cpu_area(uint8_t cpu_id);
 __PRIVILEGED_CODE void deallocate_ap_per_cpu_area(uint8_t cpu_id);
 } // namespace arch
 
+/**
+ * @brief Retrieves a pointer to another CPU's instance of a per-CPU variable.
+ * 
+ * @tparam T The type of the per-CPU variable.
+ * @param name Reference to the per-CPU variable.
+ * @param cpu The ID of the CPU whose instance should be accessed.
+ * @return Pointer to the CPU's instance of the variable, or `nullptr` if the CPU has no per-CPU area.
+ * 
+ * @note Privilege: **required**
+ */
+template <typename T>
+inline T* per_cpu_ptr(T& name, uint64_t cpu) {
+    uintptr_t base = arch::get_per_cpu_area(cpu);
+    if (!base) {
+        return nullptr;
+    }
+
+    return reinterpret_cast<T*>(base + PER_CPU_OFFSET(name));
+}
+
 #endif // PERCPU_H
@@ -18,6 +18,8 @@
 #define APIC_LVT_LINT1    0x360  // LINT1 interrupt
 #define APIC_LVT_ERROR    0x370  // Error interrupt
 
+#define APIC_REG_ID       0x20   // Local APIC ID register
+
 namespace arch::x86 {
 /**
  * @class lapic
@@ -151,6 +153,20 @@ public:
      */
     __PRIVILEGED_CODE void send_startup_ipi(uint8_t apic_id, uint32_t vector);
 
+    /**
+     * @brief Sends a fixed-delivery Inter-Processor Interrupt (IPI) to a specified LAPIC.
+     * @param apic_id The APIC ID of the target LAPIC.
+     * @param vector The interrupt vector to raise on the target processor.
+     * 
+     * @note Privilege: **required**
+     */
+    __PRIVILEGED_CODE void send_ipi(uint8_t apic_id, uint8_t vector);
+
+    /**
+     * @brief Retrieves the APIC ID of the processor owning this LAPIC.
+     */
+    __PRIVILEGED_CODE uint8_t apic_id() const { return m_apic_id; }
+
     /**
      * @brief Waits for an ICR command completion by reading the Delivery Status bit.
      * 
@@ -168,6 +184,9 @@ public:
      * @note Privilege: **required**
      */
     __PRIVILEGED_CODE void disable_legacy_pic();
+
+private:
+    uint8_t m_apic_id;
 };
 } // namespace arch::x86
 
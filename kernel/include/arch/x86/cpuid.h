@@ -22,9 +22,22 @@
 #define CPUID_FEAT_EDX_PGE         (1 << 13)
 #define CPUID_FEAT_EDX_PAT         (1 << 16)
 
+// Feature bits in EDX for CPUID with EAX=1
+#define CPUID_FEAT_EDX_FXSR        (1 << 24)
+
 // Feature bits in ECX for CPUID with EAX=1
 #define CPUID_FEAT_ECX_SSE3        (1 << 0)
 #define CPUID_FEAT_ECX_VMX         (1 << 5)
+#define CPUID_FEAT_ECX_XSAVE       (1 << 26)
+#define CPUID_FEAT_ECX_OSXSAVE     (1 << 27)
+
+// Processor extended state enumeration leaf
+#define CPUID_XSAVE_STATE          0x0000000D
+
+// Feature bits in EAX for CPUID with EAX=0xD, ECX=1
+#define CPUID_FEAT_EAX_XSAVEOPT    (1 << 0)
+#define CPUID_FEAT_EAX_XSAVEC      (1 << 1)
+#define CPUID_FEAT_EAX_XSAVES      (1 << 3)
 
 // Feature bits in ECX for CPUID with EAX=7, ECX=0
 #define CPUID_FEAT_ECX_FSGSBASE    (1 << 0)
@@ -284,9 +297,9 @@ __PRIVILEGED_CODE static inline bool cpuid_is_sse2_supported() {
  * @note Privilege: **required**
  */
 __PRIVILEGED_CODE static inline bool cpuid_is_sse3_supported() {
-    uint32_t eax, edx;
-    read_cpuid(CPUID_FEATURES, &eax, &edx);
-    return (eax & CPUID_ECX_SSE3) != 0;
+    uint32_t eax, ebx, ecx, edx;
+    read_cpuid_full(CPUID_FEATURES, &eax, &ebx, &ecx, &edx);
+    return (ecx & CPUID_ECX_SSE3) != 0;
 }
 
 /**
@@ -298,9 +311,9 @@ __PRIVILEGED_CODE static inline bool cpuid_is_sse3_supported() {
  * @note Privilege: **required**
  */
 __PRIVILEGED_CODE static inline bool cpuid_is_avx_supported() {
-    uint32_t eax, edx;
-    read_cpuid(CPUID_FEATURES, &eax, &edx);
-    return (eax & CPUID_ECX_AVX) != 0;
+    uint32_t eax, ebx, ecx, edx;
+    read_cpuid_full(CPUID_FEATURES, &eax, &ebx, &ecx, &edx);
+    return (ecx & CPUID_ECX_AVX) != 0;
 }
 
 /**
@@ -312,11 +325,47 @@ __PRIVILEGED_CODE static inline bool cpuid_is_avx_supported() {
  * @note Privilege: **required**
  */
 __PRIVILEGED_CODE static inline bool cpuid_is_fma_supported() {
+    uint32_t eax, ebx, ecx, edx;
+    read_cpuid_full(CPUID_FEATURES, &eax, &ebx, &ecx, &edx);
+    return (ecx & CPUID_ECX_FMA) != 0;
+}
+
+
+/**
+ * @brief Checks if the CPU supports the FXSAVE and FXRSTOR instructions.
+ * @return True if FXSR is supported, false otherwise.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE static inline bool cpuid_is_fxsr_supported() {
     uint32_t eax, edx;
     read_cpuid(CPUID_FEATURES, &eax, &edx);
-    return (eax & CPUID_ECX_FMA) != 0;
+    return (edx & CPUID_FEAT_EDX_FXSR) != 0;
 }
 
+/**
+ * @brief Checks if the CPU supports the XSAVE family of instructions.
+ * @return True if XSAVE is supported, false otherwise.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE static inline bool cpuid_is_xsave_supported() {
+    uint32_t eax, ebx, ecx, edx;
+    read_cpuid_full(CPUID_FEATURES, &eax, &ebx, &ecx, &edx);
+    return (ecx & CPUID_FEAT_ECX_XSAVE) != 0;
+}
+
+/**
+ * @brief Checks if the CPU supports the XSAVEOPT instruction.
+ * @return True if XSAVEOPT is supported, false otherwise.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE static inline bool cpuid_is_xsaveopt_supported() {
+    uint32_t eax, ebx, ecx, edx;
+    read_cpuid_full(CPUID_XSAVE_STATE, 1, &eax, &ebx, &ecx, &edx);
+    return (eax & CPUID_FEAT_EAX_XSAVEOPT) != 0;
+}
 
 /**
  * @brief Checks if the CPU supports the Page Attribute Table (PAT).
@@ -0,0 +1,15 @@
+#ifdef ARCH_X86_64
+#ifndef PAGE_FAULT_H
+#define PAGE_FAULT_H
+#include <interrupts/irq.h>
+
+// Page fault error code bits
+#define PF_ERR_PRESENT      (1ULL << 0)     // Protection violation, the page was present
+#define PF_ERR_WRITE        (1ULL << 1)     // The access was a write
+
+namespace arch::x86 {
+DEFINE_INT_HANDLER(exc_page_fault_handler);
+} // namespace arch::x86
+
+#endif // PAGE_FAULT_H
+#endif // ARCH_X86_64
@@ -0,0 +1,107 @@
+#ifdef ARCH_X86_64
+#ifndef FPU_H
+#define FPU_H
+#include <interrupts/irq.h>
+
+// XCR0 state component bits
+#define XFEATURE_X87            (1ULL << 0)
+#define XFEATURE_SSE            (1ULL << 1)
+#define XFEATURE_AVX            (1ULL << 2)
+
+// Offsets of the control words inside of the legacy FXSAVE region
+#define FXSAVE_FCW_OFFSET       0
+#define FXSAVE_MXCSR_OFFSET     24
+
+// Power-on values of the x87 control word and MXCSR
+#define FPU_DEFAULT_FCW         0x037F
+#define FPU_DEFAULT_MXCSR       0x1F80
+
+// Size of the legacy FXSAVE region, also the minimum size of an XSAVE area
+#define FXSAVE_AREA_SIZE        512
+
+// Per-task extended state buffers are allocated in whole pages
+#define FPU_STATE_PAGES         1
+
+struct task_control_block;
+
+namespace arch::x86 {
+/**
+ * @enum fpu_switch_policy
+ * @brief Determines when a task's extended register state gets restored.
+ */
+enum class fpu_switch_policy {
+    // Restore state on the first FPU/SIMD instruction after a switch (#NM trap)
+    LAZY = 0,
+
+    // Restore state during the switch for tasks that have used the FPU before
+    EAGER
+};
+
+/**
+ * @brief Enables x87/SSE/AVX support and extended state management on the current CPU.
+ * @param cpu_id ID of the current CPU.
+ *
+ * Sets up CR0/CR4 and XCR0, picking XSAVEOPT, XSAVE or FXSAVE depending on what
+ * the processor supports. Must be called after the CPU's per-CPU area is set up.
+ *
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void init_fpu(uint8_t cpu_id);
+
+/**
+ * @brief Selects when extended state is restored on context switches.
+ * @param policy The policy to apply to all CPUs.
+ *
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void fpu_set_switch_policy(fpu_switch_policy policy);
+
+/**
+ * @brief Retrieves the size of a task's extended state area in bytes.
+ * @return The size of the save area, or 0 if extended state management is unavailable.
+ *
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE size_t fpu_state_size();
+
+/**
+ * @brief Allocates and initializes the extended state area of a task.
+ * @param task The task that will own the state area.
+ * @return True if the area was allocated, false otherwise.
+ *
+ * Only tasks with an extended state area may execute FPU/SIMD instructions.
+ *
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE bool fpu_alloc_task_state(task_control_block* task);
+
+/**
+ * @brief Releases the extended state area of a task.
+ * @param task The task owning the state area.
+ *
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void fpu_free_task_state(task_control_block* task);
+
+/**
+ * @brief Saves and restores extended state as part of a context switch.
+ * @param from The task being switched out.
+ * @param to The task being switched in.
+ *
+ * State is only saved if the outgoing task executed FPU/SIMD instructions during its time
+ * slice. Under the lazy policy, the incoming task's state is left for the #NM handler to load
+ * unless it is still live in this CPU's registers. Switches between tasks that never touch
+ * extended state cost nothing beyond a CR0 read.
+ *
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void fpu_switch_context(task_control_block* from, task_control_block* to);
+
+/**
+ * @brief Handles the Device Not Available (#NM) exception raised while CR0.TS is set.
+ */
+DEFINE_INT_HANDLER(exc_device_not_available_handler);
+} // namespace arch::x86
+
+#endif // FPU_H
+#endif // ARCH_X86_64
@@ -0,0 +1,43 @@
+#ifndef LZ4_H
+#define LZ4_H
+#include <types.h>
+
+// Magic number at the start of every LZ4 frame
+#define LZ4_FRAME_MAGIC             0x184D2204
+
+namespace lz4 {
+/**
+ * @brief Checks whether a buffer starts with an LZ4 frame.
+ * @param data Pointer to the buffer.
+ * @param length Length of the buffer in bytes.
+ * @return True if the buffer starts with the LZ4 frame magic number.
+ */
+bool is_frame(const uint8_t* data, size_t length);
+
+/**
+ * @brief Determines the decompressed size of an LZ4 frame.
+ * @param src Pointer to the frame.
+ * @param length Length of the frame in bytes.
+ * @return The decompressed size, or -1 if the frame is malformed.
+ *
+ * Uses the content size from the frame header if the compressor recorded one, otherwise
+ * the blocks get parsed without writing any output to add up the length of their data.
+ */
+ssize_t get_content_size(const uint8_t* src, size_t length);
+
+/**
+ * @brief Decompresses an LZ4 frame.
+ * @param src Pointer to the frame.
+ * @param length Length of the frame in bytes.
+ * @param dst Destination buffer.
+ * @param capacity Capacity of the destination buffer in bytes.
+ * @return Number of bytes written to `dst`, or -1 if the frame is malformed or doesn't fit.
+ *
+ * Blocks are decoded one after the other straight into the destination, which is how
+ * blocks that reference data of previous blocks are resolved, so no intermediate block
+ * buffers are needed. Checksums are skipped, not verified.
+ */
+ssize_t decompress_frame(const uint8_t* src, size_t length, uint8_t* dst, size_t capacity);
+} // namespace lz4
+
+#endif // LZ4_H
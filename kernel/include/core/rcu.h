@@ -0,0 +1,100 @@
+#ifndef RCU_H
+#define RCU_H
+#include <types.h>
+#include <kstl/atomic.h>
+
+struct task_control_block;
+
+/**
+ * @namespace rcu
+ * @brief Lightweight read-copy-update mechanism for read-mostly data.
+ * 
+ * Readers access RCU-protected pointers inside a read-side critical section without taking
+ * any locks or writing shared memory. Writers publish a modified copy of the data and then
+ * wait for a grace period before freeing the old version.
+ * 
+ * Grace periods are detected through per-CPU quiescent states reported by the scheduler:
+ * a CPU passes through a quiescent state on every scheduler invocation where the running
+ * task is outside of a read-side critical section. Readers that get preempted or sleep
+ * inside a critical section are tracked separately and also hold back grace periods.
+ */
+namespace rcu {
+/**
+ * @brief Enters an RCU read-side critical section.
+ * 
+ * Critical sections can be nested and are cheap enough to be used on hot lookup paths.
+ */
+void read_lock();
+
+/**
+ * @brief Leaves an RCU read-side critical section.
+ */
+void read_unlock();
+
+/**
+ * @brief Waits until all pre-existing RCU read-side critical sections have completed.
+ * 
+ * After this returns, data that was unpublished before the call can no longer be referenced
+ * by any reader and may be freed. Must not be called from within a read-side critical section.
+ */
+void synchronize();
+
+/**
+ * @brief Reports a quiescent state for the current CPU if the task is not in a read-side section.
+ * @param task The task currently running on the CPU.
+ * 
+ * Called by the scheduler on every scheduling decision.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void note_quiescent_state(task_control_block* task);
+
+/**
+ * @brief Records that a task is being switched out.
+ * @param task The task being switched out.
+ * 
+ * Tasks preempted inside of a read-side critical section are accounted as blocked readers
+ * until they leave the critical section.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void note_context_switch(task_control_block* task);
+
+/**
+ * @brief Reads an RCU-protected pointer inside a read-side critical section.
+ * @param ptr The RCU-protected pointer.
+ * @return The current value of the pointer.
+ */
+template <typename T>
+__force_inline__ T* dereference(T* const& ptr) {
+    return kstl::atomic_load(&ptr, kstl::memory_order::acquire);
+}
+
+/**
+ * @brief Publishes a new value of an RCU-protected pointer.
+ * @param ptr The RCU-protected pointer.
+ * @param value The new value, fully initialized before the call.
+ * 
+ * The release store orders initialization before publication,
+ * which is a plain store on x86.
+ */
+template <typename T>
+__force_inline__ void assign_pointer(T*& ptr, T* value) {
+    kstl::atomic_store(&ptr, value, kstl::memory_order::release);
+}
+
+/**
+ * @class read_guard
+ * @brief Provides RAII-style management of an RCU read-side critical section.
+ */
+class read_guard {
+public:
+    read_guard() { read_lock(); }
+    ~read_guard() { read_unlock(); }
+
+    read_guard(const read_guard&) = delete;
+    read_guard& operator=(const read_guard&) = delete;
+};
+} // namespace rcu
+
+#endif // RCU_H
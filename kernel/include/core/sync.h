@@ -1,12 +1,25 @@
 #ifndef SYNC_H
 #define SYNC_H
 #include <types.h>
+#include <kstl/atomic.h>
 
 #define SPINLOCK_STATE_UNLOCKED  0
 #define SPINLOCK_STATE_LOCKED    1
 
 #define MUTEX_STATE_UNLOCKED     0
-#define MUTEX_STATE_LOCKED       1
+
+// Low bits of the mutex owner word, task control blocks are at least 8-byte aligned
+#define MUTEX_FLAG_WAITERS       0x1
+#define MUTEX_FLAG_MASK          0x7
+
+// Upper bound on pause iterations spent spinning on a running owner
+#define MUTEX_ADAPTIVE_SPIN_LIMIT 8192
+
+#define RWLOCK_STATE_UNLOCKED    0
+#define RWLOCK_STATE_WRITER      -1
+
+// Number of pause iterations before a waiting rwlock acquirer yields
+#define RWLOCK_SPIN_LIMIT        1024
 
 #ifdef ARCH_X86_64
     #define memory_barrier() asm volatile("mfence" ::: "memory");
@@ -18,19 +31,70 @@
     #define store_memory_barrier()
 #endif
 
+#define MAX_TRACKED_LOCKS        64
+
+/**
+ * @struct lock_stats
+ * @brief Contention counters collected for a single lock.
+ * 
+ * Counters are only updated by the lock holder, so they are naturally serialized
+ * by the lock they describe. Hold times are measured in TSC cycles.
+ */
+struct lock_stats {
+    const char* name;           // Human-readable lock name
+    uint64_t acquisitions;      // Number of successful acquisitions
+    uint64_t contentions;       // Number of acquisitions that had to wait
+    uint64_t spins;             // Total number of spin iterations while waiting
+    uint64_t max_hold_cycles;   // Longest observed hold time
+    uint64_t total_hold_cycles; // Accumulated hold time
+};
+
+namespace lockstat {
+/**
+ * @brief Allocates a statistics slot for a lock.
+ * @param name Human-readable name of the lock, must outlive the lock.
+ * @return Pointer to the statistics slot, or `nullptr` if all slots are taken.
+ */
+lock_stats* register_lock(const char* name);
+
+/**
+ * @brief Retrieves the number of locks that have statistics enabled.
+ */
+size_t count();
+
+/**
+ * @brief Retrieves the statistics slot at the given index.
+ * @param index Index in the range [0, count()).
+ * @return Pointer to the statistics slot, or `nullptr` if the index is invalid.
+ */
+const lock_stats* get(size_t index);
+
+/**
+ * @brief Clears the counters of all tracked locks.
+ */
+void reset();
+
+/**
+ * @brief Prints the counters of all tracked locks to the kernel log.
+ */
+void dump();
+} // namespace lockstat
+
 /**
  * @class spinlock
- * @brief Implements a simple spinlock for low-level mutual exclusion.
+ * @brief Implements a fair ticket spinlock for low-level mutual exclusion.
  * 
  * A spinlock is a busy-wait synchronization primitive designed for situations where locks are held
- * for short durations. It uses atomic operations to acquire and release the lock.
+ * for short durations. Each acquirer atomically takes a ticket and waits for the owner field to reach
+ * it, which grants the lock in FIFO order and keeps waiters spinning on plain reads instead of
+ * hammering the cache line with atomic writes.
  */
 class spinlock {
 public:
     /**
      * @brief Constructs a spinlock in the unlocked state.
      */
-    explicit spinlock() : m_state(SPINLOCK_STATE_UNLOCKED) {}
+    explicit spinlock() : m_owner(0), m_next(0), m_stats(nullptr), m_acquired_at(0) {}
 
     /**
      * @brief Acquires the lock.
@@ -54,18 +118,44 @@ public:
      */
     bool try_lock();
 
-private:
-    volatile int m_state; /** Lock state: 0 = unlocked, 1 = locked */
+    /**
+     * @brief Disables local interrupts and acquires the lock.
+     * @return The saved interrupt state to be passed to `unlock_irqrestore`.
+     * 
+     * Must be used for locks that are also taken from interrupt handlers,
+     * otherwise an interrupt arriving on the holder's CPU deadlocks.
+     * 
+     * @note Privilege: **required**
+     */
+    uint64_t lock_irqsave();
 
     /**
-     * @brief Atomically exchanges the value at a given address.
-     * @param addr Pointer to the value to modify.
-     * @param new_value The new value to store at the address.
-     * @return The old value at the address.
+     * @brief Releases the lock and restores the saved interrupt state.
+     * @param flags Interrupt state returned by `lock_irqsave`.
      * 
-     * Used internally for lock operations.
+     * @note Privilege: **required**
+     */
+    void unlock_irqrestore(uint64_t flags);
+
+    /**
+     * @brief Checks whether the lock is currently held.
      */
-    int _atomic_xchg(volatile int* addr, int new_value);
+    bool is_locked() const {
+        return m_owner.load(kstl::memory_order::relaxed) != m_next.load(kstl::memory_order::relaxed);
+    }
+
+    /**
+     * @brief Enables contention statistics for this lock.
+     * @param name Human-readable name shown in lock statistics dumps.
+     */
+    void enable_stats(const char* name);
+
+private:
+    kstl::atomic<uint16_t> m_owner; /** Ticket currently being served */
+    kstl::atomic<uint16_t> m_next;  /** Next ticket to be handed out */
+
+    lock_stats* m_stats;            /** Optional contention counters */
+    uint64_t    m_acquired_at;      /** TSC value at the time of acquisition */
 };
 
 /**
@@ -95,19 +185,155 @@ private:
     spinlock& m_lock; /** Reference to the managed spinlock */
 };
 
+/**
+ * @class spinlock_irqsave_guard
+ * @brief Provides RAII-style management of a spinlock with local interrupts disabled.
+ * 
+ * Saves the interrupt state and disables interrupts before acquiring the spinlock,
+ * then releases the lock and restores the interrupt state on destruction.
+ * 
+ * @note Privilege: **required**
+ */
+class spinlock_irqsave_guard {
+public:
+    /**
+     * @brief Constructs a spinlock_irqsave_guard and acquires the given spinlock.
+     * @param lock Reference to the spinlock to manage.
+     */
+    explicit spinlock_irqsave_guard(spinlock& lock) : m_lock(lock) {
+        m_flags = m_lock.lock_irqsave();
+    }
+
+    /**
+     * @brief Destroys the guard, releasing the lock and restoring interrupts.
+     */
+    ~spinlock_irqsave_guard() {
+        m_lock.unlock_irqrestore(m_flags);
+    }
+
+private:
+    spinlock& m_lock; /** Reference to the managed spinlock */
+    uint64_t m_flags; /** Saved interrupt state */
+};
+
+/**
+ * @struct mcs_node
+ * @brief Per-acquirer queue node used by the MCS spinlock.
+ * 
+ * Every waiter spins on its own node, so a lock handoff only touches
+ * the cache line of the next waiter in line.
+ */
+struct mcs_node {
+    kstl::atomic<mcs_node*> next;
+    kstl::atomic<int>       locked;
+};
+
+/**
+ * @class mcs_spinlock
+ * @brief Implements a queued MCS spinlock.
+ * 
+ * Waiters form a linked queue of caller-provided nodes and each one spins on a flag
+ * in its own node. This scales better than a ticket lock for heavily contended locks
+ * shared across many CPUs, at the cost of requiring a node for every acquisition.
+ */
+class mcs_spinlock {
+public:
+    /**
+     * @brief Constructs an MCS spinlock in the unlocked state.
+     */
+    explicit mcs_spinlock() : m_tail(nullptr), m_stats(nullptr), m_acquired_at(0) {}
+
+    /**
+     * @brief Acquires the lock using the provided queue node.
+     * @param node Queue node owned by the caller until `unlock` returns.
+     */
+    void lock(mcs_node& node);
+
+    /**
+     * @brief Releases the lock and hands it to the next queued waiter.
+     * @param node The same queue node that was used to acquire the lock.
+     */
+    void unlock(mcs_node& node);
+
+    /**
+     * @brief Attempts to acquire the lock without blocking.
+     * @param node Queue node owned by the caller until `unlock` returns.
+     * @return True if the lock was successfully acquired, false otherwise.
+     */
+    bool try_lock(mcs_node& node);
+
+    /**
+     * @brief Enables contention statistics for this lock.
+     * @param name Human-readable name shown in lock statistics dumps.
+     */
+    void enable_stats(const char* name);
+
+private:
+    kstl::atomic<mcs_node*> m_tail; /** Last waiter in the queue, nullptr if unlocked */
+
+    lock_stats* m_stats;            /** Optional contention counters */
+    uint64_t    m_acquired_at;      /** TSC value at the time of acquisition */
+};
+
+/**
+ * @class mcs_spinlock_guard
+ * @brief Provides RAII-style management of an MCS spinlock.
+ * 
+ * Owns the queue node on the caller's stack for the duration of the critical section.
+ */
+class mcs_spinlock_guard {
+public:
+    /**
+     * @brief Constructs an mcs_spinlock_guard and acquires the given lock.
+     * @param lock Reference to the MCS spinlock to manage.
+     */
+    explicit mcs_spinlock_guard(mcs_spinlock& lock) : m_lock(lock), m_node() {
+        m_lock.lock(m_node);
+    }
+
+    /**
+     * @brief Destroys the guard and releases the managed lock.
+     */
+    ~mcs_spinlock_guard() {
+        m_lock.unlock(m_node);
+    }
+
+private:
+    mcs_spinlock& m_lock; /** Reference to the managed lock */
+    mcs_node m_node;      /** Queue node used for this acquisition */
+};
+
+struct task_control_block;
+
+/**
+ * @struct mutex_waiter
+ * @brief Wait queue entry of a task parked on a mutex.
+ * 
+ * Entries live on the waiting task's stack for the duration of the wait.
+ */
+struct mutex_waiter {
+    task_control_block* task;
+    mutex_waiter*       next;
+};
+
 /**
  * @class mutex
- * @brief Implements a mutex for blocking mutual exclusion.
+ * @brief Implements an adaptive mutex for blocking mutual exclusion.
+ * 
+ * The lock word records the owning task. A contended acquirer spins briefly while the owner
+ * is running on another CPU, since the lock is likely to be released soon, and otherwise
+ * parks on a FIFO wait queue and gets descheduled. Unlocking with waiters present hands
+ * ownership directly to the first waiter, which prevents barging and starvation.
  * 
- * A mutex is a synchronization primitive that blocks the thread until the lock becomes available.
- * It uses atomic operations to ensure exclusive access.
+ * Contexts that cannot sleep (interrupt handlers, interrupt-disabled sections and the
+ * idle task) never park and fall back to spinning with yields.
  */
 class mutex {
 public:
     /**
      * @brief Constructs a mutex in the unlocked state.
      */
-    explicit mutex() : m_state(MUTEX_STATE_UNLOCKED) {}
+    explicit mutex() : m_owner(MUTEX_STATE_UNLOCKED), m_wait_head(nullptr), m_wait_tail(nullptr) {}
 
     /**
      * @brief Acquires the lock, blocking until it becomes available.
@@ -117,7 +343,8 @@ public:
     /**
      * @brief Releases the lock.
      * 
-     * Marks the lock as unlocked, allowing other threads to acquire it.
+     * Hands the lock off to the first waiter if there is one,
+     * otherwise marks the lock as unlocked.
      */
     void unlock();
 
@@ -129,19 +356,48 @@ public:
      */
     bool try_lock();
 
+    /**
+     * @brief Retrieves the task currently holding the lock.
+     * @return Pointer to the owner's task control block, or `nullptr` if unlocked.
+     */
+    task_control_block* owner() const {
+        return reinterpret_cast<task_control_block*>(m_owner.load(kstl::memory_order::relaxed) & ~MUTEX_FLAG_MASK);
+    }
+
 private:
-    volatile int m_state; /** Lock state: 0 = unlocked, 1 = locked */
+    kstl::atomic<uintptr_t> m_owner; /** Owner task pointer combined with MUTEX_FLAG_* bits, 0 = unlocked */
+    spinlock m_wait_lock;            /** Protects the wait queue */
+    mutex_waiter* m_wait_head;       /** First task in line for a handoff */
+    mutex_waiter* m_wait_tail;       /** Last task in line */
 
     /**
-     * @brief Atomically compares and exchanges a value at a given address.
-     * @param addr Pointer to the value to modify.
-     * @param expected The expected value at the address.
-     * @param new_value The new value to store if the expected value matches.
+     * @brief Atomically replaces the owner word if it matches the expected value.
+     * @param expected The expected owner word.
+     * @param new_value The new owner word to store if the expected value matches.
      * @return True if the exchange was successful, false otherwise.
      * 
-     * Used internally for lock operations.
+     * Successful exchanges have acquire semantics.
      */
-    bool _atomic_cmpxchg(volatile int* addr, int expected, int new_value);
+    bool _cmpxchg_owner(uintptr_t expected, uintptr_t new_value) {
+        return m_owner.compare_exchange_strong(expected, new_value, kstl::memory_order::acquire);
+    }
+
+    /**
+     * @brief Spins while the owner is running on another CPU.
+     * @return True if the lock was acquired while spinning.
+     */
+    bool _optimistic_spin(uintptr_t self);
+
+    /**
+     * @brief Queues the current task and deschedules it until the lock is handed off.
+     * @return True once the lock was acquired, the task never returns while still queued.
+     */
+    bool _park(uintptr_t self);
+
+    /**
+     * @brief Hands the lock off to the first waiter or releases it.
+     */
+    void _unlock_slowpath();
 };
 
 /**
@@ -171,4 +427,106 @@ private:
     mutex& m_mutex; /** Reference to the managed mutex */
 };
 
+/**
+ * @class rwlock
+ * @brief Implements a writer-preferring reader-writer spinlock.
+ * 
+ * Any number of readers can hold the lock concurrently, while writers get exclusive access.
+ * Once a writer is waiting, new readers hold off so that writers can't be starved by a
+ * steady stream of readers. Waiters spin for a while and then yield if the context allows it.
+ */
+class rwlock {
+public:
+    /**
+     * @brief Constructs a reader-writer lock in the unlocked state.
+     */
+    explicit rwlock() : m_state(RWLOCK_STATE_UNLOCKED), m_waiting_writers(0) {}
+
+    /**
+     * @brief Acquires the lock for shared read access.
+     */
+    void read_lock();
+
+    /**
+     * @brief Releases shared read access.
+     */
+    void read_unlock();
+
+    /**
+     * @brief Acquires the lock for exclusive write access.
+     */
+    void write_lock();
+
+    /**
+     * @brief Releases exclusive write access.
+     */
+    void write_unlock();
+
+    /**
+     * @brief Attempts to acquire shared read access without blocking.
+     * @return True if the lock was successfully acquired, false otherwise.
+     */
+    bool try_read_lock();
+
+    /**
+     * @brief Attempts to acquire exclusive write access without blocking.
+     * @return True if the lock was successfully acquired, false otherwise.
+     */
+    bool try_write_lock();
+
+private:
+    kstl::atomic<int32_t> m_state;           /** Number of readers, or RWLOCK_STATE_WRITER if write-locked */
+    kstl::atomic<int32_t> m_waiting_writers; /** Number of writers waiting for the lock */
+
+    /**
+     * @brief Atomically replaces the lock state if it matches the expected value.
+     * 
+     * Successful exchanges have acquire semantics.
+     */
+    bool _cmpxchg_state(int32_t expected, int32_t new_value) {
+        return m_state.compare_exchange_strong(expected, new_value, kstl::memory_order::acquire);
+    }
+
+    /**
+     * @brief Relaxes the CPU between acquisition attempts.
+     */
+    void _backoff(uint64_t& spins);
+};
+
+/**
+ * @class rwlock_read_guard
+ * @brief Provides RAII-style shared ownership of a reader-writer lock.
+ */
+class rwlock_read_guard {
+public:
+    explicit rwlock_read_guard(rwlock& lock) : m_lock(lock) {
+        m_lock.read_lock();
+    }
+
+    ~rwlock_read_guard() {
+        m_lock.read_unlock();
+    }
+
+private:
+    rwlock& m_lock; /** Reference to the managed lock */
+};
+
+/**
+ * @class rwlock_write_guard
+ * @brief Provides RAII-style exclusive ownership of a reader-writer lock.
+ */
+class rwlock_write_guard {
+public:
+    explicit rwlock_write_guard(rwlock& lock) : m_lock(lock) {
+        m_lock.write_lock();
+    }
+
+    ~rwlock_write_guard() {
+        m_lock.write_unlock();
+    }
+
+private:
+    rwlock& m_lock; /** Reference to the managed lock */
+};
+
 #endif // SYNC_H
\ No newline at end of file
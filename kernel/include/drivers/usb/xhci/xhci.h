@@ -262,12 +262,19 @@ private:
     kstl::vector<xhci_port_connection_event> m_port_connection_events;
 
 private:
+    // Pops the oldest pending port connection event, returns false if none are queued
+    bool _pop_port_connection_event(xhci_port_connection_event& event);
+
+    // Protects the event queues shared with the IRQ handler
+    spinlock m_event_lock = spinlock();
+
     kstl::vector<xhci_port_status_change_trb_t*> m_port_status_change_events;
     kstl::vector<xhci_command_completion_trb_t*> m_command_completion_events;
     kstl::vector<xhci_transfer_completion_trb_t*> m_transfer_completion_events;
 
-    volatile uint8_t m_command_irq_completed = 0;
-    volatile uint8_t m_transfer_irq_completed = 0;
+    // Set by the IRQ handler once completion events have been queued
+    kstl::atomic<uint8_t> m_command_irq_completed = 0;
+    kstl::atomic<uint8_t> m_transfer_irq_completed = 0;
 
     static mutex s_xhc_command_lock;
     static mutex s_xhc_device_setup_lock;
@@ -0,0 +1,121 @@
+#ifndef BLOCK_DEVICE_H
+#define BLOCK_DEVICE_H
+#include "filesystem.h"
+
+// Block size of RAM disks unless specified otherwise
+#define RAM_BLOCK_DEVICE_DEFAULT_BLOCK_SIZE 512
+
+namespace fs {
+/**
+ * @class block_device
+ * @brief Interface of storage devices that transfer data in fixed-size blocks.
+ *
+ * Blocks are addressed by their logical block address (LBA). The block size has to
+ * be a power of two no larger than a page, so a page is always made of whole blocks.
+ */
+class block_device {
+public:
+    virtual ~block_device() = default;
+
+    /**
+     * @brief Retrieves the size of a block in bytes.
+     */
+    virtual size_t block_size() const = 0;
+
+    /**
+     * @brief Retrieves the number of blocks on the device.
+     */
+    virtual uint64_t block_count() const = 0;
+
+    /**
+     * @brief Reads consecutive blocks.
+     * @param lba Address of the first block.
+     * @param count Number of blocks to read.
+     * @param buffer Buffer of at least `count * block_size()` bytes.
+     * @return Number of blocks read on success, or a negative error code.
+     */
+    virtual ssize_t read_blocks(uint64_t lba, size_t count, void* buffer) = 0;
+
+    /**
+     * @brief Writes consecutive blocks.
+     * @param lba Address of the first block.
+     * @param count Number of blocks to write.
+     * @param buffer Buffer of at least `count * block_size()` bytes.
+     * @return Number of blocks written on success, or a negative error code.
+     */
+    virtual ssize_t write_blocks(uint64_t lba, size_t count, const void* buffer) = 0;
+
+    /**
+     * @brief Waits until every completed write has reached stable storage.
+     * @return `fs_error::success` on success, or an appropriate error code.
+     */
+    virtual fs_error flush() { return fs_error::success; }
+
+    /**
+     * @brief Retrieves the capacity of the device in bytes.
+     */
+    uint64_t capacity() const { return block_count() * block_size(); }
+};
+
+/**
+ * @class ram_block_device
+ * @brief Block device backed by kernel memory.
+ *
+ * Lets the block layer and the page cache be exercised without any storage hardware.
+ * The storage is user-accessible, since the page cache fills its pages from the
+ * context of whoever is reading, and it is freed when the device is destroyed.
+ */
+class ram_block_device : public block_device {
+public:
+    /**
+     * @brief Creates a zero-filled RAM disk.
+     * @param block_count Number of blocks.
+     * @param block_size Size of a block in bytes, a power of two no larger than a page.
+     *
+     * Check `is_valid` to find out whether the storage could be allocated.
+     */
+    ram_block_device(uint64_t block_count, size_t block_size = RAM_BLOCK_DEVICE_DEFAULT_BLOCK_SIZE);
+    ~ram_block_device();
+
+    ram_block_device(const ram_block_device&) = delete;
+    ram_block_device& operator=(const ram_block_device&) = delete;
+
+    /**
+     * @brief Checks whether the geometry was valid and the storage could be allocated.
+     */
+    bool is_valid() const { return m_storage != nullptr; }
+
+    size_t block_size() const override { return m_block_size; }
+    uint64_t block_count() const override { return m_block_count; }
+
+    ssize_t read_blocks(uint64_t lba, size_t count, void* buffer) override;
+    ssize_t write_blocks(uint64_t lba, size_t count, const void* buffer) override;
+
+    /**
+     * @brief Retrieves the number of blocks transferred from the device so far.
+     */
+    uint64_t get_blocks_read() const { return m_blocks_read; }
+
+    /**
+     * @brief Retrieves the number of blocks transferred to the device so far.
+     */
+    uint64_t get_blocks_written() const { return m_blocks_written; }
+
+private:
+    uint8_t*    m_storage;
+    size_t      m_block_size;
+    uint64_t    m_block_count;
+    size_t      m_page_count;
+    uint64_t    m_blocks_read;
+    uint64_t    m_blocks_written;
+
+    /**
+     * @brief Checks that a transfer stays within the device.
+     */
+    bool _in_range(uint64_t lba, size_t count) const {
+        return lba <= m_block_count && count <= m_block_count - lba;
+    }
+};
+} // namespace fs
+
+#endif // BLOCK_DEVICE_H
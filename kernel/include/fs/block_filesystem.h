@@ -0,0 +1,69 @@
+#ifndef BLOCK_FILESYSTEM_H
+#define BLOCK_FILESYSTEM_H
+#include "block_device.h"
+#include "page_cache.h"
+
+namespace fs {
+/**
+ * @class block_filesystem
+ * @brief Exposes the raw contents of a block device as a single file.
+ *
+ * The root node of the filesystem is a file of the device's capacity, so mounting it at
+ * a path like `/dev/ram0` makes the device accessible through the regular file calls.
+ * Reads and writes go through the page cache, which batches device access, reads ahead
+ * of sequential readers and defers writes until the pages are evicted or synced.
+ */
+class block_filesystem : public filesystem {
+public:
+    /**
+     * @brief Creates a filesystem for a block device.
+     * @param device Device to expose, its block size has to divide the page size.
+     */
+    explicit block_filesystem(const kstl::shared_ptr<block_device>& device);
+
+    /**
+     * @brief Creates the root node, a file spanning the whole device.
+     * @return A shared pointer to the root node, or null if the device is unusable.
+     */
+    kstl::shared_ptr<vfs_node> create_root_node() override;
+
+    /**
+     * @brief Unmounts the filesystem.
+     *
+     * Writes back the dirty pages, flushes the device and drops the device's cached pages.
+     */
+    void unmount() override;
+
+    /**
+     * @brief Sets the operations for a given VFS node.
+     * @param node Shared pointer to the VFS node.
+     * @param path Path of the node within the filesystem.
+     */
+    void set_ops(kstl::shared_ptr<vfs_node>& node, const kstl::string& path) override;
+
+    /**
+     * @brief Writes back every dirty cached page and flushes the device.
+     * @return `fs_error::success` on success, or an appropriate error code.
+     */
+    fs_error sync();
+
+private:
+    kstl::shared_ptr<block_device>  m_device;
+    page_cache_mapping              m_mapping;
+    kstl::shared_ptr<vfs_node>      m_root;
+
+    static ssize_t block_read(vfs_node* node, void* buffer, size_t size, uint64_t offset);
+    static ssize_t block_write(vfs_node* node, const void* buffer, size_t size, uint64_t offset);
+
+    static ssize_t _fill_page(page_cache_mapping* mapping, uint64_t page_index, void* page);
+    static ssize_t _writeback_page(page_cache_mapping* mapping, uint64_t page_index, const void* page);
+
+    /**
+     * @brief Computes the range of device blocks backing a page.
+     * @return Number of blocks backing the page, less than a page's worth for the last page.
+     */
+    size_t _page_blocks(uint64_t page_index, uint64_t& out_lba) const;
+};
+} // namespace fs
+
+#endif // BLOCK_FILESYSTEM_H
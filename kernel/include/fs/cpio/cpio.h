@@ -46,17 +46,20 @@ bool cpio_is_dir(uint32_t mode);
  * @brief Loads an initrd (initial RAM disk) from a CPIO archive.
  * @param cpio_archive Pointer to the start of the CPIO archive.
  * @param length Length of the CPIO archive in bytes.
- * @param mount_path Path where the archive should be mounted or extracted.
+ * @param mount_path Path where the archive should be mounted.
+ * @param writable Whether the mounted archive gets a writable overlay.
  * 
- * Parses and processes the provided CPIO archive, loading its contents into the specified mount path.
- * The loaded contents are stored in a newly created and mounted RAM filesystem.
+ * Indexes the provided CPIO archive and mounts a `cpio_filesystem` at the specified path,
+ * which serves the files directly out of the archive. The archive has to stay mapped,
+ * user-accessible, for as long as it is mounted.
  * 
  * @note Privilege: **required**
  */
 __PRIVILEGED_CODE void load_cpio_initrd(
     const uint8_t* cpio_archive,
     size_t length,
-    const char* mount_path
+    const char* mount_path,
+    bool writable = false
 );
 } // namespace fs
 
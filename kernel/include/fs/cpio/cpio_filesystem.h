@@ -0,0 +1,147 @@
+#ifndef CPIO_FILESYSTEM_H
+#define CPIO_FILESYSTEM_H
+#include <fs/filesystem.h>
+#include <kstl/vector.h>
+#include <kstl/hashmap.h>
+#include <sync.h>
+
+namespace fs {
+/**
+ * @struct cpio_node
+ * @brief Represents a file or directory of an indexed CPIO archive.
+ *
+ * File data points straight into the archive until the file gets written to through
+ * the writable overlay, at which point it is copied into a buffer owned by the node.
+ *
+ * Nodes are reference counted, being linked into the tree counts as one reference and
+ * every VFS node referring to the node as another. Removed nodes that are still open
+ * get freed once the last VFS node referring to them is released.
+ */
+struct cpio_node {
+    kstl::string name;
+    vfs_node_type type;
+    uint32_t permissions;
+    uint64_t creation_ts;
+    uint64_t modification_ts;
+    uint64_t access_ts;
+    const uint8_t* data; // File data, inside the archive or the overlay buffer (only for files)
+    size_t data_size; // Size of the file data
+    uint8_t* overlay_data; // Copy of the file data owned by the node, once it was written to
+    size_t overlay_capacity; // Capacity of the overlay buffer
+    cpio_node* parent;
+    kstl::vector<cpio_node*> children; // Directory children in archive order
+    kstl::hashmap<kstl::string, cpio_node*>* children_by_name; // Directory children indexed by name (only for directories)
+    kstl::atomic<size_t> refs; // The link into the tree and every VFS node referring to the node
+};
+
+/**
+ * @class cpio_filesystem
+ * @brief Serves the contents of a newc CPIO archive in place.
+ *
+ * The archive is indexed once when the filesystem gets mounted, after which reads are
+ * copied straight out of the archive memory, so the archive's contents never get
+ * duplicated. The archive memory has to stay mapped for as long as the filesystem is
+ * mounted, and has to be user-accessible for unprivileged readers.
+ *
+ * The filesystem is read-only unless it was created with a writable overlay. Files and
+ * directories created through the overlay live in kernel memory, and files from the
+ * archive are copied out of it the first time they get written to.
+ */
+class cpio_filesystem : public filesystem {
+public:
+    /**
+     * @brief Creates a filesystem backed by a CPIO archive.
+     * @param archive Pointer to the start of the archive.
+     * @param length Length of the archive in bytes.
+     * @param writable Whether files and directories can be created, written and removed.
+     */
+    cpio_filesystem(const uint8_t* archive, size_t length, bool writable = false);
+
+    /**
+     * @brief Indexes the archive and creates the root node.
+     * @return A shared pointer to the root node, or null if the archive is malformed.
+     */
+    kstl::shared_ptr<vfs_node> create_root_node() override;
+
+    /**
+     * @brief Unmounts the filesystem.
+     *
+     * Frees the archive's index and any data written through the overlay.
+     */
+    void unmount() override;
+
+    /**
+     * @brief Sets the operations for a given VFS node.
+     * @param node Shared pointer to the VFS node.
+     * @param path Path of the node within the filesystem.
+     *
+     * Operations that modify the filesystem are only set if it has a writable overlay.
+     */
+    void set_ops(kstl::shared_ptr<vfs_node>& node, const kstl::string& path) override;
+
+    /**
+     * @brief Retrieves the number of archive entries that were indexed.
+     *
+     * Directories that are only implied by the paths of other entries are not counted.
+     */
+    size_t get_indexed_node_count() const { return m_indexed_nodes; }
+
+private:
+    const uint8_t*              m_archive;
+    size_t                      m_length;
+    bool                        m_writable;
+    size_t                      m_indexed_nodes;
+    cpio_node*                  m_root_node;
+    kstl::shared_ptr<vfs_node>  m_root;
+
+    // Shared by lookups and reads, held exclusively while the overlay modifies the tree
+    rwlock                      m_lock;
+
+    static ssize_t cpio_read(vfs_node* node, void* buffer, size_t size, uint64_t offset);
+    static ssize_t cpio_write(vfs_node* node, const void* buffer, size_t size, uint64_t offset);
+    static kstl::shared_ptr<vfs_node> cpio_lookup(vfs_node* parent, const char* name);
+    static int cpio_create(vfs_node* parent, const char* name, vfs_node_type type, uint32_t perms);
+    static int cpio_remove(vfs_node* parent, vfs_node* node);
+    static int cpio_listdir(vfs_node* node, kstl::vector<kstl::string>& entries);
+    static void cpio_release(vfs_node* node);
+
+    /**
+     * @brief Builds the node tree from the archive's headers.
+     * @return False if the archive is malformed.
+     */
+    bool _index_archive();
+
+    /**
+     * @brief Finds or creates the node for a path of the archive.
+     * @param path Path relative to the archive root, components separated by `/`.
+     * @param type Type of the node at the end of the path, missing parents become directories.
+     * @return The node, or `nullptr` if a parent is not a directory.
+     */
+    cpio_node* _index_path(const kstl::string& path, vfs_node_type type);
+
+    /**
+     * @brief Creates a node and links it into a directory, the lock must be held exclusively.
+     */
+    static cpio_node* _add_child(cpio_node* dir_node, const kstl::string& name, vfs_node_type type, uint32_t perms);
+
+    /**
+     * @brief Moves a file's data into its own overlay buffer large enough for `size` bytes.
+     * @return False if the buffer couldn't be allocated.
+     */
+    static bool _copy_up(cpio_node* file_node, size_t size);
+
+    /**
+     * @brief Unlinks a node and all of its children from the tree, the lock must be held exclusively.
+     * 
+     * Drops the tree's references, nodes still referred to by VFS nodes live on until those are released.
+     */
+    static void _unlink_node(cpio_node* node);
+
+    /**
+     * @brief Drops a reference to a node, freeing it along with the last one.
+     */
+    static void _put_node(cpio_node* node);
+};
+} // namespace fs
+
+#endif // CPIO_FILESYSTEM_H
@@ -0,0 +1,162 @@
+#ifndef DENTRY_CACHE_H
+#define DENTRY_CACHE_H
+#include "vfs_node.h"
+#include <sync.h>
+#include <kstl/atomic.h>
+
+// Number of hash buckets, must be a power of two
+#define DENTRY_CACHE_BUCKETS        256
+
+// Entries kept before the least recently used ones get trimmed
+#define DENTRY_CACHE_MAX_ENTRIES    1024
+
+// Unlinked entries collected before they are freed after a grace period
+#define DENTRY_CACHE_RETIRE_BATCH   64
+
+namespace fs {
+/**
+ * @struct dentry
+ * @brief Cached result of looking up a name in a directory.
+ * 
+ * A dentry without a node is a negative entry, it remembers that the name doesn't exist.
+ * Entries are immutable once published, a changed result replaces the whole entry.
+ */
+struct dentry {
+    kstl::shared_ptr<vfs_node>  parent;     // Directory the name was looked up in
+    kstl::string                name;
+    uint64_t                    hash;
+    kstl::shared_ptr<vfs_node>  node;       // Resolved node, null for negative entries
+    bool                        referenced; // Set by lookups, gives the entry a second chance at trimming
+
+    dentry*                     hash_next;  // RCU-protected
+    dentry*                     lru_prev;
+    dentry*                     lru_next;   // Links the retired list once unlinked
+};
+
+/**
+ * @struct dentry_cache_stats
+ * @brief Counters describing how well the dentry cache performs.
+ */
+struct dentry_cache_stats {
+    size_t      entries;        // Entries currently cached
+    uint64_t    hits;           // Lookups answered from the cache, including negative ones
+    uint64_t    misses;         // Lookups that had to ask the filesystem
+    uint64_t    evictions;      // Entries trimmed to stay within the size limit
+};
+
+/**
+ * @class dentry_cache
+ * @brief Hash of (parent node, name) to the node a path component resolves to.
+ * 
+ * Lets path resolution reuse the nodes of earlier lookups instead of asking the filesystem
+ * for a freshly allocated node on every component. Entries hold a reference to their parent,
+ * so a parent node's address can't be reused while entries keyed by it are still cached.
+ * Entries get trimmed in LRU order once the cache holds `DENTRY_CACHE_MAX_ENTRIES`, entries
+ * looked up since they were last considered get moved back to the front instead.
+ * 
+ * Lookups take no locks: hash chains are walked under RCU protection and the generation
+ * is an atomic counter. The lock only serializes writers (insert, invalidate, flush) and
+ * the LRU list. Unlinked entries are freed in batches once a grace period has passed.
+ * 
+ * Every invalidation bumps a generation counter. Lookups that raced with an invalidation
+ * pass the generation they started with to `insert`, which then drops their result.
+ * 
+ * A zero-filled cache is valid and empty.
+ */
+class dentry_cache {
+public:
+    /**
+     * @brief Looks up a cached name.
+     * @param parent Directory node the name is resolved in.
+     * @param name Name of the component, doesn't have to be null-terminated.
+     * @param length Length of the name.
+     * @param out_node Receives the cached node, null for a negative entry.
+     * @return True if the name was cached, false on a cache miss.
+     */
+    bool lookup(vfs_node* parent, const char* name, size_t length, kstl::shared_ptr<vfs_node>& out_node);
+
+    /**
+     * @brief Caches the result of a lookup.
+     * @param parent Directory node the name was resolved in.
+     * @param name Name of the component.
+     * @param node Resolved node, null to cache that the name doesn't exist.
+     * @param generation Value of `generation()` from before the filesystem was asked.
+     */
+    void insert(
+        const kstl::shared_ptr<vfs_node>& parent,
+        const kstl::string& name,
+        const kstl::shared_ptr<vfs_node>& node,
+        uint64_t generation
+    );
+
+    /**
+     * @brief Drops the entry for a single name.
+     */
+    void invalidate(vfs_node* parent, const kstl::string& name);
+
+    /**
+     * @brief Drops every entry.
+     */
+    void flush();
+
+    /**
+     * @brief Retrieves the current invalidation generation.
+     */
+    uint64_t generation();
+
+    /**
+     * @brief Retrieves the cache's counters.
+     */
+    void get_stats(dentry_cache_stats& stats);
+
+private:
+    mutex       m_lock;
+    dentry*     m_buckets[DENTRY_CACHE_BUCKETS];    // RCU-protected
+
+    // Most recently inserted entry first
+    dentry*     m_lru_head;
+    dentry*     m_lru_tail;
+
+    // Unlinked entries waiting for a grace period
+    dentry*     m_retired;
+    size_t      m_retired_count;
+
+    size_t                  m_count;
+    kstl::atomic<uint64_t>  m_generation;
+    kstl::atomic<uint64_t>  m_hits;
+    kstl::atomic<uint64_t>  m_misses;
+    uint64_t                m_evictions;
+
+    static uint64_t _hash(vfs_node* parent, const char* name, size_t length);
+
+    /**
+     * @brief Finds the link pointing to the entry for a name, the lock must be held.
+     * @return The bucket head or `hash_next` field that points to the entry, null if it's not cached.
+     */
+    dentry** _find_link(vfs_node* parent, const char* name, size_t length, uint64_t hash);
+
+    /**
+     * @brief Unlinks an entry and queues it to be freed, the lock must be held.
+     * @param link The bucket head or `hash_next` field pointing to the entry.
+     */
+    void _retire(dentry** link);
+
+    /**
+     * @brief Takes the retired entries off the cache, the lock must be held.
+     * @return The list, to be passed to `_free_retired` once the lock is released.
+     */
+    dentry* _take_retired();
+
+    /**
+     * @brief Waits for a grace period and frees a list of retired entries.
+     * 
+     * Must not be called with the lock held or from within an RCU read-side critical section.
+     */
+    static void _free_retired(dentry* list);
+
+    void _lru_unlink(dentry* entry);
+    void _lru_push_front(dentry* entry);
+};
+} // namespace fs
+
+#endif // DENTRY_CACHE_H
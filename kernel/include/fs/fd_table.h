@@ -0,0 +1,143 @@
+#ifndef FD_TABLE_H
+#define FD_TABLE_H
+#include "vfs_node.h"
+#include <sync.h>
+
+// Access mode and behavior flags for opening a file
+#define FS_O_RDONLY     0x0
+#define FS_O_WRONLY     0x1
+#define FS_O_RDWR       0x2
+#define FS_O_ACCMODE    0x3
+#define FS_O_CREAT      0x40
+#define FS_O_APPEND     0x400
+
+// Reference points for repositioning a file's offset
+#define FS_SEEK_SET     0
+#define FS_SEEK_CUR     1
+#define FS_SEEK_END     2
+
+// Descriptors 0-2 are reserved for the console streams
+#define FD_STDIN        0
+#define FD_STDOUT       1
+#define FD_STDERR       2
+#define FD_TABLE_FIRST_FD   3
+#define FD_TABLE_MAX_FDS    64
+
+namespace fs {
+/**
+ * @class open_file
+ * @brief A file opened through the VFS, the node it refers to is resolved once at open time.
+ * 
+ * Holds the file's offset, which `read` and `write` advance. Reference counted,
+ * the descriptor pointing at it and every operation in flight each hold a reference.
+ */
+class open_file {
+public:
+    open_file(const kstl::shared_ptr<vfs_node>& node, uint32_t flags)
+        : m_node(node), m_flags(flags), m_offset(0), m_refcount(1) {}
+
+    open_file(const open_file&) = delete;
+    open_file& operator=(const open_file&) = delete;
+
+    vfs_node* node() const { return m_node.get(); }
+    uint32_t flags() const { return m_flags; }
+
+    /**
+     * @brief Reads from the current offset and advances it.
+     * @return Number of bytes read on success, or a negative error code.
+     */
+    ssize_t read(void* buffer, size_t size);
+
+    /**
+     * @brief Writes at the current offset, or at the end of the file when opened for appending, and advances it.
+     * @return Number of bytes written on success, or a negative error code.
+     */
+    ssize_t write(const void* buffer, size_t size);
+
+    /**
+     * @brief Reads at an explicit offset, leaving the file's offset untouched.
+     * @return Number of bytes read on success, or a negative error code.
+     */
+    ssize_t pread(void* buffer, size_t size, uint64_t offset);
+
+    /**
+     * @brief Writes at an explicit offset, leaving the file's offset untouched.
+     * @return Number of bytes written on success, or a negative error code.
+     */
+    ssize_t pwrite(const void* buffer, size_t size, uint64_t offset);
+
+    /**
+     * @brief Repositions the file's offset.
+     * @param offset Offset relative to the position selected by `whence`.
+     * @param whence One of `FS_SEEK_SET`, `FS_SEEK_CUR` or `FS_SEEK_END`.
+     * @return The new offset on success, or a negative error code.
+     */
+    ssize_t lseek(int64_t offset, int whence);
+
+    void retain() {
+        m_refcount.fetch_add(1, kstl::memory_order::relaxed);
+    }
+
+    void release() {
+        if (m_refcount.fetch_sub(1, kstl::memory_order::acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+private:
+    kstl::shared_ptr<vfs_node>  m_node;
+    uint32_t                    m_flags;
+
+    mutex                       m_offset_lock = mutex();
+    uint64_t                    m_offset;
+
+    kstl::atomic<uint32_t>      m_refcount;
+};
+
+/**
+ * @class fd_table
+ * @brief Per-process table translating file descriptors into open files.
+ * 
+ * Userland processes have their own table, kernel tasks share the kernel's table.
+ * A zero-filled table is valid and empty.
+ */
+class fd_table {
+public:
+    ~fd_table();
+
+    /**
+     * @brief Retrieves the descriptor table of the calling task.
+     */
+    static fd_table* for_current_task();
+
+    /**
+     * @brief Installs an open file under the lowest free descriptor.
+     * @param file Open file, the table takes over one of the caller's references.
+     * @return The new descriptor, or -1 if the table is full.
+     */
+    int install(open_file* file);
+
+    /**
+     * @brief Resolves a descriptor.
+     * @return The open file with a reference taken for the caller, or `nullptr` if the descriptor is not open.
+     */
+    open_file* get(int fd);
+
+    /**
+     * @brief Closes a descriptor and drops its reference.
+     * @return False if the descriptor was not open.
+     */
+    bool close(int fd);
+
+    /**
+     * @brief Closes every open descriptor.
+     */
+    void close_all();
+
+private:
+    mutex       m_lock;
+    open_file*  m_files[FD_TABLE_MAX_FDS];
+};
+} // namespace fs
+
+#endif // FD_TABLE_H
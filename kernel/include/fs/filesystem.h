@@ -3,6 +3,9 @@
 #include "vfs_node.h"
 #include <sync.h>
 
+// Longest path accepted from userland, including the terminator
+#define FS_MAX_PATH_LENGTH 4096
+
 namespace fs {
 /**
  * @enum fs_error
@@ -26,7 +29,10 @@ enum class fs_error : ssize_t {
     bad_filesystem = -11,        // Filesystem related error
     invalid_argument = -12,      // Invalid argument to an operation
     not_a_file = -13,            // Not a file error
-    unknown_error = -14          // Generic error
+    unknown_error = -14,         // Generic error
+    bad_descriptor = -15,        // File descriptor is not open
+    too_many_open_files = -16,   // No free file descriptor left
+    canceled = -17               // Operation canceled before it ran
 };
 
 /**
@@ -52,6 +58,9 @@ inline const char* error_to_string(fs_error err) {
     case fs_error::bad_filesystem:       return "Bad filesystem";
     case fs_error::invalid_argument:     return "Invalid argument";
     case fs_error::not_a_file:           return "Not a file";
+    case fs_error::bad_descriptor:       return "Bad file descriptor";
+    case fs_error::too_many_open_files:  return "Too many open files";
+    case fs_error::canceled:             return "Operation canceled";
     default:                             return "Unknown error";
     }
 }
@@ -0,0 +1,235 @@
+#ifndef IO_RING_H
+#define IO_RING_H
+#include "fd_table.h"
+#include "filesystem.h"
+#include <sched/wait_queue.h>
+#include <memory/paging.h>
+
+// Submission entry count used when none is requested, must be a power of two
+#define IO_RING_DEFAULT_ENTRIES     64
+#define IO_RING_MAX_ENTRIES         4096
+
+// Offset of the submission queue from the start of the ring pages
+#define IO_RING_HEADER_SIZE         512
+
+// Most buffers a single vectored operation may take
+#define IO_RING_MAX_IOVECS          64
+
+// Offset that makes reads and writes use and advance the file's own offset
+#define IO_RING_OFFSET_CURRENT      0xffffffffffffffffull
+
+// Operation codes
+#define IO_OP_NOP                   0
+#define IO_OP_READV                 1
+#define IO_OP_WRITEV                2
+#define IO_OP_OPEN                  3
+#define IO_OP_CLOSE                 4
+#define IO_OP_STAT                  5
+
+// Submission flags, the next entry only runs if this one succeeds
+#define IO_SQE_LINK                 0x1
+
+namespace fs {
+/**
+ * @struct io_iovec
+ * @brief One buffer of a vectored read or write.
+ */
+struct io_iovec {
+    void*   base;
+    size_t  length;
+};
+
+/**
+ * @struct io_sqe
+ * @brief Submission queue entry, describes one operation.
+ *
+ * Field use by operation:
+ * - `IO_OP_READV`/`IO_OP_WRITEV`: `fd`, `addr` is an `io_iovec` array of `len` entries, `offset`
+ *   is the file offset or `IO_RING_OFFSET_CURRENT`. Completes with the number of bytes transferred.
+ * - `IO_OP_OPEN`: `addr` is the null-terminated path, `op_flags` the `FS_O_*` flags and `len`
+ *   the permissions if the file gets created. Completes with the new descriptor.
+ * - `IO_OP_CLOSE`: `fd`.
+ * - `IO_OP_STAT`: `addr` is the null-terminated path, `addr2` the `vfs_stat_struct` to fill.
+ *
+ * Every buffer has to be user-accessible in the creating task's address space,
+ * entries pointing anywhere else complete with `invalid_argument`.
+ */
+struct io_sqe {
+    uint8_t     opcode;
+    uint8_t     flags;          // IO_SQE_* flags
+    uint16_t    reserved;
+    int32_t     fd;
+    uint64_t    offset;
+    uint64_t    addr;
+    uint64_t    addr2;
+    uint32_t    len;
+    uint32_t    op_flags;
+    uint64_t    user_data;      // Passed back untouched in the completion
+};
+
+/**
+ * @struct io_cqe
+ * @brief Completion queue entry, the result of one operation.
+ */
+struct io_cqe {
+    uint64_t    user_data;
+    int64_t     result;         // Operation result, or a negative `fs_error` code
+};
+
+/**
+ * @struct io_ring_header
+ * @brief Control block at the start of an I/O ring's shared pages.
+ *
+ * Indices increase monotonically and are masked with the entry count minus one to address
+ * an entry. The submitter owns the submission tail and the completion head, the kernel owns
+ * the other two. Each index has its own cache line.
+ */
+struct io_ring_header {
+    alignas(64) kstl::atomic<uint32_t> sq_head;     // Next entry the worker consumes
+    alignas(64) kstl::atomic<uint32_t> sq_tail;     // Next entry to be submitted
+    alignas(64) kstl::atomic<uint32_t> cq_head;     // Next completion to be reaped
+    alignas(64) kstl::atomic<uint32_t> cq_tail;     // Next completion to be posted
+
+    alignas(64) uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t sq_offset;                             // Offset of the io_sqe array from the header
+    uint32_t cq_offset;                             // Offset of the io_cqe array from the header
+};
+
+static_assert(sizeof(io_ring_header) <= IO_RING_HEADER_SIZE, "io_ring_header must fit in front of the queues");
+
+/**
+ * @struct io_ring_params
+ * @brief Describes a ring to the process that set it up.
+ */
+struct io_ring_params {
+    uint64_t    ring_addr;      // Address of the io_ring_header
+    uint64_t    ring_size;      // Size of the ring pages in bytes
+    uint32_t    sq_entries;
+    uint32_t    cq_entries;
+    uint32_t    sq_offset;
+    uint32_t    cq_offset;
+};
+
+/**
+ * @class io_ring
+ * @brief Asynchronous submission and completion queues for VFS operations.
+ *
+ * The queues live in user-accessible pages of the shared higher half, so a process fills
+ * submission entries and reaps completions in place, and a single `enter` call can hand
+ * a whole batch of operations to the kernel. The ring's worker thread executes them in
+ * submission order while the submitter keeps running.
+ *
+ * The worker runs in the address space of the task that created the ring and resolves
+ * descriptors through its descriptor table, so buffers and descriptors in submissions
+ * mean the same as they would in a direct call.
+ *
+ * Entries flagged with `IO_SQE_LINK` form a chain with the entry after them. Once an entry
+ * of a chain fails, the rest of the chain completes with `fs_error::canceled` without running.
+ *
+ * The completion queue has twice as many entries as the submission queue. The worker stops
+ * consuming submissions while it is full, until the next `enter` after completions were reaped.
+ */
+class io_ring {
+public:
+    /**
+     * @brief Creates a ring and starts its worker thread.
+     * @param entries Number of submission entries, must be a power of two.
+     * @return The ring, or `nullptr` if the entry count is invalid or allocation failed.
+     */
+    static io_ring* create(uint32_t entries = IO_RING_DEFAULT_ENTRIES);
+
+    /**
+     * @brief Stops the worker thread, waiting for it to finish its current operation, and frees the ring.
+     */
+    ~io_ring();
+
+    io_ring(const io_ring&) = delete;
+    io_ring& operator=(const io_ring&) = delete;
+
+    /**
+     * @brief Retrieves the layout of the ring's shared pages.
+     */
+    void get_params(io_ring_params& params) const;
+
+    /**
+     * @brief Reserves the next submission entry, for rings driven from the kernel.
+     * @return Zeroed entry to fill in, or `nullptr` if the submission queue is full.
+     *
+     * Reserved entries become visible to the worker with the next `submit`.
+     */
+    io_sqe* get_sqe();
+
+    /**
+     * @brief Publishes every entry reserved with `get_sqe`.
+     * @return Number of entries published.
+     */
+    uint32_t submit();
+
+    /**
+     * @brief Takes the oldest completion off the completion queue.
+     * @return False if no completion is waiting.
+     */
+    bool pop_cqe(io_cqe& out_cqe);
+
+    /**
+     * @brief Wakes the worker up for newly submitted entries and waits for completions.
+     * @param min_complete Completions to wait for, 0 to return immediately.
+     * @param timeout_ns Maximum time to wait, or `WAIT_FOREVER`.
+     * @return Number of completions waiting to be reaped, which is less than
+     *         `min_complete` if the time ran out.
+     */
+    uint32_t enter(uint32_t min_complete, uint64_t timeout_ns = WAIT_FOREVER);
+
+private:
+    io_ring_header*         m_header = nullptr;
+    io_sqe*                 m_sqes = nullptr;
+    io_cqe*                 m_cqes = nullptr;
+    size_t                  m_page_count = 0;
+
+    // Descriptor table of the creating task, operations resolve descriptors through it
+    fd_table*               m_fds = nullptr;
+
+    // Page table of the creating task, user buffers in submissions have to be accessible in it
+    paging::page_table*     m_user_pml4 = nullptr;
+
+    // Submission tail of entries reserved with get_sqe, not yet published
+    uint32_t                m_sq_pending = 0;
+
+    // Set while the rest of the current chain has to be canceled, only touched by the worker
+    bool                    m_chain_failed = false;
+
+    kstl::atomic<uint32_t>  m_stopping;
+    kstl::atomic<uint32_t>  m_worker_exited;
+
+    // The worker parks on the first, tasks waiting for completions on the second
+    sched::wait_queue       m_sq_queue;
+    sched::wait_queue       m_cq_queue;
+
+    io_ring() = default;
+
+    bool _init(uint32_t entries);
+
+    uint32_t _cq_ready() const;
+    bool _cq_has_space() const;
+
+    static void _worker_entry(void* data);
+    static int64_t _poll_work(void* data);
+    static int64_t _poll_completions(void* data);
+
+    /**
+     * @brief Runs every published submission, as long as there is room for its completion.
+     */
+    void _process_submissions();
+
+    /**
+     * @brief Executes one operation.
+     * @return The result to post as its completion.
+     */
+    int64_t _execute(const io_sqe& sqe);
+
+    int64_t _execute_rw(const io_sqe& sqe, bool write);
+};
+} // namespace fs
+
+#endif // IO_RING_H
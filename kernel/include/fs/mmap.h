@@ -0,0 +1,174 @@
+#ifndef MMAP_H
+#define MMAP_H
+#include "fd_table.h"
+#include "filesystem.h"
+#include <sync.h>
+
+// Access allowed to the pages of a mapping
+#define FS_PROT_READ        0x1
+#define FS_PROT_WRITE       0x2
+#define FS_PROT_EXEC        0x4
+
+// Whether writes to a mapping reach the file, exactly one of them has to be given
+#define FS_MAP_SHARED       0x100
+#define FS_MAP_PRIVATE      0x200
+
+// Lower half range handed out to file mappings
+#define MMAP_REGION_BASE    0x0000600000000000ull
+#define MMAP_REGION_END     0x0000700000000000ull
+
+namespace paging {
+struct page_table;
+} // namespace paging
+
+namespace fs {
+/**
+ * @struct mmap_region
+ * @brief A contiguous range of pages mapping consecutive pages of one file.
+ */
+struct mmap_region {
+    uintptr_t       start;          // Page-aligned address of the first page
+    size_t          page_count;
+    uint64_t        offset;         // Page-aligned file offset of the first page
+    uint32_t        prot;           // FS_PROT_* flags
+    uint32_t        flags;          // FS_MAP_* flags
+    open_file*      file;           // The mapping holds a reference, it keeps the file and its pages alive after removal
+    bool            in_place;       // Pages are the file's own, otherwise they are copies
+    mmap_region*    next;
+};
+
+/**
+ * @class mmap_table
+ * @brief File mappings of an address space.
+ *
+ * Files whose filesystem hands out its pages (`vfs_operations::get_page`, which ramfs
+ * implements) get mapped in place: the address space points at the file's own pages, so
+ * mapping costs no copy, every process mapping the file shares the same memory, and
+ * shared writes are the file's data right away. Other files get mapped as copies that
+ * are read in when the mapping is set up, and `msync` writes shared copies back.
+ *
+ * Private mappings of in-place files start out sharing the file's pages read-only. The
+ * first write to a page faults and gets a private copy of it (copy-on-write).
+ *
+ * The mutex serializes map, unmap and sync, which may sleep while they populate mappings
+ * or write them back. Changes to the region list and to the entries of mapped pages also
+ * take an interrupt-safe spinlock, which is all the page fault handler takes, so it never
+ * blocks on a mutex its own CPU may be holding. Holding either lock keeps the list stable.
+ *
+ * Userland processes have their own table, kernel tasks share the kernel's table. A
+ * zero-filled table is valid and empty, and works on the page table of the calling task.
+ * Unmapping from a process table only flushes the calling CPU's TLB, which is enough for
+ * single-threaded processes. The kernel's table is live on every CPU, so unmapping from it
+ * shoots down all TLBs before the pages or their file are released.
+ */
+class mmap_table {
+public:
+    /**
+     * @brief Creates an empty table for an address space.
+     * @param root_page_table Physical address of the address space's PML4, 0 for the calling task's.
+     */
+    explicit mmap_table(uint64_t root_page_table = 0)
+        : m_root_page_table(root_page_table), m_regions(nullptr), m_deferred_pages(0), m_needs_shootdown(false) {}
+
+    /**
+     * @brief Unmaps every mapping, dropping private pages.
+     */
+    ~mmap_table();
+
+    mmap_table(const mmap_table&) = delete;
+    mmap_table& operator=(const mmap_table&) = delete;
+
+    /**
+     * @brief Retrieves the mapping table of the calling task.
+     */
+    static mmap_table* for_current_task();
+
+    /**
+     * @brief Maps part of an open file.
+     * @param file File to map, the mapping takes a reference of its own.
+     * @param offset Page-aligned file offset to start at.
+     * @param length Number of bytes to map, rounded up to whole pages within the file's last page.
+     * @param prot `FS_PROT_*` flags, shared writable mappings need a file opened for writing.
+     * @param flags `FS_MAP_SHARED` or `FS_MAP_PRIVATE`.
+     * @param out_addr Receives the address of the mapping.
+     * @return `fs_error::success`, or an appropriate error code.
+     */
+    fs_error map(open_file* file, uint64_t offset, size_t length, uint32_t prot, uint32_t flags, void*& out_addr);
+
+    /**
+     * @brief Unmaps every page in a range, which may cover parts of mappings.
+     * @param addr Page-aligned start of the range.
+     * @param length Length of the range in bytes.
+     * @return `fs_error::success`, or `fs_error::invalid_argument` for a misaligned range.
+     */
+    fs_error unmap(void* addr, size_t length);
+
+    /**
+     * @brief Writes shared mappings in a range back to their files.
+     * @return `fs_error::success`, or the error of the first failed write.
+     *
+     * Mappings in place are the file's data already and private mappings never reach the file,
+     * only shared copies have anything to write.
+     */
+    fs_error sync(void* addr, size_t length);
+
+    /**
+     * @brief Resolves a write fault on a copy-on-write page.
+     * @param addr Faulting address.
+     * @return True if the page was copied and the write can be retried.
+     */
+    __PRIVILEGED_CODE bool handle_write_fault(uintptr_t addr);
+
+private:
+    mutex           m_lock;             // Serializes map, unmap and sync
+    spinlock        m_region_lock;      // Guards changes to the region list and to mapped pages, taken by the fault handler
+    uint64_t        m_root_page_table;  // 0 for the kernel's table, which uses the calling task's
+    mmap_region*    m_regions;          // Sorted by address
+    uintptr_t       m_deferred_pages;   // Physical pages unmapped from the kernel's table, waiting for the shootdown
+    bool            m_needs_shootdown;  // Kernel table entries were cleared since the last shootdown
+
+    /**
+     * @brief Retrieves the PML4 the table's mappings live in.
+     */
+    __PRIVILEGED_CODE paging::page_table* _pml4() const;
+
+    /**
+     * @brief Finds a free address range between the existing mappings, the lock must be held.
+     * @return The start of the range, or 0 if the mapping area is exhausted.
+     */
+    uintptr_t _find_free_range(size_t page_count) const;
+
+    /**
+     * @brief Maps every page of a new region, the lock must be held.
+     */
+    fs_error _populate(mmap_region* region);
+
+    /**
+     * @brief Unmaps pages [first, first + count) of a region, freeing the ones it owns. Both locks must be held.
+     *
+     * Pages of the kernel's table are only freed by the `_finish_unmap` that has to follow.
+     */
+    void _unmap_pages(mmap_region* region, size_t first, size_t count);
+
+    /**
+     * @brief Shoots down stale TLB entries of the kernel's table and frees the pages deferred
+     *        by `_unmap_pages`. Only the mutex may be held, the shootdown waits for other CPUs.
+     */
+    void _finish_unmap();
+
+    /**
+     * @brief Unmaps [first, last) from a region, trimming or splitting it. Both locks must be held.
+     * @param link The link pointing to the region, advanced past what's left of it.
+     * @param tail Preallocated region for the part after a hole punched into the middle, unused otherwise.
+     * @return The region if nothing of it is left, unlinked but still holding its file reference.
+     */
+    __PRIVILEGED_CODE mmap_region* _cut_region(mmap_region**& link, uintptr_t first, uintptr_t last, mmap_region* tail);
+
+    /**
+     * @brief Writes pages [first, first + count) of a shared copy back to its file, the lock must be held.
+     */
+    fs_error _writeback(mmap_region* region, size_t first, size_t count);
+};
+} // namespace fs
+
+#endif // MMAP_H
@@ -0,0 +1,210 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+#include "filesystem.h"
+#include <sync.h>
+
+// Number of hash buckets, must be a power of two
+#define PAGE_CACHE_BUCKETS          1024
+
+// Pages cached before the clock starts evicting them (8 MiB)
+#define PAGE_CACHE_MAX_PAGES        2048
+
+// Bounds of the read-ahead window in pages, the window doubles while reads stay sequential
+#define PAGE_CACHE_READAHEAD_MIN    4
+#define PAGE_CACHE_READAHEAD_MAX    64
+
+namespace fs {
+struct page_cache_mapping;
+
+/**
+ * @typedef page_cache_fill_t
+ * @brief Function pointer type for reading a page from the backing store.
+ * @param mapping Mapping the page belongs to.
+ * @param page_index Index of the page within the mapping.
+ * @param page Page-sized buffer to fill, data past the end of the mapping has to be zeroed.
+ * @return 0 on success, or a negative error code.
+ */
+typedef ssize_t (*page_cache_fill_t)(page_cache_mapping* mapping, uint64_t page_index, void* page);
+
+/**
+ * @typedef page_cache_writeback_t
+ * @brief Function pointer type for writing a dirty page back to the backing store.
+ * @param mapping Mapping the page belongs to.
+ * @param page_index Index of the page within the mapping.
+ * @param page Page-sized buffer holding the data.
+ * @return 0 on success, or a negative error code.
+ */
+typedef ssize_t (*page_cache_writeback_t)(page_cache_mapping* mapping, uint64_t page_index, const void* page);
+
+/**
+ * @struct page_cache_mapping
+ * @brief Cached data of one file or device, the page cache's equivalent of an inode.
+ *
+ * The address of the mapping is half of the key of its cached pages, so it must stay
+ * put and be invalidated from the cache before it goes away. A zero-filled mapping
+ * with its size and callbacks set is ready to use.
+ */
+struct page_cache_mapping {
+    page_cache_fill_t       fill;
+    page_cache_writeback_t  writeback;
+    void*                   _private;   // Owner-specific data for the callbacks
+    uint64_t                size;       // Size of the data in bytes, pages past it are never cached
+
+    // Read-ahead state, protected by the page cache's lock
+    uint64_t                ra_last_index;  // Last page of the previous read
+    uint64_t                ra_end;         // First page past the read-ahead region
+    size_t                  ra_window;      // Pages to keep ahead of a sequential reader, 0 for random access
+};
+
+/**
+ * @struct page_cache_entry
+ * @brief A cached page, free if it has no mapping.
+ */
+struct page_cache_entry {
+    page_cache_mapping*     mapping;
+    uint64_t                index;          // Index of the page within the mapping
+    uint8_t*                data;           // Page of cached data, kept when the entry gets reused
+    bool                    dirty;          // Modified since it was last written back
+    bool                    referenced;     // Accessed since the clock hand last passed
+    page_cache_entry*       hash_next;
+};
+
+/**
+ * @struct page_cache_stats
+ * @brief Counters describing how well the page cache performs.
+ */
+struct page_cache_stats {
+    size_t      pages;              // Pages currently cached
+    size_t      dirty_pages;        // Cached pages that still have to be written back
+    uint64_t    hits;               // Page accesses answered from the cache
+    uint64_t    misses;             // Page accesses that had to fill the page first
+    uint64_t    readahead_pages;    // Pages filled ahead of a sequential reader
+    uint64_t    evictions;          // Pages reclaimed by the clock
+    uint64_t    writebacks;         // Dirty pages written back to their backing store
+};
+
+/**
+ * @class page_cache
+ * @brief Caches file data by (mapping, page index) in front of slow backing stores.
+ *
+ * Reads and writes are served from cached pages, which get filled through the mapping's
+ * callbacks on a miss. Writes only dirty the cached page; dirty pages are written back
+ * when they get evicted or the mapping is synced.
+ *
+ * Once `PAGE_CACHE_MAX_PAGES` pages are cached, a clock sweeps the pages and reclaims the
+ * first one that wasn't accessed since the hand last passed it. Pages that were read
+ * ahead start out unreferenced, so read-ahead that was never used goes first.
+ *
+ * Reads that continue where the previous read of the mapping ended are treated as
+ * sequential, and the pages after them are filled ahead of time. The window starts at
+ * `PAGE_CACHE_READAHEAD_MIN` pages and doubles with every sequential read up to
+ * `PAGE_CACHE_READAHEAD_MAX`. It is refilled once the reader has consumed half of it,
+ * and a read anywhere else drops it.
+ *
+ * A single lock protects the cache and is held across fills and write-backs, which is
+ * good enough for memory-backed devices.
+ */
+class page_cache {
+public:
+    /**
+     * @brief Retrieves the global page cache.
+     */
+    static page_cache& get();
+
+    /**
+     * @brief Reads data of a mapping through the cache.
+     * @param mapping Mapping to read from.
+     * @param buffer Buffer to store the data.
+     * @param size Number of bytes to read.
+     * @param offset Offset to start reading at.
+     * @return Number of bytes read, 0 past the end of the mapping, or a negative error code.
+     */
+    ssize_t read(page_cache_mapping* mapping, void* buffer, size_t size, uint64_t offset);
+
+    /**
+     * @brief Writes data of a mapping into the cache.
+     * @param mapping Mapping to write to.
+     * @param buffer Buffer containing the data.
+     * @param size Number of bytes to write, clamped to the size of the mapping.
+     * @param offset Offset to start writing at.
+     * @return Number of bytes written, or a negative error code.
+     *
+     * Pages that are only partially overwritten are filled first.
+     */
+    ssize_t write(page_cache_mapping* mapping, const void* buffer, size_t size, uint64_t offset);
+
+    /**
+     * @brief Writes back every dirty page of a mapping.
+     * @param mapping Mapping to sync, or `nullptr` for every mapping.
+     * @return `fs_error::success` on success, or the error of the first failed write-back.
+     */
+    fs_error sync(page_cache_mapping* mapping);
+
+    /**
+     * @brief Drops every cached page of a mapping without writing it back.
+     * @param mapping Mapping to drop, it can be freed once this returns.
+     */
+    void invalidate(page_cache_mapping* mapping);
+
+    /**
+     * @brief Retrieves the cache's counters.
+     */
+    void get_stats(page_cache_stats& stats);
+
+private:
+    mutex               m_lock;
+
+    // Buckets and entries are allocated on first use, entries are handed out in order until the cache is full
+    page_cache_entry**  m_buckets;
+    page_cache_entry*   m_entries;
+    size_t              m_used_entries;
+    size_t              m_clock_hand;
+
+    size_t              m_pages;
+    size_t              m_dirty_pages;
+    uint64_t            m_hits;
+    uint64_t            m_misses;
+    uint64_t            m_readahead_pages;
+    uint64_t            m_evictions;
+    uint64_t            m_writebacks;
+
+    static uint64_t _hash(page_cache_mapping* mapping, uint64_t index);
+
+    /**
+     * @brief Finds the cached page of a mapping, the lock must be held.
+     */
+    page_cache_entry* _find(page_cache_mapping* mapping, uint64_t index);
+
+    /**
+     * @brief Finds a page or fills a new one, the lock must be held.
+     * @param fill Whether a new page has to be read from the backing store, otherwise it's zeroed.
+     * @param out_entry Receives the page.
+     * @return `fs_error::success`, or the error of the fill or allocation.
+     */
+    fs_error _get_page(page_cache_mapping* mapping, uint64_t index, bool fill, page_cache_entry*& out_entry);
+
+    /**
+     * @brief Takes a free entry, evicting a page if the cache is full. The lock must be held.
+     * @return The entry, or `nullptr` if no page could be allocated or written back.
+     */
+    page_cache_entry* _alloc_entry();
+
+    /**
+     * @brief Writes back a dirty page, the lock must be held.
+     */
+    fs_error _writeback(page_cache_entry* entry);
+
+    /**
+     * @brief Unlinks a page from its bucket and frees its entry, the lock must be held.
+     */
+    void _remove(page_cache_entry* entry);
+
+    /**
+     * @brief Updates the read-ahead state for a read of pages [first, last] and fills the
+     *        pages ahead of it if the reader is sequential. The lock must be held.
+     */
+    void _readahead(page_cache_mapping* mapping, uint64_t first, uint64_t last);
+};
+} // namespace fs
+
+#endif // PAGE_CACHE_H
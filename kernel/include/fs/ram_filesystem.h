@@ -2,6 +2,10 @@
 #define RAM_FILESYSTEM_H
 #include "filesystem.h"
 #include <kstl/vector.h>
+#include <sync.h>
+
+// Initial size of a directory's child table, must be a power of two
+#define RAMFS_CHILD_TABLE_MIN_SIZE 16
 
 namespace fs {
 struct ramfs_node;
@@ -14,6 +18,7 @@ struct ramfs_node;
  */
 struct ramfs_direntry {
     kstl::string name;
+    uint64_t hash; // Hash of the name, used to place the entry in the parent's child table
     ramfs_node* node;
 };
 
@@ -22,6 +27,21 @@ struct ramfs_direntry {
  * @brief Represents a node in the RAM filesystem.
  * 
  * A node can be a file or a directory, with associated metadata and data storage.
+ * File data is kept in individually allocated pages, indexed by their page number
+ * within the file. Pages that were never written are holes and read back as zeros.
+ *
+ * Writers of a file and namespace changes of a directory hold the node's lock exclusively,
+ * directory lookups share it. File data is read without any lock: files only ever grow,
+ * so every page below the published size stays valid, and replaced page lists are only
+ * freed after an RCU grace period.
+ *
+ * Nodes are reference counted. The directory entry linking a node counts as one reference
+ * and every VFS node referring to it as another, so a removed file stays readable and
+ * writable through descriptors that are still open, and is freed once the last one is closed.
+ *
+ * Directories index their children by name in an open-addressing hash table with linear
+ * probing, which is kept at most half full. The children vector keeps the insertion
+ * order for listing the directory.
  */
 struct ramfs_node {
     kstl::string name;
@@ -30,9 +50,14 @@ struct ramfs_node {
     uint64_t creation_ts;
     uint64_t modification_ts;
     uint64_t access_ts;
-    uint8_t* data; // File data (only for files)
-    size_t data_size; // Size of the file data
-    kstl::vector<ramfs_direntry*> children; // Directory children
+    uint8_t** pages; // Page list of the file data, null entries are holes (only for files), RCU-protected
+    size_t page_slots; // Capacity of the page list
+    kstl::atomic<size_t> data_size; // Size of the file data, published after the data is written
+    rwlock lock; // Serializes writers of the file data or of the directory's children
+    kstl::vector<ramfs_direntry*> children; // Directory children in insertion order
+    ramfs_direntry** child_table; // Children hashed by name, null slots are free
+    size_t child_table_size; // Number of slots in the child table
+    kstl::atomic<size_t> refs; // The linking directory entry and every VFS node referring to the node
 };
 
 /**
@@ -70,7 +95,7 @@ public:
 
 private:
     kstl::shared_ptr<vfs_node> m_root; /** Shared pointer to the root node */
-    mutex m_fs_lock = mutex(); /** Mutex for synchronizing filesystem operations */
+    mutex m_fs_lock = mutex(); /** Mutex for mounting and unmounting, node operations lock the nodes they touch */
 
     // RAM Filesystem Operations
 
@@ -120,6 +145,15 @@ private:
      */
     static int ramfs_remove(vfs_node* parent, vfs_node* node);
 
+    /**
+     * @brief Retrieves a page of a file's data for in-place access.
+     * @param node Pointer to the file node.
+     * @param page_index Index of the page within the file.
+     * @param allocate Whether a hole should be filled with a new zeroed page.
+     * @return Address of the page, or `nullptr` for a hole that wasn't filled.
+     */
+    static void* ramfs_get_page(vfs_node* node, uint64_t page_index, bool allocate);
+
     /**
      * @brief Lists directory entries for a given node.
      * @param node Pointer to the directory node.
@@ -128,6 +162,80 @@ private:
      */
     static int ramfs_listdir(vfs_node* node, kstl::vector<kstl::string>& entries);
 
+    /**
+     * @brief Drops a VFS node's reference to its RAM node.
+     * @param node Pointer to the VFS node being destroyed.
+     */
+    static void ramfs_release(vfs_node* node);
+
+    /**
+     * @brief Looks up a page of a file, optionally filling a hole.
+     * @note The node's lock must be held exclusively when `allocate` is set.
+     */
+    static uint8_t* _get_file_page(ramfs_node* file_node, size_t page_index, bool allocate);
+
+    /**
+     * @brief Grows a file's page list to hold at least `page_count` pages, the node's lock must be held exclusively.
+     * @param out_old_pages Receives the replaced list, or `nullptr` if the list didn't move. Lock-free readers
+     *                      may still be walking it, so it has to be passed to `_retire_page_list` once the lock
+     *                      is released.
+     * @return False if the list couldn't be allocated.
+     */
+    static bool _reserve_page_slots(ramfs_node* file_node, size_t page_count, uint8_t**& out_old_pages);
+
+    /**
+     * @brief Waits for readers of a replaced page list to finish and frees it.
+     * @note Must not be called with a node's lock held, waiting for a grace period would stall everyone queued on it.
+     */
+    static void _retire_page_list(uint8_t** old_pages);
+
+    /**
+     * @brief Hashes a directory entry name.
+     */
+    static uint64_t _hash_name(const char* name, size_t length);
+
+    /**
+     * @brief Finds a child of a directory by name, the directory's lock must be held.
+     * @return The matching directory entry, or `nullptr` if there is none.
+     */
+    static ramfs_direntry* _find_child(ramfs_node* dir_node, const char* name, size_t length);
+
+    /**
+     * @brief Adds an entry to a directory's children, the directory's lock must be held exclusively.
+     * @return False if the child table couldn't be grown.
+     */
+    static bool _insert_child(ramfs_node* dir_node, ramfs_direntry* direntry);
+
+    /**
+     * @brief Removes an entry from a directory's child table, the directory's lock must be held exclusively.
+     */
+    static void _erase_child_slot(ramfs_node* dir_node, ramfs_direntry* direntry);
+
+    /**
+     * @brief Rehashes a directory's children into a table of the given size.
+     * @return False if the new table couldn't be allocated.
+     */
+    static bool _resize_child_table(ramfs_node* dir_node, size_t new_size);
+
+    /**
+     * @brief Removes a node from its parent directory's children.
+     * @return The directory entry that referred to the node, or `nullptr` if it wasn't found.
+     */
+    static ramfs_direntry* _unlink_child(ramfs_node* parent_ram_node, ramfs_node* target_ram_node);
+
+    /**
+     * @brief Unlinks every child of a directory, recursing into subdirectories.
+     * @param dir_node Pointer to the directory node.
+     * 
+     * Children still referred to by VFS nodes live on until those are released.
+     */
+    static void _unlink_children(ramfs_node* dir_node);
+
+    /**
+     * @brief Drops a reference to a node, deleting it along with the last one.
+     */
+    static void _put_node(ramfs_node* node);
+
     /**
      * @brief Deletes a file node from the RAM filesystem.
      * @param file_node Pointer to the file node to delete.
@@ -140,7 +248,7 @@ private:
      * @brief Deletes a directory node from the RAM filesystem.
      * @param dir_node Pointer to the directory node to delete.
      * 
-     * Recursively deletes child nodes before removing the directory.
+     * Unlinks any remaining children before removing the directory.
      */
     static void _delete_ram_directory(ramfs_node* dir_node);
 };
@@ -1,6 +1,9 @@
 #ifndef VFS_H
 #define VFS_H
 #include "filesystem.h"
+#include "dentry_cache.h"
+#include "fd_table.h"
+#include "mmap.h"
 
 namespace fs {
 /**
@@ -81,6 +84,98 @@ public:
      */
     ssize_t write(const kstl::string& path, const void* buffer, size_t size, uint64_t offset);
 
+    /**
+     * @brief Opens a file and installs it in the calling process's descriptor table.
+     * @param path The path to the file to open.
+     * @param flags Access mode (`FS_O_RDONLY`, `FS_O_WRONLY` or `FS_O_RDWR`) combined with `FS_O_CREAT` and `FS_O_APPEND`.
+     * @param perms The permissions for the file if `FS_O_CREAT` creates it.
+     * @param table Descriptor table to install the file in, the calling task's if null.
+     * @return The new file descriptor on success, or a negative error code.
+     * 
+     * The path is resolved once, operations on the descriptor work on the resolved node directly.
+     */
+    int open(const kstl::string& path, uint32_t flags, uint32_t perms = 0644, fd_table* table = nullptr);
+
+    /**
+     * @brief Closes a file descriptor of the calling process.
+     * @param fd The descriptor to close.
+     * @return `fs_error::success` on success, or `fs_error::bad_descriptor` if it wasn't open.
+     */
+    fs_error close(int fd);
+
+    /**
+     * @brief Reads from an open file at its current offset and advances the offset.
+     * @param fd The descriptor of the file.
+     * @param buffer Buffer to store the read data.
+     * @param size Number of bytes to read.
+     * @return Number of bytes read on success, or a negative error code.
+     */
+    ssize_t read(int fd, void* buffer, size_t size);
+
+    /**
+     * @brief Writes to an open file at its current offset and advances the offset.
+     * @param fd The descriptor of the file.
+     * @param buffer Buffer containing the data to write.
+     * @param size Number of bytes to write.
+     * @return Number of bytes written on success, or a negative error code.
+     */
+    ssize_t write(int fd, const void* buffer, size_t size);
+
+    /**
+     * @brief Reads from an open file at a given offset without moving the file's offset.
+     * @return Number of bytes read on success, or a negative error code.
+     */
+    ssize_t pread(int fd, void* buffer, size_t size, uint64_t offset);
+
+    /**
+     * @brief Writes to an open file at a given offset without moving the file's offset.
+     * @return Number of bytes written on success, or a negative error code.
+     */
+    ssize_t pwrite(int fd, const void* buffer, size_t size, uint64_t offset);
+
+    /**
+     * @brief Repositions the offset of an open file.
+     * @param fd The descriptor of the file.
+     * @param offset Offset relative to the position selected by `whence`.
+     * @param whence One of `FS_SEEK_SET`, `FS_SEEK_CUR` or `FS_SEEK_END`.
+     * @return The new offset on success, or a negative error code.
+     */
+    ssize_t lseek(int fd, int64_t offset, int whence);
+
+    /**
+     * @brief Retrieves metadata for an open file.
+     * @param fd The descriptor of the file.
+     * @param info Reference to a `vfs_stat_struct` to populate with metadata.
+     * @return `fs_error::success` on success, or an appropriate error code.
+     */
+    fs_error fstat(int fd, vfs_stat_struct& info);
+
+    /**
+     * @brief Maps part of an open file into the calling task's address space.
+     * @param fd The descriptor of the file, it can be closed while the mapping stays.
+     * @param offset Page-aligned file offset to start at.
+     * @param length Number of bytes to map.
+     * @param prot `FS_PROT_*` flags.
+     * @param flags `FS_MAP_SHARED` or `FS_MAP_PRIVATE`.
+     * @param out_addr Receives the address of the mapping.
+     * @return `fs_error::success` on success, or an appropriate error code.
+     *
+     * See `mmap_table` for how mappings are backed.
+     */
+    fs_error mmap(int fd, uint64_t offset, size_t length, uint32_t prot, uint32_t flags, void*& out_addr);
+
+    /**
+     * @brief Unmaps a range of the calling task's file mappings.
+     * @return `fs_error::success` on success, or an appropriate error code.
+     */
+    fs_error munmap(void* addr, size_t length);
+
+    /**
+     * @brief Writes back shared file mappings of the calling task in a range.
+     * @return `fs_error::success` on success, or an appropriate error code.
+     */
+    fs_error msync(void* addr, size_t length);
+
     /**
      * @brief Lists entries in a directory at a specified path.
      * @param path The path to the directory.
@@ -111,26 +206,71 @@ public:
      */
     static kstl::string get_filename_from_path(const kstl::string& path);
 
+    /**
+     * @brief Retrieves the counters of the dentry cache used for path resolution.
+     * @param stats Reference to a `dentry_cache_stats` to populate.
+     */
+    void get_dentry_cache_stats(dentry_cache_stats& stats);
+
 private:
-    kstl::vector<mount_point> m_mount_points; /** List of all mounted filesystems */
-    mutex m_vfs_lock = mutex(); /** Mutex to synchronize VFS operations */
+    kstl::vector<mount_point>* m_mount_points = nullptr; /** RCU-protected list of all mounted filesystems */
+    mutex m_vfs_lock = mutex(); /** Mutex to serialize mount table updates */
+    dentry_cache m_dentry_cache; /** Cache of resolved path components */
+
+    /**
+     * @brief Publishes a new mount table and frees the old one after a grace period.
+     * @param new_table The fully populated mount table to publish.
+     * 
+     * Must be called with `m_vfs_lock` held.
+     */
+    void _publish_mount_table(kstl::vector<mount_point>* new_table);
+
+    /**
+     * @brief Creates a writable copy of the current mount table.
+     * 
+     * Must be called with `m_vfs_lock` held.
+     */
+    kstl::vector<mount_point>* _copy_mount_table();
 
     /**
      * @brief Checks if a path corresponds to a mount point.
-     * @param path The path to check.
+     * @param path The path to check, doesn't have to be null-terminated.
+     * @param length Length of the path.
      * @param out_root_node Reference to store the root node of the mount point, if found.
      * @return `fs_error::success` if the path is a mount point, or an appropriate error code.
      */
-    fs_error is_mount_point(const kstl::string& path, kstl::shared_ptr<vfs_node>& out_root_node);
+    fs_error is_mount_point(const char* path, size_t length, kstl::shared_ptr<vfs_node>& out_root_node);
 
     /**
      * @brief Resolves a path to its corresponding VFS node.
-     * @param path The path to resolve.
+     * @param path The path to resolve, must be absolute.
      * @param out_node Reference to store the resolved VFS node.
      * @return `fs_error::success` on success, or an appropriate error code.
+     * 
+     * Components are resolved through the dentry cache, a path whose components are all
+     * cached is resolved without allocating memory or consulting the mount table.
      */
     fs_error _resolve_path(const kstl::string& path, kstl::shared_ptr<vfs_node>& out_node);
 
+    /**
+     * @brief Resolves a path component that missed the dentry cache and caches the result.
+     * @param parent The directory node the component is looked up in.
+     * @param path The path being resolved.
+     * @param start Offset of the component within `path`.
+     * @param end Offset one past the end of the component.
+     * @param generation Dentry cache generation from before the lookup started.
+     * @param out_node Reference to store the resolved node.
+     * @return `fs_error::success` on success, or an appropriate error code.
+     */
+    fs_error _lookup_component(
+        const kstl::shared_ptr<vfs_node>& parent,
+        const kstl::string& path,
+        size_t start,
+        size_t end,
+        uint64_t generation,
+        kstl::shared_ptr<vfs_node>& out_node
+    );
+
     /**
      * @brief Splits a path into its components.
      * @param path The path to split.
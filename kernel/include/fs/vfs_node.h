@@ -94,6 +94,29 @@ typedef int (*vfs_delete_t)(vfs_node* parent, vfs_node* node);
  */
 typedef int (*vfs_listdir_t)(vfs_node* node, kstl::vector<kstl::string>& entries);
 
+/**
+ * @typedef vfs_get_page_t
+ * @brief Function pointer type for retrieving a file's backing page.
+ * 
+ * Defines the signature for accessing file data in place, without copying it.
+ * @param node Pointer to the file node.
+ * @param page_index Index of the page within the file.
+ * @param allocate Whether a hole at that index should be filled with a new zeroed page.
+ * @return Page-aligned address of the page in the shared higher half, or `nullptr` if
+ *         the page is a hole and `allocate` is false or allocation failed.
+ */
+typedef void* (*vfs_get_page_t)(vfs_node* node, uint64_t page_index, bool allocate);
+
+/**
+ * @typedef vfs_release_t
+ * @brief Function pointer type for releasing a node's filesystem-specific data.
+ * 
+ * Called when the last reference to a VFS node is dropped, lets the filesystem drop
+ * what it keeps alive for the node.
+ * @param node Pointer to the node being destroyed.
+ */
+typedef void (*vfs_release_t)(vfs_node* node);
+
 /**
  * @struct vfs_operations
  * @brief Defines the set of operations that can be performed on a VFS node.
@@ -107,6 +130,8 @@ struct vfs_operations {
     vfs_create_t     create;
     vfs_delete_t     remove;
     vfs_listdir_t    listdir;
+    vfs_get_page_t   get_page;
+    vfs_release_t    release;
 };
 
 /**
@@ -130,8 +155,16 @@ struct vfs_stat_struct {
  * @brief Represents a node in the Virtual File System (VFS).
  * 
  * A VFS node encapsulates metadata, operations, and pointers to filesystem-specific data.
+ * Nodes are shared through `kstl::shared_ptr`, destroying the last one releases the
+ * filesystem-specific data through `vfs_operations::release`.
  */
 struct vfs_node {
+    ~vfs_node() {
+        if (ops.release) {
+            ops.release(this);
+        }
+    }
+
     // Node information structure
     vfs_stat_struct stat;
 
@@ -123,6 +123,46 @@ __PRIVILEGED_CODE void enable_interrupts();
  */
 __PRIVILEGED_CODE void disable_interrupts();
 
+#ifdef ARCH_X86_64
+// Interrupt enable flag in the RFLAGS register
+#define RFLAGS_IF (1ULL << 9)
+
+/**
+ * @brief Checks whether interrupts are enabled on the current CPU.
+ * @return True if the interrupt flag is set, false otherwise.
+ *
+ * Reading RFLAGS does not require privilege, so this can be used to detect
+ * interrupt contexts or interrupt-disabled critical sections from anywhere.
+ */
+static __force_inline__ bool irqs_enabled() {
+    uint64_t rflags;
+    asm volatile ("pushfq; popq %0" : "=r"(rflags) :: "memory");
+    return (rflags & RFLAGS_IF) != 0;
+}
+
+/**
+ * @brief Saves the current interrupt state and disables interrupts.
+ * @return The saved RFLAGS value to be passed to `restore_irq_flags`.
+ * @note Privilege: **required**
+ */
+static __force_inline__ uint64_t save_and_disable_irqs() {
+    uint64_t rflags;
+    asm volatile ("pushfq; popq %0; cli" : "=r"(rflags) :: "memory");
+    return rflags;
+}
+
+/**
+ * @brief Restores the interrupt state previously saved by `save_and_disable_irqs`.
+ * @param flags The saved RFLAGS value.
+ * @note Privilege: **required**
+ */
+static __force_inline__ void restore_irq_flags(uint64_t flags) {
+    if (flags & RFLAGS_IF) {
+        asm volatile ("sti" ::: "memory");
+    }
+}
+#endif
+
 /**
  * @brief Handles a kernel panic by displaying register information and halting the system.
  * 
@@ -0,0 +1,229 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+#include <kstl/hashmap.h>
+#include <string.h>
+#include <sync.h>
+#include <sched/wait_queue.h>
+#include <ipc/handle_table.h>
+
+#define CHANNEL_ID_INVALID IPC_HANDLE_INVALID
+
+// Every slot holds one message, prefixed by its size
+#define CHANNEL_SLOT_SIZE           256
+#define CHANNEL_SLOT_HEADER_SIZE    8
+#define CHANNEL_MAX_MESSAGE_SIZE    (CHANNEL_SLOT_SIZE - CHANNEL_SLOT_HEADER_SIZE)
+
+// Slot count used when none is requested, must be a power of two
+#define CHANNEL_DEFAULT_SLOT_COUNT  64
+
+// Offset of the first slot from the start of the ring pages
+#define CHANNEL_RING_HEADER_SIZE    256
+
+// Number of polls of the ring before a waiting task parks on the doorbell
+#define CHANNEL_SPIN_LIMIT          256
+
+namespace ipc {
+using channel_handle_t = handle_t;
+
+/**
+ * @struct channel_ring
+ * @brief Control block at the start of a channel's shared ring pages.
+ *
+ * Indices increase monotonically and are masked with `slot_count - 1` to address a slot.
+ * The producer and consumer each own a cache line with their index and a cached copy of
+ * the other side's index, so the fast path only touches the other side's line when the
+ * cached view says the ring is full or empty.
+ */
+struct channel_ring {
+    // Producer-owned
+    alignas(64) kstl::atomic<uint32_t> head;            // Next slot to be written
+    uint32_t                           cached_tail;     // Producer's last observed tail
+
+    // Consumer-owned
+    alignas(64) kstl::atomic<uint32_t> tail;            // Next slot to be read
+    uint32_t                           cached_head;     // Consumer's last observed head
+
+    // Doorbell flags, set by a side that is about to park
+    alignas(64) kstl::atomic<uint32_t> consumer_waiting;
+    kstl::atomic<uint32_t>             producer_waiting;
+
+    uint32_t slot_count;
+    uint32_t slot_size;
+};
+
+static_assert(sizeof(channel_ring) <= CHANNEL_RING_HEADER_SIZE, "channel_ring must fit in front of the slots");
+
+/**
+ * @class channel
+ * @brief Single-producer/single-consumer IPC channel backed by a shared ring of fixed-size slots.
+ *
+ * The ring lives in user-accessible pages of the shared higher-half address range, so both
+ * endpoints read and write messages in place without entering the kernel. Messages are built
+ * directly in a ring slot with `begin_send`/`commit_send` and consumed in place with
+ * `begin_receive`/`end_receive`, no intermediate buffers are allocated or copied.
+ *
+ * The doorbell is only rung when the other side flagged that it's parked, in which case the
+ * waiting task gets woken up through the scheduler. As long as neither side has to block,
+ * sending and receiving are plain memory operations.
+ *
+ * Exactly one task may send and one task may receive on a channel at any given time.
+ */
+class channel : public ipc_object {
+public:
+    static constexpr ipc_object_type object_type = ipc_object_type::CHANNEL;
+
+    channel() : ipc_object(object_type) {}
+    ~channel();
+
+    /**
+     * @brief Creates a named channel.
+     * @param name Unique name other processes use to open the channel.
+     * @param slot_count Number of message slots, must be a power of two.
+     * @return Handle to the new channel, or `CHANNEL_ID_INVALID` on failure.
+     */
+    static channel_handle_t create(const kstl::string& name, uint32_t slot_count = CHANNEL_DEFAULT_SLOT_COUNT);
+
+    /**
+     * @brief Looks up an existing channel by name.
+     * @return Handle to the channel, or `CHANNEL_ID_INVALID` if no such channel exists.
+     */
+    static channel_handle_t open(const kstl::string& name);
+
+    /**
+     * @brief Closes a handle of the calling process.
+     * @return False if the handle was not open.
+     *
+     * Closing the handle returned by `create` also withdraws the channel's name.
+     * The channel is destroyed once no process holds a handle to it anymore.
+     */
+    static bool close(channel_handle_t handle);
+
+    /**
+     * @brief Resolves a handle to its channel object.
+     * @return Reference to the channel, empty if the handle is invalid.
+     *
+     * The returned reference keeps the channel alive even if the handle gets closed
+     * concurrently, so callers resolve their handle once and hold on to the reference
+     * for as long as they use the channel on the fast path.
+     */
+    static object_ref<channel> get(channel_handle_t handle);
+
+    /**
+     * @brief Reserves the next free slot for an outgoing message.
+     * @return Pointer to `CHANNEL_MAX_MESSAGE_SIZE` bytes of slot payload, or `nullptr` if the ring is full.
+     */
+    void* begin_send();
+
+    /**
+     * @brief Publishes the message built in the slot returned by `begin_send`.
+     * @param size Size of the message in bytes.
+     */
+    void commit_send(size_t size);
+
+    /**
+     * @brief Retrieves the oldest unread message without copying it.
+     * @param[out] out_size Size of the message in bytes.
+     * @return Pointer to the message payload, or `nullptr` if the ring is empty.
+     *
+     * The payload stays valid until `end_receive` releases the slot.
+     */
+    const void* begin_receive(size_t* out_size);
+
+    /**
+     * @brief Releases the slot of the message returned by `begin_receive`.
+     */
+    void end_receive();
+
+    /**
+     * @brief Copies a message into the ring without blocking.
+     * @return True if the message was sent, false if the ring is full or the message is too large.
+     */
+    bool try_send(const void* data, size_t size);
+
+    /**
+     * @brief Copies the oldest message out of the ring without blocking.
+     * @param buffer Destination buffer.
+     * @param buffer_size Capacity of `buffer`, larger messages are truncated.
+     * @param[out] out_size Size of the received message.
+     * @return True if a message was received, false if the ring is empty.
+     */
+    bool try_receive(void* buffer, size_t buffer_size, size_t* out_size);
+
+    /**
+     * @brief Copies a message into the ring, blocking while the ring is full.
+     * @return True if the message was sent, false if it is too large for a slot.
+     */
+    bool send(const void* data, size_t size);
+
+    /**
+     * @brief Copies the oldest message out of the ring, blocking until one arrives.
+     * @param timeout_ns Maximum time to wait, or `WAIT_FOREVER`.
+     * @return True if a message was received, false on timeout.
+     */
+    bool receive(void* buffer, size_t buffer_size, size_t* out_size, uint64_t timeout_ns = WAIT_FOREVER);
+
+    /**
+     * @brief Checks whether a message is waiting to be received.
+     */
+    bool can_receive();
+
+    /**
+     * @brief Blocks the consumer until a message is available.
+     * @param timeout_ns Maximum time to wait, or `WAIT_FOREVER`.
+     * @return True if a message is available, false on timeout.
+     */
+    bool wait_readable(uint64_t timeout_ns = WAIT_FOREVER);
+
+    /**
+     * @brief Blocks the producer until a slot is free.
+     * @param timeout_ns Maximum time to wait, or `WAIT_FOREVER`.
+     * @return True if a slot is free, false on timeout.
+     */
+    bool wait_writable(uint64_t timeout_ns = WAIT_FOREVER);
+
+private:
+    static name_registry s_registry;
+
+    enum channel_side {
+        CHANNEL_SIDE_CONSUMER = 0,
+        CHANNEL_SIDE_PRODUCER
+    };
+
+    channel_ring* m_ring = nullptr;
+    uint8_t* m_slots = nullptr;
+    uint32_t m_slot_mask = 0;
+    size_t m_page_count = 0;
+
+    // Tasks parked on either side, only touched on the doorbell slow path
+    sched::wait_queue m_wait_queues[2];
+
+    bool _init(uint32_t slot_count);
+
+    uint8_t* _slot(uint32_t index) {
+        return m_slots + (index & m_slot_mask) * CHANNEL_SLOT_SIZE;
+    }
+
+    bool _is_writable();
+    bool _is_readable();
+
+    kstl::atomic<uint32_t>& _waiting_flag(channel_side side) {
+        return side == CHANNEL_SIDE_CONSUMER ? m_ring->consumer_waiting : m_ring->producer_waiting;
+    }
+
+    /**
+     * @brief Rings the doorbell of a side if it flagged itself as waiting.
+     */
+    void _notify(channel_side side);
+
+    /**
+     * @brief Blocks the calling task until its side of the channel is ready.
+     * @return True if the side is ready, false on timeout.
+     */
+    bool _wait(channel_side side, uint64_t timeout_ns);
+
+    static int64_t _poll_readable(void* data);
+    static int64_t _poll_writable(void* data);
+};
+} // namespace ipc
+
+#endif // CHANNEL_H
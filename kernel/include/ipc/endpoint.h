@@ -0,0 +1,173 @@
+#ifndef ENDPOINT_H
+#define ENDPOINT_H
+#include <string.h>
+#include <sync.h>
+#include <sched/wait_queue.h>
+#include <ipc/handle_table.h>
+
+#define ENDPOINT_ID_INVALID IPC_HANDLE_INVALID
+
+// Size of the per-thread IPC buffer, bounds both requests and replies
+#define IPC_CALL_MAX_MESSAGE_SIZE 512
+
+// States of a call in flight
+#define IPC_CALL_PENDING    0
+#define IPC_CALL_REPLIED    1
+#define IPC_CALL_FAILED     2   // The server closed its handle before replying
+#define IPC_CALL_ABANDONED  3   // The client timed out while the server held the call
+
+namespace ipc {
+using endpoint_handle_t = handle_t;
+
+/**
+ * @struct ipc_call_buffer
+ * @brief Per-thread IPC buffer, describes the task's call in flight and carries its messages.
+ *
+ * Allocated from the kernel heap, which every address space shares, so the server can
+ * read the request and write the reply in place while the client's own stack and
+ * memory are not mapped.
+ */
+struct ipc_call_buffer {
+    task_control_block*     client;
+    size_t                  request_size;
+    size_t                  reply_size;
+    kstl::atomic<uint32_t>  status;         // IPC_CALL_* state
+    ipc_call_buffer*        next;           // Next call pending on the same endpoint
+    uint8_t                 message[IPC_CALL_MAX_MESSAGE_SIZE];
+};
+
+/**
+ * @class endpoint
+ * @brief Synchronous request/reply IPC between client tasks and a server task.
+ *
+ * A client's `call` blocks until the server replied. Messages travel through the client's
+ * per-thread IPC buffer: the request is copied in once, the server reads it in place and
+ * writes its reply back into the same buffer.
+ *
+ * Whenever the other side is ready to run, the CPU is handed straight to it with
+ * `scheduler::yield_to`, donating the rest of the time slice. A call to a server that is
+ * blocked in `receive` and replies right away therefore completes with two direct task
+ * switches and without either side going through a wait queue.
+ *
+ * An endpoint is served by one task at a time, which replies to each request before
+ * receiving the next one. Closing the handle returned by `create` shuts the endpoint
+ * down, calls that are still queued or being served fail.
+ */
+class endpoint : public ipc_object {
+public:
+    static constexpr ipc_object_type object_type = ipc_object_type::ENDPOINT;
+
+    endpoint() : ipc_object(object_type) {}
+
+    /**
+     * @brief Creates a named endpoint, the calling process serves it.
+     * @return Handle to the new endpoint, or `ENDPOINT_ID_INVALID` if the name is taken.
+     */
+    static endpoint_handle_t create(const kstl::string& name);
+
+    /**
+     * @brief Looks up an existing endpoint by name.
+     * @return Handle to the endpoint, or `ENDPOINT_ID_INVALID` if no such endpoint exists.
+     */
+    static endpoint_handle_t open(const kstl::string& name);
+
+    /**
+     * @brief Closes a handle of the calling process.
+     * @return False if the handle was not open.
+     */
+    static bool close(endpoint_handle_t handle);
+
+    /**
+     * @brief Sends a request and blocks until the server replies.
+     * @param handle Endpoint to call.
+     * @param request Request message, at most `IPC_CALL_MAX_MESSAGE_SIZE` bytes.
+     * @param request_size Size of the request.
+     * @param reply Destination buffer for the reply.
+     * @param reply_capacity Capacity of `reply`, larger replies are truncated.
+     * @param[out] out_reply_size Size of the reply the server sent.
+     * @param timeout_ns Maximum time to wait for the reply, or `WAIT_FOREVER`.
+     * @return True once the call was replied to, false if the handle is invalid, the request
+     *         too large, the time ran out or the endpoint was shut down before replying.
+     *
+     * A call that times out while the server is still working on it is withdrawn, its
+     * reply gets dropped.
+     */
+    static bool call(endpoint_handle_t handle, const void* request, size_t request_size,
+                     void* reply, size_t reply_capacity, size_t* out_reply_size,
+                     uint64_t timeout_ns = WAIT_FOREVER);
+
+    /**
+     * @brief Waits for the next request.
+     * @param handle Endpoint to serve.
+     * @param[out] out_size Size of the request.
+     * @param[out] out_client PID of the calling task, may be `nullptr`.
+     * @param timeout_ns Maximum time to wait, 0 to not block at all or `WAIT_FOREVER`.
+     * @return Pointer to the request, or `nullptr` on timeout, after the endpoint was shut
+     *         down or if the previous request hasn't been replied to yet.
+     *
+     * The request is read in place and stays valid until `reply` is called.
+     */
+    static const void* receive(endpoint_handle_t handle, size_t* out_size, pid_t* out_client = nullptr,
+                               uint64_t timeout_ns = WAIT_FOREVER);
+
+    /**
+     * @brief Replies to the request returned by the last `receive` and hands the CPU to the client.
+     * @return False if there is no request to reply to or the reply is too large.
+     */
+    static bool reply(endpoint_handle_t handle, const void* data, size_t size);
+
+    /**
+     * @brief Shuts the endpoint down once the creator's handle is closed, failing every call in flight.
+     */
+    void owner_closed() override;
+
+private:
+    static name_registry s_registry;
+
+    mutex m_lock;
+
+    // Calls waiting to be received, oldest first
+    ipc_call_buffer* m_pending_head = nullptr;
+    ipc_call_buffer* m_pending_tail = nullptr;
+
+    // Call that was received but not replied to yet
+    ipc_call_buffer* m_active_call = nullptr;
+
+    // Task blocked in receive(), the target of a call's handoff. Only set while the
+    // server waits, a task that returned from receive() may exit at any time.
+    task_control_block* m_server = nullptr;
+
+    // Set once the creator's handle was closed
+    bool m_closed = false;
+
+    // The server blocked in receive()
+    sched::wait_queue m_request_waiters;
+
+    // Clients whose call couldn't be replied to right away
+    sched::wait_queue m_reply_waiters;
+
+    /**
+     * @brief Retrieves the calling task's IPC buffer, allocating it on first use.
+     */
+    static ipc_call_buffer* _get_ipc_buffer();
+
+    /**
+     * @brief Hands the CPU to another task if it is ready to run.
+     *
+     * Must be called inside an RCU read-side section that was entered while the task
+     * was known to be alive, `destroy_task` waits for a grace period before freeing it.
+     */
+    static void _handoff(task_control_block* task);
+
+    /**
+     * @brief Takes back a call that timed out.
+     * @return False if the server already took the reply on its way, the caller has to wait for it.
+     */
+    bool _withdraw_call(ipc_call_buffer* pending_call);
+
+    static int64_t _poll_request(void* data);
+    static int64_t _poll_reply(void* data);
+};
+} // namespace ipc
+
+#endif // ENDPOINT_H
@@ -0,0 +1,273 @@
+#ifndef HANDLE_TABLE_H
+#define HANDLE_TABLE_H
+#include <kstl/hashmap.h>
+#include <string.h>
+#include <sync.h>
+
+#define IPC_HANDLE_INVALID              0
+
+// Handle table entries are allocated in chunks that are never freed while the table exists,
+// so lookups can index them without taking the table's lock.
+#define HANDLE_TABLE_CHUNK_ENTRIES      64
+#define HANDLE_TABLE_MAX_CHUNKS         16
+#define HANDLE_TABLE_MAX_ENTRIES        (HANDLE_TABLE_CHUNK_ENTRIES * HANDLE_TABLE_MAX_CHUNKS)
+
+// A handle is the entry index in the low half and the entry's generation in the high half
+#define IPC_HANDLE_INDEX(handle)        static_cast<uint32_t>((handle) & 0xffffffff)
+#define IPC_HANDLE_GENERATION(handle)   static_cast<uint32_t>((handle) >> 32)
+#define IPC_MAKE_HANDLE(gen, index)     ((static_cast<uint64_t>(gen) << 32) | static_cast<uint64_t>(index))
+
+namespace ipc {
+using handle_t = uint64_t;
+
+/**
+ * @enum ipc_object_type
+ * @brief Kinds of kernel objects that can be referenced through a handle.
+ */
+enum class ipc_object_type : uint32_t {
+    NONE = 0,
+    MESSAGE_QUEUE,
+    CHANNEL,
+    ENDPOINT
+};
+
+class name_registry;
+
+/**
+ * @class ipc_object
+ * @brief Reference counted base of all objects reachable through IPC handles.
+ *
+ * Every open handle and a published name each hold a reference. Once the last reference
+ * is dropped the object gets destroyed after an RCU grace period, so lock-free handle
+ * lookups that raced with the final close never see freed memory.
+ */
+class ipc_object {
+public:
+    explicit ipc_object(ipc_object_type type)
+        : m_type(type), m_refcount(1) {}
+
+    virtual ~ipc_object() = default;
+
+    ipc_object(const ipc_object&) = delete;
+    ipc_object& operator=(const ipc_object&) = delete;
+
+    ipc_object_type type() const { return m_type; }
+
+    const kstl::string& name() const { return m_name; }
+
+    /**
+     * @brief Takes an additional reference.
+     */
+    void retain() {
+        m_refcount.fetch_add(1, kstl::memory_order::relaxed);
+    }
+
+    /**
+     * @brief Takes a reference unless the object is already being destroyed.
+     * @return True if a reference was taken.
+     */
+    bool try_retain();
+
+    /**
+     * @brief Drops a reference, destroying the object when it was the last one.
+     */
+    void release();
+
+    /**
+     * @brief Called when the handle that owns the object's name is closed.
+     *
+     * The object stays alive as long as other handles refer to it, objects that
+     * are served by their creator use this to fail whatever is still waiting.
+     */
+    virtual void owner_closed() {}
+
+private:
+    friend class name_registry;
+
+    ipc_object_type         m_type;
+    kstl::atomic<uint32_t>  m_refcount;
+    kstl::string            m_name;
+};
+
+/**
+ * @class name_registry
+ * @brief Global namespace that lets unrelated processes find the same object.
+ *
+ * Only used when creating or opening handles, never on the message paths.
+ */
+class name_registry {
+public:
+    /**
+     * @brief Publishes an object under a name, taking a reference to it.
+     * @return False if the name is already taken.
+     */
+    bool publish(const kstl::string& name, ipc_object* object);
+
+    /**
+     * @brief Looks up an object by name.
+     * @return The object with a reference taken for the caller, or `nullptr` if not found.
+     */
+    ipc_object* find(const kstl::string& name, ipc_object_type type);
+
+    /**
+     * @brief Collects every object currently published under a name.
+     * @param out_objects Receives the objects, each with a reference taken for the caller.
+     * @param max_objects Capacity of `out_objects`.
+     * @param type Type of objects to collect.
+     * @return Number of objects collected.
+     */
+    size_t collect(ipc_object** out_objects, size_t max_objects, ipc_object_type type);
+
+    /**
+     * @brief Withdraws an object's name and drops the registry's reference.
+     *
+     * No-op if the object's name is not published in this registry.
+     */
+    void unpublish(ipc_object* object);
+
+private:
+    rwlock m_lock;
+    bool m_initialized;
+    kstl::hashmap<kstl::string, ipc_object*> m_names;
+
+    void _lazy_init();
+};
+
+/**
+ * @struct handle_table_entry
+ * @brief Slot of a handle table.
+ *
+ * The generation is bumped every time the slot is reused, which
+ * invalidates stale handles that still refer to the previous object.
+ */
+struct handle_table_entry {
+    kstl::atomic<ipc_object*>   object;
+    kstl::atomic<uint32_t>      generation;
+
+    // Registry the object's name gets withdrawn from when the handle is closed
+    name_registry*              name_owner;
+};
+
+/**
+ * @class handle_table
+ * @brief Per-process table translating handles into kernel objects.
+ *
+ * Resolving a handle is a bounds check and an indexed load into the table, without
+ * any global lock or hashing. Installing and closing handles takes the table's lock.
+ * A zero-filled table is valid and empty.
+ */
+class handle_table {
+public:
+    ~handle_table();
+
+    /**
+     * @brief Retrieves the handle table of the calling task.
+     *
+     * Userland processes have their own table, kernel tasks share the kernel's table.
+     */
+    static handle_table* for_current_task();
+
+    /**
+     * @brief Installs an object into a free slot.
+     * @param object Object to install, the table takes over one of the caller's references.
+     * @param name_owner If set, closing the handle also withdraws the object's name from this registry.
+     * @return The new handle, or `IPC_HANDLE_INVALID` if the table is full.
+     */
+    handle_t install(ipc_object* object, name_registry* name_owner = nullptr);
+
+    /**
+     * @brief Resolves a handle.
+     * @param handle Handle to resolve.
+     * @param type Type the object is expected to have.
+     * @return The object with a reference taken for the caller, or `nullptr` if the
+     *         handle is stale, out of range or refers to an object of another type.
+     */
+    ipc_object* lookup(handle_t handle, ipc_object_type type);
+
+    /**
+     * @brief Closes a handle and drops its reference.
+     * @param handle Handle to close.
+     * @param type Type the object is expected to have.
+     * @return False if the handle was not open or refers to an object of another type.
+     */
+    bool close(handle_t handle, ipc_object_type type);
+
+    /**
+     * @brief Closes every open handle.
+     */
+    void close_all();
+
+private:
+    mutex               m_lock;
+    handle_table_entry* m_chunks[HANDLE_TABLE_MAX_CHUNKS];
+    uint32_t            m_free_hint;
+
+    handle_table_entry* _entry(uint32_t index) {
+        handle_table_entry* chunk = kstl::atomic_load(&m_chunks[index / HANDLE_TABLE_CHUNK_ENTRIES], kstl::memory_order::acquire);
+        return chunk ? &chunk[index % HANDLE_TABLE_CHUNK_ENTRIES] : nullptr;
+    }
+
+    void _close_entry(handle_table_entry* entry);
+};
+
+/**
+ * @class object_ref
+ * @brief Holds a reference to the object behind a handle for the duration of an operation.
+ * @tparam T Object class, must expose its type as `T::object_type`.
+ */
+template <typename T>
+class object_ref {
+public:
+    object_ref() : m_object(nullptr) {}
+
+    explicit object_ref(handle_t handle) : m_object(nullptr) {
+        reset(handle);
+    }
+
+    ~object_ref() {
+        if (m_object) {
+            m_object->release();
+        }
+    }
+
+    object_ref(const object_ref&) = delete;
+    object_ref& operator=(const object_ref&) = delete;
+
+    object_ref(object_ref&& other) : m_object(other.m_object) {
+        other.m_object = nullptr;
+    }
+
+    object_ref& operator=(object_ref&& other) {
+        if (this != &other) {
+            if (m_object) {
+                m_object->release();
+            }
+
+            m_object = other.m_object;
+            other.m_object = nullptr;
+        }
+
+        return *this;
+    }
+
+    /**
+     * @brief Drops the current reference and resolves a new handle.
+     */
+    void reset(handle_t handle) {
+        if (m_object) {
+            m_object->release();
+        }
+
+        m_object = static_cast<T*>(handle_table::for_current_task()->lookup(handle, T::object_type));
+    }
+
+    T* get() const { return m_object; }
+    T* operator->() const { return m_object; }
+    explicit operator bool() const { return m_object != nullptr; }
+
+private:
+    T* m_object;
+};
+} // namespace ipc
+
+#endif // HANDLE_TABLE_H
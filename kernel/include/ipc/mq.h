@@ -3,11 +3,23 @@
 #include <kstl/hashmap.h>
 #include <string.h>
 #include <sync.h>
+#include <sched/wait_queue.h>
+#include <ipc/handle_table.h>
 
-#define MESSAGE_QUEUE_ID_INVALID 0
+#define MESSAGE_QUEUE_ID_INVALID IPC_HANDLE_INVALID
+
+// Coalescing class of messages that are always queued individually
+#define MQ_COALESCE_NONE 0
+
+// Limits a new queue starts out with
+#define MQ_DEFAULT_MAX_MESSAGES     256
+#define MQ_DEFAULT_MAX_BYTES        (256 * 1024)
+
+// Longest queue name reported in statistics, longer names are truncated
+#define MQ_STATS_NAME_LEN           31
 
 namespace ipc {
-using mq_handle_t = uint64_t;
+using mq_handle_t = handle_t;
 
 struct mq_message {
     uint64_t message_id;
@@ -16,39 +28,242 @@ struct mq_message {
 };
 
 struct mq_node {
-    mq_message* message;
+    mq_message message;
+    uint64_t coalesce_key;
     mq_node* next;
 };
 
-class message_queue {
+/**
+ * @enum mq_overflow_policy
+ * @brief What happens to messages posted to a queue that reached one of its limits.
+ */
+enum class mq_overflow_policy : uint32_t {
+    BLOCK = 0,      // Posters wait until the consumer makes room
+    FAIL,           // Posting fails right away
+    DROP_OLDEST     // The oldest pending messages are discarded to make room
+};
+
+/**
+ * @struct mq_limits
+ * @brief Bounds on the messages pending in a queue.
+ */
+struct mq_limits {
+    size_t              max_messages;   // Maximum number of pending messages
+    size_t              max_bytes;      // Maximum combined payload size of pending messages
+    mq_overflow_policy  policy;
+};
+
+/**
+ * @struct mq_stats
+ * @brief Snapshot of a queue's occupancy and traffic counters.
+ */
+struct mq_stats {
+    size_t      depth;              // Pending messages
+    size_t      bytes;              // Combined payload size of pending messages
+    size_t      high_water_mark;    // Highest depth ever reached
+    uint64_t    posted;             // Messages accepted into the queue
+    uint64_t    coalesced;          // Messages merged into a pending one
+    uint64_t    dropped;            // Pending messages discarded to make room
+    uint64_t    rejected;           // Messages refused because the queue was full
+    uint64_t    blocked;            // Times a poster had to wait for room
+    mq_limits   limits;
+};
+
+/**
+ * @struct mq_stats_info
+ * @brief Statistics of a named queue as reported by `message_queue::get_all_stats`.
+ */
+struct mq_stats_info {
+    char        name[MQ_STATS_NAME_LEN + 1];
+    mq_stats    stats;
+};
+
+/**
+ * @typedef mq_coalesce_fn
+ * @brief Classifies a message for coalescing.
+ * @return Coalescing class of the message, or `MQ_COALESCE_NONE` if it must always be queued.
+ *
+ * A message that arrives while the newest pending message is of the same class replaces it,
+ * so a burst of updates that supersede each other (e.g. pointer motion) only ever occupies
+ * one entry of a slow consumer's queue. Only adjacent messages are merged, which preserves
+ * the order of a message relative to messages of other classes.
+ */
+typedef uint64_t (*mq_coalesce_fn)(const mq_message* message);
+
+class message_queue : public ipc_object {
 public:
+    static constexpr ipc_object_type object_type = ipc_object_type::MESSAGE_QUEUE;
+
+    message_queue() : ipc_object(object_type) {}
+    ~message_queue();
+
     // Public facing API
     static mq_handle_t create(const kstl::string& name);
     static mq_handle_t open(const kstl::string& name);
 
+    /**
+     * @brief Closes a handle of the calling process.
+     * @return False if the handle was not open.
+     *
+     * Closing the handle returned by `create` also withdraws the queue's name.
+     * The queue itself is destroyed once no process holds a handle to it anymore.
+     */
+    static bool close(mq_handle_t handle);
+
     static bool post_message(mq_handle_t handle, mq_message* message);
     static bool peek_message(mq_handle_t handle);
     static bool get_message(mq_handle_t handle, mq_message* out_message);
 
+    /**
+     * @brief Posts several messages with a single acquisition of the queue's lock.
+     * @param handle Queue to post to.
+     * @param messages Messages to post, their payloads are copied.
+     * @param count Number of messages.
+     * @return True if every message was posted, false if the handle is invalid or
+     *         allocating the copies failed, in which case none of them were posted.
+     *
+     * Receivers are woken up once for the whole batch.
+     */
+    static bool post_messages(mq_handle_t handle, const mq_message* messages, size_t count);
+
+    /**
+     * @brief Retrieves up to `max_count` pending messages with a single acquisition of the queue's lock.
+     * @param handle Queue to receive from.
+     * @param out_messages Receives the messages, their payloads are allocated for the caller.
+     * @param max_count Capacity of `out_messages`.
+     * @return Number of messages retrieved, 0 if the queue is empty or the handle is invalid.
+     */
+    static size_t get_messages(mq_handle_t handle, mq_message* out_messages, size_t max_count);
+
+    /**
+     * @brief Installs the coalescing rule of a queue.
+     * @param handle Queue to configure.
+     * @param rule Classifies incoming messages, `nullptr` queues every message individually.
+     * @return False if the handle is invalid.
+     */
+    static bool set_coalescing_rule(mq_handle_t handle, mq_coalesce_fn rule);
+
+    /**
+     * @brief Changes the limits of a queue.
+     * @return False if the handle is invalid or a limit is 0.
+     *
+     * Messages already pending above the new limits are kept, new
+     * messages are only accepted once the queue drained below them.
+     */
+    static bool set_limits(mq_handle_t handle, const mq_limits& limits);
+
+    /**
+     * @brief Retrieves the statistics of a queue.
+     * @return False if the handle is invalid.
+     */
+    static bool get_stats(mq_handle_t handle, mq_stats* out_stats);
+
+    /**
+     * @brief Retrieves the statistics of every queue that currently has a name.
+     * @param buffer Receives one entry per queue.
+     * @param max_entries Capacity of `buffer`.
+     * @return Number of entries written.
+     */
+    static size_t get_all_stats(mq_stats_info* buffer, size_t max_entries);
+
+    /**
+     * @brief Retrieves the next message, blocking until one arrives.
+     * @param handle Queue to receive from.
+     * @param out_message Receives the message, its payload is allocated for the caller.
+     * @param timeout_ns Maximum time to wait, 0 to not block at all or `WAIT_FOREVER`.
+     * @return True if a message was received, false on timeout or if the handle is invalid.
+     */
+    static bool receive(mq_handle_t handle, mq_message* out_message, uint64_t timeout_ns = WAIT_FOREVER);
+
+    /**
+     * @brief Blocks until any of several queues has a message pending.
+     * @param handles Queues to wait on, at most `WAIT_MAX_QUEUES`.
+     * @param count Number of handles.
+     * @param timeout_ns Maximum time to wait, 0 to not block at all or `WAIT_FOREVER`.
+     * @return Index into `handles` of a queue with a pending message, or -1 on
+     *         timeout or if any of the handles is invalid.
+     *
+     * No message is consumed, the caller retrieves it with `get_message`.
+     */
+    static int64_t wait_any(const mq_handle_t* handles, size_t count, uint64_t timeout_ns = WAIT_FOREVER);
+
 private:
-    static mq_handle_t s_available_mq_id;
-    static mutex s_queue_map_lock;
+    // Handles are resolved through the caller's handle table,
+    // names are only looked up when opening a queue.
+    static name_registry s_registry;
 
-    static kstl::hashmap<kstl::string, mq_handle_t> s_mq_name_mappings;
-    static kstl::hashmap<mq_handle_t, kstl::shared_ptr<message_queue>> s_message_queue_map;
+    static int64_t _poll_queue(void* data);
+    static int64_t _poll_queue_set(void* data);
+    static int64_t _poll_room(void* data);
 
-    static message_queue* _get_mq_object(mq_handle_t handle);
-    
     // Private API
     mq_node* m_head = nullptr;
     mq_node* m_tail = nullptr;
-    size_t m_message_count = 0;
     mutex m_lock;
     uint64_t m_next_message_id = 1;
+    mq_coalesce_fn m_coalesce_rule = nullptr;
+
+    // Occupancy is written under the lock, but read without it by posters checking for room
+    kstl::atomic<size_t> m_message_count = 0;
+    kstl::atomic<size_t> m_byte_count = 0;
+    mq_limits m_limits = { MQ_DEFAULT_MAX_MESSAGES, MQ_DEFAULT_MAX_BYTES, mq_overflow_policy::BLOCK };
+
+    size_t m_high_water_mark = 0;
+    uint64_t m_posted_count = 0;
+    uint64_t m_coalesced_count = 0;
+    uint64_t m_dropped_count = 0;
+    kstl::atomic<uint64_t> m_rejected_count = 0;
+    kstl::atomic<uint64_t> m_blocked_count = 0;
+
+    // Tasks blocked in receive() or wait_any() on this queue
+    sched::wait_queue m_waiters;
+
+    // Posters blocked on a full queue
+    sched::wait_queue m_room_waiters;
 
-    bool _post_message(mq_message* message);
+    bool _post_messages(const mq_message* messages, size_t count);
     bool _peek_message();
-    bool _get_message(mq_message* out_message);
+    size_t _get_messages(mq_message* out_messages, size_t max_count);
+
+    /**
+     * @brief Copies a message into a new node that is ready to be queued.
+     */
+    mq_node* _alloc_node(const mq_message* message);
+
+    static void _free_node(mq_node* node);
+    static void _free_nodes(mq_node* nodes);
+
+    mq_limits _get_limits();
+    void _get_stats(mq_stats* out_stats);
+
+    /**
+     * @brief Checks whether messages of a given combined size fit within the limits.
+     */
+    bool _has_room(size_t count, size_t bytes);
+
+    /**
+     * @brief Blocks the calling poster until a message of the given size fits.
+     */
+    void _wait_for_room(size_t bytes);
+
+    /**
+     * @brief Merges a message into the newest pending one if they share a coalescing class.
+     * @return True if the message was merged, false if it still needs a slot of its own.
+     */
+    bool _try_coalesce(const mq_message* message);
+
+    /**
+     * @brief Appends a node to the queue or merges it into the newest pending message.
+     * @return False if the queue is full and its policy doesn't allow dropping older messages.
+     * @note The queue's lock must be held.
+     */
+    bool _enqueue_node_locked(mq_node* node);
+
+    /**
+     * @brief Discards the oldest pending message.
+     * @note The queue's lock must be held.
+     */
+    void _drop_oldest_locked();
 };
 } // namespace ipc
 
@@ -0,0 +1,198 @@
+#ifndef KSTL_ATOMIC_H
+#define KSTL_ATOMIC_H
+#include <types.h>
+
+namespace kstl {
+/**
+ * @enum memory_order
+ * @brief Ordering constraints for atomic operations.
+ *
+ * On x86-64 the hardware memory model is already TSO, so most orderings only
+ * restrict compiler reordering and compile down to plain moves:
+ *
+ *   - relaxed/acquire loads and relaxed/release stores are a plain `mov`.
+ *   - seq_cst stores are an implicitly locked `xchg`.
+ *   - Read-modify-write operations are always a `lock`-prefixed instruction,
+ *     which is a full barrier regardless of the requested ordering.
+ *   - Only a seq_cst fence emits a real fence instruction.
+ */
+enum class memory_order : int {
+    relaxed = __ATOMIC_RELAXED,
+    acquire = __ATOMIC_ACQUIRE,
+    release = __ATOMIC_RELEASE,
+    acq_rel = __ATOMIC_ACQ_REL,
+    seq_cst = __ATOMIC_SEQ_CST
+};
+
+/**
+ * @brief Derives a valid load ordering for the failure path of a compare-exchange.
+ */
+constexpr memory_order __cmpxchg_failure_order(memory_order order) {
+    return order == memory_order::acq_rel ? memory_order::acquire
+         : order == memory_order::release ? memory_order::relaxed
+         : order;
+}
+
+/**
+ * @brief Issues a memory fence with the given ordering.
+ *
+ * Acquire and release fences only constrain the compiler on x86-64,
+ * a seq_cst fence orders prior stores against subsequent loads.
+ */
+static __force_inline__ void atomic_thread_fence(memory_order order = memory_order::seq_cst) {
+    __atomic_thread_fence(static_cast<int>(order));
+}
+
+/**
+ * @brief Prevents the compiler from reordering memory accesses across this point.
+ *
+ * Emits no instructions, useful for ordering against interrupt handlers on the same CPU.
+ */
+static __force_inline__ void atomic_signal_fence(memory_order order = memory_order::seq_cst) {
+    __atomic_signal_fence(static_cast<int>(order));
+}
+
+/**
+ * @brief Atomically reads a plain variable that is shared with other CPUs.
+ *
+ * Meant for data whose type can't change to `atomic<T>`, such as per-CPU
+ * variables or pointers published through RCU.
+ */
+template <typename T>
+__force_inline__ T atomic_load(const T* ptr, memory_order order = memory_order::seq_cst) {
+    return __atomic_load_n(ptr, static_cast<int>(order));
+}
+
+/**
+ * @brief Atomically writes a plain variable that is shared with other CPUs.
+ */
+template <typename T>
+__force_inline__ void atomic_store(T* ptr, T value, memory_order order = memory_order::seq_cst) {
+    __atomic_store_n(ptr, value, static_cast<int>(order));
+}
+
+/**
+ * @class atomic
+ * @brief Lock-free atomic wrapper for integral and pointer types.
+ * @tparam T Integral or pointer type of 1, 2, 4 or 8 bytes.
+ *
+ * The layout is identical to a plain `T`, and a zero-filled object is a valid atomic holding
+ * zero, so atomics can be used in globals and structures that never get constructed.
+ */
+template <typename T>
+class atomic {
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+                  "kstl::atomic only supports natively sized types");
+
+public:
+    atomic() = default;
+    constexpr atomic(T value) : m_value(value) {}
+
+    atomic(const atomic&) = delete;
+    atomic& operator=(const atomic&) = delete;
+
+    /**
+     * @brief Atomically reads the current value.
+     */
+    __force_inline__ T load(memory_order order = memory_order::seq_cst) const {
+        return __atomic_load_n(&m_value, static_cast<int>(order));
+    }
+
+    /**
+     * @brief Atomically replaces the current value.
+     */
+    __force_inline__ void store(T value, memory_order order = memory_order::seq_cst) {
+        __atomic_store_n(&m_value, value, static_cast<int>(order));
+    }
+
+    /**
+     * @brief Atomically replaces the current value and returns the previous one.
+     */
+    __force_inline__ T exchange(T value, memory_order order = memory_order::seq_cst) {
+        return __atomic_exchange_n(&m_value, value, static_cast<int>(order));
+    }
+
+    /**
+     * @brief Atomically replaces the value if it equals `expected`.
+     * @param expected Value the caller expects, updated with the current value on failure.
+     * @param desired Value to store on success.
+     * @return True if the value was replaced, false otherwise.
+     */
+    __force_inline__ bool compare_exchange_strong(T& expected, T desired, memory_order order = memory_order::seq_cst) {
+        return __atomic_compare_exchange_n(
+            &m_value, &expected, desired, false,
+            static_cast<int>(order), static_cast<int>(__cmpxchg_failure_order(order))
+        );
+    }
+
+    /**
+     * @brief Same as `compare_exchange_strong`, but may fail spuriously.
+     *
+     * Never fails spuriously on x86-64, provided for use in retry loops.
+     */
+    __force_inline__ bool compare_exchange_weak(T& expected, T desired, memory_order order = memory_order::seq_cst) {
+        return __atomic_compare_exchange_n(
+            &m_value, &expected, desired, true,
+            static_cast<int>(order), static_cast<int>(__cmpxchg_failure_order(order))
+        );
+    }
+
+    /**
+     * @brief Atomically adds to the value and returns the previous value.
+     *
+     * For pointer types the argument is a byte offset.
+     */
+    template <typename D>
+    __force_inline__ T fetch_add(D delta, memory_order order = memory_order::seq_cst) {
+        return __atomic_fetch_add(&m_value, delta, static_cast<int>(order));
+    }
+
+    /**
+     * @brief Atomically subtracts from the value and returns the previous value.
+     *
+     * For pointer types the argument is a byte offset.
+     */
+    template <typename D>
+    __force_inline__ T fetch_sub(D delta, memory_order order = memory_order::seq_cst) {
+        return __atomic_fetch_sub(&m_value, delta, static_cast<int>(order));
+    }
+
+    /**
+     * @brief Atomically ANDs the value with a mask and returns the previous value.
+     */
+    __force_inline__ T fetch_and(T mask, memory_order order = memory_order::seq_cst) {
+        return __atomic_fetch_and(&m_value, mask, static_cast<int>(order));
+    }
+
+    /**
+     * @brief Atomically ORs the value with a mask and returns the previous value.
+     */
+    __force_inline__ T fetch_or(T mask, memory_order order = memory_order::seq_cst) {
+        return __atomic_fetch_or(&m_value, mask, static_cast<int>(order));
+    }
+
+    /**
+     * @brief Atomically XORs the value with a mask and returns the previous value.
+     */
+    __force_inline__ T fetch_xor(T mask, memory_order order = memory_order::seq_cst) {
+        return __atomic_fetch_xor(&m_value, mask, static_cast<int>(order));
+    }
+
+    __force_inline__ operator T() const { return load(); }
+
+    __force_inline__ T operator=(T value) {
+        store(value);
+        return value;
+    }
+
+    __force_inline__ T operator++()    { return fetch_add(1) + 1; }
+    __force_inline__ T operator++(int) { return fetch_add(1); }
+    __force_inline__ T operator--()    { return fetch_sub(1) - 1; }
+    __force_inline__ T operator--(int) { return fetch_sub(1); }
+
+private:
+    alignas(sizeof(T)) volatile T m_value;
+};
+} // namespace kstl
+
+#endif // KSTL_ATOMIC_H
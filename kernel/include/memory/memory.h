@@ -2,6 +2,7 @@
 #define MEMORY_H
 #include <types.h>
 #include <type_traits>
+#include <kstl/atomic.h>
 
 /**
  * @brief Sets the first `count` bytes of the memory area pointed to by `ptr` to the specified `value`.
@@ -72,7 +73,7 @@ template <typename U> friend class shared_ptr;
 public:
     // Default constructor
     explicit shared_ptr(T* ptr = nullptr) 
-        : m_ptr(ptr), m_ref_count(ptr ? new size_t(1) : nullptr) {}
+        : m_ptr(ptr), m_ref_count(ptr ? new kstl::atomic<size_t>(1) : nullptr) {}
 
     // Destructor
     ~shared_ptr() noexcept {
@@ -83,7 +84,7 @@ public:
     shared_ptr(const shared_ptr& other) 
         : m_ptr(other.m_ptr), m_ref_count(other.m_ref_count) {
         if (m_ref_count) {
-            ++(*m_ref_count);
+            _retain();
         }
     }
 
@@ -95,7 +96,7 @@ public:
           m_ref_count(other.m_ref_count)
     {
         if (m_ref_count) {
-            ++(*m_ref_count);
+            _retain();
         }
     }
 
@@ -106,7 +107,7 @@ public:
             m_ptr = other.m_ptr;
             m_ref_count = other.m_ref_count;
             if (m_ref_count) {
-                ++(*m_ref_count);
+                _retain();
             }
         }
         return *this;
@@ -124,7 +125,7 @@ public:
         : m_ptr(casted_ptr),
         m_ref_count(other.m_ref_count) {
         if (m_ref_count) {
-            ++(*m_ref_count);
+            _retain();
         }
     }
 
@@ -180,7 +181,7 @@ public:
 
     // Utility functions
     size_t ref_count() const {
-        return m_ref_count ? *m_ref_count : 0;
+        return m_ref_count ? m_ref_count->load(kstl::memory_order::relaxed) : 0;
     }
 
     T* get() const { 
@@ -189,10 +190,17 @@ public:
 
 private:
     T* m_ptr;
-    size_t* m_ref_count;
+    kstl::atomic<size_t>* m_ref_count;
+
+    // A new reference is always made from an existing one,
+    // so the increment itself needs no ordering.
+    void _retain() noexcept {
+        m_ref_count->fetch_add(1, kstl::memory_order::relaxed);
+    }
 
     void release_resources() noexcept {
-        if (m_ref_count && --(*m_ref_count) == 0) {
+        // The final release has to observe all writes made through other references
+        if (m_ref_count && m_ref_count->fetch_sub(1, kstl::memory_order::acq_rel) == 1) {
             delete m_ptr;
             delete m_ref_count;
         }
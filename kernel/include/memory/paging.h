@@ -291,6 +291,35 @@ __PRIVILEGED_CODE pte_t* get_pte_entry(void* vaddr);
  */
 __PRIVILEGED_CODE uintptr_t get_physical_address(void* vaddr);
 
+/**
+ * @brief Checks whether a virtual address range is mapped and user-accessible.
+ *
+ * Walks the paging hierarchy for every page in [vaddr, vaddr + size) and requires
+ * each level to be present with the user/supervisor bit set, so that pointers handed
+ * in by lower privilege code can be validated before the kernel dereferences them.
+ *
+ * @param vaddr Start of the range.
+ * @param size Size of the range in bytes, an empty range is rejected.
+ * @param pml4 Physical address of the PML4 to walk, or nullptr for the active one.
+ * @return True if lower privilege code could access the entire range.
+ *
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE bool is_user_range(uintptr_t vaddr, size_t size, page_table* pml4 = nullptr);
+
+/**
+ * @brief Checks whether a null-terminated string lies in user-accessible memory.
+ *
+ * @param vaddr Start of the string.
+ * @param max_length Most bytes the string may span, including the terminator.
+ * @param pml4 Physical address of the PML4 to walk, or nullptr for the active one.
+ * @return True if the terminator was found within `max_length` bytes and every
+ *         byte up to it passed `is_user_range`.
+ *
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE bool is_user_string(uintptr_t vaddr, size_t max_length, page_table* pml4 = nullptr);
+
 /**
  * @brief Creates a new page table hierarchy for a userland process.
  *
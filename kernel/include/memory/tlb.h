@@ -26,6 +26,24 @@ __PRIVILEGED_CODE static inline void tlb_flush_all() {
     asm volatile("mov %%cr3, %0" : "=r"(cr3));
     asm volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
 }
+
+/**
+ * @brief Installs the IPI handler that serves `tlb_shootdown` requests on every CPU.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void install_tlb_shootdown_handler();
+
+/**
+ * @brief Flushes the TLB of every online CPU and waits until all of them are done.
+ * 
+ * Needed before freeing pages that were mapped in an address space other CPUs may be
+ * running in, which is the case for the shared kernel page table. May sleep, must not
+ * be called with a spinlock held.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void tlb_shootdown();
 } // namespace paging
 
 #endif // TLB_H
@@ -3,6 +3,7 @@
 #include "module_base.h"
 #include <memory/memory.h>
 #include <kstl/vector.h>
+#include <sync.h>
 
 namespace modules {
 /**
@@ -146,11 +147,22 @@ public:
      * @brief Finds a module by its name.
      * @param name The name of the module to find.
      * @return Pointer to the module if found, or `nullptr` otherwise.
+     * 
+     * The lookup is lock-free, the module list is read under RCU protection.
      */
     module_base* find_module(const kstl::string& name);
 
 private:
-    kstl::vector<kstl::shared_ptr<module_base>> m_modules; /** List of registered modules */
+    kstl::vector<kstl::shared_ptr<module_base>>* m_modules = nullptr; /** RCU-protected list of registered modules */
+    mutex m_modules_lock = mutex(); /** Serializes module list updates */
+
+    /**
+     * @brief Publishes a new module list and frees the old one after a grace period.
+     * @param new_list The fully populated module list to publish.
+     * 
+     * Must be called with `m_modules_lock` held.
+     */
+    void _publish_module_list(kstl::vector<kstl::shared_ptr<module_base>>* new_list);
 
     /**
      * @brief Entry point for tasks to start modules asynchronously in a separate thread.
@@ -4,9 +4,13 @@
 #include "mm.h"
 #include <memory/paging.h>
 #include <arch/percpu.h>
+#include <kstl/atomic.h>
 
 #define MAX_PROCESS_NAME_LEN 255
 
+// Affinity mask that allows a task to run on any CPU
+#define CPU_AFFINITY_ALL 0xffffffffffffffffull
+
 typedef int64_t pid_t;
 
 /**
@@ -22,6 +26,45 @@ enum class process_state {
     TERMINATED  // Finished execution
 };
 
+/**
+ * @struct task_sched_stats
+ * @brief Scheduler accounting data of a task, all times are in TSC cycles.
+ */
+struct task_sched_stats {
+    uint64_t runtime;                   // Total time spent executing
+    uint64_t wait_time;                 // Total time spent runnable, waiting in a run queue
+    uint64_t nr_voluntary_switches;     // Times the task yielded or blocked
+    uint64_t nr_involuntary_switches;   // Times the task got preempted
+    uint64_t last_switch_in;            // Timestamp of the last switch into the task
+    uint64_t ready_since;               // Timestamp of when the task last became runnable, 0 if it isn't waiting
+};
+
+/**
+ * @struct task_stats_info
+ * @brief Snapshot of a task's scheduler statistics, as reported to userland.
+ */
+struct task_stats_info {
+    pid_t       pid;
+    uint32_t    cpu;
+    uint32_t    state;                  // process_state value
+    uint64_t    runtime_ns;
+    uint64_t    wait_time_ns;
+    uint64_t    nr_voluntary_switches;
+    uint64_t    nr_involuntary_switches;
+    char        name[32];
+};
+
+namespace ipc {
+class handle_table;
+struct ipc_call_buffer;
+} // namespace ipc
+
+namespace fs {
+class fd_table;
+class io_ring;
+class mmap_table;
+} // namespace fs
+
 /**
  * @struct task_control_block
  * @brief Represents the control block for a task or process.
@@ -54,10 +97,59 @@ struct task_control_block {
         uint64_t    flrsvd      : 55;
     } __attribute__((packed));
 
+    // Bitmask of CPUs the task is allowed to be balanced or migrated onto
+    uint64_t        cpu_affinity;
+
     // MMU-specific context
     mm_context      mm_ctx;
 
     char            name[MAX_PROCESS_NAME_LEN + 1];
+
+    // Intrusive linkage into the owning CPU's run queue
+    task_control_block* rq_next;
+    task_control_block* rq_prev;
+    bool                on_run_queue;
+
+    // Depth of nested RCU read-side critical sections
+    uint32_t            rcu_read_nesting;
+
+    // Set if the task got switched out inside of an RCU read-side critical section
+    bool                rcu_read_blocked;
+
+    // Extended (x87/SSE/AVX) register save area, null for tasks that can't use the FPU
+    uint8_t*            fpu_state;
+
+    // CPU ID + 1 of the CPU whose registers last had the extended state loaded, 0 if none
+    uint64_t            fpu_loaded_cpu;
+
+    // Set once the task has executed its first FPU/SIMD instruction
+    bool                fpu_used;
+
+    // Set while a CPU is executing on the task's stacks, cleared
+    // only after a context switch away from the task has completed.
+    kstl::atomic<uint8_t> on_cpu;
+
+    // CPU time and context switch accounting
+    task_sched_stats    sched_stats;
+
+    // Linkage into the global list of all tasks
+    task_control_block* tasks_next;
+    task_control_block* tasks_prev;
+
+    // IPC handles owned by the process, null for kernel tasks which share the kernel's table
+    ipc::handle_table*  handles;
+
+    // Per-thread buffer that IPC calls pass their messages through, allocated on first use
+    ipc::ipc_call_buffer* ipc_buffer;
+
+    // Open files of the process, null for kernel tasks which share the kernel's table
+    fs::fd_table*       fds;
+
+    // Asynchronous I/O ring of the process, null until the process sets one up
+    fs::io_ring*        io_ring;
+
+    // File mappings of the process, null for kernel tasks which share the kernel's table
+    fs::mmap_table*     mmaps;
 };
 
 /**
@@ -130,6 +222,20 @@ __PRIVILEGED_CODE void switch_context_in_irq(
     ptregs* irq_frame
 );
 
+/**
+ * @brief Directly switches from the current task into another task.
+ * @param from Pointer to the current task being switched out.
+ * @param to Pointer to the task being switched in.
+ * 
+ * Fast path for voluntary yields and blocking waits. Only the callee-saved registers of
+ * the outgoing task are saved, and no software interrupt is raised. The call returns once
+ * `from` gets scheduled again, either through this function or through the IRQ path.
+ * Must be called with interrupts disabled from a privileged task context.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void switch_to(task_control_block* from, task_control_block* to);
+
 /**
  * @brief Creates a privileged kernel task.
  * @param entry Entry function for the task.
@@ -175,6 +281,19 @@ __PRIVILEGED_CODE task_control_block* create_upper_class_userland_task(
  */
 __PRIVILEGED_CODE bool destroy_task(task_control_block* task);
 
+/**
+ * @brief Collects scheduler statistics of all existing tasks.
+ * @param buffer Array to write the per-task snapshots into.
+ * @param max_entries Capacity of `buffer`.
+ * @return Number of entries written, per-CPU idle tasks are not included.
+ * 
+ * `buffer` is filled while holding the task list lock with interrupts off,
+ * so it has to be kernel memory that can't fault.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE size_t get_task_stats(task_stats_info* buffer, size_t max_entries);
+
 /**
  * @brief Creates a new system stack.
  * 
@@ -28,6 +28,12 @@ struct ptregs {
     uint64_t error;             // Error code in case of a CPU exception (0 if no error code needed)
     interrupt_hw_frame hwframe; // Hardware interrupt frame
 } __attribute__((packed));
+
+// The voluntary context switch path in context_switch.S depends on this layout
+static_assert(sizeof(ptregs) == 0xd0);
+static_assert(__builtin_offsetof(ptregs, es) == 0x10);
+static_assert(__builtin_offsetof(ptregs, ds) == 0x18);
+static_assert(__builtin_offsetof(ptregs, hwframe) == 0xa8);
 #else
 struct ptregs {};
 #endif
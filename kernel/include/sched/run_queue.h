@@ -2,7 +2,6 @@
 #define RUN_QUEUE_H
 #include <sync.h>
 #include <process/process.h>
-#include <kstl/vector.h>
 
 namespace sched {
 /**
@@ -10,7 +9,9 @@ namespace sched {
  * @brief Represents a task run queue for CPU scheduling.
  * 
  * Maintains a queue of tasks eligible for execution on a CPU and provides methods to add, remove,
- * and select tasks using a Round-Robin scheduling policy.
+ * and select tasks using a Round-Robin scheduling policy. Tasks are linked intrusively through
+ * their control blocks, so queue operations never allocate and can safely be performed with
+ * interrupts disabled under the queue's IRQ-safe spinlock.
  */
 class sched_run_queue {
 public:
@@ -24,7 +25,10 @@ public:
      * @param task Pointer to the task control block to add.
      * 
      * Enqueues the task for scheduling. This method is thread-safe and ensures
-     * proper synchronization when modifying the queue.
+     * proper synchronization when modifying the queue. Adding a task that is
+     * already queued has no effect.
+     * 
+     * @note Privilege: **required**
      */
     void add_task(task_control_block* task);
 
@@ -34,6 +38,8 @@ public:
      * 
      * Dequeues the specified task, making it ineligible for further scheduling.
      * This method is thread-safe and ensures proper synchronization.
+     * 
+     * @note Privilege: **required**
      */
     void remove_task(task_control_block* task);
 
@@ -43,12 +49,49 @@ public:
      * 
      * Selects the next task for execution based on a simple Round-Robin scheduling algorithm.
      * This method ensures fairness by cycling through tasks in the order they were added.
+     * 
+     * @note Privilege: **required**
      */
     task_control_block* pick_next();
 
+    /**
+     * @brief Removes a task that is waiting in the queue and may migrate to another CPU.
+     * @param cpu The CPU that wants to run the task.
+     * @return Pointer to the removed task, or `nullptr` if no task can be migrated.
+     * 
+     * Only tasks that aren't currently executing and whose affinity mask includes `cpu`
+     * are considered. The oldest such task gets picked to preserve round-robin fairness.
+     * 
+     * @note Privilege: **required**
+     */
+    task_control_block* steal_task(int cpu);
+
+    /**
+     * @brief Picks a specific task to run next instead of the round-robin choice.
+     * @param task The task to pick.
+     * @return True if the task is waiting in this queue and got picked, false otherwise.
+     * 
+     * The task is rotated to the back of the queue, as if `pick_next` had returned it.
+     * 
+     * @note Privilege: **required**
+     */
+    bool pick_task(task_control_block* task);
+
+    /**
+     * @brief Removes a specific waiting task so it can migrate to another CPU.
+     * @param task The task to remove.
+     * @param cpu The CPU that wants to run the task.
+     * @return True if the task was removed, false if it is running or can't run on `cpu`.
+     * 
+     * @note Privilege: **required**
+     */
+    bool take_task(task_control_block* task, int cpu);
+
     /**
      * @brief Checks if the run queue is empty.
      * @return True if the queue is empty, false otherwise.
+     * 
+     * @note Privilege: **required**
      */
     bool is_empty();
 
@@ -56,12 +99,28 @@ public:
      * @brief Retrieves the size of the run queue.
      * @return The number of tasks currently in the queue.
      */
-    size_t size() const { return m_tasks.size(); }
+    size_t size() const { return m_count; }
 
 private:
-    kstl::vector<task_control_block*> m_tasks;
-    mutex m_lock = mutex();
-    size_t m_next_index;
+    task_control_block* m_head;
+    task_control_block* m_tail;
+    size_t m_count;
+    spinlock m_lock = spinlock();
+
+    /**
+     * @brief Checks whether a task is linked into this queue, the lock must be held.
+     */
+    bool _contains(task_control_block* task);
+
+    /**
+     * @brief Appends a task to the tail of the queue, the lock must be held.
+     */
+    void _append(task_control_block* task);
+
+    /**
+     * @brief Unlinks a task from the queue, the lock must be held.
+     */
+    void _unlink(task_control_block* task);
 };
 } // namespace sched
 
@@ -3,7 +3,80 @@
 #include "run_queue.h"
 #include <memory/memory.h>
 
+/**
+ * @brief Per-CPU preemption disable depth, the CPU can only be preempted while it's zero.
+ */
+DECLARE_PER_CPU(uint64_t, preempt_count);
+
+/**
+ * @brief Per-CPU flag requesting a reschedule as soon as the CPU becomes preemptible.
+ */
+DECLARE_PER_CPU(uint64_t, need_resched);
+
 namespace sched {
+/**
+ * @struct cpu_stats_info
+ * @brief Snapshot of a CPU's scheduler statistics, as reported to userland.
+ */
+struct cpu_stats_info {
+    uint64_t cpu;
+    uint64_t idle_time_ns;      // Time spent in the CPU's idle task
+    uint64_t nr_queued;         // Tasks currently in the CPU's run queue
+    uint64_t isolated;          // Non-zero if the CPU is excluded from general scheduling
+};
+
+/**
+ * @typedef sched_switch_tracepoint_t
+ * @brief Hook invoked on every context switch, with interrupts disabled.
+ */
+typedef void (*sched_switch_tracepoint_t)(task_control_block* from, task_control_block* to, bool voluntary);
+
+/**
+ * @typedef sched_wakeup_tracepoint_t
+ * @brief Hook invoked whenever a task is made runnable on a CPU.
+ */
+typedef void (*sched_wakeup_tracepoint_t)(task_control_block* task, int cpu);
+
+/**
+ * @brief Installs tracepoint hooks for scheduler events.
+ * @param on_switch Called on every context switch, or `nullptr` to disable.
+ * @param on_wakeup Called whenever a task gets enqueued, or `nullptr` to disable.
+ * 
+ * Hooks run in scheduler context and must neither block nor take sleeping locks.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void register_sched_tracepoints(sched_switch_tracepoint_t on_switch, sched_wakeup_tracepoint_t on_wakeup);
+
+/**
+ * @brief Updates runtime, wait time and switch counters of the tasks involved in a context switch.
+ * @param from The task being switched out, its state must already be updated.
+ * @param to The task being switched in.
+ * @param voluntary True if `from` yielded or blocked, false if it got preempted.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void account_task_switch(task_control_block* from, task_control_block* to, bool voluntary);
+
+/**
+ * @brief Converts a task's accounting data into a userland-facing snapshot.
+ * @param task The task to report on.
+ * @param[out] info The snapshot to fill in.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void fill_task_stats_info(task_control_block* task, task_stats_info* info);
+
+/**
+ * @brief Collects scheduler statistics of all online CPUs.
+ * @param buffer Array to write the per-CPU snapshots into.
+ * @param max_entries Capacity of `buffer`.
+ * @return Number of entries written.
+ * 
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE size_t get_cpu_stats(cpu_stats_info* buffer, size_t max_entries);
+
 /**
  * @brief Retrieves the idle task for a specified CPU.
  * 
@@ -80,7 +153,9 @@ public:
      * @param task Pointer to the task control block to add.
      * @param cpu The CPU to which the task should be assigned. Defaults to -1 (automatic CPU selection).
      * 
-     * Enqueues the task for execution, either on the specified CPU or the least-loaded CPU if `cpu = -1`.
+     * Enqueues the task for execution, either on the specified CPU or, if `cpu = -1`, on the
+     * least-loaded CPU allowed by the task's affinity mask. Isolated CPUs are only picked
+     * automatically for tasks whose affinity mask doesn't allow any other CPU.
      * 
      * @note Privilege: **required**
      */
@@ -111,39 +186,158 @@ public:
      * 
      * Forces the scheduler to pick a new task to run and switches to it. Can be called by
      * userspace for yielding purposes.
+     * 
+     * Elevated callers with interrupts enabled switch directly into the next task, which only
+     * saves callee-saved registers. All other callers raise the scheduler's software interrupt.
      */
     void schedule();
 
     /**
-     * @brief Disables preemption by masking timer tick interrupts.
-     * @param cpu The CPU for which to disable preemption. Defaults to -1 (current CPU).
+     * @brief Switches directly into a specific runnable task.
+     * @param target The task to run next.
+     * @return True if the switch happened, false if the target wasn't runnable here.
+     * 
+     * Donates the rest of the caller's time slice to `target`, which is pulled over from
+     * another CPU if it's only waiting there. Used to hand the CPU from one end of an
+     * IPC call to the other without going through the run queue order. The caller stays
+     * runnable and resumes whenever it gets scheduled again. Falls through without
+     * switching if interrupts are disabled.
+     * 
+     * @note Privilege: **required**
+     */
+    __PRIVILEGED_CODE bool yield_to(task_control_block* target);
+
+    /**
+     * @brief Disables preemption on the current CPU.
      * 
-     * Disables preemption to prevent context switches.
+     * Increments the CPU's preemption count. Timer ticks and reschedule IPIs that arrive while
+     * the count is non-zero only set `need_resched`, and the switch is deferred until the
+     * matching `preempt_enable`. Calls nest, and the task must not block in between.
      * 
      * @note Privilege: **required**
      */
-    __PRIVILEGED_CODE void preempt_disable(int cpu = -1);
+    __PRIVILEGED_CODE void preempt_disable();
 
     /**
-     * @brief Enables preemption by unmasking timer tick interrupts.
-     * @param cpu The CPU for which to enable preemption. Defaults to -1 (current CPU).
+     * @brief Re-enables preemption on the current CPU.
      * 
-     * Restores preemption, allowing context switches to occur.
+     * Decrements the CPU's preemption count and performs any reschedule
+     * that was deferred while preemption was disabled.
      * 
      * @note Privilege: **required**
      */
-    __PRIVILEGED_CODE void preempt_enable(int cpu = -1);
+    __PRIVILEGED_CODE void preempt_enable();
+
+    /**
+     * @brief Restricts the set of CPUs a task may run on.
+     * @param task The task to update.
+     * @param affinity Bitmask of allowed CPUs, bit N standing for CPU N.
+     * @return True if the mask was applied, false if it contains no online CPU.
+     * 
+     * If the calling task excludes the CPU it's running on, it migrates to an allowed
+     * CPU before returning. Other tasks waiting in a run queue move right away, running
+     * ones on their CPU's next scheduling decision and blocked ones when they wake up.
+     * 
+     * @note Privilege: **required**
+     */
+    __PRIVILEGED_CODE bool set_task_affinity(task_control_block* task, uint64_t affinity);
+
+    /**
+     * @brief Removes CPUs from general scheduling.
+     * @param cpu_mask Bitmask of CPUs to isolate, the BSP can't be isolated.
+     * 
+     * Isolated CPUs are skipped by the load balancer and neither steal work nor have it
+     * stolen, so only tasks explicitly placed on them or whose affinity covers nothing
+     * else run there. Their periodic timer tick is not started either, RCU grace periods that wait on a busy
+     * isolated CPU kick it with a reschedule IPI instead. Must be called before SMP bringup.
+     * 
+     * @note Privilege: **required**
+     */
+    __PRIVILEGED_CODE void isolate_cpus(uint64_t cpu_mask);
+
+    /**
+     * @brief Retrieves the run queue of a CPU.
+     * @param cpu The CPU whose run queue to retrieve.
+     * @return Pointer to the run queue, or `nullptr` if the CPU is offline.
+     * 
+     * @note Privilege: **required**
+     */
+    __PRIVILEGED_CODE sched_run_queue* get_run_queue(uint64_t cpu) {
+        return m_run_queues[cpu].get();
+    }
+
+    /**
+     * @brief Checks whether a CPU is isolated from general scheduling.
+     * @param cpu The CPU to check.
+     * 
+     * @note Privilege: **required**
+     */
+    __PRIVILEGED_CODE bool is_cpu_isolated(int cpu) const {
+        return (m_isolated_cpus & (1ull << cpu)) != 0;
+    }
+
+    /**
+     * @brief Requests a reschedule on a CPU.
+     * @param cpu The CPU that should reschedule.
+     * 
+     * Sets the CPU's `need_resched` flag, remote CPUs are additionally
+     * kicked with a reschedule IPI if they are currently idle.
+     * 
+     * @note Privilege: **required**
+     */
+    __PRIVILEGED_CODE void resched_cpu(int cpu);
+
+    /**
+     * @brief Performs a pending reschedule on the way out of an IRQ.
+     * @param irq_frame Pointer to the interrupt frame of the interrupted context.
+     * 
+     * Switches to the next task if `need_resched` is set and preemption is enabled.
+     * 
+     * @note Privilege: **required**
+     */
+    __PRIVILEGED_CODE void irq_exit_resched(ptregs* irq_frame);
 
 private:
     kstl::shared_ptr<sched_run_queue> m_run_queues[MAX_SYSTEM_CPUS];
 
+    // CPUs excluded from load balancing, work stealing and timer ticks
+    uint64_t m_isolated_cpus;
+
     /**
      * @brief Finds the least-loaded CPU for task assignment.
-     * @return The CPU ID of the least-loaded CPU.
+     * @param affinity Bitmask of CPUs the task is allowed to run on.
+     * @return The CPU ID of the least-loaded allowed CPU.
+     * 
+     * Used internally to balance tasks across CPUs. Isolated CPUs are only
+     * considered if the affinity mask doesn't allow any other online CPU.
+     */
+    int _load_balance_find_cpu(uint64_t affinity);
+
+    /**
+     * @brief Pulls a waiting task from another CPU's run queue.
+     * @param cpu The CPU that is about to go idle.
+     * @return The migrated task, now queued on `cpu`, or `nullptr` if there was nothing to steal.
      * 
-     * Used internally to balance tasks across CPUs.
+     * @note Privilege: **required**
+     */
+    __PRIVILEGED_CODE task_control_block* _steal_task(int cpu);
+
+    /**
+     * @brief Picks the next task for a CPU, stealing work instead of going idle.
+     * @param cpu The CPU being scheduled.
+     * 
+     * @note Privilege: **required**
+     */
+    __PRIVILEGED_CODE task_control_block* _pick_next_task(int cpu);
+
+    /**
+     * @brief Picks the next task and switches to it without raising an interrupt.
+     * 
+     * Used by `schedule` for voluntary yields and blocking waits from privileged task context.
+     * 
+     * @note Privilege: **required**
      */
-    int _load_balance_find_cpu();
+    __PRIVILEGED_CODE void _schedule_voluntary();
 };
 } // namespace sched
 
@@ -0,0 +1,119 @@
+#ifndef WAIT_QUEUE_H
+#define WAIT_QUEUE_H
+#include <sync.h>
+#include <process/process.h>
+
+// Timeout value that never expires
+#define WAIT_FOREVER        0xffffffffffffffffull
+
+// Returned by blocking waits that ran out of time
+#define WAIT_KEY_TIMEOUT    -1
+
+// Maximum number of queues a single wait can block on
+#define WAIT_MAX_QUEUES     16
+
+namespace sched {
+/**
+ * @struct wait_context
+ * @brief State of one blocking wait, shared by every queue and timeout the task waits on.
+ *
+ * Whoever first flips `woken` owns the wakeup and requeues the task, so a task waiting
+ * on several queues at once is made runnable exactly once.
+ */
+struct wait_context {
+    task_control_block*     task;
+    kstl::atomic<uint32_t>  woken;
+};
+
+/**
+ * @struct wait_queue_entry
+ * @brief Links a wait context into a wait queue, lives on the waiting task's stack.
+ */
+struct wait_queue_entry {
+    wait_context*       ctx;
+    wait_queue_entry*   next;
+    wait_queue_entry*   prev;
+};
+
+/**
+ * @struct wait_timeout
+ * @brief Deadline after which a wait context gets woken up, lives on the waiting task's stack.
+ */
+struct wait_timeout {
+    wait_context*   ctx;
+    uint64_t        deadline_ns;
+    wait_timeout*   next;
+    bool            armed;
+};
+
+/**
+ * @typedef wait_poll_fn
+ * @brief Checks the condition a task is waiting for.
+ * @return Index of the first ready source, or a negative value if nothing is ready.
+ *
+ * Runs with interrupts disabled while the task is being parked, so it must not block.
+ */
+typedef int64_t (*wait_poll_fn)(void* data);
+
+/**
+ * @class wait_queue
+ * @brief List of tasks blocked until an event on some object occurs.
+ *
+ * Wakers only take the queue's lock if someone is actually waiting, so signalling
+ * an event nobody waits for costs a fence and a load.
+ */
+class wait_queue {
+public:
+    /**
+     * @brief Registers a waiter.
+     * @note Privilege: **required**
+     */
+    __PRIVILEGED_CODE void add(wait_queue_entry* entry);
+
+    /**
+     * @brief Unregisters a waiter, no-op if a wakeup already removed it.
+     * @note Privilege: **required**
+     */
+    __PRIVILEGED_CODE void remove(wait_queue_entry* entry);
+
+    /**
+     * @brief Wakes up every task waiting on the queue.
+     *
+     * Each task is requeued on the CPU it last ran on, where its working set is still
+     * cache-hot, instead of going through the load balancer. Must be called after the
+     * state change the waiters poll for has been published.
+     */
+    void wake_all();
+
+private:
+    spinlock            m_lock;
+    wait_queue_entry*   m_head = nullptr;
+};
+
+/**
+ * @brief Blocks the calling task until a polled condition becomes true.
+ * @param queues Queues whose events may make the condition true.
+ * @param count Number of queues, at most `WAIT_MAX_QUEUES`.
+ * @param timeout_ns Maximum time to wait, 0 to only poll once or `WAIT_FOREVER`.
+ * @param poll Checks the condition, called again after every wakeup.
+ * @param data Argument passed to `poll`.
+ * @return The last non-negative result of `poll`, or `WAIT_KEY_TIMEOUT` if the time ran out.
+ *
+ * The condition is re-checked after the task registered itself on the queues, so an event
+ * that fires concurrently either gets noticed right away or wakes the task up. Contexts that
+ * can't sleep fall back to polling with yields. Timeouts have the resolution of the timer tick.
+ */
+int64_t wait_event(wait_queue* const* queues, size_t count, uint64_t timeout_ns, wait_poll_fn poll, void* data);
+
+/**
+ * @brief Wakes up the tasks of all timeouts whose deadline has passed.
+ * @param now_ns Current system time in nanoseconds.
+ *
+ * Called from the BSP's timer tick, which keeps ticking even if other CPUs are isolated.
+ *
+ * @note Privilege: **required**
+ */
+__PRIVILEGED_CODE void expire_wait_timeouts(uint64_t now_ns);
+} // namespace sched
+
+#endif // WAIT_QUEUE_H
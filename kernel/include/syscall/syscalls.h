@@ -4,10 +4,31 @@
 
 #define ENOSYS  1
 #define ENOPRIV 2
+#define EFAULT  3
+#define ENOMEM  4
 
+// File syscalls take a descriptor returned by SYSCALL_SYS_OPEN, writes
+// to FD_STDOUT and FD_STDERR go to the kernel's serial console.
 #define SYSCALL_SYS_WRITE       0
 #define SYSCALL_SYS_READ        1
 #define SYSCALL_SYS_EXIT        2
+#define SYSCALL_SYS_TASK_STATS  3
+#define SYSCALL_SYS_CPU_STATS   4
+#define SYSCALL_SYS_OPEN        5
+#define SYSCALL_SYS_CLOSE       6
+#define SYSCALL_SYS_PREAD       7
+#define SYSCALL_SYS_PWRITE      8
+#define SYSCALL_SYS_LSEEK       9
+
+// Asynchronous I/O, the ring set up by SYSCALL_SYS_IO_RING_SETUP
+// is shared with the process, see fs/io_ring.h for its layout.
+#define SYSCALL_SYS_IO_RING_SETUP   10
+#define SYSCALL_SYS_IO_RING_ENTER   11
+
+// File mappings, see fs/mmap.h for the FS_PROT_* and FS_MAP_* flags
+#define SYSCALL_SYS_MMAP        12
+#define SYSCALL_SYS_MUNMAP      13
+#define SYSCALL_SYS_MSYNC       14
 
 #define SYSCALL_SYS_ELEVATE     90
 
@@ -67,6 +67,13 @@ public:
      */
     static uint64_t get_system_time_in_seconds();
 
+    /**
+     * @brief Converts a duration in TSC cycles to nanoseconds.
+     * @param cycles The number of elapsed TSC cycles.
+     * @return The duration in nanoseconds, or 0 if the TSC hasn't been calibrated yet.
+     */
+    static uint64_t tsc_cycles_to_ns(uint64_t cycles);
+
     /**
      * @brief Ticks and updates the global system time management system.
      */
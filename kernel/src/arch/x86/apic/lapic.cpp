@@ -2,6 +2,7 @@
 #include <arch/x86/apic/lapic.h>
 #include <arch/percpu.h>
 #include <sched/sched.h>
+#include <interrupts/irq.h>
 #include <ports/ports.h>
 #include <memory/vmm.h>
 #include <memory/paging.h>
@@ -62,6 +63,9 @@ lapic::lapic(uint64_t base, uint8_t spurious_irq) {
         g_lapic_virtual_base = reinterpret_cast<volatile uint32_t*>(virt_base);
     }
 
+    // Instances are always created on the processor owning the LAPIC
+    m_apic_id = static_cast<uint8_t>(read(APIC_REG_ID) >> 24);
+
     // Set the spurious interrupt vector
     uint32_t spurious_vector = read(0xF0);
     spurious_vector |= (1 << 8);        // Enable the APIC
@@ -209,6 +213,24 @@ void lapic::send_startup_ipi(uint8_t apic_id, uint32_t vector) {
     wait_for_icr_cmd_completion();
 }
 
+__PRIVILEGED_CODE
+void lapic::send_ipi(uint8_t apic_id, uint8_t vector) {
+    // An IPI sent from an interrupt handler must not land between the two ICR writes
+    uint64_t flags = save_and_disable_irqs();
+
+    write(APIC_REG_ICR_HIGH, static_cast<uint32_t>(apic_id) << APIC_ICR_DEST_SHIFT);
+
+    // Fixed delivery, physical destination, edge-triggered
+    uint32_t icr_low = (static_cast<uint32_t>(vector) & APIC_VECTOR_MASK)
+                     | APIC_DM_FIXED
+                     | APIC_TRIGGER_EDGE;
+
+    write(APIC_REG_ICR_LOW, icr_low);
+    wait_for_icr_cmd_completion();
+
+    restore_irq_flags(flags);
+}
+
 __PRIVILEGED_CODE void lapic::wait_for_icr_cmd_completion() {
     // Wait until the Delivery Status bit is cleared, meaning
     // the IPI has been sent (the hardware is not busy anymore).
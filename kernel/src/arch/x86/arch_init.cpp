@@ -7,6 +7,7 @@
 #include <arch/x86/idt/idt.h>
 #include <arch/x86/cpuid.h>
 #include <arch/x86/fsgsbase.h>
+#include <arch/x86/fpu.h>
 #include <arch/x86/pat.h>
 #include <arch/x86/apic/lapic.h>
 #include <syscall/syscalls.h>
@@ -40,6 +41,9 @@ void arch_init() {
     // Setup per-cpu area for the bootstrapping processor
     init_bsp_per_cpu_area();
 
+    // Enable SSE/AVX and extended state management
+    x86::init_fpu(BSP_CPU_ID);
+
     // Setup BSP's idle task (current) and system stack reference
     task_control_block* bsp_idle_task = sched::get_idle_task(BSP_CPU_ID);
     zeromem(bsp_idle_task, sizeof(task_control_block));
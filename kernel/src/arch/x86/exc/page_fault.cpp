@@ -0,0 +1,27 @@
+#ifdef ARCH_X86_64
+#include <arch/x86/exc/page_fault.h>
+#include <process/ptregs.h>
+#include <fs/mmap.h>
+
+namespace arch::x86 {
+DEFINE_INT_HANDLER(exc_page_fault_handler) {
+    __unused cookie;
+
+    uint64_t fault_addr;
+    asm volatile("mov %%cr2, %0" : "=r"(fault_addr));
+
+    // Writes to copy-on-write pages of private file mappings are the only faults that get
+    // resolved, the address check keeps early boot faults away from the mapping tables.
+    bool write_protected = (regs->error & PF_ERR_PRESENT) && (regs->error & PF_ERR_WRITE);
+    if (write_protected && fault_addr >= MMAP_REGION_BASE && fault_addr < MMAP_REGION_END) {
+        if (fs::mmap_table::for_current_task()->handle_write_fault(fault_addr)) {
+            return IRQ_HANDLED;
+        }
+    }
+
+    panic(regs);
+    return IRQ_UNHANDLED;
+}
+} // namespace arch::x86
+
+#endif // ARCH_X86_64
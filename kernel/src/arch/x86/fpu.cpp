@@ -0,0 +1,263 @@
+#ifdef ARCH_X86_64
+#include <arch/x86/fpu.h>
+#include <arch/x86/cpuid.h>
+#include <arch/x86/cpu_control.h>
+#include <arch/percpu.h>
+#include <process/process.h>
+#include <memory/vmm.h>
+#include <serial/serial.h>
+
+namespace arch::x86 {
+enum class fpu_save_mode {
+    NONE = 0,   // Extended state is not managed
+    FXSAVE,     // Legacy x87/SSE state only
+    XSAVE,      // XSAVE without the modified-state optimization
+    XSAVEOPT    // XSAVE that skips components unmodified since the last XRSTOR
+};
+
+__PRIVILEGED_DATA fpu_save_mode     g_fpu_save_mode = fpu_save_mode::NONE;
+__PRIVILEGED_DATA fpu_switch_policy g_fpu_switch_policy = fpu_switch_policy::LAZY;
+__PRIVILEGED_DATA uint64_t          g_fpu_xfeatures = 0;
+__PRIVILEGED_DATA size_t            g_fpu_state_size = 0;
+
+// Task whose extended state was most recently loaded into this CPU's registers
+DEFINE_PER_CPU(task_control_block*, fpu_owner);
+
+// CPU ID + 1 of the current CPU, zero is reserved for "not loaded anywhere"
+DEFINE_PER_CPU(uint64_t, fpu_cpu_tag);
+
+static __force_inline__ uint64_t fpu_read_cr0() {
+    uint64_t cr0;
+    asm volatile ("mov %%cr0, %0" : "=r"(cr0));
+    return cr0;
+}
+
+static __force_inline__ void fpu_write_cr0(uint64_t cr0) {
+    asm volatile ("mov %0, %%cr0" :: "r"(cr0) : "memory");
+}
+
+static __force_inline__ void fpu_clts() {
+    asm volatile ("clts" ::: "memory");
+}
+
+static __force_inline__ void fpu_xsetbv(uint32_t index, uint64_t value) {
+    asm volatile ("xsetbv" :: "c"(index), "a"(static_cast<uint32_t>(value)), "d"(static_cast<uint32_t>(value >> 32)));
+}
+
+__PRIVILEGED_CODE
+static void fpu_save_state(uint8_t* area) {
+    uint32_t lo = static_cast<uint32_t>(g_fpu_xfeatures);
+    uint32_t hi = static_cast<uint32_t>(g_fpu_xfeatures >> 32);
+
+    switch (g_fpu_save_mode) {
+    case fpu_save_mode::XSAVEOPT:
+        asm volatile ("xsaveopt64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+        break;
+    case fpu_save_mode::XSAVE:
+        asm volatile ("xsave64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+        break;
+    case fpu_save_mode::FXSAVE:
+        asm volatile ("fxsave64 (%0)" :: "r"(area) : "memory");
+        break;
+    default: break;
+    }
+}
+
+__PRIVILEGED_CODE
+static void fpu_restore_state(const uint8_t* area) {
+    uint32_t lo = static_cast<uint32_t>(g_fpu_xfeatures);
+    uint32_t hi = static_cast<uint32_t>(g_fpu_xfeatures >> 32);
+
+    switch (g_fpu_save_mode) {
+    case fpu_save_mode::XSAVEOPT:
+    case fpu_save_mode::XSAVE:
+        asm volatile ("xrstor64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+        break;
+    case fpu_save_mode::FXSAVE:
+        asm volatile ("fxrstor64 (%0)" :: "r"(area) : "memory");
+        break;
+    default: break;
+    }
+}
+
+// Loads the task's state into this CPU's registers, CR0.TS must be clear
+__PRIVILEGED_CODE
+static void fpu_load_task_state(task_control_block* task) {
+    fpu_restore_state(task->fpu_state);
+
+    this_cpu_write(fpu_owner, task);
+    task->fpu_loaded_cpu = this_cpu_read(fpu_cpu_tag);
+    task->fpu_used = true;
+}
+
+__PRIVILEGED_CODE
+void init_fpu(uint8_t cpu_id) {
+    this_cpu_write(fpu_owner, static_cast<task_control_block*>(nullptr));
+    this_cpu_write(fpu_cpu_tag, static_cast<uint64_t>(cpu_id) + 1);
+
+    if (!cpuid_is_fxsr_supported() || !cpuid_is_sse_supported()) {
+        if (cpu_id == BSP_CPU_ID) {
+            serial::printf("[!] FXSR/SSE not supported, extended state will not be managed\n");
+        }
+        return;
+    }
+
+    // Use native x87 error reporting and trap FPU instructions while CR0.TS is set
+    uint64_t cr0 = fpu_read_cr0();
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP | CR0_NE;
+    fpu_write_cr0(cr0);
+
+    uint64_t cr4;
+    asm volatile ("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+
+    bool xsave = cpuid_is_xsave_supported();
+    if (xsave) {
+        cr4 |= CR4_OSXSAVE;
+    }
+    asm volatile ("mov %0, %%cr4" :: "r"(cr4));
+
+    if (cpu_id == BSP_CPU_ID) {
+        g_fpu_save_mode = fpu_save_mode::FXSAVE;
+        g_fpu_state_size = FXSAVE_AREA_SIZE;
+
+        if (xsave) {
+            uint32_t eax, ebx, ecx, edx;
+            read_cpuid_full(CPUID_XSAVE_STATE, 0, &eax, &ebx, &ecx, &edx);
+
+            // Only x87, SSE and AVX state is managed, wider vector
+            // state would need larger per-task save areas.
+            uint64_t supported = (static_cast<uint64_t>(edx) << 32) | eax;
+            g_fpu_xfeatures = supported & (XFEATURE_X87 | XFEATURE_SSE | XFEATURE_AVX);
+            g_fpu_save_mode = cpuid_is_xsaveopt_supported() ? fpu_save_mode::XSAVEOPT : fpu_save_mode::XSAVE;
+        }
+    }
+
+    if (xsave) {
+        fpu_xsetbv(0, g_fpu_xfeatures);
+
+        if (cpu_id == BSP_CPU_ID) {
+            // EBX now reports the save area size for the enabled components
+            uint32_t eax, ebx, ecx, edx;
+            read_cpuid_full(CPUID_XSAVE_STATE, 0, &eax, &ebx, &ecx, &edx);
+            g_fpu_state_size = ebx;
+        }
+    }
+
+    // Start from a clean register state
+    uint32_t mxcsr = FPU_DEFAULT_MXCSR;
+    asm volatile ("fninit");
+    asm volatile ("ldmxcsr %0" :: "m"(mxcsr));
+}
+
+__PRIVILEGED_CODE
+void fpu_set_switch_policy(fpu_switch_policy policy) {
+    g_fpu_switch_policy = policy;
+}
+
+__PRIVILEGED_CODE
+size_t fpu_state_size() {
+    return g_fpu_state_size;
+}
+
+__PRIVILEGED_CODE
+bool fpu_alloc_task_state(task_control_block* task) {
+    if (g_fpu_save_mode == fpu_save_mode::NONE) {
+        return true;
+    }
+
+    if (g_fpu_state_size > FPU_STATE_PAGES * PAGE_SIZE) {
+        return false;
+    }
+
+    // Page granularity satisfies the 64-byte alignment required by XSAVE
+    uint8_t* area = reinterpret_cast<uint8_t*>(vmm::alloc_linear_mapped_persistent_pages(FPU_STATE_PAGES));
+    if (!area) {
+        return false;
+    }
+
+    // A zeroed XSAVE header marks every component as being in its initial state,
+    // only the control words have to be valid for the first restore.
+    zeromem(area, FPU_STATE_PAGES * PAGE_SIZE);
+    *reinterpret_cast<uint16_t*>(area + FXSAVE_FCW_OFFSET) = FPU_DEFAULT_FCW;
+    *reinterpret_cast<uint32_t*>(area + FXSAVE_MXCSR_OFFSET) = FPU_DEFAULT_MXCSR;
+
+    task->fpu_state = area;
+    task->fpu_loaded_cpu = 0;
+    task->fpu_used = false;
+    return true;
+}
+
+__PRIVILEGED_CODE
+void fpu_free_task_state(task_control_block* task) {
+    if (!task->fpu_state) {
+        return;
+    }
+
+    vmm::unmap_contiguous_virtual_pages(reinterpret_cast<uintptr_t>(task->fpu_state), FPU_STATE_PAGES);
+    task->fpu_state = nullptr;
+}
+
+__PRIVILEGED_CODE
+void fpu_switch_context(task_control_block* from, task_control_block* to) {
+    if (g_fpu_save_mode == fpu_save_mode::NONE) {
+        return;
+    }
+
+    uint64_t cr0 = fpu_read_cr0();
+
+    // CR0.TS is only ever clear while the running task's state is live in the registers,
+    // so a clear TS bit means the outgoing task may have modified it during its time slice.
+    if (!(cr0 & CR0_TS) && from->fpu_state) {
+        fpu_save_state(from->fpu_state);
+    }
+
+    // Registers still hold the incoming task's state if it was the
+    // last one loaded here and didn't run on another CPU since.
+    bool live = to->fpu_state &&
+                this_cpu_read(fpu_owner) == to &&
+                to->fpu_loaded_cpu == this_cpu_read(fpu_cpu_tag);
+
+    if (!live && to->fpu_used && g_fpu_switch_policy == fpu_switch_policy::EAGER) {
+        if (cr0 & CR0_TS) {
+            fpu_clts();
+            cr0 &= ~CR0_TS;
+        }
+
+        fpu_load_task_state(to);
+        live = true;
+    }
+
+    // Only touch CR0 when the trap state actually changes, writes to it are serializing
+    if (live && (cr0 & CR0_TS)) {
+        fpu_clts();
+    } else if (!live && !(cr0 & CR0_TS)) {
+        fpu_write_cr0(cr0 | CR0_TS);
+    }
+}
+
+DEFINE_INT_HANDLER(exc_device_not_available_handler) {
+    __unused cookie;
+
+    if (g_fpu_save_mode == fpu_save_mode::NONE) {
+        panic(regs);
+        return IRQ_UNHANDLED;
+    }
+
+    fpu_clts();
+
+    task_control_block* task = current;
+    if (!task->fpu_state) {
+        // A context without a save area is about to clobber the registers. Every other
+        // task's state was already saved when it got switched out, so only ownership is lost.
+        this_cpu_write(fpu_owner, static_cast<task_control_block*>(nullptr));
+        return IRQ_HANDLED;
+    }
+
+    fpu_load_task_state(task);
+    return IRQ_HANDLED;
+}
+} // namespace arch::x86
+
+#endif // ARCH_X86_64
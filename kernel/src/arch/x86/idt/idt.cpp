@@ -2,6 +2,8 @@
 #include <arch/x86/idt/idt.h>
 #include <arch/x86/apic/lapic.h>
 #include <arch/x86/exc/bkpt.h>
+#include <arch/x86/exc/page_fault.h>
+#include <arch/x86/fpu.h>
 #include <memory/memory.h>
 #include <core/klog.h>
 #include <sched/sched.h>
@@ -177,14 +179,14 @@ static int_exc_handlers g_int_exc_handlers = {
     .overflow = 0,
     .bound_range = 0,
     .invalid_opcode = 0,
-    .device_not_available = 0,
+    .device_not_available = exc_device_not_available_handler,
     .double_fault = 0,
     .coprocessor_seg_overrun = 0,
     .invalid_tss = 0,
     .segment_not_present = 0,
     .stack_fault = 0,
     .general_protection_fault = 0,
-    .page_fault = 0
+    .page_fault = exc_page_fault_handler
 };
 
 __PRIVILEGED_DATA
@@ -237,12 +239,22 @@ void common_irq_entry(ptregs* regs) {
 
     irqreturn_t ret = desc->handler(regs, desc->cookie);
     __unused ret;
+
+    // Act on reschedule requests raised by the handler or deferred while preemption was off
+    sched::scheduler::get().irq_exit_resched(regs);
 }
 
+// Handed back to asm_common_isr_entry in rax:rdx
+struct isr_exit_info {
+    uint8_t*    prev_on_cpu;        // on_cpu flag of the task switched away from, or null
+    uint64_t    scratch_stack_top;  // stack the frame is moved onto before releasing that task
+};
+static_assert(sizeof(isr_exit_info) == 16, "isr_exit_info must be returned in rax:rdx");
+
 // Common entry point for all interrupt service routines
 EXTERN_C
 __PRIVILEGED_CODE
-void common_isr_entry(ptregs regs) {
+isr_exit_info common_isr_entry(ptregs regs) {
     // After faking out being elevated, original elevation
     // privileged should be restored, except in the case
     // when the scheduler switched context into a new task.
@@ -262,6 +274,18 @@ void common_isr_entry(ptregs regs) {
 
     // Restore the original elevate status
     original_task->elevated = original_elevate_status;
+
+    isr_exit_info info = { nullptr, 0 };
+
+    // If the scheduler switched away from the interrupted task, the frame being
+    // returned through may still live on that task's system stack. The exit path
+    // moves it onto this CPU's idle stack before letting other CPUs pick the task up.
+    if (current != original_task) {
+        info.prev_on_cpu = reinterpret_cast<uint8_t*>(&original_task->on_cpu);
+        info.scratch_stack_top = sched::get_idle_task(current->cpu)->system_stack_top;
+    }
+
+    return info;
 }
 
 __PRIVILEGED_CODE
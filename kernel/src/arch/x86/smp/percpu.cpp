@@ -35,9 +35,19 @@ void allocate_ap_per_cpu_area(uint8_t cpu_id) {
     g_per_cpu_area_ptrs[cpu_id] = reinterpret_cast<uintptr_t>(percpu_area);
 }
 
+__PRIVILEGED_CODE
+uintptr_t get_per_cpu_area(uint64_t cpu) {
+    if (cpu >= MAX_SYSTEM_CPUS) {
+        return 0;
+    }
+
+    return g_per_cpu_area_ptrs[cpu];
+}
+
 __PRIVILEGED_CODE
 void deallocate_ap_per_cpu_area(uint8_t cpu_id) {
     vmm::unmap_virtual_page(g_per_cpu_area_ptrs[cpu_id]);
+    g_per_cpu_area_ptrs[cpu_id] = 0;
 }
 } // namespace arch
 
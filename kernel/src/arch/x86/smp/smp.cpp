@@ -12,6 +12,7 @@
 #include <arch/x86/pat.h>
 #include <arch/x86/cpuid.h>
 #include <arch/x86/fsgsbase.h>
+#include <arch/x86/fpu.h>
 #include <syscall/syscalls.h>
 #include <sched/sched.h>
 #include <core/klog.h>
@@ -79,6 +80,9 @@ void ap_startup_entry(uint64_t lapicid, uint64_t acpi_cpu_index) {
     // Setup per-cpu area for the bootstrapping processor
     init_ap_per_cpu_area(acpi_cpu_index);
 
+    // Enable SSE/AVX and extended state management
+    init_fpu(acpi_cpu_index);
+
     // Setup BSP's idle task (current)
     task_control_block* ap_idle_task = sched::get_idle_task(acpi_cpu_index);
     zeromem(ap_idle_task, sizeof(task_control_block));
@@ -104,8 +108,11 @@ void ap_startup_entry(uint64_t lapicid, uint64_t acpi_cpu_index) {
     // Log that the cpu is now online
     kprint("CPU %u online!\n", current->cpu);
 
-    // Start local APIC timer in order to receive timer IRQs
-    kernel_timer::start_cpu_periodic_timer();
+    // Start local APIC timer in order to receive timer IRQs, isolated
+    // cores only get interrupted when explicitly asked to reschedule.
+    if (!sched::scheduler::get().is_cpu_isolated(acpi_cpu_index)) {
+        kernel_timer::start_cpu_periodic_timer();
+    }
 
     //serial::printf("AP core %i ready with lapic_id: %i\n", acpi_cpu_index, current->cpu);
     while (true) {
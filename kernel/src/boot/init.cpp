@@ -6,6 +6,7 @@
 #include <memory/memory.h>
 #include <memory/paging.h>
 #include <memory/vmm.h>
+#include <memory/tlb.h>
 #include <acpi/acpi.h>
 #include <time/time.h>
 #include <sched/sched.h>
@@ -19,7 +20,9 @@
 #include <fs/ram_filesystem.h>
 #include <fs/vfs.h>
 #include <fs/cpio/cpio.h>
+#include <lz4.h>
 #include <gdb/gdb_stub.h>
+#include <arch/x86/fpu.h>
 
 #ifdef BUILD_UNIT_TESTS
 #include <acpi/shutdown.h>
@@ -107,6 +110,38 @@ void walk_mbi(void* mbi) {
     }
 }
 
+// Decompresses an LZ4 compressed initrd into new user-accessible pages
+__PRIVILEGED_CODE
+const uint8_t* decompress_initrd(const uint8_t* frame, size_t length, size_t& out_size) {
+    uint64_t start = rdtsc();
+
+    ssize_t content_size = lz4::get_content_size(frame, length);
+    if (content_size <= 0) {
+        serial::printf("[!] Compressed initrd is malformed\n");
+        return nullptr;
+    }
+
+    size_t page_count = (static_cast<size_t>(content_size) + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint8_t* archive = static_cast<uint8_t*>(vmm::alloc_virtual_pages(page_count, DEFAULT_UNPRIV_PAGE_FLAGS));
+    if (!archive) {
+        serial::printf("[!] Failed to allocate %llu pages for the initrd\n", page_count);
+        return nullptr;
+    }
+
+    ssize_t decompressed = lz4::decompress_frame(frame, length, archive, content_size);
+    if (decompressed != content_size) {
+        serial::printf("[!] Failed to decompress initrd\n");
+        vmm::unmap_contiguous_virtual_pages(reinterpret_cast<uintptr_t>(archive), page_count);
+        return nullptr;
+    }
+
+    serial::printf("[*] Decompressed initrd: %llu -> %llu bytes in %llu cycles\n",
+        length, decompressed, rdtsc() - start);
+
+    out_size = static_cast<size_t>(decompressed);
+    return archive;
+}
+
 __PRIVILEGED_CODE
 void load_initrd() {
     if (!g_initrd_mod) {
@@ -116,7 +151,8 @@ void load_initrd() {
     size_t mod_size = g_initrd_mod->mod_end - g_initrd_mod->mod_start;
     size_t mod_page_count = (mod_size + PAGE_SIZE - 1) / PAGE_SIZE;
 
-    void* vaddr = vmm::map_contiguous_physical_pages(g_initrd_mod->mod_start, mod_page_count, DEFAULT_PRIV_PAGE_FLAGS);
+    // Files are read straight out of the archive, including by unprivileged processes
+    void* vaddr = vmm::map_contiguous_physical_pages(g_initrd_mod->mod_start, mod_page_count, DEFAULT_UNPRIV_PAGE_FLAGS);
     if (!vaddr) {
         serial::printf("[!] Failed to map initrd into kernel's address space\n");
         return;
@@ -126,7 +162,18 @@ void load_initrd() {
     auto& vfs = fs::virtual_filesystem::get();
     vfs.mount("/", kstl::make_shared<fs::ram_filesystem>());
 
-    fs::load_cpio_initrd(reinterpret_cast<const uint8_t*>(vaddr), mod_size, "/initrd");
+    // A compressed initrd gets decompressed once up front, the cpio filesystem then serves
+    // the decompressed archive in place. The compressed copy stays with the boot module.
+    const uint8_t* archive = reinterpret_cast<const uint8_t*>(vaddr);
+    size_t archive_size = mod_size;
+    if (lz4::is_frame(archive, mod_size)) {
+        archive = decompress_initrd(archive, mod_size, archive_size);
+        if (!archive) {
+            return;
+        }
+    }
+
+    fs::load_cpio_initrd(archive, archive_size, "/initrd", true);
 }
 
 // Since the scheduler will prioritize any other task to the idle task,
@@ -135,6 +182,41 @@ void load_initrd() {
 // when the first module task gets scheduled.
 void module_manager_init(void*);
 
+// Parses a CPU list such as "2-3,5" into a bitmask
+__PRIVILEGED_CODE
+uint64_t parse_cpu_list(const kstl::string& list) {
+    uint64_t mask = 0;
+    size_t pos = 0;
+
+    while (pos < list.length()) {
+        uint64_t first = 0;
+        while (pos < list.length() && list[pos] >= '0' && list[pos] <= '9') {
+            first = first * 10 + (list[pos++] - '0');
+        }
+
+        uint64_t last = first;
+        if (pos < list.length() && list[pos] == '-') {
+            pos++;
+            last = 0;
+            while (pos < list.length() && list[pos] >= '0' && list[pos] <= '9') {
+                last = last * 10 + (list[pos++] - '0');
+            }
+        }
+
+        for (uint64_t cpu = first; cpu <= last && cpu < MAX_SYSTEM_CPUS; cpu++) {
+            mask |= (1ull << cpu);
+        }
+
+        // Skip the separator, anything unexpected ends the list
+        if (pos < list.length() && list[pos] != ',') {
+            break;
+        }
+        pos++;
+    }
+
+    return mask;
+}
+
 EXTERN_C
 __PRIVILEGED_CODE
 void init(unsigned int magic, void* mbi) {
@@ -176,6 +258,13 @@ void init(unsigned int magic, void* mbi) {
         gdb_stub::perform_initial_trap();
     }
 
+#ifdef ARCH_X86_64
+    // Restore extended register state during context switches instead of on first use
+    if (cmdline_args.find("eagerfpu") != kstl::string::npos) {
+        arch::x86::fpu_set_switch_policy(arch::x86::fpu_switch_policy::EAGER);
+    }
+#endif
+
     // Load the initrd if it's available
     load_initrd();
 
@@ -188,6 +277,21 @@ void init(unsigned int magic, void* mbi) {
     // Initialize the scheduler
     sched::scheduler::get().init();
 
+    // Let CPUs ask each other to flush stale kernel mappings
+    paging::install_tlb_shootdown_handler();
+
+    // Keep the listed CPUs free of general scheduling and timer ticks, e.g. "isolcpus=2-3"
+    size_t isolcpus_pos = cmdline_args.find("isolcpus=");
+    if (isolcpus_pos != kstl::string::npos) {
+        size_t list_start = isolcpus_pos + 9;
+        size_t list_end = cmdline_args.find(' ', list_start);
+        kstl::string cpu_list = cmdline_args.substring(list_start, list_end == kstl::string::npos ? kstl::string::npos : list_end - list_start);
+
+        uint64_t cpu_mask = parse_cpu_list(cpu_list);
+        sched::scheduler::get().isolate_cpus(cpu_mask);
+        serial::printf("[*] Isolated CPU mask: 0x%llx\n", cpu_mask & ~(1ull << BSP_CPU_ID));
+    }
+
     // Initialize SMP and bring up application processors
     if (cmdline_args.find("nosmp") == kstl::string::npos) {
         smp::smp_init();   
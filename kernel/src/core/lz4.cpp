@@ -0,0 +1,238 @@
+#include <lz4.h>
+#include <memory/memory.h>
+
+namespace lz4 {
+// Frame descriptor flags
+#define LZ4_FLG_VERSION_MASK        0xC0
+#define LZ4_FLG_VERSION             0x40
+#define LZ4_FLG_BLOCK_CHECKSUM      0x10
+#define LZ4_FLG_CONTENT_SIZE        0x08
+#define LZ4_FLG_DICT_ID             0x01
+
+// Block size field flag marking data that is stored uncompressed
+#define LZ4_BLOCK_UNCOMPRESSED      0x80000000
+
+// Every match is at least this long, the token only stores the excess
+#define LZ4_MIN_MATCH               4
+
+struct frame_header {
+    uint8_t     flags;
+    uint64_t    content_size;   // Only valid with LZ4_FLG_CONTENT_SIZE
+    size_t      header_size;
+};
+
+static __force_inline__ uint32_t read_le32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) |
+           (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static bool parse_frame_header(const uint8_t* src, size_t length, frame_header& header) {
+    // Magic, flags, block descriptor and header checksum
+    if (length < 7 || read_le32(src) != LZ4_FRAME_MAGIC) {
+        return false;
+    }
+
+    header.flags = src[4];
+    if ((header.flags & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION) {
+        return false;
+    }
+
+    // Dictionaries would have to be provided out of band
+    if (header.flags & LZ4_FLG_DICT_ID) {
+        return false;
+    }
+
+    size_t offset = 6;
+    header.content_size = 0;
+    if (header.flags & LZ4_FLG_CONTENT_SIZE) {
+        if (offset + 8 > length) {
+            return false;
+        }
+
+        header.content_size = static_cast<uint64_t>(read_le32(src + offset)) |
+                              (static_cast<uint64_t>(read_le32(src + offset + 4)) << 32);
+        offset += 8;
+    }
+
+    // Skip the header checksum
+    header.header_size = offset + 1;
+    return header.header_size <= length;
+}
+
+/**
+ * @brief Reads the continuation bytes of a literal or match length.
+ * @return False if the input ends before the length does.
+ */
+static __force_inline__ bool read_length(const uint8_t*& ip, const uint8_t* iend, size_t& length) {
+    uint8_t byte;
+    do {
+        if (ip >= iend) {
+            return false;
+        }
+
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+/**
+ * @brief Decodes one compressed block.
+ * @param dst Start of the whole output, matches may reach back into previous blocks.
+ *            Nothing gets written if it's null, the block is only measured.
+ * @param pos Current output position, advanced past the decoded data.
+ * @param capacity Capacity of the output.
+ * @return False if the block is malformed or its data doesn't fit.
+ */
+static bool decode_block(const uint8_t* ip, const uint8_t* iend, uint8_t* dst, size_t& pos, size_t capacity) {
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        // Literals are copied straight from the input
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !read_length(ip, iend, literal_length)) {
+            return false;
+        }
+
+        if (literal_length > static_cast<size_t>(iend - ip) || literal_length > capacity - pos) {
+            return false;
+        }
+
+        if (dst) {
+            memcpy(dst + pos, ip, literal_length);
+        }
+
+        ip += literal_length;
+        pos += literal_length;
+
+        // The last sequence of a block only has literals
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+
+        size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+
+        if (offset == 0 || offset > pos) {
+            return false;
+        }
+
+        size_t match_length = token & 0xf;
+        if (match_length == 15 && !read_length(ip, iend, match_length)) {
+            return false;
+        }
+
+        match_length += LZ4_MIN_MATCH;
+        if (match_length > capacity - pos) {
+            return false;
+        }
+
+        if (dst) {
+            uint8_t* op = dst + pos;
+            const uint8_t* match = op - offset;
+            if (offset >= match_length) {
+                memcpy(op, match, match_length);
+            } else {
+                // Overlapping matches repeat the last `offset` bytes, copy them in order
+                for (size_t i = 0; i < match_length; i++) {
+                    op[i] = match[i];
+                }
+            }
+        }
+
+        pos += match_length;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Walks the blocks of a frame, decoding them into `dst` unless it's null.
+ * @return Length of the decoded data, or -1 if the frame is malformed.
+ */
+static ssize_t decode_frame(const uint8_t* src, size_t length, uint8_t* dst, size_t capacity) {
+    frame_header header;
+    if (!parse_frame_header(src, length, header)) {
+        return -1;
+    }
+
+    const uint8_t* ip = src + header.header_size;
+    const uint8_t* iend = src + length;
+    size_t pos = 0;
+
+    // Block checksums are skipped along with the blocks
+    size_t checksum_size = (header.flags & LZ4_FLG_BLOCK_CHECKSUM) ? 4 : 0;
+
+    while (true) {
+        if (iend - ip < 4) {
+            return -1;
+        }
+
+        uint32_t block_size = read_le32(ip);
+        ip += 4;
+
+        // End mark
+        if (block_size == 0) {
+            break;
+        }
+
+        bool uncompressed = block_size & LZ4_BLOCK_UNCOMPRESSED;
+        block_size &= ~LZ4_BLOCK_UNCOMPRESSED;
+
+        if (static_cast<size_t>(block_size) + checksum_size > static_cast<size_t>(iend - ip)) {
+            return -1;
+        }
+
+        if (uncompressed) {
+            if (block_size > capacity - pos) {
+                return -1;
+            }
+
+            if (dst) {
+                memcpy(dst + pos, ip, block_size);
+            }
+
+            pos += block_size;
+        } else if (!decode_block(ip, ip + block_size, dst, pos, capacity)) {
+            return -1;
+        }
+
+        ip += block_size + checksum_size;
+    }
+
+    return static_cast<ssize_t>(pos);
+}
+
+bool is_frame(const uint8_t* data, size_t length) {
+    return length >= 4 && read_le32(data) == LZ4_FRAME_MAGIC;
+}
+
+ssize_t get_content_size(const uint8_t* src, size_t length) {
+    frame_header header;
+    if (!parse_frame_header(src, length, header)) {
+        return -1;
+    }
+
+    if (header.flags & LZ4_FLG_CONTENT_SIZE) {
+        return static_cast<ssize_t>(header.content_size);
+    }
+
+    // Nothing recorded it, the blocks have to be walked to add up their data
+    return decode_frame(src, length, nullptr, static_cast<size_t>(-1));
+}
+
+ssize_t decompress_frame(const uint8_t* src, size_t length, uint8_t* dst, size_t capacity) {
+    if (!dst) {
+        return -1;
+    }
+
+    return decode_frame(src, length, dst, capacity);
+}
+} // namespace lz4
@@ -0,0 +1,121 @@
+#include <rcu.h>
+#include <sync.h>
+#include <process/process.h>
+#include <dynpriv/dynpriv.h>
+#include <sched/sched.h>
+
+namespace rcu {
+// Incremented every time the CPU passes through a quiescent state
+DEFINE_PER_CPU(uint64_t, rcu_qs_seq);
+
+// Number of tasks preempted inside a read-side critical section
+kstl::atomic<uint64_t> g_rcu_blocked_readers;
+
+// Serializes grace period waiters
+DECLARE_GLOBAL_OBJECT(mutex, g_rcu_gp_lock);
+
+void read_lock() {
+    current->rcu_read_nesting++;
+
+    // Keep the compiler from hoisting protected loads above this point
+    kstl::atomic_signal_fence();
+}
+
+void read_unlock() {
+    kstl::atomic_signal_fence();
+
+    task_control_block* task = current;
+    if (--task->rcu_read_nesting == 0 && task->rcu_read_blocked) {
+        task->rcu_read_blocked = false;
+        g_rcu_blocked_readers.fetch_sub(1, kstl::memory_order::relaxed);
+    }
+}
+
+__PRIVILEGED_CODE
+void note_quiescent_state(task_control_block* task) {
+    if (task->rcu_read_nesting) {
+        return;
+    }
+
+    // Readers preempted on this CPU were counted as blocked before the sequence moves on,
+    // a grace period that sees the new sequence is guaranteed to see them as well.
+    kstl::atomic_thread_fence(kstl::memory_order::release);
+    this_cpu_write(rcu_qs_seq, this_cpu_read(rcu_qs_seq) + 1);
+}
+
+__PRIVILEGED_CODE
+void note_context_switch(task_control_block* task) {
+    if (task->rcu_read_nesting && !task->rcu_read_blocked) {
+        task->rcu_read_blocked = true;
+        g_rcu_blocked_readers.fetch_add(1, kstl::memory_order::relaxed);
+    }
+}
+
+void synchronize() {
+    mutex_guard guard(g_rcu_gp_lock);
+
+    uint64_t snapshot[MAX_SYSTEM_CPUS];
+    uint64_t self_cpu = 0;
+
+    // Order the caller's pointer updates before sampling the quiescent state counters
+    kstl::atomic_thread_fence();
+
+    RUN_ELEVATED({
+        self_cpu = current->cpu;
+
+        for (uint64_t cpu = 0; cpu < MAX_SYSTEM_CPUS; cpu++) {
+            uint64_t* seq = per_cpu_ptr(rcu_qs_seq, cpu);
+            snapshot[cpu] = seq ? kstl::atomic_load(seq, kstl::memory_order::relaxed) : 0;
+        }
+    });
+
+    while (true) {
+        bool grace_period_elapsed = true;
+
+        RUN_ELEVATED({
+            for (uint64_t cpu = 0; cpu < MAX_SYSTEM_CPUS && grace_period_elapsed; cpu++) {
+                // The calling task is outside of any read-side section, which makes its own
+                // CPU quiescent right now. CPUs that never ran the scheduler have no readers.
+                if (cpu == self_cpu || snapshot[cpu] == 0) {
+                    continue;
+                }
+
+                // A CPU sitting in its idle task is quiescent as well, tickless
+                // isolated CPUs might not run the scheduler again for a long time.
+                task_control_block** remote_current = per_cpu_ptr(current_task, cpu);
+                task_control_block* remote_task = remote_current
+                    ? kstl::atomic_load(remote_current, kstl::memory_order::acquire)
+                    : nullptr;
+
+                if (remote_task == sched::get_idle_task(cpu) && remote_task->rcu_read_nesting == 0) {
+                    continue;
+                }
+
+                uint64_t* seq = per_cpu_ptr(rcu_qs_seq, cpu);
+                if (seq && kstl::atomic_load(seq, kstl::memory_order::acquire) == snapshot[cpu]) {
+                    grace_period_elapsed = false;
+
+                    // Isolated CPUs have no tick, a busy task there would never schedule
+                    // again on its own. The reschedule IPI runs the scheduler on its way
+                    // out, which is a quiescent state unless it interrupted a reader.
+                    sched::scheduler& scheduler = sched::scheduler::get();
+                    if (scheduler.is_cpu_isolated(static_cast<int>(cpu))) {
+                        scheduler.resched_cpu(static_cast<int>(cpu));
+                    }
+                }
+            }
+        });
+
+        // Only read once every CPU was seen quiescent. A reader preempted in between is
+        // counted as blocked before its CPU's sequence advances, reading the count first
+        // could pair a stale count of zero with the advanced sequence.
+        if (grace_period_elapsed && g_rcu_blocked_readers.load(kstl::memory_order::acquire) == 0) {
+            break;
+        }
+
+        sched::yield();
+    }
+
+    kstl::atomic_thread_fence();
+}
+} // namespace rcu
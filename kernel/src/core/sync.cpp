@@ -1,69 +1,440 @@
 #include <sync.h>
 #include <serial/serial.h>
 #include <process/process.h>
+#include <interrupts/irq.h>
+#include <memory/memory.h>
+#include <time/time.h>
+#include <klog.h>
+#include <sched/sched.h>
+#include <dynpriv/dynpriv.h>
 
-int spinlock::_atomic_xchg(volatile int* addr, int new_value) {
-    int old_value;
-    asm volatile (
-        "xchg %0, %1"
-        : "=r"(old_value), "+m"(*addr)
-        : "0"(new_value)
-        : "memory"
-    );
-    return old_value;
+// Statistics slots handed out to locks that opted into contention tracking
+lock_stats g_lock_stats[MAX_TRACKED_LOCKS];
+size_t g_lock_stats_count = 0;
+DECLARE_GLOBAL_OBJECT(spinlock, g_lock_stats_lock);
+
+static __force_inline__ void lockstat_account_acquire(lock_stats* stats, uint64_t spins, uint64_t& acquired_at) {
+    if (!stats) {
+        return;
+    }
+
+    stats->acquisitions++;
+    if (spins) {
+        stats->contentions++;
+        stats->spins += spins;
+    }
+
+    acquired_at = rdtsc();
+}
+
+static __force_inline__ void lockstat_account_release(lock_stats* stats, uint64_t acquired_at) {
+    if (!stats) {
+        return;
+    }
+
+    uint64_t held = rdtsc() - acquired_at;
+    stats->total_hold_cycles += held;
+    if (held > stats->max_hold_cycles) {
+        stats->max_hold_cycles = held;
+    }
+}
+
+namespace lockstat {
+lock_stats* register_lock(const char* name) {
+    spinlock_guard guard(g_lock_stats_lock);
+
+    if (g_lock_stats_count >= MAX_TRACKED_LOCKS) {
+        return nullptr;
+    }
+
+    lock_stats* stats = &g_lock_stats[g_lock_stats_count++];
+    zeromem(stats, sizeof(lock_stats));
+    stats->name = name;
+
+    return stats;
+}
+
+size_t count() {
+    return g_lock_stats_count;
 }
 
+const lock_stats* get(size_t index) {
+    if (index >= g_lock_stats_count) {
+        return nullptr;
+    }
+
+    return &g_lock_stats[index];
+}
+
+void reset() {
+    spinlock_guard guard(g_lock_stats_lock);
+
+    for (size_t i = 0; i < g_lock_stats_count; i++) {
+        const char* name = g_lock_stats[i].name;
+        zeromem(&g_lock_stats[i], sizeof(lock_stats));
+        g_lock_stats[i].name = name;
+    }
+}
+
+void dump() {
+    kprint("Lock statistics (hold times in TSC cycles):\n");
+
+    for (size_t i = 0; i < count(); i++) {
+        const lock_stats* stats = get(i);
+        uint64_t avg_hold = stats->acquisitions ? stats->total_hold_cycles / stats->acquisitions : 0;
+
+        kprint("  %s: acquired %llu, contended %llu, spins %llu, max hold %llu, avg hold %llu\n",
+            stats->name,
+            stats->acquisitions,
+            stats->contentions,
+            stats->spins,
+            stats->max_hold_cycles,
+            avg_hold
+        );
+    }
+}
+} // namespace lockstat
+
 void spinlock::lock() {
-    while (_atomic_xchg(&m_state, SPINLOCK_STATE_LOCKED) != 0) {
+    uint16_t ticket = m_next.fetch_add(1, kstl::memory_order::relaxed);
+    uint64_t spins = 0;
+
+    // Spin on plain reads until our ticket is being served
+    while (m_owner.load(kstl::memory_order::acquire) != ticket) {
         asm volatile ("pause");
+        ++spins;
     }
 
-    memory_barrier();
+    lockstat_account_acquire(m_stats, spins, m_acquired_at);
 }
 
 void spinlock::unlock() {
-    memory_barrier();
-    m_state = SPINLOCK_STATE_UNLOCKED;
+    lockstat_account_release(m_stats, m_acquired_at);
+
+    // Only the holder ever writes the owner field, so a release store is enough
+    uint16_t owner = m_owner.load(kstl::memory_order::relaxed);
+    m_owner.store(owner + 1, kstl::memory_order::release);
 }
 
 bool spinlock::try_lock() {
-    return _atomic_xchg(&m_state, SPINLOCK_STATE_LOCKED) == 0;
+    // The lock is free when no tickets are outstanding, in which case
+    // the owner field can't move until somebody takes the next ticket.
+    uint16_t owner = m_owner.load(kstl::memory_order::acquire);
+    uint16_t expected = owner;
+
+    if (!m_next.compare_exchange_strong(expected, owner + 1, kstl::memory_order::acquire)) {
+        return false;
+    }
+
+    lockstat_account_acquire(m_stats, 0, m_acquired_at);
+    return true;
 }
 
-bool mutex::_atomic_cmpxchg(volatile int* addr, int expected, int new_value) {
-    int prev;
-    asm volatile (
-        "lock cmpxchg %2, %1"
-        : "=a"(prev), "+m"(*addr)
-        : "r"(new_value), "0"(expected)
-        : "memory"
-    );
-    return prev == expected;
+__PRIVILEGED_CODE
+uint64_t spinlock::lock_irqsave() {
+    uint64_t flags = save_and_disable_irqs();
+    lock();
+    return flags;
+}
+
+__PRIVILEGED_CODE
+void spinlock::unlock_irqrestore(uint64_t flags) {
+    unlock();
+    restore_irq_flags(flags);
+}
+
+void spinlock::enable_stats(const char* name) {
+    if (!m_stats) {
+        m_stats = lockstat::register_lock(name);
+    }
+}
+
+void mcs_spinlock::lock(mcs_node& node) {
+    node.next.store(nullptr, kstl::memory_order::relaxed);
+    node.locked.store(1, kstl::memory_order::relaxed);
+
+    uint64_t spins = 0;
+    mcs_node* prev = m_tail.exchange(&node, kstl::memory_order::acq_rel);
+
+    if (prev) {
+        // Link behind the previous waiter and spin on our own node
+        prev->next.store(&node, kstl::memory_order::release);
+
+        while (node.locked.load(kstl::memory_order::acquire)) {
+            asm volatile ("pause");
+            ++spins;
+        }
+    }
+
+    lockstat_account_acquire(m_stats, spins, m_acquired_at);
+}
+
+void mcs_spinlock::unlock(mcs_node& node) {
+    lockstat_account_release(m_stats, m_acquired_at);
+
+    mcs_node* next = node.next.load(kstl::memory_order::acquire);
+    if (!next) {
+        // No known successor, try to swing the tail back to empty
+        mcs_node* expected = &node;
+        if (m_tail.compare_exchange_strong(expected, nullptr, kstl::memory_order::release)) {
+            return;
+        }
+
+        // A new waiter swapped the tail but has not linked itself yet
+        while (!(next = node.next.load(kstl::memory_order::acquire))) {
+            asm volatile ("pause");
+        }
+    }
+
+    next->locked.store(0, kstl::memory_order::release);
+}
+
+bool mcs_spinlock::try_lock(mcs_node& node) {
+    node.next.store(nullptr, kstl::memory_order::relaxed);
+    node.locked.store(0, kstl::memory_order::relaxed);
+
+    mcs_node* expected = nullptr;
+    if (!m_tail.compare_exchange_strong(expected, &node, kstl::memory_order::acquire)) {
+        return false;
+    }
+
+    lockstat_account_acquire(m_stats, 0, m_acquired_at);
+    return true;
+}
+
+void mcs_spinlock::enable_stats(const char* name) {
+    if (!m_stats) {
+        m_stats = lockstat::register_lock(name);
+    }
+}
+
+// Parking requires a schedulable task context with interrupts enabled
+static __force_inline__ bool mutex_can_sleep() {
+    return irqs_enabled() && current->pid != 0;
 }
 
 void mutex::lock() {
+    uintptr_t self = reinterpret_cast<uintptr_t>(current);
+
+    // Uncontended fast path
+    if (_cmpxchg_owner(MUTEX_STATE_UNLOCKED, self)) {
+        return;
+    }
+
     while (true) {
-        // Attempt to acquire the lock
-        if (_atomic_cmpxchg(&m_state, MUTEX_STATE_UNLOCKED, MUTEX_STATE_LOCKED)) {
-            memory_barrier(); // Synchronize memory after acquiring the lock
-            return;
+        if (_optimistic_spin(self)) {
+            break;
         }
 
-        // Yield CPU if lock is not acquired
-        sched::yield();
+        if (!mutex_can_sleep()) {
+            // Yield CPU if lock is not acquired
+            sched::yield();
+
+            if (_cmpxchg_owner(MUTEX_STATE_UNLOCKED, self)) {
+                break;
+            }
+            continue;
+        }
+
+        if (_park(self)) {
+            break;
+        }
     }
 }
 
 void mutex::unlock() {
-    memory_barrier(); // Synchronize memory before releasing the lock
-    m_state = MUTEX_STATE_UNLOCKED;
+    // Without queued waiters the owner word holds just the owner pointer
+    uintptr_t self = reinterpret_cast<uintptr_t>(current);
+    uintptr_t expected = self;
+    if (m_owner.compare_exchange_strong(expected, MUTEX_STATE_UNLOCKED, kstl::memory_order::release)) {
+        return;
+    }
+
+    _unlock_slowpath();
 }
 
 bool mutex::try_lock() {
     // Attempt to acquire the lock without blocking
-    if (_atomic_cmpxchg(&m_state, MUTEX_STATE_UNLOCKED, MUTEX_STATE_LOCKED)) {
-        memory_barrier();
+    if (_cmpxchg_owner(MUTEX_STATE_UNLOCKED, reinterpret_cast<uintptr_t>(current))) {
         return true;
     }
     return false;
 }
+
+bool mutex::_optimistic_spin(uintptr_t self) {
+    for (uint64_t spins = 0; spins < MUTEX_ADAPTIVE_SPIN_LIMIT; ++spins) {
+        uintptr_t owner_word = m_owner.load(kstl::memory_order::relaxed);
+
+        if (owner_word == MUTEX_STATE_UNLOCKED) {
+            if (_cmpxchg_owner(MUTEX_STATE_UNLOCKED, self)) {
+                return true;
+            }
+            continue;
+        }
+
+        // Queued waiters get the lock in FIFO order, don't barge in front of them
+        if (owner_word & MUTEX_FLAG_WAITERS) {
+            return false;
+        }
+
+        // Spinning only pays off if the owner is actively
+        // running and can release the lock any moment now.
+        task_control_block* owner = reinterpret_cast<task_control_block*>(owner_word & ~MUTEX_FLAG_MASK);
+        if (owner->state != process_state::RUNNING || owner->cpu == current->cpu) {
+            return false;
+        }
+
+        asm volatile ("pause");
+    }
+
+    return false;
+}
+
+bool mutex::_park(uintptr_t self) {
+    bool acquired = false;
+    mutex_waiter waiter = { current, nullptr };
+
+    RUN_ELEVATED({
+        auto& scheduler = sched::scheduler::get();
+        uint64_t flags = m_wait_lock.lock_irqsave();
+
+        // Flag the contention so the owner takes the handoff path on
+        // unlock, picking up the lock directly if it was just released.
+        while (true) {
+            uintptr_t owner_word = m_owner.load(kstl::memory_order::relaxed);
+
+            if (owner_word == MUTEX_STATE_UNLOCKED) {
+                if (_cmpxchg_owner(MUTEX_STATE_UNLOCKED, self)) {
+                    acquired = true;
+                    break;
+                }
+                continue;
+            }
+
+            if ((owner_word & MUTEX_FLAG_WAITERS) ||
+                _cmpxchg_owner(owner_word, owner_word | MUTEX_FLAG_WAITERS)) {
+                break;
+            }
+        }
+
+        if (!acquired) {
+            // Append to the FIFO wait queue
+            if (m_wait_tail) {
+                m_wait_tail->next = &waiter;
+            } else {
+                m_wait_head = &waiter;
+            }
+            m_wait_tail = &waiter;
+
+            // Take the task off the run queue before dropping the wait lock,
+            // so the handoff can't race with the task going to sleep.
+            current->state = process_state::WAITING;
+            scheduler.remove_task(current);
+        }
+
+        m_wait_lock.unlock_irqrestore(flags);
+
+        // Switch away until the unlocking task hands the lock off. The waiter lives on this
+        // stack and stays queued until then, so a task woken up by anything else goes back
+        // to sleep instead of returning.
+        while (!acquired) {
+            scheduler.schedule();
+
+            flags = m_wait_lock.lock_irqsave();
+
+            // The handoff unlinked the waiter and stored us as the owner before waking us up
+            acquired = (m_owner.load(kstl::memory_order::acquire) & ~MUTEX_FLAG_MASK) == self;
+            if (!acquired) {
+                current->state = process_state::WAITING;
+                scheduler.remove_task(current);
+            }
+
+            m_wait_lock.unlock_irqrestore(flags);
+        }
+    });
+
+    return acquired;
+}
+
+void mutex::_unlock_slowpath() {
+    RUN_ELEVATED({
+        uint64_t flags = m_wait_lock.lock_irqsave();
+
+        mutex_waiter* waiter = m_wait_head;
+        if (waiter) {
+            m_wait_head = waiter->next;
+            if (!m_wait_head) {
+                m_wait_tail = nullptr;
+            }
+
+            // Transfer ownership before waking the waiter up
+            uintptr_t new_owner = reinterpret_cast<uintptr_t>(waiter->task);
+            if (m_wait_head) {
+                new_owner |= MUTEX_FLAG_WAITERS;
+            }
+
+            task_control_block* task = waiter->task;
+            m_owner.store(new_owner, kstl::memory_order::release);
+
+            sched::scheduler::get().add_task(task, task->cpu);
+        } else {
+            m_owner.store(MUTEX_STATE_UNLOCKED, kstl::memory_order::release);
+        }
+
+        m_wait_lock.unlock_irqrestore(flags);
+    });
+}
+
+void rwlock::_backoff(uint64_t& spins) {
+    if (++spins < RWLOCK_SPIN_LIMIT || !mutex_can_sleep()) {
+        asm volatile ("pause");
+        return;
+    }
+
+    // The holder is likely descheduled, give it a chance to run
+    spins = 0;
+    sched::yield();
+}
+
+void rwlock::read_lock() {
+    uint64_t spins = 0;
+
+    while (!try_read_lock()) {
+        _backoff(spins);
+    }
+}
+
+void rwlock::read_unlock() {
+    m_state.fetch_sub(1, kstl::memory_order::release);
+}
+
+void rwlock::write_lock() {
+    uint64_t spins = 0;
+
+    m_waiting_writers.fetch_add(1, kstl::memory_order::relaxed);
+
+    while (!_cmpxchg_state(RWLOCK_STATE_UNLOCKED, RWLOCK_STATE_WRITER)) {
+        _backoff(spins);
+    }
+
+    m_waiting_writers.fetch_sub(1, kstl::memory_order::relaxed);
+}
+
+void rwlock::write_unlock() {
+    m_state.store(RWLOCK_STATE_UNLOCKED, kstl::memory_order::release);
+}
+
+bool rwlock::try_read_lock() {
+    int32_t state = m_state.load(kstl::memory_order::relaxed);
+
+    // Hold off new readers while a writer is waiting
+    if (state == RWLOCK_STATE_WRITER || m_waiting_writers.load(kstl::memory_order::relaxed)) {
+        return false;
+    }
+
+    return _cmpxchg_state(state, state + 1);
+}
+
+bool rwlock::try_write_lock() {
+    return _cmpxchg_state(RWLOCK_STATE_UNLOCKED, RWLOCK_STATE_WRITER);
+}
@@ -22,7 +22,9 @@ mutex xhci_driver::s_xhc_command_lock = mutex();
 mutex xhci_driver::s_xhc_device_setup_lock = mutex();
 mutex xhci_driver::s_xhc_logical_logging_block_lock = mutex();
 
-xhci_driver::xhci_driver() : pci_device_driver("xhci_driver") {}
+xhci_driver::xhci_driver() : pci_device_driver("xhci_driver") {
+    m_event_lock.enable_stats("xhci_events");
+}
 
 bool xhci_driver::init_device() {
     RUN_ELEVATED({ m_qemu_detected = DETECT_QEMU(); });
@@ -90,7 +92,11 @@ bool xhci_driver::start_device() {
                 xhci_port_connection_event conn_evt;
                 conn_evt.port_id = i + 1;
                 conn_evt.device_connected = (portsc.ccs == 1);
-                m_port_connection_events.push_back(conn_evt);
+
+                RUN_ELEVATED({
+                    spinlock_irqsave_guard guard(m_event_lock);
+                    m_port_connection_events.push_back(conn_evt);
+                });
             }
         }
     }
@@ -102,12 +108,8 @@ bool xhci_driver::start_device() {
     while (true) {
         msleep(100);
 
-        if (m_port_connection_events.empty()) {
-            continue;
-        }
-
-        for (size_t i = 0; i < m_port_connection_events.size(); i++) {
-            auto event = m_port_connection_events[i];
+        xhci_port_connection_event event;
+        while (_pop_port_connection_event(event)) {
             uint8_t port = event.port_id;
             uint8_t port_reg_idx = port - 1;
 
@@ -130,8 +132,6 @@ bool xhci_driver::start_device() {
                 _reset_port(port_reg_idx);
             }
         }
-
-        m_port_connection_events.clear();
     }
 
     return true;
@@ -466,7 +466,7 @@ xhci_command_completion_trb_t* xhci_driver::_send_command(xhci_trb_t* trb, uint3
 
     // Let the host controller process the command
     uint64_t sleep_passed = 0;
-    while (!m_command_irq_completed) {
+    while (!m_command_irq_completed.load(kstl::memory_order::acquire)) {
         usleep(10);
         sleep_passed += 10;
 
@@ -475,12 +475,18 @@ xhci_command_completion_trb_t* xhci_driver::_send_command(xhci_trb_t* trb, uint3
         }
     }
 
-    xhci_command_completion_trb_t* completion_trb =
-        m_command_completion_events.size() ? m_command_completion_events[0] : nullptr;
+    xhci_command_completion_trb_t* completion_trb = nullptr;
 
-    // Reset the irq flag and clear out the command completion event queue
-    m_command_completion_events.clear();
-    m_command_irq_completed = 0;
+    // Reset the irq flag and clear out the command completion event queue.
+    // The event lock is shared with the IRQ handler, so interrupts have to
+    // be disabled locally while holding it.
+    RUN_ELEVATED({
+        spinlock_irqsave_guard guard(m_event_lock);
+
+        completion_trb = m_command_completion_events.size() ? m_command_completion_events[0] : nullptr;
+        m_command_completion_events.clear();
+        m_command_irq_completed.store(0, kstl::memory_order::relaxed);
+    });
 
     if (!completion_trb) {
         xhci_warn("Failed to find completion TRB for command %i\n", trb->trb_type);
@@ -502,7 +508,7 @@ xhci_transfer_completion_trb_t* xhci_driver::_start_control_endpoint_transfer(xh
     // Let the host controller process the command
     const uint64_t timeout_ms = 400; 
     uint64_t sleep_passed = 0;
-    while (!m_transfer_irq_completed) {
+    while (!m_transfer_irq_completed.load(kstl::memory_order::acquire)) {
         usleep(10);
         sleep_passed += 10;
 
@@ -511,12 +517,16 @@ xhci_transfer_completion_trb_t* xhci_driver::_start_control_endpoint_transfer(xh
         }
     }
 
-    xhci_transfer_completion_trb_t* completion_trb =
-        m_transfer_completion_events.size() ? m_transfer_completion_events[0] : nullptr;
+    xhci_transfer_completion_trb_t* completion_trb = nullptr;
 
-    // Reset the irq flag and clear out the command completion event queue
-    m_transfer_completion_events.clear();
-    m_transfer_irq_completed = 0;
+    // Reset the irq flag and clear out the transfer completion event queue
+    RUN_ELEVATED({
+        spinlock_irqsave_guard guard(m_event_lock);
+
+        completion_trb = m_transfer_completion_events.size() ? m_transfer_completion_events[0] : nullptr;
+        m_transfer_completion_events.clear();
+        m_transfer_irq_completed.store(0, kstl::memory_order::relaxed);
+    });
 
     if (!completion_trb) {
         xhci_warn("Failed to find transfer completion TRB\n");
@@ -548,6 +558,9 @@ void xhci_driver::_process_events() {
         case XHCI_TRB_TYPE_PORT_STATUS_CHANGE_EVENT: {
             port_change_event_status = 1;
             auto port_evt = reinterpret_cast<xhci_port_status_change_trb_t*>(event);
+
+            // Interrupts are already disabled in the IRQ context
+            spinlock_guard guard(m_event_lock);
             m_port_status_change_events.push_back(port_evt);
 
             xhci_port_register_manager regman = _get_port_register_set(port_evt->port_id - 1);
@@ -564,13 +577,18 @@ void xhci_driver::_process_events() {
         }
         case XHCI_TRB_TYPE_CMD_COMPLETION_EVENT: {
             command_completion_status = 1;
+
+            spinlock_guard guard(m_event_lock);
             m_command_completion_events.push_back((xhci_command_completion_trb_t*)event);
             break;
         }
         case XHCI_TRB_TYPE_TRANSFER_EVENT: {
             transfer_completion_status = 1;
             auto transfer_event = (xhci_transfer_completion_trb_t*)event;
-            m_transfer_completion_events.push_back(transfer_event);
+            {
+                spinlock_guard guard(m_event_lock);
+                m_transfer_completion_events.push_back(transfer_event);
+            }
 
             auto device = m_connected_devices[transfer_event->slot_id];
             if (!device) {
@@ -587,8 +605,31 @@ void xhci_driver::_process_events() {
         }
     }
 
-    m_command_irq_completed = command_completion_status;
-    m_transfer_irq_completed = transfer_completion_status;
+    // Publish the completions after the events are queued. An interrupt without
+    // completions must not clear a flag the waiting task hasn't consumed yet.
+    if (command_completion_status) {
+        m_command_irq_completed.store(1, kstl::memory_order::release);
+    }
+
+    if (transfer_completion_status) {
+        m_transfer_irq_completed.store(1, kstl::memory_order::release);
+    }
+}
+
+bool xhci_driver::_pop_port_connection_event(xhci_port_connection_event& event) {
+    bool found = false;
+
+    RUN_ELEVATED({
+        spinlock_irqsave_guard guard(m_event_lock);
+
+        if (!m_port_connection_events.empty()) {
+            event = m_port_connection_events[0];
+            m_port_connection_events.erase(0);
+            found = true;
+        }
+    });
+
+    return found;
 }
 
 void xhci_driver::_acknowledge_irq(uint8_t interrupter) {
@@ -0,0 +1,63 @@
+#include <fs/block_device.h>
+#include <memory/vmm.h>
+#include <memory/paging.h>
+#include <dynpriv/dynpriv.h>
+
+namespace fs {
+ram_block_device::ram_block_device(uint64_t block_count, size_t block_size)
+    : m_storage(nullptr), m_block_size(block_size), m_block_count(block_count),
+      m_page_count(0), m_blocks_read(0), m_blocks_written(0) {
+    // Pages have to be made of whole blocks
+    if (block_size == 0 || block_size > PAGE_SIZE || (block_size & (block_size - 1)) != 0) {
+        return;
+    }
+
+    if (block_count == 0) {
+        return;
+    }
+
+    m_page_count = (block_count * block_size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    void* storage = nullptr;
+    RUN_ELEVATED({
+        storage = vmm::alloc_virtual_pages(m_page_count, DEFAULT_UNPRIV_PAGE_FLAGS);
+    });
+
+    if (!storage) {
+        return;
+    }
+
+    m_storage = static_cast<uint8_t*>(storage);
+    zeromem(m_storage, m_page_count * PAGE_SIZE);
+}
+
+ram_block_device::~ram_block_device() {
+    if (!m_storage) {
+        return;
+    }
+
+    RUN_ELEVATED({
+        vmm::unmap_contiguous_virtual_pages(reinterpret_cast<uintptr_t>(m_storage), m_page_count);
+    });
+}
+
+ssize_t ram_block_device::read_blocks(uint64_t lba, size_t count, void* buffer) {
+    if (!m_storage || !buffer || !_in_range(lba, count)) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    memcpy(buffer, m_storage + lba * m_block_size, count * m_block_size);
+    m_blocks_read += count;
+    return static_cast<ssize_t>(count);
+}
+
+ssize_t ram_block_device::write_blocks(uint64_t lba, size_t count, const void* buffer) {
+    if (!m_storage || !buffer || !_in_range(lba, count)) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    memcpy(m_storage + lba * m_block_size, buffer, count * m_block_size);
+    m_blocks_written += count;
+    return static_cast<ssize_t>(count);
+}
+} // namespace fs
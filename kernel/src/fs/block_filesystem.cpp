@@ -0,0 +1,155 @@
+#include <fs/block_filesystem.h>
+#include <memory/paging.h>
+#include <time/time.h>
+
+namespace fs {
+block_filesystem::block_filesystem(const kstl::shared_ptr<block_device>& device)
+    : m_device(device) {
+    zeromem(&m_mapping, sizeof(page_cache_mapping));
+    m_mapping.fill = &_fill_page;
+    m_mapping.writeback = &_writeback_page;
+    m_mapping._private = this;
+}
+
+kstl::shared_ptr<vfs_node> block_filesystem::create_root_node() {
+    if (m_root) {
+        return m_root;
+    }
+
+    if (!m_device) {
+        return vfs_null_node;
+    }
+
+    size_t block_size = m_device->block_size();
+    if (block_size == 0 || block_size > PAGE_SIZE || PAGE_SIZE % block_size != 0) {
+        return vfs_null_node;
+    }
+
+    m_mapping.size = m_device->capacity();
+
+    m_root = kstl::make_shared<vfs_node>();
+    m_root->stat.type = vfs_node_type::file;
+    m_root->stat.size = m_mapping.size;
+    m_root->stat.perms = 0644;
+    m_root->stat.creation_ts = kernel_timer::get_system_time_in_milliseconds();
+    m_root->stat.modification_ts = m_root->stat.creation_ts;
+    m_root->stat.access_ts = m_root->stat.creation_ts;
+    m_root->_private = this;
+
+    return m_root;
+}
+
+void block_filesystem::unmount() {
+    sync();
+    page_cache::get().invalidate(&m_mapping);
+
+    m_mapping.ra_last_index = 0;
+    m_mapping.ra_end = 0;
+    m_mapping.ra_window = 0;
+    m_root = vfs_null_node;
+}
+
+void block_filesystem::set_ops(kstl::shared_ptr<vfs_node>& node, const kstl::string& path) {
+    __unused path;
+    node->ops = vfs_operations{
+        .read = &block_read,
+        .write = &block_write,
+        .lookup = nullptr,
+        .create = nullptr,
+        .remove = nullptr,
+        .listdir = nullptr,
+
+        // Cached pages can be evicted, they can't be handed out for keeps
+        .get_page = nullptr,
+        .release = nullptr
+    };
+}
+
+fs_error block_filesystem::sync() {
+    fs_error status = page_cache::get().sync(&m_mapping);
+    if (status != fs_error::success) {
+        return status;
+    }
+
+    return m_device ? m_device->flush() : fs_error::success;
+}
+
+ssize_t block_filesystem::block_read(vfs_node* node, void* buffer, size_t size, uint64_t offset) {
+    if (!node || !buffer) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    auto fs = static_cast<block_filesystem*>(node->_private);
+    return page_cache::get().read(&fs->m_mapping, buffer, size, offset);
+}
+
+ssize_t block_filesystem::block_write(vfs_node* node, const void* buffer, size_t size, uint64_t offset) {
+    if (!node || !buffer) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    auto fs = static_cast<block_filesystem*>(node->_private);
+    ssize_t result = page_cache::get().write(&fs->m_mapping, buffer, size, offset);
+    if (result > 0) {
+        node->stat.modification_ts = kernel_timer::get_system_time_in_milliseconds();
+    }
+
+    return result;
+}
+
+ssize_t block_filesystem::_fill_page(page_cache_mapping* mapping, uint64_t page_index, void* page) {
+    auto fs = static_cast<block_filesystem*>(mapping->_private);
+
+    uint64_t lba;
+    size_t count = fs->_page_blocks(page_index, lba);
+    if (count == 0) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    ssize_t result = fs->m_device->read_blocks(lba, count, page);
+    if (result < 0) {
+        return result;
+    }
+
+    if (static_cast<size_t>(result) != count) {
+        return make_error_code(fs_error::io_error);
+    }
+
+    // The last page may extend past the end of the device
+    size_t filled = count * fs->m_device->block_size();
+    if (filled < PAGE_SIZE) {
+        zeromem(static_cast<uint8_t*>(page) + filled, PAGE_SIZE - filled);
+    }
+
+    return 0;
+}
+
+ssize_t block_filesystem::_writeback_page(page_cache_mapping* mapping, uint64_t page_index, const void* page) {
+    auto fs = static_cast<block_filesystem*>(mapping->_private);
+
+    uint64_t lba;
+    size_t count = fs->_page_blocks(page_index, lba);
+    if (count == 0) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    ssize_t result = fs->m_device->write_blocks(lba, count, page);
+    if (result < 0) {
+        return result;
+    }
+
+    return static_cast<size_t>(result) == count ? 0 : make_error_code(fs_error::io_error);
+}
+
+size_t block_filesystem::_page_blocks(uint64_t page_index, uint64_t& out_lba) const {
+    uint64_t blocks_per_page = PAGE_SIZE / m_device->block_size();
+    uint64_t block_count = m_device->block_count();
+
+    out_lba = page_index * blocks_per_page;
+    if (out_lba >= block_count) {
+        return 0;
+    }
+
+    return static_cast<size_t>(kstl::min(blocks_per_page, block_count - out_lba));
+}
+} // namespace fs
@@ -0,0 +1,444 @@
+#include <fs/cpio/cpio_filesystem.h>
+#include <fs/cpio/cpio.h>
+#include <time/time.h>
+#include <serial/serial.h>
+
+namespace fs {
+static __force_inline__ size_t align4(size_t x) {
+    return (x + 3) & ~3UL;
+}
+
+cpio_filesystem::cpio_filesystem(const uint8_t* archive, size_t length, bool writable)
+    : m_archive(archive), m_length(length), m_writable(writable),
+      m_indexed_nodes(0), m_root_node(nullptr) {}
+
+kstl::shared_ptr<vfs_node> cpio_filesystem::create_root_node() {
+    rwlock_write_guard guard(m_lock);
+
+    if (m_root) {
+        return m_root;
+    }
+
+    m_root_node = new cpio_node();
+    m_root_node->name = "/";
+    m_root_node->type = vfs_node_type::directory;
+    m_root_node->permissions = 0755;
+    m_root_node->children_by_name = new kstl::hashmap<kstl::string, cpio_node*>();
+    m_root_node->refs.store(1, kstl::memory_order::relaxed);
+
+    if (!_index_archive()) {
+        _unlink_node(m_root_node);
+        m_root_node = nullptr;
+        return vfs_null_node;
+    }
+
+    m_root = kstl::make_shared<vfs_node>();
+    m_root->stat.type = vfs_node_type::directory;
+    m_root->stat.perms = m_root_node->permissions;
+    m_root->_private = m_root_node;
+    m_root_node->refs.fetch_add(1, kstl::memory_order::relaxed);
+
+    return m_root;
+}
+
+void cpio_filesystem::unmount() {
+    rwlock_write_guard guard(m_lock);
+
+    // The archive itself is owned by whoever created the filesystem,
+    // nodes that are still open get freed once they are closed.
+    _unlink_node(m_root_node);
+    m_root_node = nullptr;
+    m_root = vfs_null_node;
+    m_indexed_nodes = 0;
+}
+
+void cpio_filesystem::set_ops(kstl::shared_ptr<vfs_node>& node, const kstl::string& path) {
+    __unused path;
+    node->ops = vfs_operations{
+        .read = &cpio_read,
+        .write = m_writable ? &cpio_write : nullptr,
+        .lookup = &cpio_lookup,
+        .create = nullptr,
+        .remove = m_writable ? &cpio_remove : nullptr,
+        .listdir = nullptr,
+
+        // Archive data isn't page-aligned, so there are no pages to hand out
+        .get_page = nullptr,
+        .release = &cpio_release
+    };
+
+    // Directory-specific rules
+    if (node->stat.type == vfs_node_type::directory) {
+        node->ops.read = nullptr;
+        node->ops.write = nullptr;
+        node->ops.create = m_writable ? &cpio_create : nullptr;
+        node->ops.listdir = &cpio_listdir;
+    }
+}
+
+ssize_t cpio_filesystem::cpio_read(vfs_node* node, void* buffer, size_t size, uint64_t offset) {
+    if (!node || !buffer) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    auto fs = static_cast<cpio_filesystem*>(node->fs);
+    auto file_node = static_cast<cpio_node*>(node->_private);
+    if (file_node->type != vfs_node_type::file) {
+        return make_error_code(fs_error::not_a_file);
+    }
+
+    // Only a concurrent overlay write can move the data
+    rwlock_read_guard guard(fs->m_lock);
+
+    if (offset >= file_node->data_size) {
+        return 0; // Offset out of bounds
+    }
+
+    size_t readable = kstl::min(size, file_node->data_size - offset);
+    memcpy(buffer, file_node->data + offset, readable);
+    return readable;
+}
+
+ssize_t cpio_filesystem::cpio_write(vfs_node* node, const void* buffer, size_t size, uint64_t offset) {
+    if (!node || !buffer) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    auto fs = static_cast<cpio_filesystem*>(node->fs);
+    auto file_node = static_cast<cpio_node*>(node->_private);
+    if (file_node->type != vfs_node_type::file) {
+        return make_error_code(fs_error::not_a_file);
+    }
+
+    if (size == 0) {
+        return 0;
+    }
+
+    rwlock_write_guard guard(fs->m_lock);
+
+    // Archive data is never modified, the file gets its own copy on the first write
+    size_t required_size = kstl::max(file_node->data_size, static_cast<size_t>(offset + size));
+    if (!_copy_up(file_node, required_size)) {
+        return make_error_code(fs_error::no_space_left);
+    }
+
+    // Writing past the end leaves a zero-filled gap
+    if (offset > file_node->data_size) {
+        zeromem(file_node->overlay_data + file_node->data_size, offset - file_node->data_size);
+    }
+
+    memcpy(file_node->overlay_data + offset, buffer, size);
+    file_node->data_size = required_size;
+
+    file_node->access_ts = kernel_timer::get_system_time_in_milliseconds();
+    file_node->modification_ts = file_node->access_ts;
+
+    node->stat.size = file_node->data_size;
+    return size;
+}
+
+kstl::shared_ptr<vfs_node> cpio_filesystem::cpio_lookup(vfs_node* parent, const char* name) {
+    auto fs = static_cast<cpio_filesystem*>(parent->fs);
+    auto dir_node = static_cast<cpio_node*>(parent->_private);
+    if (dir_node->type != vfs_node_type::directory) {
+        return vfs_null_node; // Not a directory
+    }
+
+    rwlock_read_guard guard(fs->m_lock);
+
+    cpio_node** entry = dir_node->children_by_name->get(kstl::string(name));
+    if (!entry) {
+        return vfs_null_node; // Not found
+    }
+
+    cpio_node* child = *entry;
+
+    auto vnode = kstl::make_shared<vfs_node>();
+    vnode->stat.type = child->type;
+    vnode->stat.size = child->data_size;
+    vnode->stat.perms = child->permissions;
+    vnode->stat.creation_ts = child->creation_ts;
+    vnode->stat.modification_ts = child->modification_ts;
+    vnode->stat.access_ts = child->access_ts;
+
+    // The tree's reference keeps the node alive while the lock is held
+    child->refs.fetch_add(1, kstl::memory_order::relaxed);
+    vnode->_private = child;
+
+    return vnode;
+}
+
+int cpio_filesystem::cpio_create(vfs_node* parent, const char* name, vfs_node_type type, uint32_t perms) {
+    auto fs = static_cast<cpio_filesystem*>(parent->fs);
+    auto dir_node = static_cast<cpio_node*>(parent->_private);
+    if (dir_node->type != vfs_node_type::directory) {
+        return make_error_code(fs_error::not_directory);
+    }
+
+    rwlock_write_guard guard(fs->m_lock);
+
+    cpio_node* child = _add_child(dir_node, kstl::string(name), type, perms);
+    if (!child) {
+        return make_error_code(fs_error::already_exists);
+    }
+
+    child->creation_ts = kernel_timer::get_system_time_in_milliseconds();
+    child->modification_ts = child->creation_ts;
+    child->access_ts = child->creation_ts;
+    return 0; // Success
+}
+
+int cpio_filesystem::cpio_remove(vfs_node* parent, vfs_node* node) {
+    if (!parent || !node) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    auto fs = static_cast<cpio_filesystem*>(node->fs);
+    auto dir_node = static_cast<cpio_node*>(parent->_private);
+    auto target_node = static_cast<cpio_node*>(node->_private);
+
+    if (dir_node->type != vfs_node_type::directory) {
+        return make_error_code(fs_error::not_directory);
+    }
+
+    rwlock_write_guard guard(fs->m_lock);
+
+    if (target_node->parent != dir_node) {
+        return make_error_code(fs_error::not_found);
+    }
+
+    // Files from the archive are only dropped from the index, their data stays in the archive
+    dir_node->children_by_name->remove(target_node->name);
+    for (size_t i = 0; i < dir_node->children.size(); ++i) {
+        if (dir_node->children[i] == target_node) {
+            dir_node->children.erase(i);
+            break;
+        }
+    }
+
+    // Open descriptors keep the node alive
+    _unlink_node(target_node);
+    return make_error_code(fs_error::success);
+}
+
+void cpio_filesystem::cpio_release(vfs_node* node) {
+    _put_node(static_cast<cpio_node*>(node->_private));
+}
+
+int cpio_filesystem::cpio_listdir(vfs_node* node, kstl::vector<kstl::string>& entries) {
+    if (!node) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    auto fs = static_cast<cpio_filesystem*>(node->fs);
+    auto dir_node = static_cast<cpio_node*>(node->_private);
+    if (dir_node->type != vfs_node_type::directory) {
+        return make_error_code(fs_error::not_directory);
+    }
+
+    rwlock_read_guard guard(fs->m_lock);
+
+    for (cpio_node* child : dir_node->children) {
+        entries.push_back(child->name);
+    }
+
+    return make_error_code(fs_error::success);
+}
+
+bool cpio_filesystem::_index_archive() {
+    size_t offset = 0;
+    while (true) {
+        // Check if there's enough room for the header
+        if (offset + sizeof(cpio_newc_header) > m_length) {
+            break; // End of archive or corrupt
+        }
+
+        const cpio_newc_header* hdr = reinterpret_cast<const cpio_newc_header*>(m_archive + offset);
+
+        // Check magic "070701"
+        if (memcmp(hdr->c_magic, CPIO_HEADER_MAGIC, 6) != 0) {
+            break;
+        }
+
+        // Parse relevant fields
+        uint32_t namesize = cpio_from_hex_str(hdr->c_namesize, 8);
+        uint32_t filesize = cpio_from_hex_str(hdr->c_filesize, 8);
+        uint32_t mode     = cpio_from_hex_str(hdr->c_mode,     8);
+        uint32_t mtime    = cpio_from_hex_str(hdr->c_mtime,    8);
+
+        offset += sizeof(cpio_newc_header);
+        if (namesize == 0 || offset + namesize > m_length) {
+            serial::printf("cpio: Truncated entry name at offset %llu\n", offset);
+            return false;
+        }
+
+        const char* filename = reinterpret_cast<const char*>(m_archive + offset);
+        if (filename[namesize - 1] != '\0') {
+            serial::printf("cpio: Unterminated entry name at offset %llu\n", offset);
+            return false;
+        }
+
+        // If the filename is "TRAILER!!!", it's the end
+        if (!strcmp(filename, CPIO_TRAILER_MARK)) {
+            break;
+        }
+
+        offset = align4(offset + namesize);
+        if (offset + filesize > m_length) {
+            serial::printf("cpio: Truncated data of '%s'\n", filename);
+            return false;
+        }
+
+        // Entries are named relative to the archive root, usually with a leading "./"
+        while (filename[0] == '.' && filename[1] == '/') {
+            filename += 2;
+        }
+        while (filename[0] == '/') {
+            filename++;
+        }
+
+        // The archive root itself only has metadata
+        if (filename[0] != '\0' && strcmp(filename, ".") != 0) {
+            vfs_node_type type = cpio_is_dir(mode) ? vfs_node_type::directory : vfs_node_type::file;
+
+            cpio_node* node = _index_path(kstl::string(filename), type);
+            if (!node) {
+                serial::printf("cpio: Conflicting entry '%s'\n", filename);
+                return false;
+            }
+
+            node->permissions = mode & 0777;
+            node->creation_ts = static_cast<uint64_t>(mtime) * 1000;
+            node->modification_ts = node->creation_ts;
+            node->access_ts = node->creation_ts;
+
+            if (type == vfs_node_type::file) {
+                node->data = m_archive + offset;
+                node->data_size = filesize;
+            }
+
+            m_indexed_nodes++;
+        }
+
+        // Skip over the file content
+        offset = align4(offset + filesize);
+    }
+
+    return true;
+}
+
+cpio_node* cpio_filesystem::_index_path(const kstl::string& path, vfs_node_type type) {
+    cpio_node* dir_node = m_root_node;
+
+    size_t start = 0;
+    while (start < path.length()) {
+        size_t end = path.find('/', start);
+        if (end == kstl::string::npos) {
+            end = path.length();
+        }
+
+        // Duplicate and trailing slashes don't make up components of their own
+        size_t next = end;
+        while (next < path.length() && path[next] == '/') {
+            next++;
+        }
+
+        bool last = (next == path.length());
+
+        if (dir_node->type != vfs_node_type::directory) {
+            return nullptr;
+        }
+
+        kstl::string component = path.substring(start, end - start);
+
+        cpio_node** existing = dir_node->children_by_name->get(component);
+        if (existing) {
+            dir_node = *existing;
+        } else {
+            // Archives normally list directories before their contents, but don't have to
+            dir_node = _add_child(dir_node, component, last ? type : vfs_node_type::directory, last ? 0644 : 0755);
+        }
+
+        if (last) {
+            return (dir_node->type == type) ? dir_node : nullptr;
+        }
+
+        start = next;
+    }
+
+    return nullptr;
+}
+
+cpio_node* cpio_filesystem::_add_child(cpio_node* dir_node, const kstl::string& name, vfs_node_type type, uint32_t perms) {
+    if (dir_node->children_by_name->find(name)) {
+        return nullptr;
+    }
+
+    auto child = new cpio_node();
+    child->name = name;
+    child->type = type;
+    child->permissions = perms;
+    child->data = nullptr;
+    child->data_size = 0;
+    child->overlay_data = nullptr;
+    child->overlay_capacity = 0;
+    child->parent = dir_node;
+    child->children_by_name = (type == vfs_node_type::directory)
+        ? new kstl::hashmap<kstl::string, cpio_node*>()
+        : nullptr;
+    child->refs.store(1, kstl::memory_order::relaxed); // Held by the tree
+
+    dir_node->children_by_name->insert(name, child);
+    dir_node->children.push_back(child);
+    return child;
+}
+
+bool cpio_filesystem::_copy_up(cpio_node* file_node, size_t size) {
+    if (file_node->overlay_data && size <= file_node->overlay_capacity) {
+        return true;
+    }
+
+    // Grow geometrically so that appending doesn't copy the whole file every time
+    size_t capacity = kstl::max(size, file_node->overlay_capacity * 2);
+    uint8_t* buffer = new uint8_t[capacity];
+    if (!buffer) {
+        return false;
+    }
+
+    if (file_node->data_size) {
+        memcpy(buffer, file_node->data, file_node->data_size);
+    }
+
+    delete[] file_node->overlay_data;
+    file_node->overlay_data = buffer;
+    file_node->overlay_capacity = capacity;
+    file_node->data = buffer;
+    return true;
+}
+
+void cpio_filesystem::_unlink_node(cpio_node* node) {
+    if (!node) {
+        return;
+    }
+
+    // A removed directory that is still open looks empty
+    for (cpio_node* child : node->children) {
+        node->children_by_name->remove(child->name);
+        _unlink_node(child);
+    }
+
+    node->children.clear();
+    node->parent = nullptr;
+    _put_node(node);
+}
+
+void cpio_filesystem::_put_node(cpio_node* node) {
+    if (node->refs.fetch_sub(1, kstl::memory_order::acq_rel) != 1) {
+        return;
+    }
+
+    delete node->children_by_name;
+    delete[] node->overlay_data;
+    delete node;
+}
+} // namespace fs
@@ -0,0 +1,251 @@
+#include <fs/dentry_cache.h>
+#include <rcu.h>
+
+namespace fs {
+bool dentry_cache::lookup(vfs_node* parent, const char* name, size_t length, kstl::shared_ptr<vfs_node>& out_node) {
+    uint64_t hash = _hash(parent, name, length);
+    rcu::read_guard guard;
+
+    dentry* entry = rcu::dereference(m_buckets[hash & (DENTRY_CACHE_BUCKETS - 1)]);
+    for (; entry; entry = rcu::dereference(entry->hash_next)) {
+        if (entry->hash == hash &&
+            entry->parent.get() == parent &&
+            entry->name.length() == length &&
+            memcmp(entry->name.data(), name, length) == 0) {
+            break;
+        }
+    }
+
+    if (!entry) {
+        m_misses.fetch_add(1, kstl::memory_order::relaxed);
+        return false;
+    }
+
+    m_hits.fetch_add(1, kstl::memory_order::relaxed);
+
+    // Keep recently resolved names away from the trimming end of the list,
+    // checked first so hot entries don't keep writing the shared cache line.
+    if (!kstl::atomic_load(&entry->referenced, kstl::memory_order::relaxed)) {
+        kstl::atomic_store(&entry->referenced, true, kstl::memory_order::relaxed);
+    }
+
+    // Entries are never modified once published, the
+    // grace period keeps this one alive while it's copied.
+    out_node = entry->node;
+    return true;
+}
+
+void dentry_cache::insert(
+    const kstl::shared_ptr<vfs_node>& parent,
+    const kstl::string& name,
+    const kstl::shared_ptr<vfs_node>& node,
+    uint64_t generation
+) {
+    uint64_t hash = _hash(parent.get(), name.data(), name.length());
+
+    dentry* entry = new dentry();
+    if (!entry) {
+        return;
+    }
+
+    entry->parent = parent;
+    entry->name = name;
+    entry->hash = hash;
+    entry->node = node;
+
+    bool stale = false;
+    dentry* retired = nullptr;
+    {
+        mutex_guard guard(m_lock);
+
+        // The name may have been created or removed while the filesystem was being asked
+        if (generation != m_generation.load(kstl::memory_order::relaxed)) {
+            stale = true;
+        } else {
+            // Replace an existing entry for the name, lookups may still be walking past it
+            dentry** link = _find_link(parent.get(), name.data(), name.length(), hash);
+            if (link) {
+                _retire(link);
+            }
+
+            dentry*& bucket = m_buckets[hash & (DENTRY_CACHE_BUCKETS - 1)];
+            entry->hash_next = bucket;
+            rcu::assign_pointer(bucket, entry);
+
+            _lru_push_front(entry);
+            ++m_count;
+
+            while (m_count > DENTRY_CACHE_MAX_ENTRIES && m_lru_tail) {
+                dentry* victim = m_lru_tail;
+
+                // Entries looked up since they were last considered get another round
+                if (kstl::atomic_load(&victim->referenced, kstl::memory_order::relaxed)) {
+                    kstl::atomic_store(&victim->referenced, false, kstl::memory_order::relaxed);
+                    _lru_unlink(victim);
+                    _lru_push_front(victim);
+                    continue;
+                }
+
+                _retire(_find_link(victim->parent.get(), victim->name.data(), victim->name.length(), victim->hash));
+                ++m_evictions;
+            }
+
+            if (m_retired_count >= DENTRY_CACHE_RETIRE_BATCH) {
+                retired = _take_retired();
+            }
+        }
+    }
+
+    // Never published, so no reader can have seen it
+    if (stale) {
+        delete entry;
+    }
+
+    _free_retired(retired);
+}
+
+void dentry_cache::invalidate(vfs_node* parent, const kstl::string& name) {
+    uint64_t hash = _hash(parent, name.data(), name.length());
+
+    dentry* retired = nullptr;
+    {
+        mutex_guard guard(m_lock);
+
+        m_generation.fetch_add(1, kstl::memory_order::release);
+
+        dentry** link = _find_link(parent, name.data(), name.length(), hash);
+        if (link) {
+            _retire(link);
+        }
+
+        if (m_retired_count >= DENTRY_CACHE_RETIRE_BATCH) {
+            retired = _take_retired();
+        }
+    }
+
+    _free_retired(retired);
+}
+
+void dentry_cache::flush() {
+    dentry* retired;
+    {
+        mutex_guard guard(m_lock);
+
+        m_generation.fetch_add(1, kstl::memory_order::release);
+
+        while (m_lru_head) {
+            dentry* entry = m_lru_head;
+            _retire(_find_link(entry->parent.get(), entry->name.data(), entry->name.length(), entry->hash));
+        }
+
+        retired = _take_retired();
+    }
+
+    // Freed right away, callers rely on the cached nodes being dropped on return
+    _free_retired(retired);
+}
+
+uint64_t dentry_cache::generation() {
+    return m_generation.load(kstl::memory_order::acquire);
+}
+
+void dentry_cache::get_stats(dentry_cache_stats& stats) {
+    mutex_guard guard(m_lock);
+
+    stats.entries = m_count;
+    stats.hits = m_hits.load(kstl::memory_order::relaxed);
+    stats.misses = m_misses.load(kstl::memory_order::relaxed);
+    stats.evictions = m_evictions;
+}
+
+uint64_t dentry_cache::_hash(vfs_node* parent, const char* name, size_t length) {
+    // FNV-1a over the name, seeded with the parent's address
+    uint64_t hash = 0xcbf29ce484222325ull ^ reinterpret_cast<uint64_t>(parent);
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<uint8_t>(name[i]);
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+dentry** dentry_cache::_find_link(vfs_node* parent, const char* name, size_t length, uint64_t hash) {
+    dentry** link = &m_buckets[hash & (DENTRY_CACHE_BUCKETS - 1)];
+    for (; *link; link = &(*link)->hash_next) {
+        dentry* entry = *link;
+        if (entry->hash == hash &&
+            entry->parent.get() == parent &&
+            entry->name.length() == length &&
+            memcmp(entry->name.data(), name, length) == 0) {
+            return link;
+        }
+    }
+
+    return nullptr;
+}
+
+void dentry_cache::_retire(dentry** link) {
+    dentry* entry = *link;
+
+    // Readers past this point keep following the entry's own
+    // hash_next, so it stays intact until the entry is freed.
+    rcu::assign_pointer(*link, entry->hash_next);
+    _lru_unlink(entry);
+    --m_count;
+
+    entry->lru_next = m_retired;
+    m_retired = entry;
+    ++m_retired_count;
+}
+
+dentry* dentry_cache::_take_retired() {
+    dentry* list = m_retired;
+    m_retired = nullptr;
+    m_retired_count = 0;
+    return list;
+}
+
+void dentry_cache::_free_retired(dentry* list) {
+    if (!list) {
+        return;
+    }
+
+    rcu::synchronize();
+
+    while (list) {
+        dentry* next = list->lru_next;
+        delete list;
+        list = next;
+    }
+}
+
+void dentry_cache::_lru_unlink(dentry* entry) {
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        m_lru_head = entry->lru_next;
+    }
+
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        m_lru_tail = entry->lru_prev;
+    }
+
+    entry->lru_prev = nullptr;
+    entry->lru_next = nullptr;
+}
+
+void dentry_cache::_lru_push_front(dentry* entry) {
+    entry->lru_prev = nullptr;
+    entry->lru_next = m_lru_head;
+
+    if (m_lru_head) {
+        m_lru_head->lru_prev = entry;
+    } else {
+        m_lru_tail = entry;
+    }
+
+    m_lru_head = entry;
+}
+} // namespace fs
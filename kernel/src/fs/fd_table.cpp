@@ -0,0 +1,155 @@
+#include <fs/fd_table.h>
+#include <fs/filesystem.h>
+#include <process/process.h>
+
+namespace fs {
+DECLARE_GLOBAL_OBJECT(fd_table, g_kernel_fd_table);
+
+ssize_t open_file::read(void* buffer, size_t size) {
+    mutex_guard guard(m_offset_lock);
+
+    ssize_t bytes_read = pread(buffer, size, m_offset);
+    if (bytes_read > 0) {
+        m_offset += bytes_read;
+    }
+
+    return bytes_read;
+}
+
+ssize_t open_file::write(const void* buffer, size_t size) {
+    mutex_guard guard(m_offset_lock);
+
+    if (m_flags & FS_O_APPEND) {
+        m_offset = m_node->stat.size;
+    }
+
+    ssize_t bytes_written = pwrite(buffer, size, m_offset);
+    if (bytes_written > 0) {
+        m_offset += bytes_written;
+    }
+
+    return bytes_written;
+}
+
+ssize_t open_file::pread(void* buffer, size_t size, uint64_t offset) {
+    if (!buffer) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    if ((m_flags & FS_O_ACCMODE) == FS_O_WRONLY) {
+        return make_error_code(fs_error::permission_denied);
+    }
+
+    if (m_node->stat.type != vfs_node_type::file) {
+        return make_error_code(fs_error::not_a_file);
+    }
+
+    if (!m_node->ops.read) {
+        return make_error_code(fs_error::unsupported_operation);
+    }
+
+    return m_node->ops.read(m_node.get(), buffer, size, offset);
+}
+
+ssize_t open_file::pwrite(const void* buffer, size_t size, uint64_t offset) {
+    if (!buffer) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    if ((m_flags & FS_O_ACCMODE) == FS_O_RDONLY) {
+        return make_error_code(fs_error::permission_denied);
+    }
+
+    if (m_node->stat.type != vfs_node_type::file) {
+        return make_error_code(fs_error::not_a_file);
+    }
+
+    if (!m_node->ops.write) {
+        return make_error_code(fs_error::unsupported_operation);
+    }
+
+    return m_node->ops.write(m_node.get(), buffer, size, offset);
+}
+
+ssize_t open_file::lseek(int64_t offset, int whence) {
+    mutex_guard guard(m_offset_lock);
+
+    int64_t base;
+    switch (whence) {
+    case FS_SEEK_SET: base = 0; break;
+    case FS_SEEK_CUR: base = static_cast<int64_t>(m_offset); break;
+    case FS_SEEK_END: base = static_cast<int64_t>(m_node->stat.size); break;
+    default: return make_error_code(fs_error::invalid_argument);
+    }
+
+    if (base + offset < 0) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    m_offset = static_cast<uint64_t>(base + offset);
+    return static_cast<ssize_t>(m_offset);
+}
+
+fd_table::~fd_table() {
+    close_all();
+}
+
+fd_table* fd_table::for_current_task() {
+    fd_table* table = current->fds;
+    return table ? table : &g_kernel_fd_table;
+}
+
+int fd_table::install(open_file* file) {
+    mutex_guard guard(m_lock);
+
+    for (int fd = FD_TABLE_FIRST_FD; fd < FD_TABLE_MAX_FDS; fd++) {
+        if (!m_files[fd]) {
+            m_files[fd] = file;
+            return fd;
+        }
+    }
+
+    return -1;
+}
+
+open_file* fd_table::get(int fd) {
+    if (fd < 0 || fd >= FD_TABLE_MAX_FDS) {
+        return nullptr;
+    }
+
+    mutex_guard guard(m_lock);
+
+    open_file* file = m_files[fd];
+    if (file) {
+        file->retain();
+    }
+
+    return file;
+}
+
+bool fd_table::close(int fd) {
+    if (fd < 0 || fd >= FD_TABLE_MAX_FDS) {
+        return false;
+    }
+
+    open_file* file = nullptr;
+    {
+        mutex_guard guard(m_lock);
+        file = m_files[fd];
+        m_files[fd] = nullptr;
+    }
+
+    if (!file) {
+        return false;
+    }
+
+    file->release();
+    return true;
+}
+
+void fd_table::close_all() {
+    for (int fd = 0; fd < FD_TABLE_MAX_FDS; fd++) {
+        close(fd);
+    }
+}
+} // namespace fs
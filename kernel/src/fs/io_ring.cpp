@@ -0,0 +1,332 @@
+#include <fs/io_ring.h>
+#include <fs/vfs.h>
+#include <memory/vmm.h>
+#include <memory/paging.h>
+#include <dynpriv/dynpriv.h>
+#include <sched/sched.h>
+
+namespace fs {
+struct io_ring_completion_wait {
+    io_ring*    ring;
+    uint32_t    min_complete;
+};
+
+io_ring* io_ring::create(uint32_t entries) {
+    if (entries == 0 || entries > IO_RING_MAX_ENTRIES || (entries & (entries - 1)) != 0) {
+        return nullptr;
+    }
+
+    auto ring = new io_ring();
+    if (!ring) {
+        return nullptr;
+    }
+
+    if (!ring->_init(entries)) {
+        delete ring;
+        return nullptr;
+    }
+
+    return ring;
+}
+
+io_ring::~io_ring() {
+    if (m_worker_exited.load(kstl::memory_order::acquire) == 0 && m_header) {
+        m_stopping.store(1, kstl::memory_order::release);
+        m_sq_queue.wake_all();
+
+        // The worker touches the ring until it flags that it's done
+        while (m_worker_exited.load(kstl::memory_order::acquire) == 0) {
+            sched::yield();
+        }
+    }
+
+    if (m_header) {
+        RUN_ELEVATED({
+            vmm::unmap_contiguous_virtual_pages(reinterpret_cast<uintptr_t>(m_header), m_page_count);
+        });
+    }
+}
+
+void io_ring::get_params(io_ring_params& params) const {
+    params.ring_addr = reinterpret_cast<uint64_t>(m_header);
+    params.ring_size = m_page_count * PAGE_SIZE;
+    params.sq_entries = m_header->sq_entries;
+    params.cq_entries = m_header->cq_entries;
+    params.sq_offset = m_header->sq_offset;
+    params.cq_offset = m_header->cq_offset;
+}
+
+io_sqe* io_ring::get_sqe() {
+    uint32_t head = m_header->sq_head.load(kstl::memory_order::acquire);
+    if (m_sq_pending - head >= m_header->sq_entries) {
+        return nullptr;
+    }
+
+    io_sqe* sqe = &m_sqes[m_sq_pending & (m_header->sq_entries - 1)];
+    zeromem(sqe, sizeof(io_sqe));
+    ++m_sq_pending;
+    return sqe;
+}
+
+uint32_t io_ring::submit() {
+    uint32_t tail = m_header->sq_tail.load(kstl::memory_order::relaxed);
+
+    // Publishing the tail makes the filled entries visible to the worker
+    m_header->sq_tail.store(m_sq_pending, kstl::memory_order::release);
+    return m_sq_pending - tail;
+}
+
+bool io_ring::pop_cqe(io_cqe& out_cqe) {
+    uint32_t head = m_header->cq_head.load(kstl::memory_order::relaxed);
+    if (head == m_header->cq_tail.load(kstl::memory_order::acquire)) {
+        return false;
+    }
+
+    out_cqe = m_cqes[head & (m_header->cq_entries - 1)];
+    m_header->cq_head.store(head + 1, kstl::memory_order::release);
+    return true;
+}
+
+uint32_t io_ring::enter(uint32_t min_complete, uint64_t timeout_ns) {
+    // Doorbell for new submissions, or for a worker blocked on a full completion queue
+    m_sq_queue.wake_all();
+
+    if (min_complete == 0) {
+        return _cq_ready();
+    }
+
+    io_ring_completion_wait wait = {
+        .ring = this,
+        .min_complete = kstl::min(min_complete, m_header->cq_entries)
+    };
+
+    sched::wait_queue* queue = &m_cq_queue;
+    sched::wait_event(&queue, 1, timeout_ns, _poll_completions, &wait);
+    return _cq_ready();
+}
+
+bool io_ring::_init(uint32_t entries) {
+    uint32_t cq_entries = entries * 2;
+    size_t sq_size = static_cast<size_t>(entries) * sizeof(io_sqe);
+    size_t cq_size = static_cast<size_t>(cq_entries) * sizeof(io_cqe);
+    size_t ring_size = IO_RING_HEADER_SIZE + sq_size + cq_size;
+    size_t page_count = (ring_size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    // Same as channels, user-accessible pages in the shared higher
+    // half are directly visible to the process that set up the ring.
+    void* ring_pages = nullptr;
+    RUN_ELEVATED({
+        ring_pages = vmm::alloc_virtual_pages(page_count, DEFAULT_UNPRIV_PAGE_FLAGS);
+    });
+
+    if (!ring_pages) {
+        return false;
+    }
+
+    zeromem(ring_pages, page_count * PAGE_SIZE);
+
+    m_header = reinterpret_cast<io_ring_header*>(ring_pages);
+    m_page_count = page_count;
+    m_header->sq_entries = entries;
+    m_header->cq_entries = cq_entries;
+    m_header->sq_offset = IO_RING_HEADER_SIZE;
+    m_header->cq_offset = static_cast<uint32_t>(IO_RING_HEADER_SIZE + sq_size);
+
+    m_sqes = reinterpret_cast<io_sqe*>(reinterpret_cast<uint8_t*>(ring_pages) + m_header->sq_offset);
+    m_cqes = reinterpret_cast<io_cqe*>(reinterpret_cast<uint8_t*>(ring_pages) + m_header->cq_offset);
+    m_fds = fd_table::for_current_task();
+    m_user_pml4 = reinterpret_cast<paging::page_table*>(current->mm_ctx.root_page_table);
+
+    task_control_block* worker = nullptr;
+    RUN_ELEVATED({
+        worker = sched::create_priv_kernel_task(_worker_entry, this);
+        if (worker) {
+            // Borrow the creator's address space, so user buffers in submissions resolve
+            worker->mm_ctx.root_page_table = current->mm_ctx.root_page_table;
+            sched::scheduler::get().add_task(worker);
+        }
+    });
+
+    if (!worker) {
+        // Nothing to wait for on teardown
+        m_worker_exited.store(1, kstl::memory_order::relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t io_ring::_cq_ready() const {
+    return m_header->cq_tail.load(kstl::memory_order::acquire) -
+           m_header->cq_head.load(kstl::memory_order::acquire);
+}
+
+bool io_ring::_cq_has_space() const {
+    return _cq_ready() < m_header->cq_entries;
+}
+
+void io_ring::_worker_entry(void* data) {
+    auto ring = reinterpret_cast<io_ring*>(data);
+    sched::wait_queue* queue = &ring->m_sq_queue;
+
+    while (true) {
+        sched::wait_event(&queue, 1, WAIT_FOREVER, _poll_work, ring);
+        if (ring->m_stopping.load(kstl::memory_order::acquire)) {
+            break;
+        }
+
+        ring->_process_submissions();
+    }
+
+    // The ring may be freed as soon as this is visible
+    ring->m_worker_exited.store(1, kstl::memory_order::release);
+    sched::exit_thread();
+}
+
+int64_t io_ring::_poll_work(void* data) {
+    auto ring = reinterpret_cast<io_ring*>(data);
+    if (ring->m_stopping.load(kstl::memory_order::acquire)) {
+        return 0;
+    }
+
+    io_ring_header* header = ring->m_header;
+    bool submitted = header->sq_tail.load(kstl::memory_order::acquire) != header->sq_head.load(kstl::memory_order::relaxed);
+    return (submitted && ring->_cq_has_space()) ? 0 : -1;
+}
+
+int64_t io_ring::_poll_completions(void* data) {
+    auto wait = reinterpret_cast<io_ring_completion_wait*>(data);
+    return wait->ring->_cq_ready() >= wait->min_complete ? 0 : -1;
+}
+
+void io_ring::_process_submissions() {
+    uint32_t head = m_header->sq_head.load(kstl::memory_order::relaxed);
+    uint32_t tail = m_header->sq_tail.load(kstl::memory_order::acquire);
+
+    // Never trust the submitter's tail to stay within the queue
+    if (tail - head > m_header->sq_entries) {
+        tail = head + m_header->sq_entries;
+    }
+
+    while (head != tail && _cq_has_space()) {
+        // The submitter may scribble over the entry once it's consumed, work on a copy
+        io_sqe sqe = m_sqes[head & (m_header->sq_entries - 1)];
+        m_header->sq_head.store(++head, kstl::memory_order::release);
+
+        int64_t result = m_chain_failed ? make_error_code(fs_error::canceled) : _execute(sqe);
+
+        // A failed entry cancels whatever is still linked after it
+        m_chain_failed = (sqe.flags & IO_SQE_LINK) && result < 0;
+
+        uint32_t cq_tail = m_header->cq_tail.load(kstl::memory_order::relaxed);
+        io_cqe* cqe = &m_cqes[cq_tail & (m_header->cq_entries - 1)];
+        cqe->user_data = sqe.user_data;
+        cqe->result = result;
+        m_header->cq_tail.store(cq_tail + 1, kstl::memory_order::release);
+
+        // Waiters may only need part of the batch
+        m_cq_queue.wake_all();
+    }
+}
+
+int64_t io_ring::_execute(const io_sqe& sqe) {
+    auto& vfs = virtual_filesystem::get();
+
+    switch (sqe.opcode) {
+    case IO_OP_NOP: {
+        return 0;
+    }
+    case IO_OP_READV: {
+        return _execute_rw(sqe, false);
+    }
+    case IO_OP_WRITEV: {
+        return _execute_rw(sqe, true);
+    }
+    case IO_OP_OPEN: {
+        if (!paging::is_user_string(sqe.addr, FS_MAX_PATH_LENGTH, m_user_pml4)) {
+            return make_error_code(fs_error::invalid_argument);
+        }
+
+        return vfs.open(reinterpret_cast<const char*>(sqe.addr), sqe.op_flags, sqe.len, m_fds);
+    }
+    case IO_OP_CLOSE: {
+        return m_fds->close(sqe.fd) ? 0 : make_error_code(fs_error::bad_descriptor);
+    }
+    case IO_OP_STAT: {
+        if (!paging::is_user_string(sqe.addr, FS_MAX_PATH_LENGTH, m_user_pml4) ||
+            !paging::is_user_range(sqe.addr2, sizeof(vfs_stat_struct), m_user_pml4)) {
+            return make_error_code(fs_error::invalid_argument);
+        }
+
+        vfs_stat_struct info;
+        fs_error result = vfs.stat(reinterpret_cast<const char*>(sqe.addr), info);
+        if (result != fs_error::success) {
+            return make_error_code(result);
+        }
+
+        memcpy(reinterpret_cast<void*>(sqe.addr2), &info, sizeof(vfs_stat_struct));
+        return 0;
+    }
+    default: {
+        return make_error_code(fs_error::unsupported_operation);
+    }
+    }
+}
+
+int64_t io_ring::_execute_rw(const io_sqe& sqe, bool write) {
+    if (!sqe.addr || sqe.len > IO_RING_MAX_IOVECS) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    // The worker is privileged, nothing the submitter points at can be trusted to be its own memory
+    if (sqe.len && !paging::is_user_range(sqe.addr, sqe.len * sizeof(io_iovec), m_user_pml4)) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    open_file* file = m_fds->get(sqe.fd);
+    if (!file) {
+        return make_error_code(fs_error::bad_descriptor);
+    }
+
+    const io_iovec* iovecs = reinterpret_cast<const io_iovec*>(sqe.addr);
+    int64_t transferred = 0;
+
+    for (uint32_t i = 0; i < sqe.len; i++) {
+        io_iovec iov = iovecs[i];
+        if (iov.length == 0) {
+            continue;
+        }
+
+        if (!paging::is_user_range(reinterpret_cast<uintptr_t>(iov.base), iov.length, m_user_pml4)) {
+            if (transferred == 0) {
+                transferred = make_error_code(fs_error::invalid_argument);
+            }
+            break;
+        }
+
+        ssize_t result;
+        if (sqe.offset == IO_RING_OFFSET_CURRENT) {
+            result = write ? file->write(iov.base, iov.length) : file->read(iov.base, iov.length);
+        } else {
+            uint64_t offset = sqe.offset + transferred;
+            result = write ? file->pwrite(iov.base, iov.length, offset) : file->pread(iov.base, iov.length, offset);
+        }
+
+        // Errors after a partial transfer are reported as the short count
+        if (result < 0) {
+            if (transferred == 0) {
+                transferred = result;
+            }
+            break;
+        }
+
+        transferred += result;
+        if (static_cast<size_t>(result) < iov.length) {
+            break;
+        }
+    }
+
+    file->release();
+    return transferred;
+}
+} // namespace fs
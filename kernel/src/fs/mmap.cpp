@@ -0,0 +1,521 @@
+#include <fs/mmap.h>
+#include <memory/paging.h>
+#include <memory/tlb.h>
+#include <dynpriv/dynpriv.h>
+#include <process/process.h>
+
+// Software bits of the page table entries, ignored by the MMU
+#define PTE_MMAP_COW        (1ULL << 9)     // Read-only until written, then copied
+#define PTE_MMAP_OWNED      (1ULL << 10)    // Page belongs to the mapping and is freed with it
+
+namespace fs {
+DECLARE_GLOBAL_OBJECT(mmap_table, g_kernel_mmap_table);
+
+/**
+ * @brief Looks up the entry of a 4KB page without allocating any page tables.
+ * @return The entry, or `nullptr` if a page table on the way is missing.
+ */
+__PRIVILEGED_CODE
+static paging::pte_t* _find_pte(paging::page_table* pml4, uintptr_t vaddr) {
+    paging::virt_addr_indices_t indices = paging::get_vaddr_page_table_indices(vaddr);
+    const uint16_t path[3] = { indices.pml4, indices.pdpt, indices.pdt };
+
+    auto table = reinterpret_cast<paging::page_table*>(paging::phys_to_virt_linear(pml4));
+    for (uint16_t index : path) {
+        paging::pte_t& entry = table->entries[index];
+        if (!entry.present) {
+            return nullptr;
+        }
+
+        table = reinterpret_cast<paging::page_table*>(
+            paging::phys_to_virt_linear(PFN_TO_ADDR(entry.page_frame_number))
+        );
+    }
+
+    return &table->entries[indices.pt];
+}
+
+mmap_table::~mmap_table() {
+    mutex_guard guard(m_lock);
+
+    while (m_regions) {
+        mmap_region* region = m_regions;
+        _writeback(region, 0, region->page_count);
+
+        RUN_ELEVATED({
+            spinlock_irqsave_guard region_guard(m_region_lock);
+            m_regions = region->next;
+            _unmap_pages(region, 0, region->page_count);
+        });
+
+        _finish_unmap();
+        region->file->release();
+        delete region;
+    }
+}
+
+mmap_table* mmap_table::for_current_task() {
+    mmap_table* table = current->mmaps;
+    return table ? table : &g_kernel_mmap_table;
+}
+
+fs_error mmap_table::map(open_file* file, uint64_t offset, size_t length, uint32_t prot, uint32_t flags, void*& out_addr) {
+    if (!file || length == 0 || offset % PAGE_SIZE != 0) {
+        return fs_error::invalid_argument;
+    }
+
+    if ((prot & ~(FS_PROT_READ | FS_PROT_WRITE | FS_PROT_EXEC)) ||
+        (flags != FS_MAP_SHARED && flags != FS_MAP_PRIVATE)) {
+        return fs_error::invalid_argument;
+    }
+
+    vfs_node* node = file->node();
+    if (node->stat.type != vfs_node_type::file) {
+        return fs_error::not_a_file;
+    }
+
+    // Every mapping reads the file, only shared writes have to be allowed to write it
+    uint32_t access = file->flags() & FS_O_ACCMODE;
+    if (access == FS_O_WRONLY) {
+        return fs_error::permission_denied;
+    }
+
+    if (flags == FS_MAP_SHARED && (prot & FS_PROT_WRITE) && access != FS_O_RDWR) {
+        return fs_error::permission_denied;
+    }
+
+    // Pages entirely past the end of the file have nothing to map
+    size_t page_count = PAGE_ALIGN_UP(length) / PAGE_SIZE;
+    if (offset + page_count * PAGE_SIZE > PAGE_ALIGN_UP(node->stat.size)) {
+        return fs_error::invalid_argument;
+    }
+
+    bool in_place = node->ops.get_page != nullptr;
+    if (!in_place && !node->ops.read) {
+        return fs_error::unsupported_operation;
+    }
+
+    mutex_guard guard(m_lock);
+
+    uintptr_t start = _find_free_range(page_count);
+    if (!start) {
+        return fs_error::no_space_left;
+    }
+
+    auto region = new mmap_region();
+    if (!region) {
+        return fs_error::no_space_left;
+    }
+
+    region->start = start;
+    region->page_count = page_count;
+    region->offset = offset;
+    region->prot = prot;
+    region->flags = flags;
+    region->file = file;
+    region->in_place = in_place;
+    file->retain();
+
+    fs_error result = _populate(region);
+    if (result != fs_error::success) {
+        file->release();
+        delete region;
+        return result;
+    }
+
+    // Keep the list sorted, finding free ranges depends on it
+    mmap_region** link = &m_regions;
+    while (*link && (*link)->start < start) {
+        link = &(*link)->next;
+    }
+
+    RUN_ELEVATED({
+        spinlock_irqsave_guard region_guard(m_region_lock);
+        region->next = *link;
+        *link = region;
+    });
+
+    out_addr = reinterpret_cast<void*>(start);
+    return fs_error::success;
+}
+
+fs_error mmap_table::unmap(void* addr, size_t length) {
+    uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+    if (start % PAGE_SIZE != 0 || length == 0) {
+        return fs_error::invalid_argument;
+    }
+
+    uintptr_t end = start + PAGE_ALIGN_UP(length);
+
+    mutex_guard guard(m_lock);
+
+    mmap_region** link = &m_regions;
+    while (*link) {
+        mmap_region* region = *link;
+        uintptr_t region_end = region->start + region->page_count * PAGE_SIZE;
+        if (region_end <= start || region->start >= end) {
+            link = &region->next;
+            continue;
+        }
+
+        uintptr_t first = kstl::max(start, region->start);
+        uintptr_t last = kstl::min(end, region_end);
+        size_t first_page = (first - region->start) / PAGE_SIZE;
+        size_t count = (last - first) / PAGE_SIZE;
+
+        // A hole in the middle leaves two regions behind, the second one needs its own
+        mmap_region* tail = nullptr;
+        if (first > region->start && last < region_end) {
+            tail = new mmap_region();
+            if (!tail) {
+                return fs_error::no_space_left;
+            }
+        }
+
+        // Shared copies are the only place their data lives until it's written back
+        _writeback(region, first_page, count);
+
+        mmap_region* removed = nullptr;
+        RUN_ELEVATED({
+            spinlock_irqsave_guard region_guard(m_region_lock);
+            removed = _cut_region(link, first, last, tail);
+        });
+
+        // No CPU may still reach the pages through its TLB once the file or the page is gone
+        _finish_unmap();
+
+        // Dropping the file may free it, which can't be done with interrupts disabled
+        if (removed) {
+            removed->file->release();
+            delete removed;
+        }
+    }
+
+    return fs_error::success;
+}
+
+fs_error mmap_table::sync(void* addr, size_t length) {
+    uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+    if (start % PAGE_SIZE != 0 || length == 0) {
+        return fs_error::invalid_argument;
+    }
+
+    uintptr_t end = start + PAGE_ALIGN_UP(length);
+
+    mutex_guard guard(m_lock);
+
+    fs_error status = fs_error::success;
+    for (mmap_region* region = m_regions; region && region->start < end; region = region->next) {
+        uintptr_t region_end = region->start + region->page_count * PAGE_SIZE;
+        if (region_end <= start) {
+            continue;
+        }
+
+        uintptr_t first = kstl::max(start, region->start);
+        uintptr_t last = kstl::min(end, region_end);
+
+        fs_error result = _writeback(region, (first - region->start) / PAGE_SIZE, (last - first) / PAGE_SIZE);
+        if (result != fs_error::success && status == fs_error::success) {
+            status = result;
+        }
+    }
+
+    return status;
+}
+
+__PRIVILEGED_CODE
+bool mmap_table::handle_write_fault(uintptr_t addr) {
+    // Never the mutex, the fault may have hit while it's held
+    spinlock_irqsave_guard guard(m_region_lock);
+
+    mmap_region* region = m_regions;
+    while (region && addr >= region->start + region->page_count * PAGE_SIZE) {
+        region = region->next;
+    }
+
+    if (!region || addr < region->start) {
+        return false;
+    }
+
+    if (region->flags != FS_MAP_PRIVATE || !(region->prot & FS_PROT_WRITE)) {
+        return false;
+    }
+
+    uintptr_t page_addr = PAGE_ALIGN_DOWN(addr);
+    paging::pte_t* pte = _find_pte(_pml4(), page_addr);
+    if (!pte || !pte->present) {
+        return false;
+    }
+
+    // Another fault on the same page may have copied it already
+    if (!(pte->value & PTE_MMAP_COW)) {
+        paging::invlpg(reinterpret_cast<void*>(page_addr));
+        return pte->read_write;
+    }
+
+    auto& physalloc = allocators::page_bitmap_allocator::get_physical_allocator();
+    void* copy = physalloc.alloc_page();
+    if (!copy) {
+        return false;
+    }
+
+    memcpy(
+        paging::phys_to_virt_linear(copy),
+        paging::phys_to_virt_linear(PFN_TO_ADDR(pte->page_frame_number)),
+        PAGE_SIZE
+    );
+
+    pte->value = (pte->value & ~PTE_MMAP_COW) | PTE_RW | PTE_MMAP_OWNED;
+    pte->page_frame_number = ADDR_TO_PFN(reinterpret_cast<uintptr_t>(copy));
+    paging::invlpg(reinterpret_cast<void*>(page_addr));
+    return true;
+}
+
+__PRIVILEGED_CODE
+mmap_region* mmap_table::_cut_region(mmap_region**& link, uintptr_t first, uintptr_t last, mmap_region* tail) {
+    mmap_region* region = *link;
+    uintptr_t region_end = region->start + region->page_count * PAGE_SIZE;
+    size_t first_page = (first - region->start) / PAGE_SIZE;
+    size_t count = (last - first) / PAGE_SIZE;
+
+    _unmap_pages(region, first_page, count);
+
+    if (first == region->start && last == region_end) {
+        *link = region->next;
+        return region;
+    }
+
+    if (tail) {
+        *tail = *region;
+        tail->start = last;
+        tail->page_count = (region_end - last) / PAGE_SIZE;
+        tail->offset = region->offset + (last - region->start);
+        tail->file->retain();
+
+        region->page_count = first_page;
+        region->next = tail;
+        link = &tail->next;
+        return nullptr;
+    }
+
+    if (first == region->start) {
+        region->offset += last - region->start;
+        region->start = last;
+    }
+
+    region->page_count -= count;
+    link = &region->next;
+    return nullptr;
+}
+
+__PRIVILEGED_CODE
+paging::page_table* mmap_table::_pml4() const {
+    return m_root_page_table ? reinterpret_cast<paging::page_table*>(m_root_page_table) : paging::get_pml4();
+}
+
+uintptr_t mmap_table::_find_free_range(size_t page_count) const {
+    uintptr_t size = page_count * PAGE_SIZE;
+    uintptr_t candidate = MMAP_REGION_BASE;
+
+    for (mmap_region* region = m_regions; region; region = region->next) {
+        if (candidate + size <= region->start) {
+            break;
+        }
+
+        candidate = kstl::max(candidate, region->start + region->page_count * PAGE_SIZE);
+    }
+
+    if (size > MMAP_REGION_END - candidate) {
+        return 0;
+    }
+
+    return candidate;
+}
+
+fs_error mmap_table::_populate(mmap_region* region) {
+    vfs_node* node = region->file->node();
+    bool writable = region->prot & FS_PROT_WRITE;
+
+    uint64_t flags = PTE_PRESENT | PTE_US;
+    if (!(region->prot & FS_PROT_EXEC)) {
+        flags |= PTE_NX;
+    }
+
+    fs_error status = fs_error::success;
+    size_t mapped = 0;
+
+    RUN_ELEVATED({
+        auto& physalloc = allocators::page_bitmap_allocator::get_physical_allocator();
+        paging::page_table* pml4 = _pml4();
+
+        for (mapped = 0; mapped < region->page_count; ++mapped) {
+            uint64_t page_index = region->offset / PAGE_SIZE + mapped;
+            uintptr_t paddr;
+            uint64_t page_flags = flags;
+
+            if (region->in_place) {
+                // Holes get filled, so later writes through the file land in the mapped page
+                void* page = node->ops.get_page(node, page_index, true);
+                if (!page) {
+                    status = fs_error::no_space_left;
+                    break;
+                }
+
+                paddr = paging::get_physical_address(page);
+
+                // Private writes get their own copy of the page on the first write
+                if (writable) {
+                    page_flags |= (region->flags == FS_MAP_SHARED) ? PTE_RW : PTE_MMAP_COW;
+                }
+            } else {
+                void* copy = physalloc.alloc_page();
+                if (!copy) {
+                    status = fs_error::no_space_left;
+                    break;
+                }
+
+                paddr = reinterpret_cast<uintptr_t>(copy);
+
+                // The tail of the file's last page reads back as zeros
+                uint8_t* data = static_cast<uint8_t*>(paging::phys_to_virt_linear(copy));
+                zeromem(data, PAGE_SIZE);
+
+                ssize_t result = region->file->pread(data, PAGE_SIZE, page_index * PAGE_SIZE);
+                if (result < 0) {
+                    physalloc.free_page(copy);
+                    status = static_cast<fs_error>(result);
+                    break;
+                }
+
+                page_flags |= PTE_MMAP_OWNED;
+                if (writable) {
+                    page_flags |= PTE_RW;
+                }
+            }
+
+            paging::map_page(region->start + mapped * PAGE_SIZE, paddr, page_flags, pml4);
+        }
+    });
+
+    if (status != fs_error::success) {
+        RUN_ELEVATED({
+            spinlock_irqsave_guard region_guard(m_region_lock);
+            _unmap_pages(region, 0, mapped);
+        });
+
+        _finish_unmap();
+    }
+
+    return status;
+}
+
+void mmap_table::_unmap_pages(mmap_region* region, size_t first, size_t count) {
+    RUN_ELEVATED({
+        auto& physalloc = allocators::page_bitmap_allocator::get_physical_allocator();
+        paging::page_table* pml4 = _pml4();
+        bool active = pml4 == paging::get_pml4();
+
+        // Kernel tasks on other CPUs share the kernel's table and may still have the pages cached
+        bool shared = !m_root_page_table;
+
+        for (size_t i = first; i < first + count; ++i) {
+            uintptr_t vaddr = region->start + i * PAGE_SIZE;
+            paging::pte_t* pte = _find_pte(pml4, vaddr);
+            if (!pte || !pte->present) {
+                continue;
+            }
+
+            if (pte->value & PTE_MMAP_OWNED) {
+                uintptr_t paddr = PFN_TO_ADDR(pte->page_frame_number);
+                if (shared) {
+                    // Chained through the pages themselves until _finish_unmap frees them
+                    *reinterpret_cast<uintptr_t*>(paging::phys_to_virt_linear(paddr)) = m_deferred_pages;
+                    m_deferred_pages = paddr;
+                } else {
+                    physalloc.free_page(reinterpret_cast<void*>(paddr));
+                }
+            }
+
+            m_needs_shootdown |= shared;
+
+            pte->value = 0;
+            if (active) {
+                paging::invlpg(reinterpret_cast<void*>(vaddr));
+            }
+        }
+    });
+}
+
+void mmap_table::_finish_unmap() {
+    RUN_ELEVATED({
+        uintptr_t pages = 0;
+        bool needs_shootdown = false;
+
+        {
+            spinlock_irqsave_guard region_guard(m_region_lock);
+            pages = m_deferred_pages;
+            needs_shootdown = m_needs_shootdown;
+            m_deferred_pages = 0;
+            m_needs_shootdown = false;
+        }
+
+        if (needs_shootdown) {
+            paging::tlb_shootdown();
+        }
+
+        auto& physalloc = allocators::page_bitmap_allocator::get_physical_allocator();
+        while (pages) {
+            uintptr_t next = *reinterpret_cast<uintptr_t*>(paging::phys_to_virt_linear(pages));
+            physalloc.free_page(reinterpret_cast<void*>(pages));
+            pages = next;
+        }
+    });
+}
+
+fs_error mmap_table::_writeback(mmap_region* region, size_t first, size_t count) {
+    if (region->in_place || region->flags != FS_MAP_SHARED || !(region->prot & FS_PROT_WRITE)) {
+        return fs_error::success;
+    }
+
+    uint64_t file_size = region->file->node()->stat.size;
+    fs_error status = fs_error::success;
+
+    RUN_ELEVATED({
+        paging::page_table* pml4 = _pml4();
+        bool active = pml4 == paging::get_pml4();
+
+        for (size_t i = first; i < first + count; ++i) {
+            uint64_t offset = region->offset + i * PAGE_SIZE;
+            if (offset >= file_size) {
+                break;
+            }
+
+            uintptr_t vaddr = region->start + i * PAGE_SIZE;
+            paging::pte_t* pte = _find_pte(pml4, vaddr);
+
+            // Only pages written since the last write-back have anything new
+            if (!pte || !pte->present || !pte->dirty) {
+                continue;
+            }
+
+            const void* data = paging::phys_to_virt_linear(PFN_TO_ADDR(pte->page_frame_number));
+            size_t size = static_cast<size_t>(kstl::min(static_cast<uint64_t>(PAGE_SIZE), file_size - offset));
+
+            ssize_t result = region->file->pwrite(data, size, offset);
+            if (result < 0) {
+                if (status == fs_error::success) {
+                    status = static_cast<fs_error>(result);
+                }
+                continue;
+            }
+
+            pte->dirty = 0;
+            if (active) {
+                paging::invlpg(reinterpret_cast<void*>(vaddr));
+            }
+        }
+    });
+
+    return status;
+}
+} // namespace fs
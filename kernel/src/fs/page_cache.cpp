@@ -0,0 +1,347 @@
+#include <fs/page_cache.h>
+#include <memory/vmm.h>
+#include <memory/paging.h>
+#include <dynpriv/dynpriv.h>
+
+namespace fs {
+DECLARE_GLOBAL_OBJECT(page_cache, g_page_cache);
+
+page_cache& page_cache::get() {
+    return g_page_cache;
+}
+
+ssize_t page_cache::read(page_cache_mapping* mapping, void* buffer, size_t size, uint64_t offset) {
+    if (!mapping || !buffer || !mapping->fill) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    if (offset >= mapping->size || size == 0) {
+        return 0;
+    }
+
+    size = static_cast<size_t>(kstl::min(static_cast<uint64_t>(size), mapping->size - offset));
+
+    uint64_t first = offset / PAGE_SIZE;
+    uint64_t last = (offset + size - 1) / PAGE_SIZE;
+
+    mutex_guard guard(m_lock);
+
+    // Fill the pages after this read before they are asked for
+    _readahead(mapping, first, last);
+
+    uint8_t* dst = static_cast<uint8_t*>(buffer);
+    size_t bytes_read = 0;
+    while (bytes_read < size) {
+        uint64_t pos = offset + bytes_read;
+        size_t page_offset = pos % PAGE_SIZE;
+        size_t chunk = kstl::min(size - bytes_read, PAGE_SIZE - page_offset);
+
+        page_cache_entry* entry;
+        fs_error result = _get_page(mapping, pos / PAGE_SIZE, true, entry);
+        if (result != fs_error::success) {
+            return bytes_read ? static_cast<ssize_t>(bytes_read) : make_error_code(result);
+        }
+
+        memcpy(dst + bytes_read, entry->data + page_offset, chunk);
+        bytes_read += chunk;
+    }
+
+    return static_cast<ssize_t>(bytes_read);
+}
+
+ssize_t page_cache::write(page_cache_mapping* mapping, const void* buffer, size_t size, uint64_t offset) {
+    if (!mapping || !buffer || !mapping->fill) {
+        return make_error_code(fs_error::invalid_argument);
+    }
+
+    if (size == 0) {
+        return 0;
+    }
+
+    // Mappings have a fixed size, there is nowhere to put data past it
+    if (offset >= mapping->size) {
+        return make_error_code(fs_error::no_space_left);
+    }
+
+    size = static_cast<size_t>(kstl::min(static_cast<uint64_t>(size), mapping->size - offset));
+
+    mutex_guard guard(m_lock);
+
+    const uint8_t* src = static_cast<const uint8_t*>(buffer);
+    size_t bytes_written = 0;
+    while (bytes_written < size) {
+        uint64_t pos = offset + bytes_written;
+        size_t page_offset = pos % PAGE_SIZE;
+        size_t chunk = kstl::min(size - bytes_written, PAGE_SIZE - page_offset);
+
+        // Pages that get overwritten up to the end of their data don't have to be read first
+        bool overwritten = page_offset == 0 && (chunk == PAGE_SIZE || pos + chunk >= mapping->size);
+
+        page_cache_entry* entry;
+        fs_error result = _get_page(mapping, pos / PAGE_SIZE, !overwritten, entry);
+        if (result != fs_error::success) {
+            return bytes_written ? static_cast<ssize_t>(bytes_written) : make_error_code(result);
+        }
+
+        memcpy(entry->data + page_offset, src + bytes_written, chunk);
+        if (!entry->dirty) {
+            entry->dirty = true;
+            ++m_dirty_pages;
+        }
+
+        bytes_written += chunk;
+    }
+
+    return static_cast<ssize_t>(bytes_written);
+}
+
+fs_error page_cache::sync(page_cache_mapping* mapping) {
+    mutex_guard guard(m_lock);
+
+    fs_error status = fs_error::success;
+    for (size_t i = 0; i < m_used_entries; ++i) {
+        page_cache_entry* entry = &m_entries[i];
+        if (!entry->mapping || !entry->dirty) {
+            continue;
+        }
+
+        if (mapping && entry->mapping != mapping) {
+            continue;
+        }
+
+        fs_error result = _writeback(entry);
+        if (result != fs_error::success && status == fs_error::success) {
+            status = result;
+        }
+    }
+
+    return status;
+}
+
+void page_cache::invalidate(page_cache_mapping* mapping) {
+    mutex_guard guard(m_lock);
+
+    for (size_t i = 0; i < m_used_entries; ++i) {
+        if (m_entries[i].mapping == mapping) {
+            _remove(&m_entries[i]);
+        }
+    }
+}
+
+void page_cache::get_stats(page_cache_stats& stats) {
+    mutex_guard guard(m_lock);
+
+    stats.pages = m_pages;
+    stats.dirty_pages = m_dirty_pages;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.readahead_pages = m_readahead_pages;
+    stats.evictions = m_evictions;
+    stats.writebacks = m_writebacks;
+}
+
+uint64_t page_cache::_hash(page_cache_mapping* mapping, uint64_t index) {
+    // Consecutive pages of a mapping land in consecutive buckets
+    uint64_t hash = reinterpret_cast<uint64_t>(mapping) * 0x9e3779b97f4a7c15ull;
+    return (hash >> 32) + index;
+}
+
+page_cache_entry* page_cache::_find(page_cache_mapping* mapping, uint64_t index) {
+    if (!m_buckets) {
+        return nullptr;
+    }
+
+    for (page_cache_entry* entry = m_buckets[_hash(mapping, index) & (PAGE_CACHE_BUCKETS - 1)]; entry; entry = entry->hash_next) {
+        if (entry->mapping == mapping && entry->index == index) {
+            return entry;
+        }
+    }
+
+    return nullptr;
+}
+
+fs_error page_cache::_get_page(page_cache_mapping* mapping, uint64_t index, bool fill, page_cache_entry*& out_entry) {
+    page_cache_entry* entry = _find(mapping, index);
+    if (entry) {
+        ++m_hits;
+        entry->referenced = true;
+        out_entry = entry;
+        return fs_error::success;
+    }
+
+    ++m_misses;
+
+    entry = _alloc_entry();
+    if (!entry) {
+        return fs_error::no_space_left;
+    }
+
+    if (fill) {
+        ssize_t result = mapping->fill(mapping, index, entry->data);
+        if (result < 0) {
+            // The entry was never linked, it stays free
+            return static_cast<fs_error>(result);
+        }
+    } else {
+        zeromem(entry->data, PAGE_SIZE);
+    }
+
+    entry->mapping = mapping;
+    entry->index = index;
+    entry->dirty = false;
+    entry->referenced = true;
+
+    page_cache_entry*& bucket = m_buckets[_hash(mapping, index) & (PAGE_CACHE_BUCKETS - 1)];
+    entry->hash_next = bucket;
+    bucket = entry;
+    ++m_pages;
+
+    out_entry = entry;
+    return fs_error::success;
+}
+
+page_cache_entry* page_cache::_alloc_entry() {
+    if (!m_entries) {
+        m_buckets = new page_cache_entry*[PAGE_CACHE_BUCKETS];
+        m_entries = new page_cache_entry[PAGE_CACHE_MAX_PAGES];
+        if (!m_buckets || !m_entries) {
+            delete[] m_buckets;
+            delete[] m_entries;
+            m_buckets = nullptr;
+            m_entries = nullptr;
+            return nullptr;
+        }
+
+        zeromem(m_buckets, sizeof(page_cache_entry*) * PAGE_CACHE_BUCKETS);
+        zeromem(m_entries, sizeof(page_cache_entry) * PAGE_CACHE_MAX_PAGES);
+    }
+
+    // Grow the cache until it is full before reclaiming anything
+    if (m_used_entries < PAGE_CACHE_MAX_PAGES) {
+        page_cache_entry* entry = &m_entries[m_used_entries];
+
+        void* page = nullptr;
+        RUN_ELEVATED({
+            page = vmm::alloc_virtual_page(DEFAULT_UNPRIV_PAGE_FLAGS);
+        });
+
+        if (page) {
+            entry->data = static_cast<uint8_t*>(page);
+            ++m_used_entries;
+            return entry;
+        }
+
+        // Out of memory, fall back to reclaiming whatever is already cached
+        if (m_used_entries == 0) {
+            return nullptr;
+        }
+    }
+
+    // The first pass clears every reference bit, so two passes always find
+    // a victim unless write-backs keep failing.
+    for (size_t i = 0; i < 2 * m_used_entries; ++i) {
+        page_cache_entry* entry = &m_entries[m_clock_hand];
+        m_clock_hand = (m_clock_hand + 1) % m_used_entries;
+
+        if (!entry->mapping) {
+            return entry;
+        }
+
+        if (entry->referenced) {
+            entry->referenced = false;
+            continue;
+        }
+
+        if (entry->dirty && _writeback(entry) != fs_error::success) {
+            continue;
+        }
+
+        _remove(entry);
+        ++m_evictions;
+        return entry;
+    }
+
+    return nullptr;
+}
+
+fs_error page_cache::_writeback(page_cache_entry* entry) {
+    page_cache_mapping* mapping = entry->mapping;
+    if (!mapping->writeback) {
+        return fs_error::unsupported_operation;
+    }
+
+    ssize_t result = mapping->writeback(mapping, entry->index, entry->data);
+    if (result < 0) {
+        return static_cast<fs_error>(result);
+    }
+
+    entry->dirty = false;
+    --m_dirty_pages;
+    ++m_writebacks;
+    return fs_error::success;
+}
+
+void page_cache::_remove(page_cache_entry* entry) {
+    page_cache_entry** link = &m_buckets[_hash(entry->mapping, entry->index) & (PAGE_CACHE_BUCKETS - 1)];
+    while (*link != entry) {
+        link = &(*link)->hash_next;
+    }
+
+    *link = entry->hash_next;
+
+    if (entry->dirty) {
+        --m_dirty_pages;
+    }
+
+    // The data page stays with the entry for its next use
+    entry->mapping = nullptr;
+    entry->hash_next = nullptr;
+    entry->dirty = false;
+    entry->referenced = false;
+    --m_pages;
+}
+
+void page_cache::_readahead(page_cache_mapping* mapping, uint64_t first, uint64_t last) {
+    // Continuing within or right after the previous read's last page counts as sequential
+    bool sequential = first == mapping->ra_last_index || first == mapping->ra_last_index + 1;
+    mapping->ra_last_index = last;
+
+    if (!sequential) {
+        mapping->ra_window = 0;
+        mapping->ra_end = 0;
+        return;
+    }
+
+    mapping->ra_window = mapping->ra_window
+        ? kstl::min(mapping->ra_window * 2, static_cast<size_t>(PAGE_CACHE_READAHEAD_MAX))
+        : PAGE_CACHE_READAHEAD_MIN;
+
+    // Only refill once the reader has eaten into the second half of the window
+    if (mapping->ra_end > last + 1 + mapping->ra_window / 2) {
+        return;
+    }
+
+    uint64_t page_count = (mapping->size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t start = kstl::max(mapping->ra_end, last + 1);
+    uint64_t end = kstl::min(last + 1 + mapping->ra_window, page_count);
+
+    uint64_t index;
+    for (index = start; index < end; ++index) {
+        if (_find(mapping, index)) {
+            continue;
+        }
+
+        page_cache_entry* entry;
+        if (_get_page(mapping, index, true, entry) != fs_error::success) {
+            break;
+        }
+
+        // Not counted as an access, unused read-ahead is the first to be reclaimed
+        --m_misses;
+        ++m_readahead_pages;
+        entry->referenced = false;
+    }
+
+    mapping->ra_end = index;
+}
+} // namespace fs
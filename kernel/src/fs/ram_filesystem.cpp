@@ -1,6 +1,10 @@
 #include <fs/ram_filesystem.h>
 #include <time/time.h>
 #include <serial/serial.h>
+#include <memory/vmm.h>
+#include <memory/paging.h>
+#include <dynpriv/dynpriv.h>
+#include <rcu.h>
 
 namespace fs {
 kstl::shared_ptr<vfs_node> ram_filesystem::create_root_node() {
@@ -18,8 +22,9 @@ kstl::shared_ptr<vfs_node> ram_filesystem::create_root_node() {
     auto root_ram_node = new ramfs_node();
     root_ram_node->name = "/";
     root_ram_node->type = vfs_node_type::directory;
+    root_ram_node->refs.store(1, kstl::memory_order::relaxed);
 
-    // Link the VFS node with the RAM node
+    // Link the VFS node with the RAM node, the root is only referred to by it
     m_root->_private = root_ram_node;
 
     return m_root;
@@ -28,9 +33,10 @@ kstl::shared_ptr<vfs_node> ram_filesystem::create_root_node() {
 void ram_filesystem::unmount() {
     mutex_guard guard(m_fs_lock);
 
-    // Cleanup all resources
+    // Cleanup all resources, nodes that are still open get freed once they are closed
+    // and the root goes with the root VFS node.
     auto root_ram_node = static_cast<ramfs_node*>(m_root->_private);
-    _delete_ram_directory(root_ram_node);
+    _unlink_children(root_ram_node);
 }
 
 void ram_filesystem::set_ops(kstl::shared_ptr<vfs_node>& node, const kstl::string& path) {
@@ -42,7 +48,9 @@ void ram_filesystem::set_ops(kstl::shared_ptr<vfs_node>& node, const kstl::strin
         .lookup = &ramfs_lookup,
         .create = nullptr,
         .remove = &ramfs_remove,
-        .listdir = nullptr
+        .listdir = nullptr,
+        .get_page = &ramfs_get_page,
+        .release = &ramfs_release
     };
 
     // Directory-specific rules
@@ -51,13 +59,11 @@ void ram_filesystem::set_ops(kstl::shared_ptr<vfs_node>& node, const kstl::strin
         node->ops.write = nullptr;
         node->ops.create = &ramfs_create;
         node->ops.listdir = &ramfs_listdir;
+        node->ops.get_page = nullptr;
     }
 }
 
 ssize_t ram_filesystem::ramfs_read(vfs_node* node, void* buffer, size_t size, uint64_t offset) {
-    auto fs = static_cast<ram_filesystem*>(node->fs);
-    mutex_guard guard(fs->m_fs_lock);
-
     // Validate the input node and buffer
     if (!node || !buffer) {
         return make_error_code(fs_error::invalid_argument);
@@ -68,23 +74,44 @@ ssize_t ram_filesystem::ramfs_read(vfs_node* node, void* buffer, size_t size, ui
         return make_error_code(fs_error::not_a_file);
     }
 
+    // Readers don't take the node's lock, the page list
+    // they picked up stays valid until they are done.
+    rcu::read_guard rcu_guard;
+
+    // Every page below the published size is in the page list by now
+    size_t data_size = ram_node->data_size.load(kstl::memory_order::acquire);
+
     // Calculate the readable size
-    if (offset >= ram_node->data_size) {
+    if (offset >= data_size) {
         return 0; // Offset out of bounds
     }
 
     // Update the last access timestamp
-    ram_node->access_ts = kernel_timer::get_system_time_in_milliseconds();
+    kstl::atomic_store(&ram_node->access_ts, kernel_timer::get_system_time_in_milliseconds(), kstl::memory_order::relaxed);
+
+    size_t readable = kstl::min(size, data_size - offset);
+    uint8_t* dest = static_cast<uint8_t*>(buffer);
+
+    // Copy page by page, holes read back as zeros
+    for (size_t copied = 0; copied < readable; ) {
+        uint64_t position = offset + copied;
+        size_t page_offset = position % PAGE_SIZE;
+        size_t chunk = kstl::min(readable - copied, PAGE_SIZE - page_offset);
+
+        uint8_t* page = _get_file_page(ram_node, position / PAGE_SIZE, false);
+        if (page) {
+            memcpy(dest + copied, page + page_offset, chunk);
+        } else {
+            zeromem(dest + copied, chunk);
+        }
+
+        copied += chunk;
+    }
 
-    size_t readable = kstl::min(size, ram_node->data_size - offset);
-    memcpy(buffer, ram_node->data + offset, readable);
     return readable;
 }
 
 ssize_t ram_filesystem::ramfs_write(vfs_node* node, const void* buffer, size_t size, uint64_t offset) {
-    auto fs = static_cast<ram_filesystem*>(node->fs);
-    mutex_guard guard(fs->m_fs_lock);
-
     // Validate the input node and buffer
     if (!node || !buffer) {
         return make_error_code(fs_error::invalid_argument);
@@ -97,61 +124,122 @@ ssize_t ram_filesystem::ramfs_write(vfs_node* node, const void* buffer, size_t s
         return make_error_code(fs_error::not_a_file);
     }
 
-    // Resize the data buffer if necessary
-    size_t required_size = offset + size;
-    if (required_size > ram_node->data_size) {
-        uint8_t* new_data = new uint8_t[required_size];
-        if (ram_node->data) {
-            memcpy(new_data, ram_node->data, ram_node->data_size); // Copy existing data
-            delete[] ram_node->data; // Free old buffer
-        }
-        ram_node->data = new_data;
-        ram_node->data_size = required_size;
+    if (size == 0) {
+        return 0;
     }
 
-    // Update the last access and modification timestamps
-    ram_node->access_ts = kernel_timer::get_system_time_in_milliseconds();
-    ram_node->modification_ts = ram_node->access_ts;
+    uint8_t** old_pages = nullptr;
+    size_t written = 0;
+    {
+        rwlock_write_guard guard(ram_node->lock);
+
+        // Only the page list grows with the file, existing data is never moved
+        size_t required_size = offset + size;
+        if (!_reserve_page_slots(ram_node, (required_size + PAGE_SIZE - 1) / PAGE_SIZE, old_pages)) {
+            return make_error_code(fs_error::no_space_left);
+        }
+
+        // Write the data page by page, filling holes as they get written to
+        const uint8_t* src = static_cast<const uint8_t*>(buffer);
+        while (written < size) {
+            uint64_t position = offset + written;
+            size_t page_offset = position % PAGE_SIZE;
+            size_t chunk = kstl::min(size - written, PAGE_SIZE - page_offset);
+
+            uint8_t* page = _get_file_page(ram_node, position / PAGE_SIZE, true);
+            if (!page) {
+                break;
+            }
+
+            memcpy(page + page_offset, src + written, chunk);
+            written += chunk;
+        }
+
+        if (written > 0) {
+            // Publishing the new size makes the written pages visible to lock-free readers
+            size_t data_size = ram_node->data_size.load(kstl::memory_order::relaxed);
+            if (offset + written > data_size) {
+                data_size = offset + written;
+                ram_node->data_size.store(data_size, kstl::memory_order::release);
+            }
+
+            // Update the last access and modification timestamps
+            ram_node->access_ts = kernel_timer::get_system_time_in_milliseconds();
+            ram_node->modification_ts = ram_node->access_ts;
 
-    // Write the data into the file's data buffer
-    memcpy(ram_node->data + offset, buffer, size);
+            // Update the size in the VFS node to match the RAM node
+            node->stat.size = data_size;
+        }
+    }
 
-    // Update the size in the VFS node to match the RAM node
-    node->stat.size = ram_node->data_size;
+    // Other writers don't have to wait for the grace period
+    _retire_page_list(old_pages);
+
+    if (written == 0) {
+        return make_error_code(fs_error::no_space_left);
+    }
 
     // Return the number of bytes written
-    return size;
+    return written;
 }
 
-kstl::shared_ptr<vfs_node> ram_filesystem::ramfs_lookup(vfs_node* parent, const char* name) {
-    auto fs = static_cast<ram_filesystem*>(parent->fs);
-    mutex_guard guard(fs->m_fs_lock);
+void* ram_filesystem::ramfs_get_page(vfs_node* node, uint64_t page_index, bool allocate) {
+    auto ram_node = static_cast<ramfs_node*>(node->_private);
+    if (ram_node->type != vfs_node_type::file) {
+        return nullptr;
+    }
+
+    // Pages stay allocated for the lifetime of the file, only the list holding them moves
+    if (!allocate) {
+        rcu::read_guard rcu_guard;
+        return _get_file_page(ram_node, page_index, false);
+    }
 
+    uint8_t** old_pages = nullptr;
+    uint8_t* page = nullptr;
+    {
+        rwlock_write_guard guard(ram_node->lock);
+        if (_reserve_page_slots(ram_node, page_index + 1, old_pages)) {
+            page = _get_file_page(ram_node, page_index, true);
+        }
+    }
+
+    // Waited for without the lock, callers like mmap may be holding locks of their own
+    _retire_page_list(old_pages);
+    return page;
+}
+
+kstl::shared_ptr<vfs_node> ram_filesystem::ramfs_lookup(vfs_node* parent, const char* name) {
     auto ram_node = static_cast<ramfs_node*>(parent->_private);
     if (ram_node->type != vfs_node_type::directory) {
         return vfs_null_node; // Not a directory
     }
 
-    for (ramfs_direntry* entry : ram_node->children) {
-        if (entry->name == name) {
-            // Create and return the virtual filesystem node
-            auto vnode = kstl::make_shared<vfs_node>();
-            vnode->stat.type = entry->node->type;
-            vnode->stat.size = entry->node->data_size;
-            vnode->stat.perms = entry->node->permissions;
-            vnode->stat.creation_ts = entry->node->creation_ts;
-            vnode->stat.modification_ts = entry->node->modification_ts;
-            vnode->stat.access_ts = entry->node->access_ts;
-            vnode->_private = entry->node;
+    // Lookups only share the directory's lock, they don't block each other
+    rwlock_read_guard guard(ram_node->lock);
 
-#if 0
-            serial::printf("ramfs> lookup for '%s' resolved to a ram node: 0x%llx\n", name, entry->node);
-#endif
-            return vnode;
-        }
+    ramfs_direntry* entry = _find_child(ram_node, name, strlen(name));
+    if (!entry) {
+        return vfs_null_node; // Not found
     }
 
-    return vfs_null_node; // Not found
+    // Create and return the virtual filesystem node
+    auto vnode = kstl::make_shared<vfs_node>();
+    vnode->stat.type = entry->node->type;
+    vnode->stat.size = entry->node->data_size.load(kstl::memory_order::acquire);
+    vnode->stat.perms = entry->node->permissions;
+    vnode->stat.creation_ts = entry->node->creation_ts;
+    vnode->stat.modification_ts = entry->node->modification_ts;
+    vnode->stat.access_ts = entry->node->access_ts;
+
+    // The entry's reference keeps the node alive while the directory is locked
+    entry->node->refs.fetch_add(1, kstl::memory_order::relaxed);
+    vnode->_private = entry->node;
+
+#if 0
+    serial::printf("ramfs> lookup for '%s' resolved to a ram node: 0x%llx\n", name, entry->node);
+#endif
+    return vnode;
 }
 
 int ram_filesystem::ramfs_create(
@@ -160,9 +248,6 @@ int ram_filesystem::ramfs_create(
     vfs_node_type type,
     uint32_t perms
 ) {
-    auto fs = static_cast<ram_filesystem*>(parent->fs);
-    mutex_guard guard(fs->m_fs_lock);
-
     auto ram_node = static_cast<ramfs_node*>(parent->_private);
     if (ram_node->type != vfs_node_type::directory) {
         return -1; // Not a directory
@@ -175,8 +260,12 @@ int ram_filesystem::ramfs_create(
     new_node->creation_ts = kernel_timer::get_system_time_in_milliseconds();
     new_node->modification_ts = new_node->creation_ts;
     new_node->access_ts = new_node->creation_ts;
-    new_node->data = nullptr;
-    new_node->data_size = 0;
+    new_node->pages = nullptr;
+    new_node->page_slots = 0;
+    new_node->data_size.store(0, kstl::memory_order::relaxed);
+    new_node->child_table = nullptr;
+    new_node->child_table_size = 0;
+    new_node->refs.store(1, kstl::memory_order::relaxed); // Held by the directory entry
 
 #if 0
     serial::printf("ramfs> created a new ram node '%s' (0x%llx)\n", name, new_node);
@@ -185,10 +274,19 @@ int ram_filesystem::ramfs_create(
     // Create a new directory entry
     auto new_direntry = new ramfs_direntry();
     new_direntry->name = name;
+    new_direntry->hash = _hash_name(name, new_direntry->name.length());
     new_direntry->node = new_node;
 
+    // Only linking the new node into the parent is a namespace change
+    rwlock_write_guard guard(ram_node->lock);
+
     // Add the directory entry to the parent ram node
-    ram_node->children.push_back(new_direntry);
+    if (!_insert_child(ram_node, new_direntry)) {
+        delete new_direntry;
+        delete new_node;
+        return make_error_code(fs_error::no_space_left);
+    }
+
     return 0; // Success
 }
 
@@ -198,9 +296,6 @@ int ram_filesystem::ramfs_remove(vfs_node* parent, vfs_node* node) {
         return make_error_code(fs_error::invalid_argument);
     }
 
-    auto fs = static_cast<ram_filesystem*>(node->fs);
-    mutex_guard guard(fs->m_fs_lock);
-
     auto parent_ram_node = static_cast<ramfs_node*>(parent->_private);
     auto target_ram_node = static_cast<ramfs_node*>(node->_private);
 
@@ -209,10 +304,49 @@ int ram_filesystem::ramfs_remove(vfs_node* parent, vfs_node* node) {
         return make_error_code(fs_error::not_directory);
     }
 
-    // Find the target node in the parent's children
+    ramfs_direntry* direntry = _unlink_child(parent_ram_node, target_ram_node);
+    if (!direntry) {
+        return make_error_code(fs_error::not_found); // Node not found in parent's children
+    }
+
+    // The target's contents go with it
+    if (target_ram_node->type == vfs_node_type::directory) {
+        _unlink_children(target_ram_node);
+    }
+
+    // Drop the entry's reference, open descriptors and mappings keep the node
+    // alive, and readers of the file's data hold one through their VFS node.
+    delete direntry;
+    _put_node(target_ram_node);
+
+    return make_error_code(fs_error::success);
+}
+
+ramfs_direntry* ram_filesystem::_unlink_child(ramfs_node* parent_ram_node, ramfs_node* target_ram_node) {
+    rwlock_write_guard guard(parent_ram_node->lock);
+
+    // The entry is found through the target's name, the node comparison
+    // tells apart entries that happen to share a name.
+    ramfs_direntry* direntry = nullptr;
+    size_t mask = parent_ram_node->child_table_size - 1;
+    uint64_t hash = _hash_name(target_ram_node->name.c_str(), target_ram_node->name.length());
+
+    for (size_t slot = hash & mask; parent_ram_node->child_table && parent_ram_node->child_table[slot]; slot = (slot + 1) & mask) {
+        if (parent_ram_node->child_table[slot]->node == target_ram_node) {
+            direntry = parent_ram_node->child_table[slot];
+            break;
+        }
+    }
+
+    if (!direntry) {
+        return nullptr;
+    }
+
+    _erase_child_slot(parent_ram_node, direntry);
+
+    // Only the listing order needs the vector, finding the entry in it is a pointer comparison per child
     for (size_t i = 0; i < parent_ram_node->children.size(); ++i) {
-        auto direntry = parent_ram_node->children[i];
-        if (direntry->node != target_ram_node) {
+        if (parent_ram_node->children[i] != direntry) {
             continue;
         }
 
@@ -226,22 +360,10 @@ int ram_filesystem::ramfs_remove(vfs_node* parent, vfs_node* node) {
 
         // Remove the directory entry from the parent's children
         parent_ram_node->children.erase(i);
-
-        // Recursively delete the target node
-        if (target_ram_node->type == vfs_node_type::directory) {
-            _delete_ram_directory(target_ram_node);
-        } else {
-            _delete_ram_file(target_ram_node);
-        }
-
-        // Delete the directory entry itself
-        delete direntry;
-
-        return make_error_code(fs_error::success);
+        break;
     }
 
-
-    return make_error_code(fs_error::not_found); // Node not found in parent's children
+    return direntry;
 }
 
 int ram_filesystem::ramfs_listdir(vfs_node* node, kstl::vector<kstl::string>& entries) {
@@ -249,9 +371,6 @@ int ram_filesystem::ramfs_listdir(vfs_node* node, kstl::vector<kstl::string>& en
         return make_error_code(fs_error::invalid_argument);
     }
 
-    auto fs = static_cast<ram_filesystem*>(node->fs);
-    mutex_guard guard(fs->m_fs_lock);
-
     auto ram_node = static_cast<ramfs_node*>(node->_private);
 
     // Ensure the node is a directory
@@ -259,6 +378,8 @@ int ram_filesystem::ramfs_listdir(vfs_node* node, kstl::vector<kstl::string>& en
         return make_error_code(fs_error::not_directory);
     }
 
+    rwlock_read_guard guard(ram_node->lock);
+
     // Populate the entries with the names of the children
     for (ramfs_direntry* entry : ram_node->children) {
         entries.push_back(entry->name);
@@ -267,6 +388,40 @@ int ram_filesystem::ramfs_listdir(vfs_node* node, kstl::vector<kstl::string>& en
     return make_error_code(fs_error::success);
 }
 
+void ram_filesystem::ramfs_release(vfs_node* node) {
+    _put_node(static_cast<ramfs_node*>(node->_private));
+}
+
+void ram_filesystem::_unlink_children(ramfs_node* dir_node) {
+    rwlock_write_guard guard(dir_node->lock);
+
+    for (ramfs_direntry* direntry : dir_node->children) {
+        ramfs_node* child = direntry->node;
+        if (child->type == vfs_node_type::directory) {
+            _unlink_children(child);
+        }
+
+        delete direntry;
+        _put_node(child);
+    }
+
+    dir_node->children.clear();
+    if (dir_node->child_table) {
+        zeromem(dir_node->child_table, dir_node->child_table_size * sizeof(ramfs_direntry*));
+    }
+}
+
+void ram_filesystem::_put_node(ramfs_node* node) {
+    if (node->refs.fetch_sub(1, kstl::memory_order::acq_rel) != 1) {
+        return;
+    }
+
+    if (node->type == vfs_node_type::directory) {
+        _delete_ram_directory(node);
+    } else {
+        _delete_ram_file(node);
+    }
+}
 
 void ram_filesystem::_delete_ram_file(ramfs_node* file_node) {
     if (!file_node || file_node->type != vfs_node_type::file) {
@@ -278,12 +433,92 @@ void ram_filesystem::_delete_ram_file(ramfs_node* file_node) {
 #endif
 
     // Free the file data and delete the node
-    delete[] file_node->data;
-    file_node->data = nullptr;
-    file_node->data_size = 0;
+    for (size_t i = 0; i < file_node->page_slots; ++i) {
+        uint8_t* page = file_node->pages[i];
+        if (page) {
+            RUN_ELEVATED({
+                vmm::unmap_virtual_page(reinterpret_cast<uintptr_t>(page));
+            });
+        }
+    }
+
+    delete[] file_node->pages;
+    file_node->pages = nullptr;
+    file_node->page_slots = 0;
+    file_node->data_size.store(0, kstl::memory_order::relaxed);
     delete file_node;
 }
 
+uint8_t* ram_filesystem::_get_file_page(ramfs_node* file_node, size_t page_index, bool allocate) {
+    // The capacity is published after the list it belongs to, so it's read first
+    size_t page_slots = kstl::atomic_load(&file_node->page_slots, kstl::memory_order::acquire);
+    uint8_t** pages = rcu::dereference(file_node->pages);
+    if (!pages || page_index >= page_slots) {
+        return nullptr;
+    }
+
+    uint8_t* page = rcu::dereference(pages[page_index]);
+    if (page || !allocate) {
+        return page;
+    }
+
+    // Pages are mapped user-accessible in the shared higher half, so they can be
+    // read without elevating and handed out for mapping without copying them.
+    RUN_ELEVATED({
+        page = static_cast<uint8_t*>(vmm::alloc_virtual_page(DEFAULT_UNPRIV_PAGE_FLAGS));
+    });
+
+    if (!page) {
+        return nullptr;
+    }
+
+    zeromem(page, PAGE_SIZE);
+    rcu::assign_pointer(pages[page_index], page);
+    return page;
+}
+
+bool ram_filesystem::_reserve_page_slots(ramfs_node* file_node, size_t page_count, uint8_t**& out_old_pages) {
+    out_old_pages = nullptr;
+    if (page_count <= file_node->page_slots) {
+        return true;
+    }
+
+    // Grow geometrically, appending to a file only copies the list of page pointers now and then
+    size_t new_slots = file_node->page_slots ? file_node->page_slots : 8;
+    while (new_slots < page_count) {
+        new_slots *= 2;
+    }
+
+    uint8_t** new_pages = new uint8_t*[new_slots];
+    if (!new_pages) {
+        return false;
+    }
+
+    uint8_t** old_pages = file_node->pages;
+    if (old_pages) {
+        memcpy(new_pages, old_pages, file_node->page_slots * sizeof(uint8_t*));
+    }
+
+    zeromem(new_pages + file_node->page_slots, (new_slots - file_node->page_slots) * sizeof(uint8_t*));
+
+    // The list only ever grows, so a reader pairing the new list with the old capacity is safe
+    rcu::assign_pointer(file_node->pages, new_pages);
+    kstl::atomic_store(&file_node->page_slots, new_slots, kstl::memory_order::release);
+
+    // Lock-free readers may still be walking the old list, the caller frees it after a grace period
+    out_old_pages = old_pages;
+    return true;
+}
+
+void ram_filesystem::_retire_page_list(uint8_t** old_pages) {
+    if (!old_pages) {
+        return;
+    }
+
+    rcu::synchronize();
+    delete[] old_pages;
+}
+
 void ram_filesystem::_delete_ram_directory(ramfs_node* dir_node) {
     if (!dir_node || dir_node->type != vfs_node_type::directory) {
         return; // Not a valid directory node
@@ -293,20 +528,112 @@ void ram_filesystem::_delete_ram_directory(ramfs_node* dir_node) {
     serial::printf("ramfs> deleting directory '%s'\n", dir_node->name.c_str());
 #endif
 
-    // Recursively delete each child
-    for (ramfs_direntry* direntry : dir_node->children) {
-        if (direntry->node->type == vfs_node_type::directory) {
-            _delete_ram_directory(direntry->node);
-        } else {
-            _delete_ram_file(direntry->node);
+    // Children left over from a directory that was never unlinked, like the root's
+    _unlink_children(dir_node);
+
+    // Delete the directory itself
+    delete[] dir_node->child_table;
+    dir_node->child_table = nullptr;
+    dir_node->child_table_size = 0;
+    delete dir_node;
+}
+
+uint64_t ram_filesystem::_hash_name(const char* name, size_t length) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<uint8_t>(name[i]);
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+ramfs_direntry* ram_filesystem::_find_child(ramfs_node* dir_node, const char* name, size_t length) {
+    if (!dir_node->child_table) {
+        return nullptr;
+    }
+
+    uint64_t hash = _hash_name(name, length);
+    size_t mask = dir_node->child_table_size - 1;
+
+    // The table always has free slots, so every probe sequence ends
+    for (size_t slot = hash & mask; dir_node->child_table[slot]; slot = (slot + 1) & mask) {
+        ramfs_direntry* entry = dir_node->child_table[slot];
+        if (entry->hash == hash &&
+            entry->name.length() == length &&
+            memcmp(entry->name.data(), name, length) == 0) {
+            return entry;
         }
+    }
 
-        // Delete the directory entry
-        delete direntry;
+    return nullptr;
+}
+
+bool ram_filesystem::_insert_child(ramfs_node* dir_node, ramfs_direntry* direntry) {
+    // Keep the table at most half full so probe sequences stay short
+    size_t count = dir_node->children.size() + 1;
+    if (count * 2 > dir_node->child_table_size) {
+        size_t new_size = dir_node->child_table_size ? dir_node->child_table_size * 2 : RAMFS_CHILD_TABLE_MIN_SIZE;
+        if (!_resize_child_table(dir_node, new_size)) {
+            return false;
+        }
     }
 
-    // Clear the children vector and delete the directory itself
-    dir_node->children.clear();
-    delete dir_node;
+    size_t mask = dir_node->child_table_size - 1;
+    size_t slot = direntry->hash & mask;
+    while (dir_node->child_table[slot]) {
+        slot = (slot + 1) & mask;
+    }
+
+    dir_node->child_table[slot] = direntry;
+    dir_node->children.push_back(direntry);
+    return true;
+}
+
+void ram_filesystem::_erase_child_slot(ramfs_node* dir_node, ramfs_direntry* direntry) {
+    size_t mask = dir_node->child_table_size - 1;
+
+    size_t slot = direntry->hash & mask;
+    while (dir_node->child_table[slot] != direntry) {
+        slot = (slot + 1) & mask;
+    }
+
+    // Shift later entries of the probe sequence back into the hole instead of leaving
+    // a tombstone, an entry may only move if its home slot isn't between the hole and it.
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & mask; dir_node->child_table[next]; next = (next + 1) & mask) {
+        size_t home = dir_node->child_table[next]->hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            dir_node->child_table[hole] = dir_node->child_table[next];
+            hole = next;
+        }
+    }
+
+    dir_node->child_table[hole] = nullptr;
+}
+
+bool ram_filesystem::_resize_child_table(ramfs_node* dir_node, size_t new_size) {
+    auto new_table = new ramfs_direntry*[new_size];
+    if (!new_table) {
+        return false;
+    }
+
+    zeromem(new_table, new_size * sizeof(ramfs_direntry*));
+
+    size_t mask = new_size - 1;
+    for (ramfs_direntry* entry : dir_node->children) {
+        size_t slot = entry->hash & mask;
+        while (new_table[slot]) {
+            slot = (slot + 1) & mask;
+        }
+
+        new_table[slot] = entry;
+    }
+
+    delete[] dir_node->child_table;
+    dir_node->child_table = new_table;
+    dir_node->child_table_size = new_size;
+    return true;
 }
 } // namespace fs
@@ -1,5 +1,6 @@
 #include <fs/vfs.h>
 #include <serial/serial.h>
+#include <rcu.h>
 
 namespace fs {
 virtual_filesystem g_global_vfs = virtual_filesystem();
@@ -30,12 +31,19 @@ fs_error virtual_filesystem::mount(
     root_node->fs = fs.get();
     fs->set_ops(root_node, path);
 
-    m_mount_points.push_back(mount_point {
+    // Publish an updated copy of the mount table, path
+    // resolution keeps reading the old one locklessly.
+    kstl::vector<mount_point>* new_table = _copy_mount_table();
+    new_table->push_back(mount_point {
         .path = path,
         .root_node = root_node,
         .owner_fs = fs
     });
 
+    _publish_mount_table(new_table);
+
+    // Cached lookups may now be shadowed by the new mount
+    m_dentry_cache.flush();
     return fs_error::success;
 }
 
@@ -48,19 +56,28 @@ fs_error virtual_filesystem::unmount(
         return fs_error::invalid_argument;
     }
 
-    for (size_t i = 0; i < m_mount_points.size(); ++i) {
-        auto& mnt = m_mount_points[i];
-        if (mnt.path == path) {
-            // Call the filesystem's specific unmount hook
-            mnt.owner_fs->unmount();
+    kstl::vector<mount_point>* new_table = _copy_mount_table();
+
+    for (size_t i = 0; i < new_table->size(); ++i) {
+        if ((*new_table)[i].path == path) {
+            kstl::shared_ptr<filesystem> owner_fs = (*new_table)[i].owner_fs;
+
+            // Remove the mount point and wait for in-flight lookups to drain
+            new_table->erase(i);
+            _publish_mount_table(new_table);
 
-            // Remove the mount point
-            m_mount_points.erase(i);
+            // Drop every cached node before the filesystem tears them down
+            m_dentry_cache.flush();
+
+            // Call the filesystem's specific unmount hook
+            owner_fs->unmount();
 
             return fs_error::success;
         }
     }
 
+    delete new_table;
+
     // Mount point was not found
     return fs_error::invalid_path;
 }
@@ -126,8 +143,13 @@ fs_error virtual_filesystem::create(
 
     // Call the create operation
     int status = parent_node->ops.create(parent_node.get(), name.c_str(), type, perms);
-    
-    return (status == 0) ? fs_error::success : fs_error::io_error;
+    if (status != 0) {
+        return fs_error::io_error;
+    }
+
+    // Forget that the name didn't exist
+    m_dentry_cache.invalidate(parent_node.get(), name);
+    return fs_error::success;
 }
 
 fs_error virtual_filesystem::remove(
@@ -186,7 +208,19 @@ fs_error virtual_filesystem::remove(
 
     // Call the remove operation
     int status = parent_node->ops.remove(parent_node.get(), target_node.get());
-    return (status == 0) ? fs_error::success : fs_error::io_error;
+    if (status != 0) {
+        return fs_error::io_error;
+    }
+
+    // A removed directory takes its whole subtree with it, whose entries are
+    // keyed by nodes further down. Removals are rare, just start over then.
+    if (target_node->stat.type == vfs_node_type::directory) {
+        m_dentry_cache.flush();
+    } else {
+        m_dentry_cache.invalidate(parent_node.get(), name);
+    }
+
+    return fs_error::success;
 }
 
 ssize_t virtual_filesystem::read(
@@ -261,6 +295,134 @@ ssize_t virtual_filesystem::write(
     return bytes_written;
 }
 
+int virtual_filesystem::open(const kstl::string& path, uint32_t flags, uint32_t perms, fd_table* table) {
+    // Resolve the node once, every operation on the descriptor reuses it
+    kstl::shared_ptr<vfs_node> resolved_node;
+    fs_error result = _resolve_path(path, resolved_node);
+
+    if (result == fs_error::not_found && (flags & FS_O_CREAT)) {
+        result = create(path, vfs_node_type::file, perms);
+        if (result == fs_error::success || result == fs_error::already_exists) {
+            result = _resolve_path(path, resolved_node);
+        }
+    }
+
+    if (result != fs_error::success) {
+        return static_cast<int>(make_error_code(result));
+    }
+
+    // Directories can only be opened for reading
+    if (resolved_node->stat.type == vfs_node_type::directory && (flags & FS_O_ACCMODE) != FS_O_RDONLY) {
+        return static_cast<int>(make_error_code(fs_error::is_directory));
+    }
+
+    auto file = new open_file(resolved_node, flags);
+    if (!file) {
+        return static_cast<int>(make_error_code(fs_error::no_space_left));
+    }
+
+    if (!table) {
+        table = fd_table::for_current_task();
+    }
+
+    int fd = table->install(file);
+    if (fd < 0) {
+        file->release();
+        return static_cast<int>(make_error_code(fs_error::too_many_open_files));
+    }
+
+    return fd;
+}
+
+fs_error virtual_filesystem::close(int fd) {
+    return fd_table::for_current_task()->close(fd) ? fs_error::success : fs_error::bad_descriptor;
+}
+
+ssize_t virtual_filesystem::read(int fd, void* buffer, size_t size) {
+    open_file* file = fd_table::for_current_task()->get(fd);
+    if (!file) {
+        return make_error_code(fs_error::bad_descriptor);
+    }
+
+    ssize_t bytes_read = file->read(buffer, size);
+    file->release();
+    return bytes_read;
+}
+
+ssize_t virtual_filesystem::write(int fd, const void* buffer, size_t size) {
+    open_file* file = fd_table::for_current_task()->get(fd);
+    if (!file) {
+        return make_error_code(fs_error::bad_descriptor);
+    }
+
+    ssize_t bytes_written = file->write(buffer, size);
+    file->release();
+    return bytes_written;
+}
+
+ssize_t virtual_filesystem::pread(int fd, void* buffer, size_t size, uint64_t offset) {
+    open_file* file = fd_table::for_current_task()->get(fd);
+    if (!file) {
+        return make_error_code(fs_error::bad_descriptor);
+    }
+
+    ssize_t bytes_read = file->pread(buffer, size, offset);
+    file->release();
+    return bytes_read;
+}
+
+ssize_t virtual_filesystem::pwrite(int fd, const void* buffer, size_t size, uint64_t offset) {
+    open_file* file = fd_table::for_current_task()->get(fd);
+    if (!file) {
+        return make_error_code(fs_error::bad_descriptor);
+    }
+
+    ssize_t bytes_written = file->pwrite(buffer, size, offset);
+    file->release();
+    return bytes_written;
+}
+
+ssize_t virtual_filesystem::lseek(int fd, int64_t offset, int whence) {
+    open_file* file = fd_table::for_current_task()->get(fd);
+    if (!file) {
+        return make_error_code(fs_error::bad_descriptor);
+    }
+
+    ssize_t new_offset = file->lseek(offset, whence);
+    file->release();
+    return new_offset;
+}
+
+fs_error virtual_filesystem::fstat(int fd, vfs_stat_struct& info) {
+    open_file* file = fd_table::for_current_task()->get(fd);
+    if (!file) {
+        return fs_error::bad_descriptor;
+    }
+
+    info = file->node()->stat;
+    file->release();
+    return fs_error::success;
+}
+
+fs_error virtual_filesystem::mmap(int fd, uint64_t offset, size_t length, uint32_t prot, uint32_t flags, void*& out_addr) {
+    open_file* file = fd_table::for_current_task()->get(fd);
+    if (!file) {
+        return fs_error::bad_descriptor;
+    }
+
+    fs_error result = mmap_table::for_current_task()->map(file, offset, length, prot, flags, out_addr);
+    file->release();
+    return result;
+}
+
+fs_error virtual_filesystem::munmap(void* addr, size_t length) {
+    return mmap_table::for_current_task()->unmap(addr, length);
+}
+
+fs_error virtual_filesystem::msync(void* addr, size_t length) {
+    return mmap_table::for_current_task()->sync(addr, length);
+}
+
 fs_error virtual_filesystem::listdir(const kstl::string& path, kstl::vector<kstl::string>& entries) {
     // Validate the input path
     if (path.empty()) {
@@ -331,12 +493,24 @@ kstl::string virtual_filesystem::get_filename_from_path(const kstl::string& path
     return components.empty() ? "" : components.back();
 }
 
+void virtual_filesystem::get_dentry_cache_stats(dentry_cache_stats& stats) {
+    m_dentry_cache.get_stats(stats);
+}
+
 fs_error virtual_filesystem::is_mount_point(
-    const kstl::string& path,
+    const char* path,
+    size_t length,
     kstl::shared_ptr<vfs_node>& out_root_node
 ) {
-    for (auto& mnt : m_mount_points) {
-        if (mnt.path == path) {
+    rcu::read_guard guard;
+
+    kstl::vector<mount_point>* table = rcu::dereference(m_mount_points);
+    if (!table) {
+        return fs_error::not_found;
+    }
+
+    for (auto& mnt : *table) {
+        if (mnt.path.length() == length && memcmp(mnt.path.data(), path, length) == 0) {
             out_root_node = mnt.root_node;
             return fs_error::success;
         }
@@ -345,74 +519,82 @@ fs_error virtual_filesystem::is_mount_point(
     return fs_error::not_found;
 }
 
+void virtual_filesystem::_publish_mount_table(kstl::vector<mount_point>* new_table) {
+    kstl::vector<mount_point>* old_table = m_mount_points;
+    rcu::assign_pointer(m_mount_points, new_table);
+
+    if (old_table) {
+        rcu::synchronize();
+        delete old_table;
+    }
+}
+
+kstl::vector<mount_point>* virtual_filesystem::_copy_mount_table() {
+    if (!m_mount_points) {
+        return new kstl::vector<mount_point>();
+    }
+
+    return new kstl::vector<mount_point>(*m_mount_points);
+}
+
 fs_error virtual_filesystem::_resolve_path(
     const kstl::string& path,
     kstl::shared_ptr<vfs_node>& out_node
 ) {
-    mutex_guard guard(m_vfs_lock);
+    // Path resolution doesn't take any locks on cache hits, the
+    // dentry cache and the mount table are read under RCU protection.
 
     // Validate the input path
-    if (path.empty()) {
+    if (path.empty() || path[0] != '/') {
         return fs_error::invalid_path;
     }
 
-    // Split the path into components
-    kstl::vector<kstl::string> components;
-    _split_path(path, components);
-
-    if (components.empty()) {
-        return fs_error::invalid_path;
-    }
+    // Taken before any lookup, so results that race with a create or
+    // remove of the same name are not put into the cache.
+    uint64_t generation = m_dentry_cache.generation();
 
-    // Determine the starting root node
+    // Start at the root filesystem
     kstl::shared_ptr<vfs_node> current_node;
-    if ((is_mount_point(components.front(), current_node)) != fs_error::success) {
+    if (is_mount_point("/", 1, current_node) != fs_error::success) {
         return fs_error::invalid_path;
     }
 
-    // Keep track of the current filesystem
-    filesystem* current_fs = current_node->fs;
+    // Walk the components in place instead of splitting the path up front
+    const char* chars = path.data();
+    size_t length = path.length();
+    size_t pos = 0;
 
-    // Build the current path dynamically as we iterate
-    kstl::string current_path = components.front() == "/" ? "/" : "";
-
-    // Iterate through the components
-    for (size_t i = (components.front() == "/" ? 1 : 0); i < components.size(); ++i) {
-        const kstl::string& component = components[i];
+    while (true) {
+        while (pos < length && chars[pos] == '/') {
+            ++pos;
+        }
 
-        // Update the current path
-        if (current_path != "/") {
-            current_path += "/";
+        if (pos == length) {
+            break;
         }
-        current_path += component;
-
-        // Check if current path matches a mount point
-        kstl::shared_ptr<vfs_node> mount_node;
-        if (is_mount_point(current_path, mount_node) == fs_error::success) {
-            current_node = mount_node;
-#if 0
-            serial::printf("switching to a new filesystem's root node: %llx\n", current_node.get());
-#endif
-            continue; // Switch to the new filesystem's root node
+
+        size_t start = pos;
+        while (pos < length && chars[pos] != '/') {
+            ++pos;
         }
 
-        // Ensure the current node has a valid lookup operation
-        if (!current_node->ops.lookup) {
-            return fs_error::unsupported_operation;
+        // Cached components resolve to the node, or to a mounted filesystem's root, directly
+        kstl::shared_ptr<vfs_node> next_node;
+        if (m_dentry_cache.lookup(current_node.get(), chars + start, pos - start, next_node)) {
+            if (!next_node) {
+                return fs_error::not_found; // Negative entry
+            }
+
+            current_node = next_node;
+            continue;
         }
 
-        // Perform the lookup for the next component
-        current_node = current_node->ops.lookup(current_node.get(), component.c_str());
-        
-        // If lookup fails, return an error
-        if (!current_node) {
-            return fs_error::not_found;
+        fs_error result = _lookup_component(current_node, path, start, pos, generation, next_node);
+        if (result != fs_error::success) {
+            return result;
         }
 
-        // Since the node was most likely newly created, we need
-        // to update its ops struct as well as the fs reference.
-        current_node->fs = current_fs;
-        current_fs->set_ops(current_node, current_path);
+        current_node = next_node;
     }
 
     // If we resolved all components successfully, set the output node
@@ -420,6 +602,62 @@ fs_error virtual_filesystem::_resolve_path(
     return fs_error::success;
 }
 
+fs_error virtual_filesystem::_lookup_component(
+    const kstl::shared_ptr<vfs_node>& parent,
+    const kstl::string& path,
+    size_t start,
+    size_t end,
+    uint64_t generation,
+    kstl::shared_ptr<vfs_node>& out_node
+) {
+    kstl::string component = path.substring(start, end - start);
+
+    // Build the normalized path up to and including this component
+    kstl::string current_path;
+    current_path.reserve(end);
+    for (size_t i = 0; i < end; ++i) {
+        if (path[i] == '/' && i + 1 < end && path[i + 1] == '/') {
+            continue;
+        }
+        current_path.append(path[i]);
+    }
+
+    // Check if current path matches a mount point
+    kstl::shared_ptr<vfs_node> mount_node;
+    if (is_mount_point(current_path.data(), current_path.length(), mount_node) == fs_error::success) {
+        // Switch to the new filesystem's root node
+        m_dentry_cache.insert(parent, component, mount_node, generation);
+        out_node = mount_node;
+        return fs_error::success;
+    }
+
+    // Ensure the current node has a valid lookup operation
+    if (!parent->ops.lookup) {
+        return fs_error::unsupported_operation;
+    }
+
+    // Perform the lookup for the component
+    kstl::shared_ptr<vfs_node> node = parent->ops.lookup(parent.get(), component.c_str());
+
+    if (node) {
+        // The node was newly created by the filesystem, we need
+        // to update its ops struct as well as the fs reference.
+        node->fs = parent->fs;
+        node->fs->set_ops(node, current_path);
+    }
+
+    // Misses are cached as well, so probing for a missing file stays cheap
+    m_dentry_cache.insert(parent, component, node, generation);
+
+    // If lookup fails, return an error
+    if (!node) {
+        return fs_error::not_found;
+    }
+
+    out_node = node;
+    return fs_error::success;
+}
+
 void virtual_filesystem::_split_path(
     const kstl::string& path,
     kstl::vector<kstl::string>& components
@@ -0,0 +1,252 @@
+#include <ipc/channel.h>
+#include <memory/vmm.h>
+#include <dynpriv/dynpriv.h>
+
+namespace ipc {
+name_registry channel::s_registry;
+
+channel::~channel() {
+    if (m_ring) {
+        RUN_ELEVATED({
+            vmm::unmap_contiguous_virtual_pages(reinterpret_cast<uintptr_t>(m_ring), m_page_count);
+        });
+    }
+}
+
+channel_handle_t channel::create(const kstl::string& name, uint32_t slot_count) {
+    if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0) {
+        return CHANNEL_ID_INVALID;
+    }
+
+    auto chan = new channel();
+    if (!chan) {
+        return CHANNEL_ID_INVALID;
+    }
+
+    if (!chan->_init(slot_count) || !s_registry.publish(name, chan)) {
+        chan->release();
+        return CHANNEL_ID_INVALID;
+    }
+
+    // The creator's handle owns the name, closing it makes the channel unreachable by name
+    channel_handle_t handle = handle_table::for_current_task()->install(chan, &s_registry);
+    if (handle == CHANNEL_ID_INVALID) {
+        s_registry.unpublish(chan);
+        chan->release();
+    }
+
+    return handle;
+}
+
+channel_handle_t channel::open(const kstl::string& name) {
+    ipc_object* chan = s_registry.find(name, object_type);
+    if (!chan) {
+        return CHANNEL_ID_INVALID;
+    }
+
+    channel_handle_t handle = handle_table::for_current_task()->install(chan);
+    if (handle == CHANNEL_ID_INVALID) {
+        chan->release();
+    }
+
+    return handle;
+}
+
+bool channel::close(channel_handle_t handle) {
+    return handle_table::for_current_task()->close(handle, object_type);
+}
+
+object_ref<channel> channel::get(channel_handle_t handle) {
+    return object_ref<channel>(handle);
+}
+
+void* channel::begin_send() {
+    if (!_is_writable()) {
+        return nullptr;
+    }
+
+    uint32_t head = m_ring->head.load(kstl::memory_order::relaxed);
+    return _slot(head) + CHANNEL_SLOT_HEADER_SIZE;
+}
+
+void channel::commit_send(size_t size) {
+    uint32_t head = m_ring->head.load(kstl::memory_order::relaxed);
+    *reinterpret_cast<uint32_t*>(_slot(head)) = static_cast<uint32_t>(size);
+
+    // Publishing the new head makes the slot contents visible to the consumer
+    m_ring->head.store(head + 1, kstl::memory_order::release);
+    _notify(CHANNEL_SIDE_CONSUMER);
+}
+
+const void* channel::begin_receive(size_t* out_size) {
+    if (!_is_readable()) {
+        return nullptr;
+    }
+
+    uint8_t* slot = _slot(m_ring->tail.load(kstl::memory_order::relaxed));
+    *out_size = *reinterpret_cast<uint32_t*>(slot);
+    return slot + CHANNEL_SLOT_HEADER_SIZE;
+}
+
+void channel::end_receive() {
+    uint32_t tail = m_ring->tail.load(kstl::memory_order::relaxed);
+
+    // The release store keeps our reads of the slot from being reordered past its reuse
+    m_ring->tail.store(tail + 1, kstl::memory_order::release);
+    _notify(CHANNEL_SIDE_PRODUCER);
+}
+
+bool channel::try_send(const void* data, size_t size) {
+    if (size > CHANNEL_MAX_MESSAGE_SIZE) {
+        return false;
+    }
+
+    void* slot = begin_send();
+    if (!slot) {
+        return false;
+    }
+
+    memcpy(slot, data, size);
+    commit_send(size);
+    return true;
+}
+
+bool channel::try_receive(void* buffer, size_t buffer_size, size_t* out_size) {
+    size_t size = 0;
+    const void* payload = begin_receive(&size);
+    if (!payload) {
+        return false;
+    }
+
+    memcpy(buffer, payload, kstl::min(size, buffer_size));
+    end_receive();
+
+    *out_size = size;
+    return true;
+}
+
+bool channel::send(const void* data, size_t size) {
+    if (size > CHANNEL_MAX_MESSAGE_SIZE) {
+        return false;
+    }
+
+    void* slot;
+    while (!(slot = begin_send())) {
+        _wait(CHANNEL_SIDE_PRODUCER, WAIT_FOREVER);
+    }
+
+    memcpy(slot, data, size);
+    commit_send(size);
+    return true;
+}
+
+bool channel::receive(void* buffer, size_t buffer_size, size_t* out_size, uint64_t timeout_ns) {
+    if (!wait_readable(timeout_ns)) {
+        return false;
+    }
+
+    return try_receive(buffer, buffer_size, out_size);
+}
+
+bool channel::can_receive() {
+    return _is_readable();
+}
+
+bool channel::wait_readable(uint64_t timeout_ns) {
+    return _is_readable() || _wait(CHANNEL_SIDE_CONSUMER, timeout_ns);
+}
+
+bool channel::wait_writable(uint64_t timeout_ns) {
+    return _is_writable() || _wait(CHANNEL_SIDE_PRODUCER, timeout_ns);
+}
+
+bool channel::_init(uint32_t slot_count) {
+    size_t ring_size = CHANNEL_RING_HEADER_SIZE + static_cast<size_t>(slot_count) * CHANNEL_SLOT_SIZE;
+    size_t page_count = (ring_size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    // The higher half is shared by every address space, mapping the ring
+    // user-accessible there makes it directly visible to both endpoints.
+    void* ring_pages = nullptr;
+    RUN_ELEVATED({
+        ring_pages = vmm::alloc_virtual_pages(page_count, DEFAULT_UNPRIV_PAGE_FLAGS);
+    });
+
+    if (!ring_pages) {
+        return false;
+    }
+
+    zeromem(ring_pages, page_count * PAGE_SIZE);
+
+    m_ring = reinterpret_cast<channel_ring*>(ring_pages);
+    m_page_count = page_count;
+    m_ring->slot_count = slot_count;
+    m_ring->slot_size = CHANNEL_SLOT_SIZE;
+
+    m_slots = reinterpret_cast<uint8_t*>(ring_pages) + CHANNEL_RING_HEADER_SIZE;
+    m_slot_mask = slot_count - 1;
+    return true;
+}
+
+bool channel::_is_writable() {
+    uint32_t head = m_ring->head.load(kstl::memory_order::relaxed);
+    if (head - m_ring->cached_tail < m_ring->slot_count) {
+        return true;
+    }
+
+    // Only re-read the consumer's index once the cached one says the ring is full
+    m_ring->cached_tail = m_ring->tail.load(kstl::memory_order::acquire);
+    return head - m_ring->cached_tail < m_ring->slot_count;
+}
+
+bool channel::_is_readable() {
+    uint32_t tail = m_ring->tail.load(kstl::memory_order::relaxed);
+    if (tail != m_ring->cached_head) {
+        return true;
+    }
+
+    // Only re-read the producer's index once the cached one says the ring is empty
+    m_ring->cached_head = m_ring->head.load(kstl::memory_order::acquire);
+    return tail != m_ring->cached_head;
+}
+
+void channel::_notify(channel_side side) {
+    // Orders the index update against the flag check, pairs with
+    // the flag being set before the ring is re-checked in _wait().
+    kstl::atomic_thread_fence(kstl::memory_order::seq_cst);
+
+    if (_waiting_flag(side).load(kstl::memory_order::relaxed)) {
+        m_wait_queues[side].wake_all();
+    }
+}
+
+bool channel::_wait(channel_side side, uint64_t timeout_ns) {
+    sched::wait_poll_fn poll = (side == CHANNEL_SIDE_CONSUMER) ? _poll_readable : _poll_writable;
+
+    // The other side is usually just about to catch up, avoid parking if possible
+    for (uint32_t spins = 0; spins < CHANNEL_SPIN_LIMIT; ++spins) {
+        if (poll(this) >= 0) {
+            return true;
+        }
+
+        asm volatile ("pause");
+    }
+
+    // Raise the doorbell flag before parking, the other side only
+    // signals the wait queue while it sees the flag set.
+    _waiting_flag(side).store(1, kstl::memory_order::seq_cst);
+
+    sched::wait_queue* queue = &m_wait_queues[side];
+    bool ready = sched::wait_event(&queue, 1, timeout_ns, poll, this) >= 0;
+
+    _waiting_flag(side).store(0, kstl::memory_order::relaxed);
+    return ready;
+}
+
+int64_t channel::_poll_readable(void* data) {
+    return reinterpret_cast<channel*>(data)->_is_readable() ? 0 : -1;
+}
+
+int64_t channel::_poll_writable(void* data) {
+    return reinterpret_cast<channel*>(data)->_is_writable() ? 0 : -1;
+}
+} // namespace ipc
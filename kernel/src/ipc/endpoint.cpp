@@ -0,0 +1,330 @@
+#include <ipc/endpoint.h>
+#include <sched/sched.h>
+#include <time/time.h>
+#include <dynpriv/dynpriv.h>
+#include <rcu.h>
+
+namespace ipc {
+name_registry endpoint::s_registry;
+
+endpoint_handle_t endpoint::create(const kstl::string& name) {
+    auto ep = new endpoint();
+    if (!ep) {
+        return ENDPOINT_ID_INVALID;
+    }
+
+    if (!s_registry.publish(name, ep)) {
+        ep->release();
+        return ENDPOINT_ID_INVALID;
+    }
+
+    // The creator's handle owns the name, closing it makes the endpoint unreachable by name
+    endpoint_handle_t handle = handle_table::for_current_task()->install(ep, &s_registry);
+    if (handle == ENDPOINT_ID_INVALID) {
+        s_registry.unpublish(ep);
+        ep->release();
+    }
+
+    return handle;
+}
+
+endpoint_handle_t endpoint::open(const kstl::string& name) {
+    ipc_object* ep = s_registry.find(name, object_type);
+    if (!ep) {
+        return ENDPOINT_ID_INVALID;
+    }
+
+    endpoint_handle_t handle = handle_table::for_current_task()->install(ep);
+    if (handle == ENDPOINT_ID_INVALID) {
+        ep->release();
+    }
+
+    return handle;
+}
+
+bool endpoint::close(endpoint_handle_t handle) {
+    return handle_table::for_current_task()->close(handle, object_type);
+}
+
+bool endpoint::call(endpoint_handle_t handle, const void* request, size_t request_size,
+                    void* reply, size_t reply_capacity, size_t* out_reply_size, uint64_t timeout_ns) {
+    if (request_size > IPC_CALL_MAX_MESSAGE_SIZE) {
+        return false;
+    }
+
+    object_ref<endpoint> ep(handle);
+    if (!ep) {
+        return false; // Invalid handle
+    }
+
+    ipc_call_buffer* pending_call = _get_ipc_buffer();
+    if (!pending_call) {
+        return false;
+    }
+
+    memcpy(pending_call->message, request, request_size);
+    pending_call->client = current;
+    pending_call->request_size = request_size;
+    pending_call->reply_size = 0;
+    pending_call->status.store(IPC_CALL_PENDING, kstl::memory_order::relaxed);
+    pending_call->next = nullptr;
+
+    {
+        // The server may return from receive() and exit before the handoff is done with it
+        rcu::read_guard rcu_guard;
+        task_control_block* server = nullptr;
+
+        {
+            mutex_guard guard(ep->m_lock);
+
+            if (ep->m_closed) {
+                return false;
+            }
+
+            if (ep->m_pending_tail) {
+                ep->m_pending_tail->next = pending_call;
+            } else {
+                kstl::atomic_store(&ep->m_pending_head, pending_call, kstl::memory_order::release);
+            }
+            ep->m_pending_tail = pending_call;
+
+            server = ep->m_server;
+        }
+
+        // Wake the server up and run it right away on the rest of our time slice
+        ep->m_request_waiters.wake_all();
+        _handoff(server);
+    }
+
+    // Usually the server already replied and handed the CPU back by now
+    sched::wait_queue* waiters[1] = { &ep->m_reply_waiters };
+    if (sched::wait_event(waiters, 1, timeout_ns, _poll_reply, pending_call) < 0) {
+        if (ep->_withdraw_call(pending_call)) {
+            return false;
+        }
+
+        // The reply is already being written
+        sched::wait_event(waiters, 1, WAIT_FOREVER, _poll_reply, pending_call);
+    }
+
+    if (pending_call->status.load(kstl::memory_order::acquire) != IPC_CALL_REPLIED) {
+        return false;
+    }
+
+    size_t reply_size = pending_call->reply_size;
+    memcpy(reply, pending_call->message, kstl::min(reply_size, reply_capacity));
+
+    if (out_reply_size) {
+        *out_reply_size = reply_size;
+    }
+
+    return true;
+}
+
+const void* endpoint::receive(endpoint_handle_t handle, size_t* out_size, pid_t* out_client, uint64_t timeout_ns) {
+    object_ref<endpoint> ep(handle);
+    if (!ep) {
+        return nullptr; // Invalid handle
+    }
+
+    sched::wait_queue* waiters[1] = { &ep->m_request_waiters };
+    uint64_t start = kernel_timer::get_system_time_in_nanoseconds();
+
+    while (true) {
+        ipc_call_buffer* received = nullptr;
+        {
+            mutex_guard guard(ep->m_lock);
+
+            // The previous request has to be replied to first
+            if (ep->m_closed || ep->m_active_call) {
+                if (ep->m_server == current) {
+                    ep->m_server = nullptr;
+                }
+                return nullptr;
+            }
+
+            received = ep->m_pending_head;
+            if (received) {
+                kstl::atomic_store(&ep->m_pending_head, received->next, kstl::memory_order::relaxed);
+                if (!received->next) {
+                    ep->m_pending_tail = nullptr;
+                }
+
+                ep->m_active_call = received;
+                ep->m_server = nullptr;
+            } else {
+                ep->m_server = current;
+            }
+        }
+
+        if (received) {
+            *out_size = received->request_size;
+            if (out_client) {
+                *out_client = received->client->pid;
+            }
+
+            return received->message;
+        }
+
+        uint64_t remaining = timeout_ns;
+        if (timeout_ns != WAIT_FOREVER) {
+            uint64_t elapsed = kernel_timer::get_system_time_in_nanoseconds() - start;
+            remaining = elapsed >= timeout_ns ? 0 : timeout_ns - elapsed;
+        }
+
+        if (remaining == 0 || sched::wait_event(waiters, 1, remaining, _poll_request, ep.get()) < 0) {
+            mutex_guard guard(ep->m_lock);
+            if (ep->m_server == current) {
+                ep->m_server = nullptr;
+            }
+            return nullptr;
+        }
+    }
+}
+
+bool endpoint::reply(endpoint_handle_t handle, const void* data, size_t size) {
+    if (size > IPC_CALL_MAX_MESSAGE_SIZE) {
+        return false;
+    }
+
+    object_ref<endpoint> ep(handle);
+    if (!ep) {
+        return false; // Invalid handle
+    }
+
+    ipc_call_buffer* active_call = nullptr;
+    bool abandoned = false;
+    {
+        mutex_guard guard(ep->m_lock);
+        active_call = ep->m_active_call;
+        ep->m_active_call = nullptr;
+
+        // The client gave up on the call and left the buffer to us
+        abandoned = active_call && active_call->status.load(kstl::memory_order::relaxed) == IPC_CALL_ABANDONED;
+    }
+
+    if (!active_call) {
+        return false;
+    }
+
+    if (abandoned) {
+        delete active_call;
+        return false;
+    }
+
+    // The client may issue its next call or exit as soon as it sees this one was replied to
+    task_control_block* client = active_call->client;
+
+    memcpy(active_call->message, data, size);
+    active_call->reply_size = size;
+
+    rcu::read_guard rcu_guard;
+    active_call->status.store(IPC_CALL_REPLIED, kstl::memory_order::release);
+
+    ep->m_reply_waiters.wake_all();
+    _handoff(client);
+    return true;
+}
+
+void endpoint::owner_closed() {
+    {
+        mutex_guard guard(m_lock);
+        kstl::atomic_store(&m_closed, true, kstl::memory_order::release);
+        m_server = nullptr;
+
+        ipc_call_buffer* pending_call = m_pending_head;
+        kstl::atomic_store(&m_pending_head, static_cast<ipc_call_buffer*>(nullptr), kstl::memory_order::relaxed);
+        m_pending_tail = nullptr;
+
+        // The client may reuse its buffer as soon as it sees the failure
+        while (pending_call) {
+            ipc_call_buffer* next = pending_call->next;
+            pending_call->status.store(IPC_CALL_FAILED, kstl::memory_order::release);
+            pending_call = next;
+        }
+
+        if (m_active_call) {
+            if (m_active_call->status.load(kstl::memory_order::relaxed) == IPC_CALL_ABANDONED) {
+                delete m_active_call;
+            } else {
+                m_active_call->status.store(IPC_CALL_FAILED, kstl::memory_order::release);
+            }
+            m_active_call = nullptr;
+        }
+    }
+
+    // Fail the waiting clients and whoever else is blocked in receive()
+    m_reply_waiters.wake_all();
+    m_request_waiters.wake_all();
+}
+
+bool endpoint::_withdraw_call(ipc_call_buffer* pending_call) {
+    mutex_guard guard(m_lock);
+
+    // Replied to or failed in the meantime
+    if (pending_call->status.load(kstl::memory_order::acquire) != IPC_CALL_PENDING) {
+        return false;
+    }
+
+    ipc_call_buffer* prev = nullptr;
+    for (ipc_call_buffer* queued = m_pending_head; queued; prev = queued, queued = queued->next) {
+        if (queued != pending_call) {
+            continue;
+        }
+
+        if (prev) {
+            prev->next = queued->next;
+        } else {
+            kstl::atomic_store(&m_pending_head, queued->next, kstl::memory_order::relaxed);
+        }
+
+        if (m_pending_tail == queued) {
+            m_pending_tail = prev;
+        }
+        return true;
+    }
+
+    // The server is reading the request in place, it keeps the buffer
+    // and frees it on reply. The client gets a new one for its next call.
+    if (m_active_call == pending_call) {
+        pending_call->status.store(IPC_CALL_ABANDONED, kstl::memory_order::relaxed);
+        current->ipc_buffer = nullptr;
+        return true;
+    }
+
+    // Taken by reply(), which is writing the reply right now
+    return false;
+}
+
+ipc_call_buffer* endpoint::_get_ipc_buffer() {
+    if (!current->ipc_buffer) {
+        current->ipc_buffer = new ipc_call_buffer();
+    }
+
+    return current->ipc_buffer;
+}
+
+void endpoint::_handoff(task_control_block* task) {
+    if (!task) {
+        return;
+    }
+
+    RUN_ELEVATED({
+        sched::scheduler::get().yield_to(task);
+    });
+}
+
+int64_t endpoint::_poll_request(void* data) {
+    auto ep = reinterpret_cast<endpoint*>(data);
+    if (kstl::atomic_load(&ep->m_closed, kstl::memory_order::acquire)) {
+        return 0;
+    }
+
+    return kstl::atomic_load(&ep->m_pending_head, kstl::memory_order::acquire) ? 0 : -1;
+}
+
+int64_t endpoint::_poll_reply(void* data) {
+    auto pending_call = reinterpret_cast<ipc_call_buffer*>(data);
+    return pending_call->status.load(kstl::memory_order::acquire) != IPC_CALL_PENDING ? 0 : -1;
+}
+} // namespace ipc
@@ -0,0 +1,253 @@
+#include <ipc/handle_table.h>
+#include <process/process.h>
+#include <rcu.h>
+
+namespace ipc {
+// Shared by all kernel tasks, which don't own a table of their own
+DECLARE_GLOBAL_OBJECT(handle_table, g_kernel_handle_table);
+
+bool ipc_object::try_retain() {
+    uint32_t refcount = m_refcount.load(kstl::memory_order::relaxed);
+
+    // An object whose count dropped to zero is waiting for its grace period to end
+    while (refcount != 0) {
+        if (m_refcount.compare_exchange_weak(refcount, refcount + 1, kstl::memory_order::acquire)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ipc_object::release() {
+    if (m_refcount.fetch_sub(1, kstl::memory_order::acq_rel) != 1) {
+        return;
+    }
+
+    // Lookups that found the object before its last handle was closed may still be reading it
+    rcu::synchronize();
+    delete this;
+}
+
+void name_registry::_lazy_init() {
+    // Registries are global and never get constructed
+    if (!m_initialized) {
+        m_names = kstl::hashmap<kstl::string, ipc_object*>();
+        m_initialized = true;
+    }
+}
+
+bool name_registry::publish(const kstl::string& name, ipc_object* object) {
+    rwlock_write_guard guard(m_lock);
+    _lazy_init();
+
+    if (m_names.find(name)) {
+        return false;
+    }
+
+    object->retain();
+    object->m_name = name;
+    m_names[name] = object;
+    return true;
+}
+
+ipc_object* name_registry::find(const kstl::string& name, ipc_object_type type) {
+    rwlock_read_guard guard(m_lock);
+
+    // The map gets initialized by the first publish() call
+    if (!m_initialized) {
+        return nullptr;
+    }
+
+    ipc_object** object = m_names.get(name);
+    if (!object || (*object)->type() != type) {
+        return nullptr;
+    }
+
+    (*object)->retain();
+    return *object;
+}
+
+size_t name_registry::collect(ipc_object** out_objects, size_t max_objects, ipc_object_type type) {
+    rwlock_read_guard guard(m_lock);
+
+    if (!m_initialized) {
+        return 0;
+    }
+
+    size_t count = 0;
+    for (const auto& name : m_names.keys()) {
+        if (count == max_objects) {
+            break;
+        }
+
+        ipc_object* object = *m_names.get(name);
+        if (object->type() == type) {
+            object->retain();
+            out_objects[count++] = object;
+        }
+    }
+
+    return count;
+}
+
+void name_registry::unpublish(ipc_object* object) {
+    {
+        rwlock_write_guard guard(m_lock);
+
+        // The name may already have been withdrawn
+        ipc_object** published = m_initialized ? m_names.get(object->m_name) : nullptr;
+        if (!published || *published != object) {
+            return;
+        }
+
+        m_names.remove(object->m_name);
+    }
+
+    object->release();
+}
+
+handle_table::~handle_table() {
+    close_all();
+
+    for (uint32_t i = 0; i < HANDLE_TABLE_MAX_CHUNKS; i++) {
+        delete[] m_chunks[i];
+        m_chunks[i] = nullptr;
+    }
+}
+
+handle_table* handle_table::for_current_task() {
+    handle_table* table = current->handles;
+    return table ? table : &g_kernel_handle_table;
+}
+
+handle_t handle_table::install(ipc_object* object, name_registry* name_owner) {
+    mutex_guard guard(m_lock);
+
+    for (uint32_t scanned = 0; scanned < HANDLE_TABLE_MAX_ENTRIES; scanned++) {
+        uint32_t index = (m_free_hint + scanned) % HANDLE_TABLE_MAX_ENTRIES;
+        uint32_t chunk_index = index / HANDLE_TABLE_CHUNK_ENTRIES;
+
+        if (!m_chunks[chunk_index]) {
+            auto chunk = new handle_table_entry[HANDLE_TABLE_CHUNK_ENTRIES];
+            if (!chunk) {
+                return IPC_HANDLE_INVALID;
+            }
+
+            zeromem(chunk, sizeof(handle_table_entry) * HANDLE_TABLE_CHUNK_ENTRIES);
+            kstl::atomic_store(&m_chunks[chunk_index], chunk, kstl::memory_order::release);
+        }
+
+        handle_table_entry* entry = _entry(index);
+        if (entry->object.load(kstl::memory_order::relaxed)) {
+            continue;
+        }
+
+        // A fresh generation invalidates handles to whatever previously lived in the slot,
+        // it's never 0 so that no valid handle ever equals IPC_HANDLE_INVALID.
+        uint32_t generation = entry->generation.load(kstl::memory_order::relaxed) + 1;
+        if (generation == 0) {
+            generation = 1;
+        }
+
+        entry->generation.store(generation, kstl::memory_order::relaxed);
+        entry->name_owner = name_owner;
+        entry->object.store(object, kstl::memory_order::release);
+
+        m_free_hint = index + 1;
+        return IPC_MAKE_HANDLE(generation, index);
+    }
+
+    return IPC_HANDLE_INVALID;
+}
+
+ipc_object* handle_table::lookup(handle_t handle, ipc_object_type type) {
+    uint32_t index = IPC_HANDLE_INDEX(handle);
+    uint32_t generation = IPC_HANDLE_GENERATION(handle);
+
+    if (index >= HANDLE_TABLE_MAX_ENTRIES || generation == 0) {
+        return nullptr;
+    }
+
+    ipc_object* object = nullptr;
+    bool stale = false;
+
+    {
+        rcu::read_guard guard;
+
+        handle_table_entry* entry = _entry(index);
+        if (!entry || entry->generation.load(kstl::memory_order::acquire) != generation) {
+            return nullptr;
+        }
+
+        object = entry->object.load(kstl::memory_order::acquire);
+        if (!object || object->type() != type || !object->try_retain()) {
+            return nullptr;
+        }
+
+        // The slot could have been closed and reused between the loads
+        stale = entry->generation.load(kstl::memory_order::acquire) != generation;
+    }
+
+    if (stale) {
+        object->release();
+        return nullptr;
+    }
+
+    return object;
+}
+
+bool handle_table::close(handle_t handle, ipc_object_type type) {
+    uint32_t index = IPC_HANDLE_INDEX(handle);
+    if (index >= HANDLE_TABLE_MAX_ENTRIES) {
+        return false;
+    }
+
+    mutex_guard guard(m_lock);
+
+    handle_table_entry* entry = _entry(index);
+    if (!entry || entry->generation.load(kstl::memory_order::relaxed) != IPC_HANDLE_GENERATION(handle)) {
+        return false;
+    }
+
+    ipc_object* object = entry->object.load(kstl::memory_order::relaxed);
+    if (!object || object->type() != type) {
+        return false;
+    }
+
+    _close_entry(entry);
+
+    if (index < m_free_hint) {
+        m_free_hint = index;
+    }
+    return true;
+}
+
+void handle_table::close_all() {
+    mutex_guard guard(m_lock);
+
+    for (uint32_t index = 0; index < HANDLE_TABLE_MAX_ENTRIES; index++) {
+        handle_table_entry* entry = _entry(index);
+        if (entry && entry->object.load(kstl::memory_order::relaxed)) {
+            _close_entry(entry);
+        }
+    }
+
+    m_free_hint = 0;
+}
+
+void handle_table::_close_entry(handle_table_entry* entry) {
+    ipc_object* object = entry->object.exchange(nullptr, kstl::memory_order::acq_rel);
+
+    // Bumping the generation right away makes concurrent lookups of the handle fail
+    entry->generation.fetch_add(1, kstl::memory_order::release);
+
+    if (entry->name_owner) {
+        entry->name_owner->unpublish(object);
+        entry->name_owner = nullptr;
+        object->owner_closed();
+    }
+
+    object->release();
+}
+} // namespace ipc
@@ -1,57 +1,82 @@
 #include <ipc/mq.h>
+#include <time/time.h>
 
 namespace ipc {
-mq_handle_t message_queue::s_available_mq_id = 0;
-mutex message_queue::s_queue_map_lock = mutex();
-
-kstl::hashmap<kstl::string, mq_handle_t> message_queue::s_mq_name_mappings;
-kstl::hashmap<mq_handle_t, kstl::shared_ptr<message_queue>> message_queue::s_message_queue_map;
+// Queues polled by a single wait_any() call
+struct mq_wait_set {
+    message_queue* queues[WAIT_MAX_QUEUES];
+    size_t count;
+};
+
+// Room a blocked poster waits for
+struct mq_room_request {
+    message_queue* queue;
+    size_t bytes;
+};
+
+name_registry message_queue::s_registry;
+
+message_queue::~message_queue() {
+    while (m_head) {
+        mq_node* node = m_head;
+        m_head = node->next;
+        _free_node(node);
+    }
+}
 
 mq_handle_t message_queue::create(const kstl::string& name) {
-    mutex_guard guard(s_queue_map_lock);
-
-    if (s_available_mq_id == 0) {
-        s_mq_name_mappings = kstl::hashmap<kstl::string, mq_handle_t>();
-        s_message_queue_map = kstl::hashmap<mq_handle_t, kstl::shared_ptr<message_queue>>();
-        
-        s_available_mq_id++;
+    auto queue = new message_queue();
+    if (!queue) {
+        return MESSAGE_QUEUE_ID_INVALID;
     }
 
-    if (s_mq_name_mappings.find(name)) {
+    if (!s_registry.publish(name, queue)) {
+        queue->release();
         return MESSAGE_QUEUE_ID_INVALID;
     }
 
-    mq_handle_t id = s_available_mq_id++;
-    s_message_queue_map[id] = kstl::make_shared<message_queue>();
-    s_mq_name_mappings[name] = id;
+    // The creator's handle owns the name, closing it makes the queue unreachable by name
+    mq_handle_t handle = handle_table::for_current_task()->install(queue, &s_registry);
+    if (handle == MESSAGE_QUEUE_ID_INVALID) {
+        s_registry.unpublish(queue);
+        queue->release();
+    }
 
-    return id;
+    return handle;
 }
 
 mq_handle_t message_queue::open(const kstl::string& name) {
-    mutex_guard guard(s_queue_map_lock);
-
-    if (!s_mq_name_mappings.find(name)) {
+    ipc_object* queue = s_registry.find(name, object_type);
+    if (!queue) {
         return MESSAGE_QUEUE_ID_INVALID;
     }
 
-    return s_mq_name_mappings[name];
+    mq_handle_t handle = handle_table::for_current_task()->install(queue);
+    if (handle == MESSAGE_QUEUE_ID_INVALID) {
+        queue->release();
+    }
+
+    return handle;
+}
+
+bool message_queue::close(mq_handle_t handle) {
+    return handle_table::for_current_task()->close(handle, object_type);
 }
 
 bool message_queue::post_message(mq_handle_t handle, mq_message* message) {
     // Retrieve the message queue object by handle
-    message_queue* queue = _get_mq_object(handle);
+    object_ref<message_queue> queue(handle);
     if (!queue) {
         return false; // Invalid handle
     }
 
     // Delegate to the private member function
-    return queue->_post_message(message);
+    return queue->_post_messages(message, 1);
 }
 
 bool message_queue::peek_message(mq_handle_t handle) {
     // Retrieve the message queue object by handle
-    message_queue* queue = _get_mq_object(handle);
+    object_ref<message_queue> queue(handle);
     if (!queue) {
         return false; // Invalid handle
     }
@@ -62,114 +87,509 @@ bool message_queue::peek_message(mq_handle_t handle) {
 
 bool message_queue::get_message(mq_handle_t handle, mq_message* out_message) {
     // Retrieve the message queue object by handle
-    message_queue* queue = _get_mq_object(handle);
+    object_ref<message_queue> queue(handle);
     if (!queue) {
         return false; // Invalid handle
     }
 
     // Delegate to the private member function
-    return queue->_get_message(out_message);
+    return queue->_get_messages(out_message, 1) == 1;
 }
 
-message_queue* message_queue::_get_mq_object(mq_handle_t handle) {
-    mutex_guard guard(s_queue_map_lock);
-
-    if (!s_message_queue_map.find(handle)) {
-        return nullptr;
+bool message_queue::post_messages(mq_handle_t handle, const mq_message* messages, size_t count) {
+    object_ref<message_queue> queue(handle);
+    if (!queue) {
+        return false; // Invalid handle
     }
 
-    return s_message_queue_map[handle].get();
+    return queue->_post_messages(messages, count);
 }
 
-bool message_queue::_post_message(mq_message* message) {
-    // Allocate memory for the new message
-    mq_message* new_message = new mq_message;
-    if (!new_message) {
-        return false;  // Allocation failed
+size_t message_queue::get_messages(mq_handle_t handle, mq_message* out_messages, size_t max_count) {
+    object_ref<message_queue> queue(handle);
+    if (!queue) {
+        return 0; // Invalid handle
     }
 
-    // Allocate memory for the payload
-    new_message->payload_size = message->payload_size;
-    new_message->payload = new uint8_t[message->payload_size];
-    if (!new_message->payload) {
-        delete new_message;
-        return false;  // Allocation failed
+    return queue->_get_messages(out_messages, max_count);
+}
+
+bool message_queue::set_coalescing_rule(mq_handle_t handle, mq_coalesce_fn rule) {
+    object_ref<message_queue> queue(handle);
+    if (!queue) {
+        return false; // Invalid handle
     }
 
-    // Copy the message data and payload
-    new_message->message_id = m_next_message_id++;
-    memcpy(new_message->payload, message->payload, message->payload_size);
+    kstl::atomic_store(&queue->m_coalesce_rule, rule, kstl::memory_order::release);
+    return true;
+}
 
-    // Create a new node to hold the message
-    mq_node* new_node = new mq_node;
-    if (!new_node) {
-        delete[] new_message->payload;
-        delete new_message;
+bool message_queue::set_limits(mq_handle_t handle, const mq_limits& limits) {
+    if (limits.max_messages == 0 || limits.max_bytes == 0) {
         return false;
     }
 
-    new_node->message = new_message;
-    new_node->next = nullptr;
+    object_ref<message_queue> queue(handle);
+    if (!queue) {
+        return false; // Invalid handle
+    }
 
-    // Lock the queue before modifying it
-    mutex_guard guard(m_lock);
+    {
+        mutex_guard guard(queue->m_lock);
+        queue->m_limits = limits;
+    }
 
-    // Append the new node to the end of the queue
-    if (!m_tail) {
-        m_head = new_node;
-        m_tail = new_node;
-    } else {
-        m_tail->next = new_node;
-        m_tail = new_node;
+    // Raised limits or a policy that no longer blocks may let waiting posters through
+    queue->m_room_waiters.wake_all();
+    return true;
+}
+
+bool message_queue::get_stats(mq_handle_t handle, mq_stats* out_stats) {
+    object_ref<message_queue> queue(handle);
+    if (!queue) {
+        return false; // Invalid handle
+    }
+
+    queue->_get_stats(out_stats);
+    return true;
+}
+
+size_t message_queue::get_all_stats(mq_stats_info* buffer, size_t max_entries) {
+    if (max_entries == 0) {
+        return 0;
+    }
+
+    ipc_object** queues = new ipc_object*[max_entries];
+    if (!queues) {
+        return 0;
+    }
+
+    size_t count = s_registry.collect(queues, max_entries, object_type);
+    for (size_t i = 0; i < count; i++) {
+        auto queue = static_cast<message_queue*>(queues[i]);
+
+        const kstl::string& name = queue->name();
+        size_t name_length = kstl::min(name.length(), static_cast<size_t>(MQ_STATS_NAME_LEN));
+
+        zeromem(buffer[i].name, sizeof(buffer[i].name));
+        memcpy(buffer[i].name, name.c_str(), name_length);
+        queue->_get_stats(&buffer[i].stats);
+
+        queue->release();
+    }
+
+    delete[] queues;
+    return count;
+}
+
+bool message_queue::receive(mq_handle_t handle, mq_message* out_message, uint64_t timeout_ns) {
+    object_ref<message_queue> queue(handle);
+    if (!queue) {
+        return false; // Invalid handle
+    }
+
+    sched::wait_queue* waiters[1] = { &queue->m_waiters };
+    uint64_t start = kernel_timer::get_system_time_in_nanoseconds();
+
+    while (true) {
+        if (queue->_get_messages(out_message, 1)) {
+            return true;
+        }
+
+        // Another receiver may have taken the message we were woken up for,
+        // keep waiting for whatever is left of the timeout.
+        uint64_t remaining = timeout_ns;
+        if (timeout_ns != WAIT_FOREVER) {
+            uint64_t elapsed = kernel_timer::get_system_time_in_nanoseconds() - start;
+            if (elapsed >= timeout_ns) {
+                return false;
+            }
+            remaining = timeout_ns - elapsed;
+        }
+
+        if (sched::wait_event(waiters, 1, remaining, _poll_queue, queue.get()) < 0) {
+            return false;
+        }
+    }
+}
+
+int64_t message_queue::wait_any(const mq_handle_t* handles, size_t count, uint64_t timeout_ns) {
+    if (count == 0 || count > WAIT_MAX_QUEUES) {
+        return -1;
+    }
+
+    // Keeps every queue alive while the task is parked on it
+    object_ref<message_queue> refs[WAIT_MAX_QUEUES];
+
+    mq_wait_set set;
+    sched::wait_queue* waiters[WAIT_MAX_QUEUES];
+
+    set.count = count;
+    for (size_t i = 0; i < count; i++) {
+        refs[i].reset(handles[i]);
+        if (!refs[i]) {
+            return -1; // Invalid handle
+        }
+
+        set.queues[i] = refs[i].get();
+
+        waiters[i] = &set.queues[i]->m_waiters;
+    }
+
+    int64_t ready = sched::wait_event(waiters, count, timeout_ns, _poll_queue_set, &set);
+    return ready >= 0 ? ready : -1;
+}
+
+int64_t message_queue::_poll_queue(void* data) {
+    return reinterpret_cast<message_queue*>(data)->_peek_message() ? 0 : -1;
+}
+
+int64_t message_queue::_poll_queue_set(void* data) {
+    auto set = reinterpret_cast<mq_wait_set*>(data);
+
+    for (size_t i = 0; i < set->count; i++) {
+        if (set->queues[i]->_peek_message()) {
+            return static_cast<int64_t>(i);
+        }
+    }
+
+    return -1;
+}
+
+
+int64_t message_queue::_poll_room(void* data) {
+    auto request = reinterpret_cast<mq_room_request*>(data);
+    return request->queue->_has_room(1, request->bytes) ? 0 : -1;
+}
+
+bool message_queue::_post_messages(const mq_message* messages, size_t count) {
+    mq_limits limits = _get_limits();
+
+    // A message that can never fit would block or be dropped forever
+    for (size_t i = 0; i < count; i++) {
+        if (messages[i].payload_size > limits.max_bytes) {
+            m_rejected_count.fetch_add(1, kstl::memory_order::relaxed);
+            return false;
+        }
+    }
+
+    size_t next = 0;
+    while (next < count) {
+        // Posters of a blocking queue wait for room before copying anything,
+        // so a stalled consumer stalls its producers instead of growing the heap.
+        // A message that supersedes the newest pending one takes no extra slot, so it's
+        // merged in before waiting, otherwise a full queue would hold it back needlessly.
+        if (limits.policy == mq_overflow_policy::BLOCK && !_has_room(1, messages[next].payload_size)) {
+            if (_try_coalesce(&messages[next])) {
+                ++next;
+                continue;
+            }
+
+            _wait_for_room(messages[next].payload_size);
+        }
+
+        // Copy as much of the batch as currently fits, a queue that doesn't block takes all of it
+        size_t end = next;
+        size_t bytes = 0;
+        do {
+            bytes += messages[end++].payload_size;
+        } while (end < count && (limits.policy != mq_overflow_policy::BLOCK ||
+                                 _has_room(end - next + 1, bytes + messages[end].payload_size)));
+
+        // Fail-fast batches are all-or-nothing, refuse them before allocating
+        if (limits.policy == mq_overflow_policy::FAIL && !_has_room(end - next, bytes)) {
+            m_rejected_count.fetch_add(end - next, kstl::memory_order::relaxed);
+            return false;
+        }
+
+        // Copy the batch up front so the lock is only held for linking the nodes in
+        mq_node* batch_head = nullptr;
+        mq_node* batch_tail = nullptr;
+
+        for (size_t i = next; i < end; i++) {
+            mq_node* node = _alloc_node(&messages[i]);
+            if (!node) {
+                _free_nodes(batch_head);
+                return false;  // Allocation failed
+            }
+
+            if (batch_tail) {
+                batch_tail->next = node;
+            } else {
+                batch_head = node;
+            }
+            batch_tail = node;
+        }
+
+        size_t enqueued = 0;
+        bool rejected = false;
+
+        {
+            // Lock the queue before modifying it
+            mutex_guard guard(m_lock);
+
+            if (limits.policy == mq_overflow_policy::FAIL && !_has_room(end - next, bytes)) {
+                rejected = true;
+            } else {
+                while (batch_head) {
+                    mq_node* node = batch_head;
+                    batch_head = node->next;
+
+                    if (!_enqueue_node_locked(node)) {
+                        // Lost the room to another poster, retry the rest
+                        node->next = batch_head;
+                        batch_head = node;
+                        break;
+                    }
+
+                    ++enqueued;
+                }
+            }
+        }
+
+        _free_nodes(batch_head);
+
+        if (enqueued) {
+            // Wake up blocked receivers, goes straight back if there are none
+            m_waiters.wake_all();
+        }
+
+        if (rejected) {
+            m_rejected_count.fetch_add(end - next, kstl::memory_order::relaxed);
+            return false;
+        }
+
+        next += enqueued;
     }
 
     return true;
 }
 
 bool message_queue::_peek_message() {
-    mutex_guard guard(m_lock);
+    // Lock-free so that it can be polled while a waiter is being parked
+    // with interrupts disabled, a stale answer only costs a retry.
+    return kstl::atomic_load(&m_head, kstl::memory_order::acquire) != nullptr;
+}
+
+size_t message_queue::_get_messages(mq_message* out_messages, size_t max_count) {
+    mq_node* nodes = nullptr;
+    size_t count = 0;
+
+    {
+        mutex_guard guard(m_lock);
+
+        // Detach the oldest nodes in one go
+        nodes = m_head;
+        mq_node* last = nullptr;
+        size_t bytes = 0;
+
+        while (m_head && count < max_count) {
+            last = m_head;
+            bytes += m_head->message.payload_size;
+            m_head = m_head->next;
+            ++count;
+        }
+
+        if (last) {
+            last->next = nullptr;
+        }
+
+        if (!m_head) {
+            m_tail = nullptr;  // Queue is now empty
+        }
+
+        m_message_count.store(m_message_count.load(kstl::memory_order::relaxed) - count, kstl::memory_order::relaxed);
+        m_byte_count.store(m_byte_count.load(kstl::memory_order::relaxed) - bytes, kstl::memory_order::relaxed);
+    }
 
-    // Return true if the queue is not empty
-    return (m_head != nullptr);
+    if (count) {
+        // Let posters waiting for room retry, goes straight back if there are none
+        m_room_waiters.wake_all();
+    }
+
+    // The queued payload copies are handed to the caller as they are
+    for (size_t i = 0; i < count; i++) {
+        mq_node* node = nodes;
+        nodes = node->next;
+
+        out_messages[i] = node->message;
+        delete node;
+    }
+
+    return count;
 }
 
-bool message_queue::_get_message(mq_message* out_message) {
+mq_node* message_queue::_alloc_node(const mq_message* message) {
+    mq_node* node = new mq_node;
+    if (!node) {
+        return nullptr;
+    }
+
+    node->message.message_id = 0;
+    node->message.payload_size = message->payload_size;
+    node->message.payload = new uint8_t[message->payload_size];
+    if (!node->message.payload) {
+        delete node;
+        return nullptr;
+    }
+
+    memcpy(node->message.payload, message->payload, message->payload_size);
+    node->next = nullptr;
+
+    // Classify the message before taking the lock, the rule may look at the payload
+    mq_coalesce_fn rule = kstl::atomic_load(&m_coalesce_rule, kstl::memory_order::acquire);
+    node->coalesce_key = rule ? rule(&node->message) : MQ_COALESCE_NONE;
+
+    return node;
+}
+
+void message_queue::_free_node(mq_node* node) {
+    delete[] node->message.payload;
+    delete node;
+}
+
+void message_queue::_free_nodes(mq_node* nodes) {
+    while (nodes) {
+        mq_node* next = nodes->next;
+        _free_node(nodes);
+        nodes = next;
+    }
+}
+
+mq_limits message_queue::_get_limits() {
     mutex_guard guard(m_lock);
+    return m_limits;
+}
 
-    if (!m_head) {
-        return false;  // Queue is empty
+void message_queue::_get_stats(mq_stats* out_stats) {
+    mutex_guard guard(m_lock);
+
+    out_stats->depth = m_message_count.load(kstl::memory_order::relaxed);
+    out_stats->bytes = m_byte_count.load(kstl::memory_order::relaxed);
+    out_stats->high_water_mark = m_high_water_mark;
+    out_stats->posted = m_posted_count;
+    out_stats->coalesced = m_coalesced_count;
+    out_stats->dropped = m_dropped_count;
+    out_stats->rejected = m_rejected_count.load(kstl::memory_order::relaxed);
+    out_stats->blocked = m_blocked_count.load(kstl::memory_order::relaxed);
+    out_stats->limits = m_limits;
+}
+
+bool message_queue::_has_room(size_t count, size_t bytes) {
+    // Lock-free so that it can be polled while a poster is being parked, the limits
+    // are word-sized and a stale answer is re-checked under the lock before enqueueing.
+    size_t max_messages = kstl::atomic_load(&m_limits.max_messages, kstl::memory_order::relaxed);
+    size_t max_bytes = kstl::atomic_load(&m_limits.max_bytes, kstl::memory_order::relaxed);
+
+    return m_message_count.load(kstl::memory_order::acquire) + count <= max_messages &&
+           m_byte_count.load(kstl::memory_order::acquire) + bytes <= max_bytes;
+}
+
+void message_queue::_wait_for_room(size_t bytes) {
+    m_blocked_count.fetch_add(1, kstl::memory_order::relaxed);
+
+    mq_room_request request = { this, bytes };
+    sched::wait_queue* waiters[1] = { &m_room_waiters };
+    sched::wait_event(waiters, 1, WAIT_FOREVER, _poll_room, &request);
+}
+
+bool message_queue::_try_coalesce(const mq_message* message) {
+    // Without a rule nothing merges, don't bother copying the payload
+    if (!kstl::atomic_load(&m_coalesce_rule, kstl::memory_order::acquire)) {
+        return false;
     }
 
-    // Get the node at the head of the queue
-    mq_node* node = m_head;
-    m_head = node->next;
+    mq_node* node = _alloc_node(message);
+    if (!node) {
+        return false;
+    }
 
-    if (!m_head) {
-        m_tail = nullptr;  // Queue is now empty
+    bool merged = false;
+
+    if (node->coalesce_key != MQ_COALESCE_NONE) {
+        mutex_guard guard(m_lock);
+
+        // Only the merge path of the enqueue is allowed here, appending needs room
+        if (m_tail && m_tail->coalesce_key == node->coalesce_key) {
+            merged = _enqueue_node_locked(node);
+        }
+    }
+
+    if (!merged) {
+        _free_node(node);
+        return false;
     }
 
-    // Copy the message metadata
-    out_message->message_id = node->message->message_id;
-    out_message->payload_size = node->message->payload_size;
+    // Receivers see the newer payload
+    m_waiters.wake_all();
+    return true;
+}
+
+bool message_queue::_enqueue_node_locked(mq_node* node) {
+    size_t size = node->message.payload_size;
+
+    // The newest pending message is superseded by one of the same class
+    if (m_tail && node->coalesce_key != MQ_COALESCE_NONE && m_tail->coalesce_key == node->coalesce_key) {
+        size_t bytes = m_byte_count.load(kstl::memory_order::relaxed) - m_tail->message.payload_size + size;
+        if (bytes > m_limits.max_bytes && m_limits.policy != mq_overflow_policy::DROP_OLDEST) {
+            return false;
+        }
+
+        node->message.message_id = m_next_message_id++;
 
-    // Allocate memory for the payload in the output message
-    out_message->payload = new uint8_t[node->message->payload_size];
-    if (!out_message->payload) {
-        delete node->message->payload;
-        delete node->message;
+        delete[] m_tail->message.payload;
+        m_tail->message = node->message;
         delete node;
-        return false;  // Allocation failed
+
+        m_byte_count.store(bytes, kstl::memory_order::relaxed);
+        ++m_posted_count;
+        ++m_coalesced_count;
+        return true;
     }
 
-    // Copy the payload
-    memcpy(out_message->payload, node->message->payload, node->message->payload_size);
+    if (m_limits.policy == mq_overflow_policy::DROP_OLDEST) {
+        while (m_head && !_has_room(1, size)) {
+            _drop_oldest_locked();
+        }
+    } else if (!_has_room(1, size)) {
+        return false;
+    }
 
-    // Free the message and node memory
-    delete[] node->message->payload;
-    delete node->message;
-    delete node;
+    node->message.message_id = m_next_message_id++;
+
+    // Append the new node to the end of the queue
+    if (!m_tail) {
+        kstl::atomic_store(&m_head, node, kstl::memory_order::release);
+    } else {
+        m_tail->next = node;
+    }
+
+    m_tail = node;
 
+    size_t depth = m_message_count.load(kstl::memory_order::relaxed) + 1;
+    m_message_count.store(depth, kstl::memory_order::relaxed);
+    m_byte_count.store(m_byte_count.load(kstl::memory_order::relaxed) + size, kstl::memory_order::relaxed);
+
+    if (depth > m_high_water_mark) {
+        m_high_water_mark = depth;
+    }
+
+    ++m_posted_count;
     return true;
 }
 
+void message_queue::_drop_oldest_locked() {
+    mq_node* node = m_head;
+    kstl::atomic_store(&m_head, node->next, kstl::memory_order::release);
+
+    if (!m_head) {
+        m_tail = nullptr;
+    }
+
+    m_message_count.store(m_message_count.load(kstl::memory_order::relaxed) - 1, kstl::memory_order::relaxed);
+    m_byte_count.store(m_byte_count.load(kstl::memory_order::relaxed) - node->message.payload_size, kstl::memory_order::relaxed);
+    ++m_dropped_count;
+
+    _free_node(node);
+}
 } // namespace ipc
@@ -383,6 +383,96 @@ uintptr_t get_physical_address(void* vaddr) {
     return phys_base + offset;
 }
 
+__PRIVILEGED_CODE
+bool is_user_range(uintptr_t vaddr, size_t size, page_table* pml4) {
+    if (!vaddr || !size || vaddr + size < vaddr) {
+        return false;
+    }
+
+    // Both ends have to be canonical and in the same half, otherwise the
+    // walk below would alias the non-canonical hole onto real mappings.
+    uint64_t first_high_bits = static_cast<uint64_t>(static_cast<int64_t>(vaddr) >> 47);
+    uint64_t last_high_bits = static_cast<uint64_t>(static_cast<int64_t>(vaddr + size - 1) >> 47);
+    if ((first_high_bits != 0 && first_high_bits != ~0ull) || first_high_bits != last_high_bits) {
+        return false;
+    }
+
+    if (!pml4) {
+        pml4 = get_pml4();
+    }
+
+    page_table* pml4_table = reinterpret_cast<page_table*>(phys_to_virt_linear(pml4));
+    uintptr_t end = vaddr + size;
+
+    for (uintptr_t page = PAGE_ALIGN_DOWN(vaddr); page < end; ) {
+        virt_addr_indices_t indices = get_vaddr_page_table_indices(page);
+
+        pte_t* entry = &pml4_table->entries[indices.pml4];
+        if (!entry->present || !entry->user_supervisor) {
+            return false;
+        }
+
+        page_table* pdpt = reinterpret_cast<page_table*>(phys_to_virt_linear(PFN_TO_ADDR(entry->page_frame_number)));
+        entry = &pdpt->entries[indices.pdpt];
+        if (!entry->present || !entry->user_supervisor) {
+            return false;
+        }
+
+        // 1GB large page
+        if (entry->value & PTE_PS) {
+            page = (page & ~0x3FFFFFFFull) + 0x40000000;
+            continue;
+        }
+
+        page_table* pdt = reinterpret_cast<page_table*>(phys_to_virt_linear(PFN_TO_ADDR(entry->page_frame_number)));
+        entry = &pdt->entries[indices.pdt];
+        if (!entry->present || !entry->user_supervisor) {
+            return false;
+        }
+
+        // 2MB large page
+        if (entry->value & PTE_PS) {
+            page = (page & ~0x1FFFFFull) + LARGE_PAGE_SIZE;
+            continue;
+        }
+
+        page_table* pt = reinterpret_cast<page_table*>(phys_to_virt_linear(PFN_TO_ADDR(entry->page_frame_number)));
+        entry = &pt->entries[indices.pt];
+        if (!entry->present || !entry->user_supervisor) {
+            return false;
+        }
+
+        page += PAGE_SIZE;
+    }
+
+    return true;
+}
+
+__PRIVILEGED_CODE
+bool is_user_string(uintptr_t vaddr, size_t max_length, page_table* pml4) {
+    size_t scanned = 0;
+
+    while (scanned < max_length) {
+        // Validate one page at a time, the terminator may come before the end of the range
+        uintptr_t chunk_start = vaddr + scanned;
+        size_t chunk_size = kstl::min(PAGE_SIZE - (chunk_start & (PAGE_SIZE - 1)), max_length - scanned);
+        if (!is_user_range(chunk_start, chunk_size, pml4)) {
+            return false;
+        }
+
+        const char* chunk = reinterpret_cast<const char*>(chunk_start);
+        for (size_t i = 0; i < chunk_size; i++) {
+            if (chunk[i] == '\0') {
+                return true;
+            }
+        }
+
+        scanned += chunk_size;
+    }
+
+    return false;
+}
+
 __PRIVILEGED_CODE
 page_table* create_higher_class_userland_page_table() {
     // Get the current page table
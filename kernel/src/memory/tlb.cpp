@@ -0,0 +1,71 @@
+#include <memory/tlb.h>
+#include <interrupts/irq.h>
+#include <sched/sched.h>
+#include <sync.h>
+
+#ifdef ARCH_X86_64
+#include <arch/x86/apic/lapic.h>
+#endif
+
+// Vector of the IPI that makes other CPUs flush their TLB
+#define TLB_SHOOTDOWN_IRQ IRQ19
+
+namespace paging {
+// CPUs that still have to flush for the shootdown in flight
+__PRIVILEGED_DATA kstl::atomic<uint64_t> g_tlb_shootdown_pending;
+
+// Only one shootdown is in flight at a time
+DECLARE_GLOBAL_OBJECT(mutex, g_tlb_shootdown_lock);
+
+DEFINE_INT_HANDLER(irq_handler_tlb_shootdown) {
+    __unused regs;
+    __unused cookie;
+
+    tlb_flush_all();
+    g_tlb_shootdown_pending.fetch_and(~(1ull << current->cpu), kstl::memory_order::release);
+
+    return IRQ_HANDLED;
+}
+
+__PRIVILEGED_CODE
+void install_tlb_shootdown_handler() {
+    // flags = 1 for fast apic EOI path on x86
+    register_irq_handler(TLB_SHOOTDOWN_IRQ, irq_handler_tlb_shootdown, 1, nullptr);
+}
+
+__PRIVILEGED_CODE
+void tlb_shootdown() {
+    mutex_guard guard(g_tlb_shootdown_lock);
+
+    tlb_flush_all();
+
+#ifdef ARCH_X86_64
+    sched::scheduler& scheduler = sched::scheduler::get();
+    uint64_t self_cpu = current->cpu;
+    uint64_t targets = 0;
+
+    // CPUs without a run queue aren't online yet and have nothing cached
+    for (uint64_t cpu = 0; cpu < MAX_SYSTEM_CPUS; cpu++) {
+        if (cpu != self_cpu && scheduler.get_run_queue(cpu) && arch::x86::lapic::get(cpu).get()) {
+            targets |= 1ull << cpu;
+        }
+    }
+
+    if (!targets) {
+        return;
+    }
+
+    g_tlb_shootdown_pending.store(targets, kstl::memory_order::release);
+
+    for (uint64_t cpu = 0; cpu < MAX_SYSTEM_CPUS; cpu++) {
+        if (targets & (1ull << cpu)) {
+            arch::x86::lapic::get()->send_ipi(arch::x86::lapic::get(cpu)->apic_id(), TLB_SHOOTDOWN_IRQ);
+        }
+    }
+
+    while (g_tlb_shootdown_pending.load(kstl::memory_order::acquire)) {
+        asm volatile ("pause");
+    }
+#endif
+}
+} // namespace paging
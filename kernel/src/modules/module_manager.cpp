@@ -4,6 +4,7 @@
 #include <sched/sched.h>
 #include <serial/serial.h>
 #include <dynpriv/dynpriv.h>
+#include <rcu.h>
 
 namespace modules {
 module_manager g_global_module_manager;
@@ -19,6 +20,8 @@ bool module_manager::register_module(const kstl::shared_ptr<module_base>& mod) {
         return false;
     }
 
+    mutex_guard guard(m_modules_lock);
+
     // Check if a module with the same name is already registered
     module_base* existing = find_module(mod->name());
     if (existing != nullptr) {
@@ -30,7 +33,13 @@ bool module_manager::register_module(const kstl::shared_ptr<module_base>& mod) {
     // Set the module state to indicate that it has been loaded into the system
     mod->m_state = module_state::loaded;
 
-    m_modules.push_back(mod);
+    auto new_list = m_modules
+        ? new kstl::vector<kstl::shared_ptr<module_base>>(*m_modules)
+        : new kstl::vector<kstl::shared_ptr<module_base>>();
+
+    new_list->push_back(mod);
+    _publish_module_list(new_list);
+
     return true;
 }
 
@@ -40,13 +49,17 @@ bool module_manager::unregister_module(module_base* mod) {
         return false;
     }
 
-    for (size_t i = 0; i < m_modules.size(); i++) {
-        if (m_modules[i].get() == mod) {
-            m_modules.erase(i);
+    mutex_guard guard(m_modules_lock);
+
+    for (size_t i = 0; m_modules && i < m_modules->size(); i++) {
+        if ((*m_modules)[i].get() == mod) {
+            auto new_list = new kstl::vector<kstl::shared_ptr<module_base>>(*m_modules);
+            new_list->erase(i);
 
             // Set the module state to indicate that it has been unloaded
             mod->m_state = module_state::unloaded;
 
+            _publish_module_list(new_list);
             return true;
         }
     }
@@ -133,16 +146,33 @@ module_base* module_manager::find_module(const kstl::string& name) {
         return nullptr;
     }
 
-    for (size_t i = 0; i < m_modules.size(); i++) {
-        const kstl::string& mod_name = m_modules[i]->name();
+    rcu::read_guard guard;
+
+    auto modules = rcu::dereference(m_modules);
+    if (!modules) {
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < modules->size(); i++) {
+        const kstl::string& mod_name = (*modules)[i]->name();
         if (mod_name == name) {
-            return m_modules[i].get();
+            return (*modules)[i].get();
         }
     }
 
     return nullptr;
 }
 
+void module_manager::_publish_module_list(kstl::vector<kstl::shared_ptr<module_base>>* new_list) {
+    auto old_list = m_modules;
+    rcu::assign_pointer(m_modules, new_list);
+
+    if (old_list) {
+        rcu::synchronize();
+        delete old_list;
+    }
+}
+
 void module_manager::_module_start_task_entry(module_base* mod) {
     if (!mod->init()) {
         mod->m_state = module_state::error;
@@ -230,17 +230,26 @@ void* elf64_loader::_allocate_and_map_segment(
 
 uint8_t* elf64_loader::_read_file(const char* file_path, size_t& file_size) {
     auto& vfs = fs::virtual_filesystem::get();
-    fs::vfs_stat_struct stat;
+
+    // Resolve the path once, the stat and read below work on the open file
+    int fd = vfs.open(file_path, FS_O_RDONLY);
+    if (fd < 0) {
+        _log_error("Failed to open file.");
+        return nullptr;
+    }
 
     // Get file stats
-    if (vfs.stat(file_path, stat) != fs::fs_error::success) {
+    fs::vfs_stat_struct stat;
+    if (vfs.fstat(fd, stat) != fs::fs_error::success) {
         _log_error("Failed to stat file.");
+        vfs.close(fd);
         return nullptr;
     }
 
     file_size = stat.size;
     if (file_size == 0) {
         _log_error("File is empty.");
+        vfs.close(fd);
         return nullptr;
     }
 
@@ -248,12 +257,17 @@ uint8_t* elf64_loader::_read_file(const char* file_path, size_t& file_size) {
     uint8_t* buffer = reinterpret_cast<uint8_t*>(zmalloc(file_size));
     if (!buffer) {
         _log_error("Failed to allocate memory for file.");
+        vfs.close(fd);
         return nullptr;
     }
 
     // Read file into buffer
-    if (!vfs.read(file_path, buffer, file_size, 0)) {
+    ssize_t bytes_read = vfs.read(fd, buffer, file_size);
+    vfs.close(fd);
+
+    if (bytes_read != static_cast<ssize_t>(file_size)) {
         _log_error("Failed to read file into buffer.");
+        free(buffer);
         return nullptr;
     }
 
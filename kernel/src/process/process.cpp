@@ -1,14 +1,29 @@
 #include <process/process.h>
+#include <rcu.h>
 #include <memory/memory.h>
 #include <memory/vmm.h>
 #include <memory/paging.h>
 #include <arch/x86/gdt/gdt.h>
+#include <arch/x86/fpu.h>
 #include <sched/sched.h>
 #include <dynpriv/dynpriv.h>
+#include <interrupts/irq.h>
+#include <ipc/handle_table.h>
+#include <ipc/endpoint.h>
+#include <fs/fd_table.h>
+#include <fs/io_ring.h>
+#include <fs/mmap.h>
 
 DEFINE_PER_CPU(task_control_block*, current_task);
 DEFINE_PER_CPU(uint64_t, current_system_stack);
 
+EXTERN_C __PRIVILEGED_CODE void asm_switch_to(
+    ptregs* from_ctx,
+    ptregs* to_ctx,
+    uint8_t* from_on_cpu,
+    uint64_t scratch_stack_top
+);
+
 #define SCHED_STACK_TOP_PADDING     0x80
 
 #define SCHED_SYSTEM_STACK_PAGES    2
@@ -32,6 +47,39 @@ pid_t alloc_task_pid() {
     return g_available_task_pid++;
 }
 
+// List of every task that got created and not yet destroyed
+DECLARE_GLOBAL_OBJECT(spinlock, g_task_list_lock);
+__PRIVILEGED_DATA task_control_block* g_task_list_head = nullptr;
+
+__PRIVILEGED_CODE
+static void _register_task(task_control_block* task) {
+    spinlock_irqsave_guard guard(g_task_list_lock);
+
+    task->tasks_prev = nullptr;
+    task->tasks_next = g_task_list_head;
+    if (g_task_list_head) {
+        g_task_list_head->tasks_prev = task;
+    }
+    g_task_list_head = task;
+}
+
+__PRIVILEGED_CODE
+static void _unregister_task(task_control_block* task) {
+    spinlock_irqsave_guard guard(g_task_list_lock);
+
+    if (task->tasks_prev) {
+        task->tasks_prev->tasks_next = task->tasks_next;
+    } else if (g_task_list_head == task) {
+        g_task_list_head = task->tasks_next;
+    } else {
+        return; // Never registered
+    }
+
+    if (task->tasks_next) {
+        task->tasks_next->tasks_prev = task->tasks_prev;
+    }
+}
+
 // Saves context registers from the interrupt frame into a CPU context struct
 __PRIVILEGED_CODE
 void save_cpu_context(ptregs* process_context, ptregs* irq_frame) {
@@ -44,6 +92,17 @@ void restore_cpu_context(ptregs* process_context, ptregs* irq_frame) {
     memcpy(irq_frame, process_context, sizeof(ptregs));
 }
 
+// Marks the task as running on this CPU, waiting for another CPU
+// to finish switching away from the task first if necessary.
+__PRIVILEGED_CODE
+static void _claim_task_cpu(task_control_block* task) {
+    uint8_t expected = 0;
+    while (!task->on_cpu.compare_exchange_weak(expected, 1, kstl::memory_order::acquire)) {
+        expected = 0;
+        asm volatile ("pause");
+    }
+}
+
 // Saves and restores necessary registers into the appropriate
 // process control blocks using an interrupt frame.
 // *Note* Meant to be called from within an interrupt handler
@@ -59,6 +118,9 @@ void switch_context_in_irq(
     __unused old_cpu;
     __unused new_cpu;
 
+    // Wait for the CPU that last ran the task to get off of its stacks
+    _claim_task_cpu(to);
+
     // Save the current context into the 'from' TCB
     save_cpu_context(&from->cpu_context, irq_frame);
 
@@ -68,12 +130,27 @@ void switch_context_in_irq(
     // Restore the context from the 'to' TCB
     restore_cpu_context(&to->cpu_context, irq_frame);
 
+    // Save extended register state if it was touched and arm the lazy restore
+    arch::x86::fpu_switch_context(from, to);
+
     // Perform an address space switch if needed
     if (from->mm_ctx.root_page_table != to->mm_ctx.root_page_table) {
         install_mm_context(to->mm_ctx);
         memory_barrier();
     }
 
+    // Explicit scheduler interrupts and tasks that block are voluntary switches, the rest are preemptions
+    bool voluntary = irq_frame->intno == IRQ16 || from->state != process_state::RUNNING;
+
+    // Keep the running state up to date, adaptive locks rely
+    // on it to decide whether spinning on an owner pays off.
+    if (from->state == process_state::RUNNING) {
+        from->state = process_state::READY;
+    }
+    to->state = process_state::RUNNING;
+
+    account_task_switch(from, to, voluntary);
+
     // Set the new value of current_task for the current CPU
     this_cpu_write(current_task, to);
 
@@ -81,6 +158,47 @@ void switch_context_in_irq(
     this_cpu_write(current_system_stack, to->system_stack_top);
 }
 
+// Switches directly into another task outside of interrupt context.
+// *Note* Returns only once the 'from' task gets scheduled again.
+__PRIVILEGED_CODE
+void switch_to(task_control_block* from, task_control_block* to) {
+    _claim_task_cpu(to);
+
+    // Save the current MMU context into the 'from' TCB
+    from->mm_ctx = save_mm_context();
+
+    // Save extended register state if it was touched and arm the lazy restore
+    arch::x86::fpu_switch_context(from, to);
+
+    // Perform an address space switch if needed
+    if (from->mm_ctx.root_page_table != to->mm_ctx.root_page_table) {
+        install_mm_context(to->mm_ctx);
+        memory_barrier();
+    }
+
+    if (from->state == process_state::RUNNING) {
+        from->state = process_state::READY;
+    }
+    to->state = process_state::RUNNING;
+
+    account_task_switch(from, to, true);
+
+    this_cpu_write(current_task, to);
+    this_cpu_write(current_system_stack, to->system_stack_top);
+
+    // Preempted tasks have a full register frame that gets restored with an iretq. It's
+    // staged on this CPU's own system stack, which isn't in use while interrupts are off
+    // and is never touched by other CPUs, unlike the stacks of the tasks involved.
+    uint64_t scratch_stack_top = get_idle_task(from->cpu)->system_stack_top;
+
+    asm_switch_to(
+        &from->cpu_context,
+        &to->cpu_context,
+        reinterpret_cast<uint8_t*>(&from->on_cpu),
+        scratch_stack_top
+    );
+}
+
 __PRIVILEGED_CODE
 task_control_block* create_priv_kernel_task(task_entry_fn_t entry, void* task_data) {
     task_control_block* task = new task_control_block();
@@ -92,6 +210,7 @@ task_control_block* create_priv_kernel_task(task_entry_fn_t entry, void* task_da
     task->state = process_state::READY;
     task->pid = alloc_task_pid();
     task->elevated = 1;
+    task->cpu_affinity = CPU_AFFINITY_ALL;
 
     // Allocate the primary execution task stack
     void* task_stack = vmm::alloc_contiguous_virtual_pages(SCHED_TASK_STACK_PAGES, DEFAULT_PRIV_PAGE_FLAGS);
@@ -128,6 +247,7 @@ task_control_block* create_priv_kernel_task(task_entry_fn_t entry, void* task_da
     // Setup the page table
     task->mm_ctx.root_page_table = reinterpret_cast<uint64_t>(paging::get_pml4());
 
+    _register_task(task);
     return task;
 }
 
@@ -142,6 +262,7 @@ task_control_block* create_unpriv_kernel_task(task_entry_fn_t entry, void* task_
     task->state = process_state::READY;
     task->pid = alloc_task_pid();
     task->elevated = 0;
+    task->cpu_affinity = CPU_AFFINITY_ALL;
 
     // Allocate the primary execution task stack
     void* task_stack = vmm::alloc_contiguous_virtual_pages(SCHED_TASK_STACK_PAGES, DEFAULT_UNPRIV_PAGE_FLAGS);
@@ -178,6 +299,7 @@ task_control_block* create_unpriv_kernel_task(task_entry_fn_t entry, void* task_
     // Setup the page table
     task->mm_ctx.root_page_table = reinterpret_cast<uint64_t>(paging::get_pml4());
 
+    _register_task(task);
     return task;
 }
 
@@ -195,6 +317,7 @@ task_control_block* create_upper_class_userland_task(
     task->state = process_state::READY;
     task->pid = alloc_task_pid();
     task->elevated = 0;
+    task->cpu_affinity = CPU_AFFINITY_ALL;
 
     // Allocate the system stack used for sensitive system and interrupt contexts
     task->system_stack = allocate_system_stack(task->system_stack_top);
@@ -209,6 +332,43 @@ task_control_block* create_upper_class_userland_task(
         return nullptr;
     }
 
+    // Userland code is free to use SSE/AVX, so it needs a place to save that state
+    if (!arch::x86::fpu_alloc_task_state(task)) {
+        vmm::unmap_contiguous_virtual_pages(reinterpret_cast<uintptr_t>(task->system_stack), SCHED_SYSTEM_STACK_PAGES);
+        delete task;
+        return nullptr;
+    }
+
+    // Every userland process resolves its IPC handles through a table of its own
+    task->handles = new ipc::handle_table();
+    if (!task->handles) {
+        arch::x86::fpu_free_task_state(task);
+        vmm::unmap_contiguous_virtual_pages(reinterpret_cast<uintptr_t>(task->system_stack), SCHED_SYSTEM_STACK_PAGES);
+        delete task;
+        return nullptr;
+    }
+
+    // File descriptors are per-process as well
+    task->fds = new fs::fd_table();
+    if (!task->fds) {
+        delete task->handles;
+        arch::x86::fpu_free_task_state(task);
+        vmm::unmap_contiguous_virtual_pages(reinterpret_cast<uintptr_t>(task->system_stack), SCHED_SYSTEM_STACK_PAGES);
+        delete task;
+        return nullptr;
+    }
+
+    // As are file mappings, which live in the process's own page table
+    task->mmaps = new fs::mmap_table(reinterpret_cast<uint64_t>(pt));
+    if (!task->mmaps) {
+        delete task->fds;
+        delete task->handles;
+        arch::x86::fpu_free_task_state(task);
+        vmm::unmap_contiguous_virtual_pages(reinterpret_cast<uintptr_t>(task->system_stack), SCHED_SYSTEM_STACK_PAGES);
+        delete task;
+        return nullptr;
+    }
+
     // Initialize the CPU context
     task->cpu_context.hwframe.rip = entry_addr;             // Set instruction pointer to the task function
     task->cpu_context.hwframe.rflags = 0x200;               // Enable interrupts
@@ -225,6 +385,7 @@ task_control_block* create_upper_class_userland_task(
     // Setup the page table
     task->mm_ctx.root_page_table = reinterpret_cast<uint64_t>(pt);
 
+    _register_task(task);
     return task;
 }
 
@@ -234,16 +395,48 @@ bool destroy_task(task_control_block* task) {
         return false;
     }
 
+    _unregister_task(task);
+
     // Destroy the stacks
     vmm::unmap_contiguous_virtual_pages(reinterpret_cast<uintptr_t>(task->task_stack), SCHED_TASK_STACK_PAGES);
     vmm::unmap_contiguous_virtual_pages(reinterpret_cast<uintptr_t>(task->system_stack), SCHED_SYSTEM_STACK_PAGES);
 
+    // Destroy the extended register save area
+    arch::x86::fpu_free_task_state(task);
+
+    // The ring's worker has to stop using the descriptor table before it goes away
+    delete task->io_ring;
+
+    // Shared copies get written back while the files are still open
+    delete task->mmaps;
+
+    // Close every handle and file the process still holds
+    delete task->handles;
+    delete task->ipc_buffer;
+    delete task->fds;
+
+    // IPC handoffs may still be switching to the task through a pointer read inside a read-side section
+    rcu::synchronize();
+
     // Free the actual task structure
     delete task;
 
     return true;
 }
 
+__PRIVILEGED_CODE
+size_t get_task_stats(task_stats_info* buffer, size_t max_entries) {
+    spinlock_irqsave_guard guard(g_task_list_lock);
+
+    size_t count = 0;
+    for (task_control_block* task = g_task_list_head; task && count < max_entries; task = task->tasks_next) {
+        task_stats_info* info = &buffer[count++];
+        fill_task_stats_info(task, info);
+    }
+
+    return count;
+}
+
 __PRIVILEGED_CODE
 uint64_t allocate_system_stack(uint64_t& out_stack_top) {
     void* stack = vmm::alloc_linear_mapped_persistent_pages(SCHED_SYSTEM_STACK_PAGES);
@@ -292,10 +485,8 @@ void exit_thread() {
 
     auto& scheduler = sched::scheduler::get();
 
-    // First disable the timer IRQs to avoid bugs
-    // that could come from an unexpected context
-    // switch here.
-    scheduler.preempt_disable();
+    // Preemption doesn't have to be disabled here, once the task is off of
+    // the run queue, getting preempted just switches away from it for good.
 
     // Indicate that this task is ready to be reaped
     current->state = process_state::TERMINATED;
@@ -1,60 +1,152 @@
 #include <sched/run_queue.h>
 
 namespace sched {
-sched_run_queue::sched_run_queue() : m_next_index(0) {}
+sched_run_queue::sched_run_queue() : m_head(nullptr), m_tail(nullptr), m_count(0) {
+    m_lock.enable_stats("sched_run_queue");
+}
 
 void sched_run_queue::add_task(task_control_block* task) {
-    mutex_guard guard(m_lock); // Automatically acquires and releases the lock
-    m_tasks.push_back(task);
-}
+    spinlock_irqsave_guard guard(m_lock);
 
-void sched_run_queue::remove_task(task_control_block* task) {
-    mutex_guard guard(m_lock);
+    if (task->on_run_queue) {
+        return;
+    }
 
-    // Search for the task and remove it
-    for (size_t i = 0; i < m_tasks.size(); ++i) {
-        if (m_tasks[i] == task) {
-            m_tasks.erase(i);
+    _append(task);
+}
 
-            // Adjust the round-robin index if needed
-            if (i < m_next_index && m_next_index > 0) {
-                --m_next_index;
-            } else if (m_next_index >= m_tasks.size()) {
-                m_next_index = 0;
-            }
+void sched_run_queue::remove_task(task_control_block* task) {
+    spinlock_irqsave_guard guard(m_lock);
 
-            return;
-        }
+    if (!task->on_run_queue) {
+        return;
     }
+
+    _unlink(task);
 }
 
 task_control_block* sched_run_queue::pick_next() {
-    mutex_guard guard(m_lock);
+    spinlock_irqsave_guard guard(m_lock);
 
-    if (m_tasks.empty()) {
+    if (!m_head) {
         return nullptr; // No task to run
     }
 
-    size_t original_index = m_next_index;
-
     // Attempt to find a non-idle task
-    do {
-        task_control_block* next_task = m_tasks[m_next_index];
-        m_next_index = (m_next_index + 1) % m_tasks.size();
+    task_control_block* next_task = m_head;
+    while (next_task && next_task->pid == 0) { // Assuming idle task has pid 0
+        next_task = next_task->rq_next;
+    }
+
+    // If we only have the idle task, return it
+    if (!next_task) {
+        return m_head;
+    }
 
-        // Check if this is a non-idle task
-        if (next_task->pid != 0) { // Assuming idle task has pid 0
-            return next_task;
+    // Rotate the picked task to the back of the queue
+    // to cycle through tasks in a round-robin fashion.
+    _unlink(next_task);
+    _append(next_task);
+
+    return next_task;
+}
+
+task_control_block* sched_run_queue::steal_task(int cpu) {
+    spinlock_irqsave_guard guard(m_lock);
+
+    for (task_control_block* task = m_head; task; task = task->rq_next) {
+        // Idle tasks, running tasks and tasks that aren't allowed on the CPU stay put
+        if (task->pid == 0 || task->state != process_state::READY || task->on_cpu.load()) {
+            continue;
         }
 
-    } while (m_next_index != original_index); // Ensure we loop back to the original position
+        if (!(task->cpu_affinity & (1ull << cpu))) {
+            continue;
+        }
 
-    // If we only have the idle task, return it
-    return m_tasks[original_index];
+        _unlink(task);
+        return task;
+    }
+
+    return nullptr;
+}
+
+bool sched_run_queue::pick_task(task_control_block* task) {
+    spinlock_irqsave_guard guard(m_lock);
+
+    if (!_contains(task) || task->state != process_state::READY) {
+        return false;
+    }
+
+    _unlink(task);
+    _append(task);
+    return true;
+}
+
+bool sched_run_queue::take_task(task_control_block* task, int cpu) {
+    spinlock_irqsave_guard guard(m_lock);
+
+    // Same rules as for stealing, the task must be waiting and allowed on the CPU
+    if (!_contains(task) || task->state != process_state::READY || task->on_cpu.load()) {
+        return false;
+    }
+
+    if (!(task->cpu_affinity & (1ull << cpu))) {
+        return false;
+    }
+
+    _unlink(task);
+    return true;
 }
 
 bool sched_run_queue::is_empty() {
-    mutex_guard guard(m_lock);
-    return m_tasks.empty();
+    spinlock_irqsave_guard guard(m_lock);
+    return m_head == nullptr;
+}
+
+bool sched_run_queue::_contains(task_control_block* task) {
+    // The task's CPU field can change without this queue's lock held, so
+    // membership is only trusted after finding the task in the list itself.
+    for (task_control_block* entry = m_head; entry; entry = entry->rq_next) {
+        if (entry == task) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void sched_run_queue::_append(task_control_block* task) {
+    task->rq_next = nullptr;
+    task->rq_prev = m_tail;
+
+    if (m_tail) {
+        m_tail->rq_next = task;
+    } else {
+        m_head = task;
+    }
+
+    m_tail = task;
+    task->on_run_queue = true;
+    ++m_count;
+}
+
+void sched_run_queue::_unlink(task_control_block* task) {
+    if (task->rq_prev) {
+        task->rq_prev->rq_next = task->rq_next;
+    } else {
+        m_head = task->rq_next;
+    }
+
+    if (task->rq_next) {
+        task->rq_next->rq_prev = task->rq_prev;
+    } else {
+        m_tail = task->rq_prev;
+    }
+
+    task->rq_next = nullptr;
+    task->rq_prev = nullptr;
+    task->on_run_queue = false;
+    --m_count;
 }
 } // namespace sched
@@ -1,18 +1,113 @@
 #include <sched/sched.h>
+#include <sched/wait_queue.h>
 #include <interrupts/irq.h>
 #include <time/time.h>
 #include <serial/serial.h>
+#include <rcu.h>
+#include <dynpriv/dynpriv.h>
 
 #ifdef ARCH_X86_64
 #include <arch/x86/apic/lapic.h>
 #endif
 
+// IPI vector used to make another CPU reschedule
+#define SCHED_RESCHEDULE_IRQ IRQ18
+
+DEFINE_PER_CPU(uint64_t, preempt_count);
+DEFINE_PER_CPU(uint64_t, need_resched);
+
 namespace sched {
 DEFINE_INT_HANDLER(irq_handler_timer);
 DEFINE_INT_HANDLER(irq_handler_schedule);
+DEFINE_INT_HANDLER(irq_handler_resched_ipi);
 
 task_control_block g_idle_tasks[MAX_SYSTEM_CPUS];
 
+__PRIVILEGED_DATA kstl::atomic<sched_switch_tracepoint_t> g_sched_switch_tracepoint;
+__PRIVILEGED_DATA kstl::atomic<sched_wakeup_tracepoint_t> g_sched_wakeup_tracepoint;
+
+// Runtime including the slice that is currently in progress
+static uint64_t _task_runtime(task_control_block* task) {
+    uint64_t runtime = task->sched_stats.runtime;
+    if (task->state == process_state::RUNNING && task->sched_stats.last_switch_in) {
+        runtime += rdtsc() - task->sched_stats.last_switch_in;
+    }
+
+    return runtime;
+}
+
+__PRIVILEGED_CODE
+void register_sched_tracepoints(sched_switch_tracepoint_t on_switch, sched_wakeup_tracepoint_t on_wakeup) {
+    g_sched_switch_tracepoint.store(on_switch);
+    g_sched_wakeup_tracepoint.store(on_wakeup);
+}
+
+__PRIVILEGED_CODE
+void account_task_switch(task_control_block* from, task_control_block* to, bool voluntary) {
+    uint64_t now = rdtsc();
+
+    task_sched_stats& out = from->sched_stats;
+    if (out.last_switch_in) {
+        out.runtime += now - out.last_switch_in;
+    }
+
+    if (voluntary) {
+        ++out.nr_voluntary_switches;
+    } else {
+        ++out.nr_involuntary_switches;
+    }
+
+    // Preempted and yielding tasks start waiting for their next turn right away
+    out.ready_since = (from->state == process_state::READY) ? now : 0;
+
+    task_sched_stats& in = to->sched_stats;
+    if (in.ready_since) {
+        in.wait_time += now - in.ready_since;
+        in.ready_since = 0;
+    }
+    in.last_switch_in = now;
+
+    sched_switch_tracepoint_t hook = g_sched_switch_tracepoint.load(kstl::memory_order::relaxed);
+    if (hook) {
+        hook(from, to, voluntary);
+    }
+}
+
+__PRIVILEGED_CODE
+void fill_task_stats_info(task_control_block* task, task_stats_info* info) {
+    info->pid = task->pid;
+    info->cpu = task->cpu;
+    info->state = static_cast<uint32_t>(task->state);
+    info->runtime_ns = kernel_timer::tsc_cycles_to_ns(_task_runtime(task));
+    info->wait_time_ns = kernel_timer::tsc_cycles_to_ns(task->sched_stats.wait_time);
+    info->nr_voluntary_switches = task->sched_stats.nr_voluntary_switches;
+    info->nr_involuntary_switches = task->sched_stats.nr_involuntary_switches;
+
+    memcpy(info->name, task->name, sizeof(info->name) - 1);
+    info->name[sizeof(info->name) - 1] = '\0';
+}
+
+__PRIVILEGED_CODE
+size_t get_cpu_stats(cpu_stats_info* buffer, size_t max_entries) {
+    auto& scheduler = scheduler::get();
+    size_t count = 0;
+
+    for (uint64_t cpu = 0; cpu < MAX_SYSTEM_CPUS && count < max_entries; cpu++) {
+        sched_run_queue* rq = scheduler.get_run_queue(cpu);
+        if (!rq) {
+            continue;
+        }
+
+        cpu_stats_info* info = &buffer[count++];
+        info->cpu = cpu;
+        info->idle_time_ns = kernel_timer::tsc_cycles_to_ns(_task_runtime(&g_idle_tasks[cpu]));
+        info->nr_queued = rq->size();
+        info->isolated = scheduler.is_cpu_isolated(cpu);
+    }
+
+    return count;
+}
+
 __PRIVILEGED_CODE
 task_control_block* get_idle_task(uint64_t cpu) {
     if (cpu > MAX_SYSTEM_CPUS - 1) {
@@ -27,18 +122,21 @@ void install_sched_irq_handlers() {
     const uint8_t flags = 1;
     register_irq_handler(IRQ0, irq_handler_timer, flags, nullptr);
     register_irq_handler(IRQ16, irq_handler_schedule, flags, nullptr);
+    register_irq_handler(SCHED_RESCHEDULE_IRQ, irq_handler_resched_ipi, flags, nullptr);
 }
 
 DEFINE_INT_HANDLER(irq_handler_timer) {
+    __unused regs;
     __unused cookie;
 
-    // Only the BSP updates global time
+    // Only the BSP updates global time and expires timed waits
     if (current->cpu == BSP_CPU_ID) {
         kernel_timer::sched_irq_global_tick();
+        expire_wait_timeouts(kernel_timer::get_system_time_in_nanoseconds());
     }
 
-    // Call scheduler routines
-    scheduler::get().__schedule(regs);
+    // The time slice is over, the switch happens on IRQ exit if preemption is enabled
+    this_cpu_write(need_resched, static_cast<uint64_t>(1));
 
     return IRQ_HANDLED;
 }
@@ -50,6 +148,14 @@ DEFINE_INT_HANDLER(irq_handler_schedule) {
     return IRQ_HANDLED;
 }
 
+DEFINE_INT_HANDLER(irq_handler_resched_ipi) {
+    __unused regs;
+    __unused cookie;
+
+    // The sender already set need_resched, it's acted upon on IRQ exit
+    return IRQ_HANDLED;
+}
+
 __PRIVILEGED_CODE
 scheduler& scheduler::get() {
     GENERATE_STATIC_SINGLETON(scheduler);
@@ -79,8 +185,9 @@ void scheduler::unregister_cpu_run_queue(uint64_t cpu) {
 
 __PRIVILEGED_CODE
 void scheduler::add_task(task_control_block* task, int cpu) {
-    if (cpu == -1) {
-        cpu = _load_balance_find_cpu();
+    // Wakeups requeue on the task's last CPU, which its affinity may no longer allow
+    if (cpu == -1 || (task->pid != 0 && !(task->cpu_affinity & (1ull << cpu)))) {
+        cpu = _load_balance_find_cpu(task->cpu_affinity);
     }
 
     if (m_run_queues[cpu].get() == nullptr) {
@@ -88,32 +195,31 @@ void scheduler::add_task(task_control_block* task, int cpu) {
         return;
     }
 
-    // Mask the timer interrupts while adding the task to the queue
-    preempt_disable(cpu);
-
     // Prepare the task
     task->cpu = cpu;
     task->state = process_state::READY;
+    task->sched_stats.ready_since = rdtsc();
 
     // Atomically add the task to the run-queue of the target processor
     m_run_queues[cpu]->add_task(task);
 
-    // Unmask the timer interrupt and continue as usual
-    preempt_enable(cpu);
+    sched_wakeup_tracepoint_t hook = g_sched_wakeup_tracepoint.load(kstl::memory_order::relaxed);
+    if (hook) {
+        hook(task, cpu);
+    }
+
+    // Make sure an idle remote CPU notices the new task right away
+    if (cpu != static_cast<int>(current->cpu)) {
+        resched_cpu(cpu);
+    }
 }
 
 __PRIVILEGED_CODE
 void scheduler::remove_task(task_control_block* task) {
     int cpu = task->cpu;
 
-    // Mask the timer interrupts while removing the task from the queue
-    preempt_disable(cpu);
-
     // Atomically remove the task from the run-queue of the target processor
     m_run_queues[cpu]->remove_task(task);
-
-    // Unmask the timer interrupt and continue as usual
-    preempt_enable(cpu);
 }
 
 // Called from the IRQ interrupt context. Picks the
@@ -121,62 +227,274 @@ void scheduler::remove_task(task_control_block* task) {
 __PRIVILEGED_CODE
 void scheduler::__schedule(ptregs* irq_frame) {
     int cpu = current->cpu;
-    task_control_block* next = m_run_queues[cpu]->pick_next();
+
+    // Any pending reschedule request is satisfied by this pick
+    this_cpu_write(need_resched, static_cast<uint64_t>(0));
+
+    // Every scheduling point outside of a read-side critical section is an RCU quiescent state
+    rcu::note_quiescent_state(current);
+
+    task_control_block* next = _pick_next_task(cpu);
     if (next && next != current) {
+        rcu::note_context_switch(current);
         switch_context_in_irq(cpu, cpu, current, next, irq_frame);
     }
 }
 
+// Voluntary counterpart of __schedule, switches directly
+// into the next task without going through an interrupt.
+__PRIVILEGED_CODE
+void scheduler::_schedule_voluntary() {
+    uint64_t flags = save_and_disable_irqs();
+
+    task_control_block* task = current;
+    int cpu = task->cpu;
+
+    this_cpu_write(need_resched, static_cast<uint64_t>(0));
+
+    rcu::note_quiescent_state(task);
+
+    task_control_block* next = _pick_next_task(cpu);
+    if (next && next != task) {
+        rcu::note_context_switch(task);
+        switch_to(task, next);
+    }
+
+    restore_irq_flags(flags);
+}
+
+__PRIVILEGED_CODE
+bool scheduler::yield_to(task_control_block* target) {
+    if (!irqs_enabled()) {
+        return false;
+    }
+
+    uint64_t flags = save_and_disable_irqs();
+
+    task_control_block* task = current;
+    int cpu = task->cpu;
+    bool switched = false;
+
+    if (target != task) {
+        // Bring the target over if it's only waiting for its turn on another CPU
+        int target_cpu = target->cpu;
+        if (target_cpu != cpu && m_run_queues[target_cpu]->take_task(target, cpu)) {
+            target->cpu = cpu;
+            m_run_queues[cpu]->add_task(target);
+        }
+
+        if (static_cast<int>(target->cpu) == cpu && m_run_queues[cpu]->pick_task(target)) {
+            this_cpu_write(need_resched, static_cast<uint64_t>(0));
+
+            rcu::note_quiescent_state(task);
+            rcu::note_context_switch(task);
+            switch_to(task, target);
+            switched = true;
+        }
+    }
+
+    restore_irq_flags(flags);
+    return switched;
+}
+
 // Forces a new task to get scheduled and triggers a
 // context switch without the need for a timer tick.
 void scheduler::schedule() {
+    // Privileged callers in task context take the direct switch path, interrupt
+    // handlers and unprivileged callers go through the scheduler IRQ instead.
+    if (dynpriv::is_elevated() && irqs_enabled()) {
+        _schedule_voluntary();
+        return;
+    }
+
     asm volatile ("int $48");
 }
 
-// Masks timer tick-based interrupts
 __PRIVILEGED_CODE
-void scheduler::preempt_disable(int cpu) {
-    if (cpu == -1) {
-        cpu = current->cpu;
+void scheduler::preempt_disable() {
+    // Interrupt handlers always leave the count balanced, so a
+    // plain read-modify-write of the local count is safe here.
+    this_cpu_write(preempt_count, this_cpu_read(preempt_count) + 1);
+    kstl::atomic_signal_fence();
+}
+
+__PRIVILEGED_CODE
+void scheduler::preempt_enable() {
+    kstl::atomic_signal_fence();
+    uint64_t count = this_cpu_read(preempt_count) - 1;
+    this_cpu_write(preempt_count, count);
+
+    // Catch up on a reschedule that got deferred while preemption was disabled
+    if (count == 0 && this_cpu_read(need_resched) && irqs_enabled()) {
+        schedule();
+    }
+}
+
+__PRIVILEGED_CODE
+void scheduler::resched_cpu(int cpu) {
+    if (cpu == static_cast<int>(current->cpu)) {
+        this_cpu_write(need_resched, static_cast<uint64_t>(1));
+        return;
+    }
+
+    uint64_t* remote_need_resched = per_cpu_ptr(need_resched, cpu);
+    task_control_block** remote_current = per_cpu_ptr(current_task, cpu);
+    if (!remote_need_resched || !remote_current) {
+        return;
+    }
+
+    kstl::atomic_store(remote_need_resched, static_cast<uint64_t>(1), kstl::memory_order::release);
+
+    // A busy CPU picks the new task up on its next tick anyway, only a CPU sitting
+    // in its idle task or one without timer ticks needs to be interrupted.
+    task_control_block* remote_task = kstl::atomic_load(remote_current, kstl::memory_order::acquire);
+    if (remote_task != get_idle_task(cpu) && !is_cpu_isolated(cpu)) {
+        return;
     }
 
 #ifdef ARCH_X86_64
-    arch::x86::lapic::get(cpu)->mask_timer_irq();
+    auto& target = arch::x86::lapic::get(cpu);
+    if (target.get()) {
+        arch::x86::lapic::get()->send_ipi(target->apic_id(), SCHED_RESCHEDULE_IRQ);
+    }
 #endif
 }
 
-// Unmasks timer tick-based interrupts
 __PRIVILEGED_CODE
-void scheduler::preempt_enable(int cpu) {
-        if (cpu == -1) {
-        cpu = current->cpu;
+void scheduler::irq_exit_resched(ptregs* irq_frame) {
+    if (!this_cpu_read(need_resched) || this_cpu_read(preempt_count) != 0) {
+        return;
     }
 
-#ifdef ARCH_X86_64
-    arch::x86::lapic::get(cpu)->unmask_timer_irq();
-#endif
+    __schedule(irq_frame);
 }
 
-int scheduler::_load_balance_find_cpu() {
-    int optimal_cpu = 0;
-    size_t min_load = m_run_queues[0]->size();
+__PRIVILEGED_CODE
+bool scheduler::set_task_affinity(task_control_block* task, uint64_t affinity) {
+    uint64_t online = 0;
+    for (int i = 0; i < MAX_SYSTEM_CPUS; ++i) {
+        if (m_run_queues[i].get()) {
+            online |= (1ull << i);
+        }
+    }
+
+    if (!(affinity & online)) {
+        return false;
+    }
+
+    task->cpu_affinity = affinity;
+
+    int cpu = task->cpu;
+    if (affinity & (1ull << cpu)) {
+        return true;
+    }
+
+    // Migrate the calling task right away if its CPU is no longer allowed. It
+    // gets queued on the new CPU first, and the on_cpu handshake keeps that CPU
+    // from switching into it until the switch away from this CPU completes.
+    if (task == current) {
+        remove_task(task);
+        add_task(task);
+        schedule();
+        return true;
+    }
+
+    // A task waiting for its turn moves over right away. One that is running gets
+    // moved by its CPU's next pick, blocked tasks get placed by their wakeup.
+    int target_cpu = _load_balance_find_cpu(affinity);
+    if (m_run_queues[cpu].get() && m_run_queues[cpu]->take_task(task, target_cpu)) {
+        add_task(task, target_cpu);
+    } else {
+        resched_cpu(cpu);
+    }
+
+    return true;
+}
+
+__PRIVILEGED_CODE
+void scheduler::isolate_cpus(uint64_t cpu_mask) {
+    m_isolated_cpus = cpu_mask & ~(1ull << BSP_CPU_ID);
+}
+
+int scheduler::_load_balance_find_cpu(uint64_t affinity) {
+    uint64_t allowed = affinity & ~m_isolated_cpus;
+
+    // Tasks confined to isolated CPUs are balanced among those
+    bool any_housekeeping_cpu = false;
+    for (int i = 0; i < MAX_SYSTEM_CPUS; ++i) {
+        if (m_run_queues[i].get() && (allowed & (1ull << i))) {
+            any_housekeeping_cpu = true;
+            break;
+        }
+    }
+
+    if (!any_housekeeping_cpu) {
+        allowed = affinity;
+    }
+
+    int optimal_cpu = -1;
+    size_t min_load = 0;
 
     // Iterate over all CPUs to find the least loaded one
     for (int i = 0; i < MAX_SYSTEM_CPUS; ++i) {
-        // Skip over invalid queues
-        if (!m_run_queues[i].get()) {
+        // Skip over invalid queues and CPUs outside of the affinity mask
+        if (!m_run_queues[i].get() || !(allowed & (1ull << i))) {
             continue;
         }
 
         size_t load = m_run_queues[i]->size();
 
         // Check if this CPU has a lighter load
-        if (load < min_load) {
+        if (optimal_cpu == -1 || load < min_load) {
             min_load = load;
             optimal_cpu = i;
         }
     }
 
-    return optimal_cpu;
+    // No allowed CPU is online, fall back to the boot processor
+    return optimal_cpu == -1 ? BSP_CPU_ID : optimal_cpu;
+}
+
+__PRIVILEGED_CODE
+task_control_block* scheduler::_steal_task(int cpu) {
+    for (int i = 0; i < MAX_SYSTEM_CPUS; ++i) {
+        // Tasks on isolated CPUs were placed there on purpose
+        if (i == cpu || !m_run_queues[i].get() || is_cpu_isolated(i)) {
+            continue;
+        }
+
+        task_control_block* task = m_run_queues[i]->steal_task(cpu);
+        if (task) {
+            task->cpu = cpu;
+            m_run_queues[cpu]->add_task(task);
+            return task;
+        }
+    }
+
+    return nullptr;
+}
+
+__PRIVILEGED_CODE
+task_control_block* scheduler::_pick_next_task(int cpu) {
+    task_control_block* next = m_run_queues[cpu]->pick_next();
+
+    // Tasks whose affinity changed while they were running or queued here move on to
+    // an allowed CPU. The on_cpu handshake keeps the new CPU from switching into the
+    // current task before the switch away from it completes.
+    while (next && next->pid != 0 && !(next->cpu_affinity & (1ull << cpu))) {
+        m_run_queues[cpu]->remove_task(next);
+        add_task(next);
+        next = m_run_queues[cpu]->pick_next();
+    }
+
+    // Rather than idling, pull over a task that's waiting for its turn elsewhere
+    if (next && next->pid == 0 && !is_cpu_isolated(cpu)) {
+        task_control_block* stolen = _steal_task(cpu);
+        if (stolen) {
+            next = stolen;
+        }
+    }
+
+    return next;
 }
 } // namespace sched
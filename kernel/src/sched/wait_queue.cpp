@@ -0,0 +1,209 @@
+#include <sched/wait_queue.h>
+#include <sched/sched.h>
+#include <interrupts/irq.h>
+#include <time/time.h>
+#include <dynpriv/dynpriv.h>
+
+namespace sched {
+// Armed timeouts, sorted by deadline
+__PRIVILEGED_DATA wait_timeout* g_wait_timeouts_head;
+DECLARE_GLOBAL_OBJECT(spinlock, g_wait_timeouts_lock);
+
+// Makes the waiting task runnable again if nobody else claimed the wakeup yet
+__PRIVILEGED_CODE
+static void _wake_context(wait_context* ctx) {
+    if (ctx->woken.exchange(1, kstl::memory_order::acq_rel) != 0) {
+        return;
+    }
+
+    task_control_block* task = ctx->task;
+    scheduler::get().add_task(task, task->cpu);
+}
+
+__PRIVILEGED_CODE
+static void _arm_timeout(wait_timeout* timeout) {
+    spinlock_irqsave_guard guard(g_wait_timeouts_lock);
+
+    wait_timeout** link = &g_wait_timeouts_head;
+    while (*link && (*link)->deadline_ns <= timeout->deadline_ns) {
+        link = &(*link)->next;
+    }
+
+    timeout->next = *link;
+    timeout->armed = true;
+    *link = timeout;
+}
+
+__PRIVILEGED_CODE
+static void _cancel_timeout(wait_timeout* timeout) {
+    spinlock_irqsave_guard guard(g_wait_timeouts_lock);
+
+    if (!timeout->armed) {
+        return;
+    }
+
+    wait_timeout** link = &g_wait_timeouts_head;
+    while (*link && *link != timeout) {
+        link = &(*link)->next;
+    }
+
+    if (*link) {
+        *link = timeout->next;
+    }
+    timeout->armed = false;
+}
+
+__PRIVILEGED_CODE
+void expire_wait_timeouts(uint64_t now_ns) {
+    // Cheap check on every tick, the lock is only taken once something expired
+    wait_timeout* head = kstl::atomic_load(&g_wait_timeouts_head, kstl::memory_order::relaxed);
+    if (!head || head->deadline_ns > now_ns) {
+        return;
+    }
+
+    spinlock_irqsave_guard guard(g_wait_timeouts_lock);
+
+    while (g_wait_timeouts_head && g_wait_timeouts_head->deadline_ns <= now_ns) {
+        wait_timeout* timeout = g_wait_timeouts_head;
+        g_wait_timeouts_head = timeout->next;
+        timeout->armed = false;
+
+        // Still under the lock, so the waiter can't return and release the context yet
+        _wake_context(timeout->ctx);
+    }
+}
+
+__PRIVILEGED_CODE
+void wait_queue::add(wait_queue_entry* entry) {
+    spinlock_irqsave_guard guard(m_lock);
+
+    entry->prev = nullptr;
+    entry->next = m_head;
+    if (m_head) {
+        m_head->prev = entry;
+    }
+    kstl::atomic_store(&m_head, entry, kstl::memory_order::relaxed);
+}
+
+__PRIVILEGED_CODE
+void wait_queue::remove(wait_queue_entry* entry) {
+    spinlock_irqsave_guard guard(m_lock);
+
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else if (m_head == entry) {
+        kstl::atomic_store(&m_head, entry->next, kstl::memory_order::relaxed);
+    } else {
+        // Already unlinked
+        return;
+    }
+
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    }
+
+    entry->next = nullptr;
+    entry->prev = nullptr;
+}
+
+void wait_queue::wake_all() {
+    // Orders the caller's state change against the waiter check, pairs
+    // with the fence between registration and polling in wait_event().
+    kstl::atomic_thread_fence(kstl::memory_order::seq_cst);
+
+    if (!kstl::atomic_load(&m_head, kstl::memory_order::relaxed)) {
+        return;
+    }
+
+    RUN_ELEVATED({
+        spinlock_irqsave_guard guard(m_lock);
+
+        // Entries stay linked until their waiter unregisters them after waking up
+        for (wait_queue_entry* entry = m_head; entry; entry = entry->next) {
+            _wake_context(entry->ctx);
+        }
+    });
+}
+
+// Parks the task on all queues once, returns after being woken up
+__PRIVILEGED_CODE
+static void _wait_event_block(wait_queue* const* queues, size_t count, uint64_t deadline_ns,
+                              wait_poll_fn poll, void* data) {
+    auto& sched = scheduler::get();
+
+    wait_context ctx;
+    ctx.task = current;
+    ctx.woken.store(0, kstl::memory_order::relaxed);
+
+    wait_queue_entry entries[WAIT_MAX_QUEUES];
+    wait_timeout timeout = { &ctx, deadline_ns, nullptr, false };
+
+    uint64_t flags = save_and_disable_irqs();
+
+    // Leave the run queue first, any wakeup from here on requeues the task
+    current->state = process_state::WAITING;
+    sched.remove_task(current);
+
+    for (size_t i = 0; i < count; i++) {
+        entries[i].ctx = &ctx;
+        queues[i]->add(&entries[i]);
+    }
+
+    if (deadline_ns != WAIT_FOREVER) {
+        _arm_timeout(&timeout);
+    }
+
+    // Re-check now that wakers can see us, the condition may have become true in between
+    kstl::atomic_thread_fence(kstl::memory_order::seq_cst);
+    if (poll(data) >= 0) {
+        _wake_context(&ctx);
+    }
+
+    restore_irq_flags(flags);
+
+    sched.schedule();
+
+    for (size_t i = 0; i < count; i++) {
+        queues[i]->remove(&entries[i]);
+    }
+
+    _cancel_timeout(&timeout);
+}
+
+int64_t wait_event(wait_queue* const* queues, size_t count, uint64_t timeout_ns, wait_poll_fn poll, void* data) {
+    int64_t ready = poll(data);
+    if (ready >= 0 || timeout_ns == 0) {
+        return ready >= 0 ? ready : WAIT_KEY_TIMEOUT;
+    }
+
+    if (count > WAIT_MAX_QUEUES) {
+        return WAIT_KEY_TIMEOUT;
+    }
+
+    uint64_t now = kernel_timer::get_system_time_in_nanoseconds();
+    uint64_t deadline = (timeout_ns == WAIT_FOREVER || timeout_ns > WAIT_FOREVER - now)
+        ? WAIT_FOREVER
+        : now + timeout_ns;
+
+    bool can_sleep = irqs_enabled() && current->pid != 0;
+
+    while (true) {
+        if (can_sleep) {
+            RUN_ELEVATED({
+                _wait_event_block(queues, count, deadline, poll, data);
+            });
+        } else {
+            yield();
+        }
+
+        ready = poll(data);
+        if (ready >= 0) {
+            return ready;
+        }
+
+        if (deadline != WAIT_FOREVER && kernel_timer::get_system_time_in_nanoseconds() >= deadline) {
+            return WAIT_KEY_TIMEOUT;
+        }
+    }
+}
+} // namespace sched
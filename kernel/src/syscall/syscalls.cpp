@@ -1,7 +1,39 @@
 #include <syscall/syscalls.h>
 #include <process/process.h>
+#include <sched/sched.h>
 #include <serial/serial.h>
 #include <dynpriv/dynpriv.h>
+#include <fs/vfs.h>
+#include <fs/io_ring.h>
+#include <memory/paging.h>
+
+// Largest chunk of console output copied out per serial write
+#define SYSCALL_CONSOLE_CHUNK_SIZE 128
+
+// Most task snapshots reported by a single SYS_TASK_STATS call
+#define SYSCALL_MAX_TASK_STATS 256
+
+__PRIVILEGED_CODE
+static int _write_console(const char* buffer, size_t size) {
+    char chunk[SYSCALL_CONSOLE_CHUNK_SIZE + 1];
+
+    for (size_t written = 0; written < size; ) {
+        size_t chunk_size = kstl::min(size - written, static_cast<size_t>(SYSCALL_CONSOLE_CHUNK_SIZE));
+        memcpy(chunk, buffer + written, chunk_size);
+        chunk[chunk_size] = '\0';
+
+        serial::write(serial::g_kernel_uart_port, chunk);
+        written += chunk_size;
+    }
+
+    return static_cast<int>(size);
+}
+
+// Zero-length transfers never touch the buffer, so any pointer is fine for them
+__PRIVILEGED_CODE
+static bool _is_user_buffer(uint64_t buffer, uint64_t size) {
+    return size == 0 || paging::is_user_range(buffer, size);
+}
 
 EXTERN_C
 __PRIVILEGED_CODE
@@ -14,26 +46,186 @@ int __syscall_handler(
     uint64_t arg5
 ) {
     int return_val = 0;
-    __unused arg1;
-    __unused arg2;
-    __unused arg3;
-    __unused arg4;
-    __unused arg5;
 
     switch (syscallnum) {
     case SYSCALL_SYS_WRITE: {
-        // Handle write syscall
-        serial::printf((const char*)arg2);
+        // arg1: fd, arg2: buffer, arg3: size, returns the number of bytes written
+        if (!_is_user_buffer(arg2, arg3)) {
+            return_val = static_cast<int>(fs::make_error_code(fs::fs_error::invalid_argument));
+            break;
+        }
+
+        int fd = static_cast<int>(arg1);
+        if (fd == FD_STDOUT || fd == FD_STDERR) {
+            return_val = _write_console(reinterpret_cast<const char*>(arg2), arg3);
+            break;
+        }
+
+        return_val = static_cast<int>(fs::virtual_filesystem::get().write(fd, reinterpret_cast<const void*>(arg2), arg3));
         break;
     }
     case SYSCALL_SYS_READ: {
-        // Handle read syscall
+        // arg1: fd, arg2: buffer, arg3: size, returns the number of bytes read
+        if (!_is_user_buffer(arg2, arg3)) {
+            return_val = static_cast<int>(fs::make_error_code(fs::fs_error::invalid_argument));
+            break;
+        }
+
+        return_val = static_cast<int>(fs::virtual_filesystem::get().read(static_cast<int>(arg1), reinterpret_cast<void*>(arg2), arg3));
         break;
     }
     case SYSCALL_SYS_EXIT: {
         sched::exit_thread();
         break;
     }
+    case SYSCALL_SYS_TASK_STATS: {
+        // arg1: task_stats_info array, arg2: capacity, returns the number of entries written
+        size_t max_entries = kstl::min(arg2, static_cast<uint64_t>(SYSCALL_MAX_TASK_STATS));
+        if (!max_entries || !paging::is_user_range(arg1, max_entries * sizeof(task_stats_info))) {
+            return_val = -EFAULT;
+            break;
+        }
+
+        // Snapshot into a kernel buffer, the task list lock can't be held across the copy out
+        task_stats_info* stats = new task_stats_info[max_entries];
+        if (!stats) {
+            return_val = -ENOMEM;
+            break;
+        }
+
+        size_t count = sched::get_task_stats(stats, max_entries);
+        memcpy(reinterpret_cast<void*>(arg1), stats, count * sizeof(task_stats_info));
+        delete[] stats;
+
+        return_val = static_cast<int>(count);
+        break;
+    }
+    case SYSCALL_SYS_CPU_STATS: {
+        // arg1: cpu_stats_info array, arg2: capacity, returns the number of entries written
+        size_t max_entries = kstl::min(arg2, static_cast<uint64_t>(MAX_SYSTEM_CPUS));
+        if (!max_entries || !paging::is_user_range(arg1, max_entries * sizeof(sched::cpu_stats_info))) {
+            return_val = -EFAULT;
+            break;
+        }
+
+        sched::cpu_stats_info* stats = new sched::cpu_stats_info[max_entries];
+        if (!stats) {
+            return_val = -ENOMEM;
+            break;
+        }
+
+        size_t count = sched::get_cpu_stats(stats, max_entries);
+        memcpy(reinterpret_cast<void*>(arg1), stats, count * sizeof(sched::cpu_stats_info));
+        delete[] stats;
+
+        return_val = static_cast<int>(count);
+        break;
+    }
+    case SYSCALL_SYS_OPEN: {
+        // arg1: path, arg2: FS_O_* flags, arg3: permissions if created, returns the fd
+        if (!paging::is_user_string(arg1, FS_MAX_PATH_LENGTH)) {
+            return_val = static_cast<int>(fs::make_error_code(fs::fs_error::invalid_argument));
+            break;
+        }
+
+        return_val = fs::virtual_filesystem::get().open(reinterpret_cast<const char*>(arg1), static_cast<uint32_t>(arg2), static_cast<uint32_t>(arg3));
+        break;
+    }
+    case SYSCALL_SYS_CLOSE: {
+        // arg1: fd
+        return_val = static_cast<int>(fs::virtual_filesystem::get().close(static_cast<int>(arg1)));
+        break;
+    }
+    case SYSCALL_SYS_PREAD: {
+        // arg1: fd, arg2: buffer, arg3: size, arg4: offset, returns the number of bytes read
+        if (!_is_user_buffer(arg2, arg3)) {
+            return_val = static_cast<int>(fs::make_error_code(fs::fs_error::invalid_argument));
+            break;
+        }
+
+        return_val = static_cast<int>(fs::virtual_filesystem::get().pread(static_cast<int>(arg1), reinterpret_cast<void*>(arg2), arg3, arg4));
+        break;
+    }
+    case SYSCALL_SYS_PWRITE: {
+        // arg1: fd, arg2: buffer, arg3: size, arg4: offset, returns the number of bytes written
+        if (!_is_user_buffer(arg2, arg3)) {
+            return_val = static_cast<int>(fs::make_error_code(fs::fs_error::invalid_argument));
+            break;
+        }
+
+        return_val = static_cast<int>(fs::virtual_filesystem::get().pwrite(static_cast<int>(arg1), reinterpret_cast<const void*>(arg2), arg3, arg4));
+        break;
+    }
+    case SYSCALL_SYS_LSEEK: {
+        // arg1: fd, arg2: offset, arg3: FS_SEEK_* whence, returns the new offset
+        return_val = static_cast<int>(fs::virtual_filesystem::get().lseek(static_cast<int>(arg1), static_cast<int64_t>(arg2), static_cast<int>(arg3)));
+        break;
+    }
+    case SYSCALL_SYS_IO_RING_SETUP: {
+        // arg1: submission entries, arg2: io_ring_params to fill
+        if (!arg2) {
+            return_val = static_cast<int>(fs::make_error_code(fs::fs_error::invalid_argument));
+            break;
+        }
+
+        // One ring per process
+        if (current->io_ring) {
+            return_val = static_cast<int>(fs::make_error_code(fs::fs_error::already_exists));
+            break;
+        }
+
+        fs::io_ring* ring = fs::io_ring::create(static_cast<uint32_t>(arg1));
+        if (!ring) {
+            return_val = static_cast<int>(fs::make_error_code(fs::fs_error::invalid_argument));
+            break;
+        }
+
+        current->io_ring = ring;
+        ring->get_params(*reinterpret_cast<fs::io_ring_params*>(arg2));
+        break;
+    }
+    case SYSCALL_SYS_IO_RING_ENTER: {
+        // arg1: completions to wait for, arg2: timeout in nanoseconds or 0 to wait forever,
+        // returns the number of completions ready to be reaped
+        if (!current->io_ring) {
+            return_val = static_cast<int>(fs::make_error_code(fs::fs_error::bad_descriptor));
+            break;
+        }
+
+        uint64_t timeout_ns = arg2 ? arg2 : WAIT_FOREVER;
+        return_val = static_cast<int>(current->io_ring->enter(static_cast<uint32_t>(arg1), timeout_ns));
+        break;
+    }
+    case SYSCALL_SYS_MMAP: {
+        // arg1: fd, arg2: offset, arg3: length, arg4: FS_PROT_* | FS_MAP_* flags,
+        // arg5: pointer receiving the address of the mapping
+        if (!paging::is_user_range(arg5, sizeof(uint64_t))) {
+            return_val = static_cast<int>(fs::make_error_code(fs::fs_error::invalid_argument));
+            break;
+        }
+
+        uint32_t prot = static_cast<uint32_t>(arg4) & (FS_PROT_READ | FS_PROT_WRITE | FS_PROT_EXEC);
+        uint32_t flags = static_cast<uint32_t>(arg4) & ~prot;
+
+        void* addr = nullptr;
+        fs::fs_error result = fs::virtual_filesystem::get().mmap(static_cast<int>(arg1), arg2, arg3, prot, flags, addr);
+        if (result == fs::fs_error::success) {
+            *reinterpret_cast<uint64_t*>(arg5) = reinterpret_cast<uint64_t>(addr);
+        }
+
+        return_val = static_cast<int>(result);
+        break;
+    }
+    case SYSCALL_SYS_MUNMAP: {
+        // arg1: address, arg2: length
+        return_val = static_cast<int>(fs::virtual_filesystem::get().munmap(reinterpret_cast<void*>(arg1), arg2));
+        break;
+    }
+    case SYSCALL_SYS_MSYNC: {
+        // arg1: address, arg2: length
+        return_val = static_cast<int>(fs::virtual_filesystem::get().msync(reinterpret_cast<void*>(arg1), arg2));
+        break;
+    }
     case SYSCALL_SYS_ELEVATE: {
         // Make sure that the thread is allowed to elevate
         if (!dynpriv::is_asid_allowed()) {
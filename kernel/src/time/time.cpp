@@ -64,6 +64,16 @@ uint64_t kernel_timer::get_system_time_in_nanoseconds() {
     return s_global_system_time_ns;
 }
 
+uint64_t kernel_timer::tsc_cycles_to_ns(uint64_t cycles) {
+    uint64_t freq = s_tsc_ticks_calibrated_frequency;
+    if (!freq) {
+        return 0;
+    }
+
+    // Split into whole seconds and a remainder to avoid overflowing for long uptimes
+    return (cycles / freq) * 1'000'000'000ULL + ((cycles % freq) * 1'000'000'000ULL) / freq;
+}
+
 uint64_t kernel_timer::get_system_time_in_milliseconds() {
     return s_global_system_time_ns / 1'000'000ULL;
 }
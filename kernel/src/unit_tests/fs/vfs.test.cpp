@@ -1,6 +1,14 @@
 #include <unit_tests/unit_tests.h>
 #include <fs/vfs.h>
 #include <fs/ram_filesystem.h>
+#include <fs/cpio/cpio.h>
+#include <fs/cpio/cpio_filesystem.h>
+#include <fs/block_filesystem.h>
+#include <fs/io_ring.h>
+#include <lz4.h>
+#include <memory/paging.h>
+#include <time/time.h>
+#include <sched/sched.h>
 
 using namespace fs;
 
@@ -563,3 +571,1136 @@ DECLARE_UNIT_TEST("vfs create write and verify file contents", test_vfs_write_ve
 
     return UNIT_TEST_SUCCESS;
 }
+
+// Test that repeated lookups are served by the dentry cache and that it follows creates and removals
+DECLARE_UNIT_TEST("vfs dentry cache", test_vfs_dentry_cache) {
+    auto mockfs = kstl::make_shared<ram_filesystem>();
+
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", mockfs);
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    status = vfs.create("/bin", fs::vfs_node_type::directory, 0755);
+    ASSERT_EQ(status, fs_error::success, "Failed to create directory '/bin': %s", error_to_string(status));
+
+    // Probing a missing file leaves a negative entry behind that the create has to drop
+    kstl::string file_path = "/bin/dcache_app";
+    ASSERT_TRUE(!vfs.path_exists(file_path), "File '%s' should not exist yet", file_path.c_str());
+    ASSERT_TRUE(!vfs.path_exists(file_path), "Negative entry for '%s' should persist", file_path.c_str());
+
+    status = vfs.create(file_path, fs::vfs_node_type::file, 0755);
+    ASSERT_EQ(status, fs_error::success, "Failed to create file '%s': %s", file_path.c_str(), error_to_string(status));
+    ASSERT_TRUE(vfs.path_exists(file_path), "File '%s' does not exist after creation", file_path.c_str());
+
+    const char* write_data = "dcache";
+    ssize_t bytes_written = vfs.write(file_path, write_data, strlen(write_data), 0);
+    ASSERT_EQ(bytes_written, (ssize_t)strlen(write_data), "Failed to write to file '%s'", file_path.c_str());
+
+    // Every component of the path is cached now, resolving it again must not miss
+    dentry_cache_stats before;
+    vfs.get_dentry_cache_stats(before);
+
+    for (int i = 0; i < 16; i++) {
+        vfs_stat_struct info;
+        status = vfs.stat("//bin//dcache_app", info);
+        ASSERT_EQ(status, fs_error::success, "Failed to stat '%s': %s", file_path.c_str(), error_to_string(status));
+        ASSERT_EQ(info.size, (uint64_t)strlen(write_data), "Cached node should reflect the write");
+    }
+
+    dentry_cache_stats after;
+    vfs.get_dentry_cache_stats(after);
+    ASSERT_EQ(after.misses, before.misses, "Repeated lookups should not miss the dentry cache");
+    ASSERT_EQ(after.hits - before.hits, (uint64_t)32, "Each lookup should hit once per component");
+
+    // Removing the file has to drop its entry
+    status = vfs.remove(file_path);
+    ASSERT_EQ(status, fs_error::success, "Failed to remove file '%s': %s", file_path.c_str(), error_to_string(status));
+    ASSERT_TRUE(!vfs.path_exists(file_path), "File '%s' still exists after removal", file_path.c_str());
+
+    status = vfs.unmount("/");
+    ASSERT_EQ(status, fs_error::success, "Failed to unmount ramfs: %s", error_to_string(status));
+
+    vfs.get_dentry_cache_stats(after);
+    ASSERT_EQ(after.entries, (size_t)0, "Unmounting should flush the dentry cache");
+
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test reading and writing a file through a descriptor with a cached offset
+DECLARE_UNIT_TEST("vfs file descriptors", test_vfs_file_descriptors) {
+    auto mockfs = kstl::make_shared<ram_filesystem>();
+
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", mockfs);
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    kstl::string file_path = "/fd_test.txt";
+    ASSERT_TRUE(vfs.open(file_path, FS_O_RDONLY) < 0, "Opening a missing file without FS_O_CREAT should fail");
+
+    int fd = vfs.open(file_path, FS_O_RDWR | FS_O_CREAT);
+    ASSERT_TRUE(fd >= FD_TABLE_FIRST_FD, "Failed to open '%s': %s", file_path.c_str(), error_to_string(fd));
+
+    // Sequential writes advance the offset
+    ASSERT_EQ(vfs.write(fd, "Hello, ", 7), (ssize_t)7, "First write should be complete");
+    ASSERT_EQ(vfs.write(fd, "descriptors!", 12), (ssize_t)12, "Second write should be complete");
+    ASSERT_EQ(vfs.lseek(fd, 0, FS_SEEK_CUR), (ssize_t)19, "Offset should follow the writes");
+
+    // Read it back in small chunks from the start
+    ASSERT_EQ(vfs.lseek(fd, 0, FS_SEEK_SET), (ssize_t)0, "Seeking to the start should succeed");
+
+    char buffer[32] = { 0 };
+    size_t total = 0;
+    ssize_t bytes_read;
+    while ((bytes_read = vfs.read(fd, buffer + total, 4)) > 0) {
+        total += bytes_read;
+    }
+    ASSERT_EQ(total, (size_t)19, "Chunked reads should return the whole file");
+    ASSERT_EQ(strcmp(buffer, "Hello, descriptors!"), 0, "Data read back does not match data written");
+
+    // Positional I/O leaves the offset alone
+    char word[12] = { 0 };
+    ASSERT_EQ(vfs.pread(fd, word, 11, 7), (ssize_t)11, "pread should read at the given offset");
+    ASSERT_EQ(strcmp(word, "descriptors"), 0, "pread returned the wrong data");
+    ASSERT_EQ(vfs.lseek(fd, 0, FS_SEEK_CUR), (ssize_t)19, "pread should not move the offset");
+    ASSERT_EQ(vfs.lseek(fd, -1, FS_SEEK_END), (ssize_t)18, "Seeking relative to the end should succeed");
+    ASSERT_TRUE(vfs.lseek(fd, -20, FS_SEEK_CUR) < 0, "Seeking before the start should fail");
+
+    vfs_stat_struct info;
+    ASSERT_EQ(vfs.fstat(fd, info), fs_error::success, "fstat should succeed on an open descriptor");
+    ASSERT_EQ(info.size, (uint64_t)19, "fstat should report the written size");
+
+    ASSERT_EQ(vfs.close(fd), fs_error::success, "Closing an open descriptor should succeed");
+    ASSERT_EQ(vfs.close(fd), fs_error::bad_descriptor, "Closing a descriptor twice should fail");
+    ASSERT_EQ(vfs.read(fd, buffer, 4), make_error_code(fs_error::bad_descriptor), "Reading a closed descriptor should fail");
+
+    // Access modes are enforced
+    fd = vfs.open(file_path, FS_O_RDONLY);
+    ASSERT_TRUE(fd >= FD_TABLE_FIRST_FD, "Failed to reopen '%s'", file_path.c_str());
+    ASSERT_EQ(vfs.write(fd, "x", 1), make_error_code(fs_error::permission_denied), "Writing a read-only descriptor should fail");
+    vfs.close(fd);
+
+    status = vfs.unmount("/");
+    ASSERT_EQ(status, fs_error::success, "Failed to unmount ramfs: %s", error_to_string(status));
+
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test that a removed file stays usable through descriptors that are still open
+DECLARE_UNIT_TEST("vfs remove open file", test_vfs_remove_open_file) {
+    auto mockfs = kstl::make_shared<ram_filesystem>();
+
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", mockfs);
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    kstl::string file_path = "/unlinked.txt";
+    int fd = vfs.open(file_path, FS_O_RDWR | FS_O_CREAT);
+    ASSERT_TRUE(fd >= FD_TABLE_FIRST_FD, "Failed to open '%s': %s", file_path.c_str(), error_to_string(fd));
+    ASSERT_EQ(vfs.write(fd, "Still ", 6), (ssize_t)6, "Write before the removal should be complete");
+
+    status = vfs.remove(file_path);
+    ASSERT_EQ(status, fs_error::success, "Failed to remove open file '%s': %s", file_path.c_str(), error_to_string(status));
+    ASSERT_TRUE(!vfs.path_exists(file_path), "File '%s' still exists after removal", file_path.c_str());
+
+    // The descriptor keeps the file's node and data alive
+    ASSERT_EQ(vfs.write(fd, "here!", 5), (ssize_t)5, "Writing a removed file through an open descriptor should succeed");
+    ASSERT_EQ(vfs.lseek(fd, 0, FS_SEEK_SET), (ssize_t)0, "Seeking in a removed file should succeed");
+
+    char buffer[16] = { 0 };
+    ASSERT_EQ(vfs.read(fd, buffer, sizeof(buffer) - 1), (ssize_t)11, "Reading a removed file should return its data");
+    ASSERT_EQ(strcmp(buffer, "Still here!"), 0, "Data read back from a removed file does not match");
+
+    char word[5] = { 0 };
+    ASSERT_EQ(vfs.pread(fd, word, 4, 6), (ssize_t)4, "pread on a removed file should succeed");
+    ASSERT_EQ(strcmp(word, "here"), 0, "pread on a removed file returned the wrong data");
+
+    vfs_stat_struct info;
+    ASSERT_EQ(vfs.fstat(fd, info), fs_error::success, "fstat on a removed file should succeed");
+    ASSERT_EQ(info.size, (uint64_t)11, "fstat should report the removed file's size");
+
+    // A new file under the same name is independent of the removed one
+    int new_fd = vfs.open(file_path, FS_O_RDWR | FS_O_CREAT);
+    ASSERT_TRUE(new_fd >= FD_TABLE_FIRST_FD, "Failed to recreate '%s': %s", file_path.c_str(), error_to_string(new_fd));
+    ASSERT_EQ(vfs.read(new_fd, buffer, sizeof(buffer)), (ssize_t)0, "Recreated file should be empty");
+    ASSERT_EQ(vfs.close(new_fd), fs_error::success, "Closing the recreated file should succeed");
+
+    // Closing the last descriptor frees the removed file
+    ASSERT_EQ(vfs.close(fd), fs_error::success, "Closing a removed file should succeed");
+
+    status = vfs.unmount("/");
+    ASSERT_EQ(status, fs_error::success, "Failed to unmount ramfs: %s", error_to_string(status));
+
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test sparse ramfs files and measure appending to a large file in small writes
+DECLARE_UNIT_TEST("vfs ramfs page storage benchmark", test_vfs_ramfs_page_storage) {
+    const size_t total_size = 16 * 1024 * 1024;
+    const size_t write_size = 512;
+
+    auto mockfs = kstl::make_shared<ram_filesystem>();
+
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", mockfs);
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    // Writing past the end leaves a hole that reads back as zeros
+    int fd = vfs.open("/sparse.bin", FS_O_RDWR | FS_O_CREAT);
+    ASSERT_TRUE(fd >= FD_TABLE_FIRST_FD, "Failed to open sparse file: %s", error_to_string(fd));
+    ASSERT_EQ(vfs.pwrite(fd, "end", 3, 3 * PAGE_SIZE + 100), (ssize_t)3, "Write past the end should succeed");
+
+    uint8_t hole[64];
+    memset(hole, 0xff, sizeof(hole));
+    ASSERT_EQ(vfs.pread(fd, hole, sizeof(hole), PAGE_SIZE), (ssize_t)sizeof(hole), "Reading a hole should succeed");
+    for (size_t i = 0; i < sizeof(hole); i++) {
+        ASSERT_EQ(hole[i], (uint8_t)0, "Holes should read back as zeros");
+    }
+
+    char tail[4] = { 0 };
+    ASSERT_EQ(vfs.pread(fd, tail, 3, 3 * PAGE_SIZE + 100), (ssize_t)3, "Reading the written tail should succeed");
+    ASSERT_EQ(strcmp(tail, "end"), 0, "Data after the hole does not match");
+
+    // Page-straddling reads and writes
+    char straddle[8] = { 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h' };
+    ASSERT_EQ(vfs.pwrite(fd, straddle, sizeof(straddle), PAGE_SIZE - 4), (ssize_t)sizeof(straddle), "Straddling write should succeed");
+
+    char readback[8] = { 0 };
+    ASSERT_EQ(vfs.pread(fd, readback, sizeof(readback), PAGE_SIZE - 4), (ssize_t)sizeof(readback), "Straddling read should succeed");
+    ASSERT_EQ(memcmp(readback, straddle, sizeof(straddle)), 0, "Data across the page boundary does not match");
+    vfs.close(fd);
+
+    // Append in small writes, which used to copy the whole file on every growth
+    fd = vfs.open("/append.bin", FS_O_WRONLY | FS_O_CREAT | FS_O_APPEND);
+    ASSERT_TRUE(fd >= FD_TABLE_FIRST_FD, "Failed to open append file: %s", error_to_string(fd));
+
+    static uint8_t chunk[512];
+    uint64_t start = rdtsc();
+    for (size_t written = 0; written < total_size; written += write_size) {
+        memset(chunk, static_cast<int>((written / write_size) & 0xff), write_size);
+
+        ssize_t result = vfs.write(fd, chunk, write_size);
+        ASSERT_EQ(result, (ssize_t)write_size, "Append failed at offset %llu", written);
+    }
+    uint64_t append_cycles = rdtsc() - start;
+    vfs.close(fd);
+
+    vfs_stat_struct info;
+    ASSERT_EQ(vfs.stat("/append.bin", info), fs_error::success, "Failed to stat appended file");
+    ASSERT_EQ(info.size, (uint64_t)total_size, "Appended file has the wrong size");
+
+    // Spot check a chunk in the middle of the file
+    fd = vfs.open("/append.bin", FS_O_RDONLY);
+    size_t probe_index = 12345;
+    ASSERT_EQ(vfs.pread(fd, chunk, write_size, probe_index * write_size), (ssize_t)write_size, "Reading back a chunk should succeed");
+    ASSERT_EQ(chunk[0], (uint8_t)(probe_index & 0xff), "Appended data does not match");
+    ASSERT_EQ(chunk[write_size - 1], (uint8_t)(probe_index & 0xff), "Appended data does not match");
+    vfs.close(fd);
+
+    serial::printf(UNIT_TEST_PREFIX "ramfs append benchmark: %llu MiB in %llu byte writes\n", total_size / (1024 * 1024), write_size);
+    serial::printf(UNIT_TEST_PREFIX "  %llu cycles/write\n", append_cycles / (total_size / write_size));
+
+    ASSERT_EQ(vfs.remove("/append.bin"), fs_error::success, "Failed to remove appended file");
+    ASSERT_EQ(vfs.remove("/sparse.bin"), fs_error::success, "Failed to remove sparse file");
+
+    status = vfs.unmount("/");
+    ASSERT_EQ(status, fs_error::success, "Failed to unmount ramfs: %s", error_to_string(status));
+
+    return UNIT_TEST_SUCCESS;
+}
+
+struct ramfs_concurrency_context {
+    int fd;
+    size_t total_size;
+    volatile int finished;
+};
+
+// Appends a pattern to a file that the test reads concurrently
+void ramfs_appender_task(void* data) {
+    auto ctx = reinterpret_cast<ramfs_concurrency_context*>(data);
+    auto& vfs = virtual_filesystem::get();
+
+    uint8_t chunk[256];
+    for (size_t offset = 0; offset < ctx->total_size; offset += sizeof(chunk)) {
+        for (size_t i = 0; i < sizeof(chunk); i++) {
+            chunk[i] = static_cast<uint8_t>((offset + i) * 7);
+        }
+
+        if (vfs.pwrite(ctx->fd, chunk, sizeof(chunk), offset) != (ssize_t)sizeof(chunk)) {
+            break;
+        }
+    }
+
+    ctx->finished = 1;
+    sched::exit_thread();
+}
+
+// Test that file data published by a concurrent writer is always read back intact
+DECLARE_UNIT_TEST("vfs ramfs concurrent readers and writer", test_vfs_ramfs_concurrency) {
+    auto mockfs = kstl::make_shared<ram_filesystem>();
+
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", mockfs);
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    // A second file that is only ever read, alongside the one being written
+    const char* static_data = "read-only data that never changes";
+    ASSERT_EQ(vfs.create("/static.txt", vfs_node_type::file, 0644), fs_error::success, "Failed to create static file");
+    ASSERT_EQ(vfs.write("/static.txt", static_data, strlen(static_data), 0), (ssize_t)strlen(static_data), "Failed to write static file");
+
+    auto ctx = new ramfs_concurrency_context();
+    ASSERT_TRUE(ctx != nullptr, "Context should be allocated");
+
+    ctx->total_size = 2 * 1024 * 1024;
+    ctx->fd = vfs.open("/grow.bin", FS_O_RDWR | FS_O_CREAT);
+    ASSERT_TRUE(ctx->fd >= FD_TABLE_FIRST_FD, "Failed to open growing file: %s", error_to_string(ctx->fd));
+
+    task_control_block* task = sched::create_priv_kernel_task(ramfs_appender_task, ctx);
+    ASSERT_TRUE(task != nullptr, "Appender task should be created");
+    sched::scheduler::get().add_task(task);
+
+    // Keep reading below the published size while the file grows, with a 10 second timeout
+    uint64_t start = kernel_timer::get_system_time_in_nanoseconds();
+    uint64_t probe = 0;
+    size_t reads = 0;
+    while (!ctx->finished) {
+        if (kernel_timer::get_system_time_in_nanoseconds() - start > 10'000'000'000ull) {
+            break;
+        }
+
+        vfs_stat_struct info;
+        ASSERT_EQ(vfs.stat("/grow.bin", info), fs_error::success, "Failed to stat growing file");
+
+        if (info.size >= 64) {
+            uint8_t buffer[64];
+            probe = (probe * 6364136223846793005ull + 1442695040888963407ull);
+            uint64_t offset = (probe >> 16) % (info.size - sizeof(buffer) + 1);
+
+            ASSERT_EQ(vfs.pread(ctx->fd, buffer, sizeof(buffer), offset), (ssize_t)sizeof(buffer), "Read below the published size should be complete");
+            for (size_t i = 0; i < sizeof(buffer); i++) {
+                ASSERT_EQ(buffer[i], static_cast<uint8_t>((offset + i) * 7), "Read torn data at offset %llu", offset + i);
+            }
+            reads++;
+        }
+
+        char static_buffer[64] = { 0 };
+        ASSERT_EQ(vfs.read("/static.txt", static_buffer, sizeof(static_buffer), 0), (ssize_t)strlen(static_data), "Failed to read static file");
+        ASSERT_EQ(strcmp(static_buffer, static_data), 0, "Static file data does not match");
+
+        sched::yield();
+    }
+
+    ASSERT_EQ(ctx->finished, 1, "Appender should finish writing");
+
+    vfs_stat_struct info;
+    ASSERT_EQ(vfs.stat("/grow.bin", info), fs_error::success, "Failed to stat grown file");
+    ASSERT_EQ(info.size, (uint64_t)ctx->total_size, "Grown file has the wrong size");
+
+    serial::printf(UNIT_TEST_PREFIX "ramfs concurrency: %llu verified reads while the file grew\n", reads);
+
+    vfs.close(ctx->fd);
+    delete ctx;
+
+    ASSERT_EQ(vfs.remove("/grow.bin"), fs_error::success, "Failed to remove grown file");
+    ASSERT_EQ(vfs.remove("/static.txt"), fs_error::success, "Failed to remove static file");
+
+    status = vfs.unmount("/");
+    ASSERT_EQ(status, fs_error::success, "Failed to unmount ramfs: %s", error_to_string(status));
+
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test and measure creating, looking up and removing entries of a large ramfs directory
+DECLARE_UNIT_TEST("vfs ramfs large directory benchmark", test_vfs_ramfs_large_directory) {
+    const int entry_count = 10000;
+    char path[64];
+
+    auto mockfs = kstl::make_shared<ram_filesystem>();
+
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", mockfs);
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    status = vfs.create("/bench", vfs_node_type::directory, 0755);
+    ASSERT_EQ(status, fs_error::success, "Failed to create directory: %s", error_to_string(status));
+
+    uint64_t start = rdtsc();
+    for (int i = 0; i < entry_count; i++) {
+        sprintf(path, sizeof(path), "/bench/entry_%i", i);
+        status = vfs.create(path, vfs_node_type::file, 0644);
+        ASSERT_EQ(status, fs_error::success, "Failed to create '%s': %s", path, error_to_string(status));
+    }
+    uint64_t create_cycles = rdtsc() - start;
+
+    // Far more entries than the dentry cache holds, so most lookups reach the directory itself
+    vfs_stat_struct info;
+    start = rdtsc();
+    for (int i = 0; i < entry_count; i++) {
+        sprintf(path, sizeof(path), "/bench/entry_%i", (i * 7919) % entry_count);
+        status = vfs.stat(path, info);
+        ASSERT_EQ(status, fs_error::success, "Failed to look up '%s': %s", path, error_to_string(status));
+    }
+    uint64_t lookup_cycles = rdtsc() - start;
+
+    ASSERT_EQ(vfs.stat("/bench/entry_missing", info), fs_error::not_found, "Missing entry should not be found");
+
+    // Removing every other entry shifts colliding entries around in the table
+    for (int i = 0; i < entry_count; i += 2) {
+        sprintf(path, sizeof(path), "/bench/entry_%i", i);
+        status = vfs.remove(path);
+        ASSERT_EQ(status, fs_error::success, "Failed to remove '%s': %s", path, error_to_string(status));
+    }
+
+    for (int i = 0; i < entry_count; i++) {
+        sprintf(path, sizeof(path), "/bench/entry_%i", i);
+        status = vfs.stat(path, info);
+        ASSERT_EQ(status, (i % 2) ? fs_error::success : fs_error::not_found, "Unexpected lookup result for '%s'", path);
+    }
+
+    // Listing keeps the creation order
+    kstl::vector<kstl::string> entries;
+    status = vfs.listdir("/bench", entries);
+    ASSERT_EQ(status, fs_error::success, "Failed to list directory: %s", error_to_string(status));
+    ASSERT_EQ(entries.size(), (size_t)(entry_count / 2), "Directory listing has the wrong number of entries");
+    ASSERT_EQ(strcmp(entries[0].c_str(), "entry_1"), 0, "Directory listing is out of order");
+    ASSERT_EQ(strcmp(entries[entries.size() - 1].c_str(), "entry_9999"), 0, "Directory listing is out of order");
+
+    serial::printf(UNIT_TEST_PREFIX "ramfs directory benchmark: %i entries\n", entry_count);
+    serial::printf(UNIT_TEST_PREFIX "  create: %llu cycles/entry\n", create_cycles / entry_count);
+    serial::printf(UNIT_TEST_PREFIX "  lookup: %llu cycles/entry\n", lookup_cycles / entry_count);
+
+    ASSERT_EQ(vfs.remove("/bench"), fs_error::success, "Failed to remove directory");
+
+    status = vfs.unmount("/");
+    ASSERT_EQ(status, fs_error::success, "Failed to unmount ramfs: %s", error_to_string(status));
+
+    return UNIT_TEST_SUCCESS;
+}
+
+// Appends a newc entry to an archive that is being built
+static void append_cpio_entry(uint8_t* archive, size_t& offset, const char* name, uint32_t mode, const char* data) {
+    auto write_hex = [](char* field, uint32_t value) {
+        for (int i = 7; i >= 0; i--) {
+            field[i] = "0123456789abcdef"[value & 0xf];
+            value >>= 4;
+        }
+    };
+
+    size_t name_size = strlen(name) + 1;
+    size_t data_size = data ? strlen(data) : 0;
+
+    auto hdr = reinterpret_cast<cpio_newc_header*>(archive + offset);
+    memset(hdr, '0', sizeof(cpio_newc_header));
+    memcpy(hdr->c_magic, CPIO_HEADER_MAGIC, 6);
+    write_hex(hdr->c_mode, mode);
+    write_hex(hdr->c_filesize, static_cast<uint32_t>(data_size));
+    write_hex(hdr->c_namesize, static_cast<uint32_t>(name_size));
+    offset += sizeof(cpio_newc_header);
+
+    memcpy(archive + offset, name, name_size);
+    offset = (offset + name_size + 3) & ~3ul;
+
+    if (data_size) {
+        memcpy(archive + offset, data, data_size);
+        offset = (offset + data_size + 3) & ~3ul;
+    }
+}
+
+// Test serving a CPIO archive in place, read-only and with a writable overlay
+DECLARE_UNIT_TEST("vfs cpio filesystem", test_vfs_cpio_filesystem) {
+    const char* app_data = "application binary";
+    const char* font_data = "font glyphs";
+
+    uint8_t* archive = new uint8_t[4096];
+    ASSERT_TRUE(archive != nullptr, "Archive should be allocated");
+    zeromem(archive, 4096);
+
+    // The font's parent directories are only implied by its path
+    size_t length = 0;
+    append_cpio_entry(archive, length, ".", 0040755, nullptr);
+    append_cpio_entry(archive, length, "./bin", 0040755, nullptr);
+    append_cpio_entry(archive, length, "./bin/app", 0100755, app_data);
+    append_cpio_entry(archive, length, "./res/fonts/zap.psf", 0100644, font_data);
+    append_cpio_entry(archive, length, CPIO_TRAILER_MARK, 0, nullptr);
+
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", kstl::make_shared<ram_filesystem>());
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    auto cpiofs = kstl::make_shared<cpio_filesystem>(archive, length);
+    status = vfs.mount("/cpio", cpiofs);
+    ASSERT_EQ(status, fs_error::success, "Failed to mount cpio archive: %s", error_to_string(status));
+    ASSERT_EQ(cpiofs->get_indexed_node_count(), (size_t)3, "Every archive entry but the root should be indexed");
+
+    char buffer[64] = { 0 };
+    ASSERT_EQ(vfs.read("/cpio/bin/app", buffer, sizeof(buffer), 0), (ssize_t)strlen(app_data), "Failed to read archived file");
+    ASSERT_EQ(strcmp(buffer, app_data), 0, "Archived file data does not match");
+
+    memset(buffer, 0, sizeof(buffer));
+    ASSERT_EQ(vfs.read("/cpio/res/fonts/zap.psf", buffer, sizeof(buffer), 5), (ssize_t)strlen(font_data) - 5, "Failed to read archived file at an offset");
+    ASSERT_EQ(strcmp(buffer, font_data + 5), 0, "Archived file data does not match");
+
+    vfs_stat_struct info;
+    ASSERT_EQ(vfs.stat("/cpio/res/fonts", info), fs_error::success, "Implied directory should exist");
+    ASSERT_EQ(info.type, vfs_node_type::directory, "Implied parent should be a directory");
+
+    kstl::vector<kstl::string> entries;
+    ASSERT_EQ(vfs.listdir("/cpio", entries), fs_error::success, "Failed to list archive root");
+    ASSERT_EQ(entries.size(), (size_t)2, "Archive root should have two entries");
+    ASSERT_EQ(strcmp(entries[0].c_str(), "bin"), 0, "Archive root listing is out of order");
+
+    // Without an overlay the archive is read-only
+    ASSERT_EQ(vfs.write("/cpio/bin/app", "x", 1, 0), make_error_code(fs_error::unsupported_operation), "Read-only archive should reject writes");
+    ASSERT_EQ(vfs.create("/cpio/new.txt", vfs_node_type::file, 0644), fs_error::unsupported_operation, "Read-only archive should reject creation");
+
+    ASSERT_EQ(vfs.unmount("/cpio"), fs_error::success, "Failed to unmount cpio archive");
+
+    // With an overlay, written files are copied out of the archive first
+    status = vfs.mount("/cpio", kstl::make_shared<cpio_filesystem>(archive, length, true));
+    ASSERT_EQ(status, fs_error::success, "Failed to mount writable cpio archive: %s", error_to_string(status));
+
+    ASSERT_EQ(vfs.write("/cpio/bin/app", "APP", 3, 0), (ssize_t)3, "Overlay write should succeed");
+    ASSERT_EQ(vfs.write("/cpio/bin/app", "!", 1, strlen(app_data)), (ssize_t)1, "Overlay append should succeed");
+
+    memset(buffer, 0, sizeof(buffer));
+    ASSERT_EQ(vfs.read("/cpio/bin/app", buffer, sizeof(buffer), 0), (ssize_t)strlen(app_data) + 1, "Failed to read overlay file");
+    ASSERT_EQ(strcmp(buffer, "APPlication binary!"), 0, "Overlay file data does not match");
+
+    bool archive_intact = false;
+    for (size_t i = 0; i + strlen(app_data) <= length; i++) {
+        if (memcmp(archive + i, app_data, strlen(app_data)) == 0) {
+            archive_intact = true;
+            break;
+        }
+    }
+    ASSERT_TRUE(archive_intact, "Overlay writes must not modify the archive");
+
+    ASSERT_EQ(vfs.create("/cpio/bin/new.txt", vfs_node_type::file, 0644), fs_error::success, "Overlay create should succeed");
+    ASSERT_EQ(vfs.write("/cpio/bin/new.txt", "new", 3, 0), (ssize_t)3, "Writing a new overlay file should succeed");
+    ASSERT_EQ(vfs.remove("/cpio/res/fonts/zap.psf"), fs_error::success, "Removing an archived file should succeed");
+    ASSERT_EQ(vfs.stat("/cpio/res/fonts/zap.psf", info), fs_error::not_found, "Removed archived file should be gone");
+
+    ASSERT_EQ(vfs.unmount("/cpio"), fs_error::success, "Failed to unmount writable cpio archive");
+    ASSERT_EQ(vfs.unmount("/"), fs_error::success, "Failed to unmount ramfs");
+
+    delete[] archive;
+    return UNIT_TEST_SUCCESS;
+}
+
+// LZ4 frame of a small cpio archive holding "./etc/motd", compressed with
+// linked blocks and without a recorded content size.
+static const uint8_t g_compressed_cpio[] = {
+    0x04, 0x22, 0x4d, 0x18, 0x64, 0x40, 0xa7, 0x01, 0x01, 0x00, 0x00, 0x77,
+    0x30, 0x37, 0x30, 0x37, 0x30, 0x31, 0x30, 0x01, 0x00, 0x5f, 0x34, 0x31,
+    0x65, 0x64, 0x30, 0x01, 0x00, 0x03, 0x2f, 0x31, 0x30, 0x01, 0x00, 0x23,
+    0x14, 0x32, 0x09, 0x00, 0x2f, 0x2e, 0x00, 0x70, 0x00, 0x52, 0x15, 0x36,
+    0x70, 0x00, 0x4f, 0x2f, 0x65, 0x74, 0x63, 0x74, 0x00, 0x00, 0x4f, 0x38,
+    0x31, 0x61, 0x34, 0x74, 0x00, 0x12, 0x2f, 0x33, 0x36, 0x74, 0x00, 0x15,
+    0x19, 0x62, 0x74, 0x00, 0xf2, 0x1e, 0x2f, 0x6d, 0x6f, 0x74, 0x64, 0x00,
+    0x00, 0x00, 0x00, 0x6c, 0x69, 0x6e, 0x65, 0x20, 0x30, 0x30, 0x20, 0x6f,
+    0x66, 0x20, 0x61, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x72, 0x65, 0x73, 0x73,
+    0x65, 0x64, 0x20, 0x69, 0x6e, 0x69, 0x74, 0x72, 0x64, 0x20, 0x66, 0x69,
+    0x6c, 0x65, 0x0a, 0x24, 0x00, 0x1f, 0x31, 0x24, 0x00, 0x10, 0x1f, 0x32,
+    0x24, 0x00, 0x10, 0x1f, 0x33, 0x24, 0x00, 0x10, 0x1f, 0x34, 0x24, 0x00,
+    0x10, 0x1f, 0x35, 0x24, 0x00, 0x10, 0x1f, 0x36, 0x24, 0x00, 0x10, 0x1f,
+    0x37, 0x24, 0x00, 0x10, 0x1f, 0x38, 0x24, 0x00, 0x10, 0x1f, 0x39, 0x24,
+    0x00, 0x0f, 0x1f, 0x31, 0x68, 0x01, 0x10, 0x1f, 0x31, 0x68, 0x01, 0x10,
+    0x1f, 0x31, 0x68, 0x01, 0x10, 0x1f, 0x31, 0x68, 0x01, 0x10, 0x1f, 0x31,
+    0x68, 0x01, 0x10, 0x1f, 0x31, 0x68, 0x01, 0x10, 0x1f, 0x31, 0x68, 0x01,
+    0x10, 0x1f, 0x31, 0x68, 0x01, 0x10, 0x1f, 0x31, 0x68, 0x01, 0x10, 0x1f,
+    0x31, 0x68, 0x01, 0x10, 0x1f, 0x32, 0x68, 0x01, 0x10, 0x1f, 0x32, 0x68,
+    0x01, 0x10, 0x1f, 0x32, 0x68, 0x01, 0x10, 0x1f, 0x32, 0x68, 0x01, 0x0b,
+    0x0e, 0xdc, 0x03, 0x0e, 0xa4, 0x03, 0x0f, 0x50, 0x04, 0x2e, 0x05, 0xdc,
+    0x03, 0xe0, 0x54, 0x52, 0x41, 0x49, 0x4c, 0x45, 0x52, 0x21, 0x21, 0x21,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9f, 0xd7, 0x4e, 0x06
+};
+
+// Test decompressing an LZ4 compressed initrd and serving it in place
+DECLARE_UNIT_TEST("vfs lz4 compressed cpio archive", test_vfs_lz4_cpio) {
+    const size_t archive_size = 1340;
+
+    ASSERT_TRUE(lz4::is_frame(g_compressed_cpio, sizeof(g_compressed_cpio)), "Frame should be recognized");
+    ASSERT_EQ(lz4::get_content_size(g_compressed_cpio, sizeof(g_compressed_cpio)), (ssize_t)archive_size, "Measured content size does not match");
+
+    uint8_t* archive = new uint8_t[archive_size];
+    ASSERT_TRUE(archive != nullptr, "Archive should be allocated");
+
+    ASSERT_EQ(lz4::decompress_frame(g_compressed_cpio, sizeof(g_compressed_cpio), archive, archive_size - 1), (ssize_t)-1, "Decompressing into a short buffer should fail");
+    ASSERT_EQ(lz4::decompress_frame(g_compressed_cpio, sizeof(g_compressed_cpio) / 2, archive, archive_size), (ssize_t)-1, "Decompressing a truncated frame should fail");
+    ASSERT_EQ(lz4::decompress_frame(g_compressed_cpio, sizeof(g_compressed_cpio), archive, archive_size), (ssize_t)archive_size, "Failed to decompress frame");
+
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", kstl::make_shared<ram_filesystem>());
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    status = vfs.mount("/lz4", kstl::make_shared<cpio_filesystem>(archive, archive_size));
+    ASSERT_EQ(status, fs_error::success, "Failed to mount decompressed archive: %s", error_to_string(status));
+
+    vfs_stat_struct info;
+    ASSERT_EQ(vfs.stat("/lz4/etc/motd", info), fs_error::success, "Decompressed file should exist");
+    ASSERT_EQ(info.size, (uint64_t)864, "Decompressed file has the wrong size");
+
+    const char* last_line = "line 23 of a compressed initrd file\n";
+    char buffer[64] = { 0 };
+    ASSERT_EQ(vfs.read("/lz4/etc/motd", buffer, sizeof(buffer), 864 - strlen(last_line)), (ssize_t)strlen(last_line), "Failed to read decompressed file");
+    ASSERT_EQ(strcmp(buffer, last_line), 0, "Decompressed file data does not match");
+
+    ASSERT_EQ(vfs.unmount("/lz4"), fs_error::success, "Failed to unmount decompressed archive");
+    ASSERT_EQ(vfs.unmount("/"), fs_error::success, "Failed to unmount ramfs");
+
+    delete[] archive;
+    return UNIT_TEST_SUCCESS;
+}
+
+// Byte the test patterns store at a device offset
+static __force_inline__ uint8_t block_pattern(uint64_t offset) {
+    return static_cast<uint8_t>((offset * 13) ^ (offset >> 9));
+}
+
+// Fills a RAM disk with the test pattern, bypassing the page cache
+static bool fill_block_device(block_device* device) {
+    static uint8_t block[PAGE_SIZE];
+    size_t block_size = device->block_size();
+
+    for (uint64_t lba = 0; lba < device->block_count(); lba++) {
+        for (size_t i = 0; i < block_size; i++) {
+            block[i] = block_pattern(lba * block_size + i);
+        }
+
+        if (device->write_blocks(lba, 1, block) != 1) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Test reading and writing a RAM disk through the page cache
+DECLARE_UNIT_TEST("vfs block device page cache", test_vfs_block_device_page_cache) {
+    // The last page of the device is only half backed by blocks
+    const uint64_t block_count = 2050;
+    const uint64_t device_size = block_count * 512;
+
+    auto device = kstl::make_shared<ram_block_device>(block_count);
+    ASSERT_TRUE(device->is_valid(), "RAM disk should be allocated");
+    ASSERT_TRUE(fill_block_device(device.get()), "Failed to fill RAM disk");
+    ASSERT_FALSE(kstl::make_shared<ram_block_device>(8, 768)->is_valid(), "Block sizes that don't divide a page should be rejected");
+
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", kstl::make_shared<ram_filesystem>());
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    auto blockfs = kstl::make_shared<block_filesystem>(device);
+    status = vfs.mount("/ram0", blockfs);
+    ASSERT_EQ(status, fs_error::success, "Failed to mount RAM disk: %s", error_to_string(status));
+
+    vfs_stat_struct info;
+    ASSERT_EQ(vfs.stat("/ram0", info), fs_error::success, "Failed to stat RAM disk");
+    ASSERT_EQ(info.type, vfs_node_type::file, "RAM disk should be a file");
+    ASSERT_EQ(info.size, device_size, "RAM disk has the wrong size");
+
+    page_cache_stats before;
+    page_cache::get().get_stats(before);
+    uint64_t blocks_read_before = device->get_blocks_read();
+
+    // A sequential reader should mostly be served from read-ahead
+    static uint8_t buffer[PAGE_SIZE];
+    int fd = vfs.open("/ram0", FS_O_RDWR);
+    ASSERT_TRUE(fd >= FD_TABLE_FIRST_FD, "Failed to open RAM disk: %s", error_to_string(fd));
+
+    uint64_t offset = 0;
+    while (offset < device_size) {
+        ssize_t result = vfs.read(fd, buffer, sizeof(buffer));
+        ASSERT_TRUE(result > 0, "Sequential read failed at offset %llu", offset);
+
+        for (ssize_t i = 0; i < result; i++) {
+            ASSERT_EQ(buffer[i], block_pattern(offset + i), "Device data does not match at offset %llu", offset + i);
+        }
+
+        offset += result;
+    }
+
+    ASSERT_EQ(offset, device_size, "Sequential read should stop at the end of the device");
+    ASSERT_EQ(vfs.read(fd, buffer, sizeof(buffer)), (ssize_t)0, "Reading past the end should return 0");
+
+    page_cache_stats after;
+    page_cache::get().get_stats(after);
+
+    uint64_t page_count = (device_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    ASSERT_TRUE(after.readahead_pages - before.readahead_pages > page_count / 2, "Sequential reads should trigger read-ahead");
+    ASSERT_TRUE(after.misses - before.misses < page_count / 4, "Read-ahead should absorb most misses");
+    ASSERT_EQ(device->get_blocks_read() - blocks_read_before, block_count, "Every block should have been read exactly once");
+
+    // Cached pages are served without touching the device again
+    blocks_read_before = device->get_blocks_read();
+    ASSERT_EQ(vfs.pread(fd, buffer, 100, 12345), (ssize_t)100, "Cached read should succeed");
+    ASSERT_EQ(buffer[0], block_pattern(12345), "Cached data does not match");
+    ASSERT_EQ(device->get_blocks_read(), blocks_read_before, "Cached read should not reach the device");
+
+    // Writes stay in the cache until they are synced
+    uint8_t block[512];
+    ASSERT_EQ(vfs.pwrite(fd, "cached", 6, 5000), (ssize_t)6, "Write should succeed");
+    ASSERT_EQ(device->read_blocks(9, 1, block), (ssize_t)1, "Failed to read block behind the cache");
+    ASSERT_EQ(block[5000 - 9 * 512], block_pattern(5000), "Write should not reach the device before a sync");
+
+    char readback[8] = { 0 };
+    ASSERT_EQ(vfs.pread(fd, readback, 6, 5000), (ssize_t)6, "Reading back a cached write should succeed");
+    ASSERT_EQ(strcmp(readback, "cached"), 0, "Cached write does not match");
+
+    ASSERT_EQ(blockfs->sync(), fs_error::success, "Sync should succeed");
+    ASSERT_EQ(device->read_blocks(9, 1, block), (ssize_t)1, "Failed to read synced block");
+    ASSERT_EQ(memcmp(block + 5000 - 9 * 512, "cached", 6), 0, "Synced write should reach the device");
+    ASSERT_EQ(block[5000 - 9 * 512 + 6], block_pattern(5006), "Sync should preserve the rest of the block");
+
+    // Writes are clamped to the device, with nothing left to write past it
+    ASSERT_EQ(vfs.pwrite(fd, "tail", 4, device_size - 2), (ssize_t)2, "Write at the end should be clamped");
+    ASSERT_EQ(vfs.pwrite(fd, "tail", 4, device_size), make_error_code(fs_error::no_space_left), "Write past the end should fail");
+
+    // Unmounting writes back whatever is still dirty
+    ASSERT_EQ(vfs.pwrite(fd, "first", 5, 0), (ssize_t)5, "Write should succeed");
+    vfs.close(fd);
+
+    ASSERT_EQ(vfs.unmount("/ram0"), fs_error::success, "Failed to unmount RAM disk");
+    ASSERT_EQ(device->read_blocks(0, 1, block), (ssize_t)1, "Failed to read first block");
+    ASSERT_EQ(memcmp(block, "first", 5), 0, "Unmount should write back dirty pages");
+    ASSERT_EQ(device->read_blocks(block_count - 1, 1, block), (ssize_t)1, "Failed to read last block");
+    ASSERT_EQ(memcmp(block + 510, "ta", 2), 0, "Clamped write should reach the last block");
+
+    page_cache::get().get_stats(after);
+    ASSERT_EQ(after.dirty_pages, (size_t)0, "No dirty pages should be left behind");
+
+    ASSERT_EQ(vfs.unmount("/"), fs_error::success, "Failed to unmount ramfs");
+    return UNIT_TEST_SUCCESS;
+}
+
+static uint64_t throughput_mib(uint64_t bytes, uint64_t ns) {
+    return (bytes / 1024) * 1'000'000'000ull / (ns ? ns : 1) / 1024;
+}
+
+// Benchmark sequential, cached and random access to a RAM disk larger than the page cache
+DECLARE_UNIT_TEST("vfs block device throughput benchmark", test_vfs_block_device_throughput) {
+    const uint64_t device_size = 16 * 1024 * 1024;
+    const size_t io_size = 4096;
+    const uint64_t warm_size = 4 * 1024 * 1024;
+    const size_t random_reads = 2048;
+
+    auto device = kstl::make_shared<ram_block_device>(device_size / 512);
+    ASSERT_TRUE(device->is_valid(), "RAM disk should be allocated");
+    ASSERT_TRUE(fill_block_device(device.get()), "Failed to fill RAM disk");
+
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", kstl::make_shared<ram_filesystem>());
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    auto blockfs = kstl::make_shared<block_filesystem>(device);
+    status = vfs.mount("/ram0", blockfs);
+    ASSERT_EQ(status, fs_error::success, "Failed to mount RAM disk: %s", error_to_string(status));
+
+    int fd = vfs.open("/ram0", FS_O_RDWR);
+    ASSERT_TRUE(fd >= FD_TABLE_FIRST_FD, "Failed to open RAM disk: %s", error_to_string(fd));
+
+    static uint8_t buffer[4096];
+
+    // Straight from the device, the cost the cache has to amortize
+    uint64_t start = kernel_timer::get_system_time_in_nanoseconds();
+    for (uint64_t offset = 0; offset < device_size; offset += io_size) {
+        ASSERT_EQ(device->read_blocks(offset / 512, io_size / 512, buffer), (ssize_t)(io_size / 512), "Raw device read failed");
+    }
+    uint64_t raw_ns = kernel_timer::get_system_time_in_nanoseconds() - start;
+
+    page_cache_stats before;
+    page_cache::get().get_stats(before);
+
+    // Cold sequential pass, larger than the cache so the clock has to evict
+    start = kernel_timer::get_system_time_in_nanoseconds();
+    for (uint64_t offset = 0; offset < device_size; offset += io_size) {
+        ASSERT_EQ(vfs.pread(fd, buffer, io_size, offset), (ssize_t)io_size, "Cold read failed at offset %llu", offset);
+    }
+    uint64_t cold_ns = kernel_timer::get_system_time_in_nanoseconds() - start;
+    ASSERT_EQ(buffer[io_size - 1], block_pattern(device_size - 1), "Cold read data does not match");
+
+    page_cache_stats cold;
+    page_cache::get().get_stats(cold);
+
+    // Warm pass over the most recently read part of the device
+    start = kernel_timer::get_system_time_in_nanoseconds();
+    for (uint64_t offset = device_size - warm_size; offset < device_size; offset += io_size) {
+        ASSERT_EQ(vfs.pread(fd, buffer, io_size, offset), (ssize_t)io_size, "Warm read failed at offset %llu", offset);
+    }
+    uint64_t warm_ns = kernel_timer::get_system_time_in_nanoseconds() - start;
+
+    page_cache_stats warm;
+    page_cache::get().get_stats(warm);
+    ASSERT_TRUE(warm.hits - cold.hits > (warm_size / io_size) / 2, "Recently read pages should mostly stay cached");
+
+    // Random page reads, which must not trigger read-ahead
+    uint64_t seed = 0x2545f4914f6cdd1dull;
+    start = kernel_timer::get_system_time_in_nanoseconds();
+    for (size_t i = 0; i < random_reads; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        uint64_t offset = ((seed >> 33) % (device_size / io_size)) * io_size;
+
+        ASSERT_EQ(vfs.pread(fd, buffer, io_size, offset), (ssize_t)io_size, "Random read failed at offset %llu", offset);
+        ASSERT_EQ(buffer[7], block_pattern(offset + 7), "Random read data does not match");
+    }
+    uint64_t random_ns = kernel_timer::get_system_time_in_nanoseconds() - start;
+
+    page_cache_stats random;
+    page_cache::get().get_stats(random);
+
+    // Sequential writes, followed by writing everything back
+    memset(buffer, 0x5a, sizeof(buffer));
+    start = kernel_timer::get_system_time_in_nanoseconds();
+    for (uint64_t offset = 0; offset < device_size; offset += io_size) {
+        ASSERT_EQ(vfs.pwrite(fd, buffer, io_size, offset), (ssize_t)io_size, "Write failed at offset %llu", offset);
+    }
+    ASSERT_EQ(blockfs->sync(), fs_error::success, "Sync should succeed");
+    uint64_t write_ns = kernel_timer::get_system_time_in_nanoseconds() - start;
+
+    uint8_t block[512];
+    ASSERT_EQ(device->read_blocks(device_size / 512 - 1, 1, block), (ssize_t)1, "Failed to read last block");
+    ASSERT_EQ(block[511], (uint8_t)0x5a, "Written data should reach the device");
+    vfs.close(fd);
+
+    serial::printf(UNIT_TEST_PREFIX "block device benchmark: %llu MiB RAM disk, %llu byte I/O\n", device_size / (1024 * 1024), io_size);
+    serial::printf(UNIT_TEST_PREFIX "  raw device:      %llu MiB/s\n", throughput_mib(device_size, raw_ns));
+    serial::printf(UNIT_TEST_PREFIX "  cold sequential: %llu MiB/s (%llu pages read ahead, %llu evicted)\n",
+        throughput_mib(device_size, cold_ns), cold.readahead_pages - before.readahead_pages, cold.evictions - before.evictions);
+    serial::printf(UNIT_TEST_PREFIX "  warm sequential: %llu MiB/s (%llu hits)\n", throughput_mib(warm_size, warm_ns), warm.hits - cold.hits);
+    serial::printf(UNIT_TEST_PREFIX "  random:          %llu MiB/s (%llu pages read ahead)\n",
+        throughput_mib(random_reads * io_size, random_ns), random.readahead_pages - warm.readahead_pages);
+    serial::printf(UNIT_TEST_PREFIX "  write + sync:    %llu MiB/s\n", throughput_mib(device_size, write_ns));
+
+    ASSERT_EQ(vfs.unmount("/ram0"), fs_error::success, "Failed to unmount RAM disk");
+    ASSERT_EQ(vfs.unmount("/"), fs_error::success, "Failed to unmount ramfs");
+    return UNIT_TEST_SUCCESS;
+}
+
+// Reaps the completions of a batch, indexed by their user data
+static bool reap_io_completions(io_ring* ring, io_cqe* results, size_t count) {
+    if (ring->enter(static_cast<uint32_t>(count), 5'000'000'000ull) < count) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        io_cqe cqe;
+        if (!ring->pop_cqe(cqe) || cqe.user_data >= count) {
+            return false;
+        }
+
+        results[cqe.user_data] = cqe;
+    }
+
+    return true;
+}
+
+// Test batching vectored, open, stat and linked operations through an I/O ring
+DECLARE_UNIT_TEST("vfs io ring", test_vfs_io_ring) {
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", kstl::make_shared<ram_filesystem>());
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    ASSERT_EQ(vfs.create("/font.psf", vfs_node_type::file, 0644), fs_error::success, "Failed to create file");
+    ASSERT_EQ(vfs.write("/font.psf", "glyph data", 10, 0), (ssize_t)10, "Failed to write file");
+
+    ASSERT_TRUE(io_ring::create(3) == nullptr, "Entry counts must be powers of two");
+
+    io_ring* ring = io_ring::create(8);
+    ASSERT_TRUE(ring != nullptr, "Ring should be created");
+
+    io_ring_params params;
+    ring->get_params(params);
+    ASSERT_EQ(params.sq_entries, (uint32_t)8, "Ring has the wrong submission queue size");
+    ASSERT_EQ(params.cq_entries, (uint32_t)16, "Completion queue should be twice the submission queue");
+
+    // One batch: open, stat, a vectored read and write of already open files and a nop
+    int fd = vfs.open("/font.psf", FS_O_RDWR);
+    ASSERT_TRUE(fd >= FD_TABLE_FIRST_FD, "Failed to open file: %s", error_to_string(fd));
+
+    char head[6] = { 0 };
+    char tail[6] = { 0 };
+    io_iovec read_iov[2] = { { head, 5 }, { tail, 5 } };
+    io_iovec write_iov[2] = { { (void*)"GLY", 3 }, { (void*)"PH", 2 } };
+    vfs_stat_struct info;
+    zeromem(&info, sizeof(info));
+
+    io_sqe* sqe = ring->get_sqe();
+    sqe->opcode = IO_OP_OPEN;
+    sqe->addr = reinterpret_cast<uint64_t>("/new.bin");
+    sqe->op_flags = FS_O_RDWR | FS_O_CREAT;
+    sqe->len = 0644;
+    sqe->user_data = 0;
+
+    sqe = ring->get_sqe();
+    sqe->opcode = IO_OP_STAT;
+    sqe->addr = reinterpret_cast<uint64_t>("/font.psf");
+    sqe->addr2 = reinterpret_cast<uint64_t>(&info);
+    sqe->user_data = 1;
+
+    sqe = ring->get_sqe();
+    sqe->opcode = IO_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(read_iov);
+    sqe->len = 2;
+    sqe->offset = 0;
+    sqe->user_data = 2;
+
+    // Linked, so the write only runs after the read succeeded
+    sqe->flags = IO_SQE_LINK;
+
+    sqe = ring->get_sqe();
+    sqe->opcode = IO_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(write_iov);
+    sqe->len = 2;
+    sqe->offset = 0;
+    sqe->user_data = 3;
+
+    sqe = ring->get_sqe();
+    sqe->opcode = IO_OP_NOP;
+    sqe->user_data = 4;
+
+    ASSERT_EQ(ring->submit(), (uint32_t)5, "Every reserved entry should be submitted");
+
+    io_cqe results[8];
+    ASSERT_TRUE(reap_io_completions(ring, results, 5), "Batch should complete");
+
+    ASSERT_TRUE(results[0].result >= FD_TABLE_FIRST_FD, "Open through the ring failed: %s", error_to_string(results[0].result));
+    int ring_fd = static_cast<int>(results[0].result);
+    ASSERT_EQ(vfs.stat("/new.bin", info), fs_error::success, "Ring open should have created the file");
+
+    ASSERT_EQ(results[1].result, (int64_t)0, "Stat through the ring failed");
+    ASSERT_EQ(info.size, (uint64_t)10, "Ring stat reported the wrong size");
+
+    ASSERT_EQ(results[2].result, (int64_t)10, "Vectored read should fill both buffers");
+    ASSERT_EQ(strcmp(head, "glyph"), 0, "First buffer of the vectored read does not match");
+    ASSERT_EQ(strcmp(tail, " data"), 0, "Second buffer of the vectored read does not match");
+
+    ASSERT_EQ(results[3].result, (int64_t)5, "Vectored write should write both buffers");
+    ASSERT_EQ(results[4].result, (int64_t)0, "Nop should succeed");
+
+    char readback[11] = { 0 };
+    ASSERT_EQ(vfs.pread(fd, readback, 10, 0), (ssize_t)10, "Failed to read back file");
+    ASSERT_EQ(strcmp(readback, "GLYPH data"), 0, "Vectored write data does not match");
+
+    // A failing link cancels the rest of its chain, the next chain runs normally
+    sqe = ring->get_sqe();
+    sqe->opcode = IO_OP_OPEN;
+    sqe->addr = reinterpret_cast<uint64_t>("/missing.psf");
+    sqe->flags = IO_SQE_LINK;
+    sqe->user_data = 0;
+
+    sqe = ring->get_sqe();
+    sqe->opcode = IO_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(read_iov);
+    sqe->len = 2;
+    sqe->flags = IO_SQE_LINK;
+    sqe->user_data = 1;
+
+    sqe = ring->get_sqe();
+    sqe->opcode = IO_OP_NOP;
+    sqe->user_data = 2;
+
+    sqe = ring->get_sqe();
+    sqe->opcode = IO_OP_CLOSE;
+    sqe->fd = ring_fd;
+    sqe->user_data = 3;
+
+    ring->submit();
+    ASSERT_TRUE(reap_io_completions(ring, results, 4), "Linked batch should complete");
+    ASSERT_EQ(results[0].result, make_error_code(fs_error::not_found), "Opening a missing file should fail");
+    ASSERT_EQ(results[1].result, make_error_code(fs_error::canceled), "Linked read should be canceled");
+    ASSERT_EQ(results[2].result, make_error_code(fs_error::canceled), "End of the chain should be canceled");
+    ASSERT_EQ(results[3].result, (int64_t)0, "Unlinked close should run");
+    ASSERT_EQ(vfs.close(ring_fd), fs_error::bad_descriptor, "Ring close should have closed the descriptor");
+
+    // The submission queue holds at most its entry count until the worker consumes it
+    for (int i = 0; i < 8; i++) {
+        sqe = ring->get_sqe();
+        ASSERT_TRUE(sqe != nullptr, "Submission queue should have room");
+        sqe->opcode = IO_OP_NOP;
+        sqe->user_data = i;
+    }
+    ASSERT_TRUE(ring->get_sqe() == nullptr, "Full submission queue should reject entries");
+
+    ring->submit();
+    ASSERT_TRUE(reap_io_completions(ring, results, 8), "Full queue should complete");
+
+    vfs.close(fd);
+    delete ring;
+
+    ASSERT_EQ(vfs.remove("/new.bin"), fs_error::success, "Failed to remove ring-created file");
+    ASSERT_EQ(vfs.remove("/font.psf"), fs_error::success, "Failed to remove file");
+    ASSERT_EQ(vfs.unmount("/"), fs_error::success, "Failed to unmount ramfs");
+    return UNIT_TEST_SUCCESS;
+}
+
+DECLARE_UNIT_TEST("vfs file mappings", test_vfs_file_mappings) {
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", kstl::make_shared<ram_filesystem>());
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    // Three pages, the last one only partially filled
+    const size_t file_size = 2 * PAGE_SIZE + 100;
+    static uint8_t contents[2 * PAGE_SIZE + 100];
+    for (size_t i = 0; i < file_size; i++) {
+        contents[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+
+    ASSERT_EQ(vfs.create("/asset.bin", vfs_node_type::file, 0644), fs_error::success, "Failed to create file");
+    ASSERT_EQ(vfs.write("/asset.bin", contents, file_size, 0), (ssize_t)file_size, "Failed to write file");
+
+    int ro_fd = vfs.open("/asset.bin", FS_O_RDONLY);
+    int rw_fd = vfs.open("/asset.bin", FS_O_RDWR);
+    ASSERT_TRUE(ro_fd >= FD_TABLE_FIRST_FD && rw_fd >= FD_TABLE_FIRST_FD, "Failed to open file");
+
+    void* addr = nullptr;
+    ASSERT_EQ(vfs.mmap(ro_fd, 100, PAGE_SIZE, FS_PROT_READ, FS_MAP_SHARED, addr), fs_error::invalid_argument, "Misaligned offsets should be rejected");
+    ASSERT_EQ(vfs.mmap(ro_fd, 0, 4 * PAGE_SIZE, FS_PROT_READ, FS_MAP_SHARED, addr), fs_error::invalid_argument, "Pages past the end of the file should be rejected");
+    ASSERT_EQ(vfs.mmap(ro_fd, 0, PAGE_SIZE, FS_PROT_READ, FS_MAP_SHARED | FS_MAP_PRIVATE, addr), fs_error::invalid_argument, "Exactly one sharing mode should be required");
+    ASSERT_EQ(vfs.mmap(ro_fd, 0, PAGE_SIZE, FS_PROT_READ | FS_PROT_WRITE, FS_MAP_SHARED, addr), fs_error::permission_denied, "Shared writes should need a writable file");
+
+    // Read-only mappings are the file's own pages, later writes to the file show through
+    uint8_t* shared_ro = nullptr;
+    status = vfs.mmap(ro_fd, 0, file_size, FS_PROT_READ, FS_MAP_SHARED, addr);
+    ASSERT_EQ(status, fs_error::success, "Read-only mapping failed: %s", error_to_string(status));
+    shared_ro = static_cast<uint8_t*>(addr);
+    ASSERT_EQ(memcmp(shared_ro, contents, file_size), 0, "Mapped data does not match the file");
+    ASSERT_EQ(shared_ro[file_size], (uint8_t)0, "The tail of the last page should read as zeros");
+
+    ASSERT_EQ(vfs.pwrite(rw_fd, "live", 4, PAGE_SIZE), (ssize_t)4, "Write to the file failed");
+    ASSERT_EQ(memcmp(shared_ro + PAGE_SIZE, "live", 4), 0, "File writes should be visible through the mapping");
+
+    // The mapping keeps the file open after its descriptor is gone
+    ASSERT_EQ(vfs.close(ro_fd), fs_error::success, "Failed to close descriptor");
+    ASSERT_EQ(shared_ro[0], contents[0], "Mapping should outlive its descriptor");
+
+    // Shared writes land in the file without a sync
+    status = vfs.mmap(rw_fd, PAGE_SIZE, PAGE_SIZE, FS_PROT_READ | FS_PROT_WRITE, FS_MAP_SHARED, addr);
+    ASSERT_EQ(status, fs_error::success, "Shared writable mapping failed: %s", error_to_string(status));
+    uint8_t* shared_rw = static_cast<uint8_t*>(addr);
+    memcpy(shared_rw + 8, "shared", 6);
+
+    char readback[8] = { 0 };
+    ASSERT_EQ(vfs.pread(rw_fd, readback, 6, PAGE_SIZE + 8), (ssize_t)6, "Failed to read back file");
+    ASSERT_EQ(strcmp(readback, "shared"), 0, "Shared mapping writes should reach the file");
+    ASSERT_EQ(memcmp(shared_ro + PAGE_SIZE + 8, "shared", 6), 0, "Mappings of the same file should share pages");
+
+    // Private writes copy the page on the first write and never reach the file
+    status = vfs.mmap(rw_fd, 0, file_size, FS_PROT_READ | FS_PROT_WRITE, FS_MAP_PRIVATE, addr);
+    ASSERT_EQ(status, fs_error::success, "Private mapping failed: %s", error_to_string(status));
+    uint8_t* priv = static_cast<uint8_t*>(addr);
+    ASSERT_EQ(memcmp(priv + PAGE_SIZE + 8, "shared", 6), 0, "Private mapping should start out with the file's data");
+
+    memcpy(priv + PAGE_SIZE + 8, "copied", 6);
+    ASSERT_EQ(memcmp(priv + PAGE_SIZE + 8, "copied", 6), 0, "Private write should be visible in the mapping");
+    ASSERT_EQ(memcmp(priv + PAGE_SIZE, "live", 4), 0, "Private copy should keep the rest of the page");
+    ASSERT_EQ(vfs.pread(rw_fd, readback, 6, PAGE_SIZE + 8), (ssize_t)6, "Failed to read back file");
+    ASSERT_EQ(strcmp(readback, "shared"), 0, "Private writes should not reach the file");
+    ASSERT_EQ(memcmp(shared_ro + PAGE_SIZE + 8, "shared", 6), 0, "Private writes should not reach other mappings");
+    ASSERT_EQ(vfs.msync(priv, file_size), fs_error::success, "Syncing a private mapping should succeed");
+    ASSERT_EQ(vfs.pread(rw_fd, readback, 6, PAGE_SIZE + 8), (ssize_t)6, "Failed to read back file");
+    ASSERT_EQ(strcmp(readback, "shared"), 0, "Syncing a private mapping should leave the file alone");
+
+    // Punching a hole into a mapping leaves both ends mapped
+    ASSERT_EQ(vfs.munmap(priv + 1, PAGE_SIZE), fs_error::invalid_argument, "Misaligned unmaps should be rejected");
+    ASSERT_EQ(vfs.munmap(priv + PAGE_SIZE, PAGE_SIZE), fs_error::success, "Unmapping the middle page failed");
+    ASSERT_EQ(priv[0], contents[0], "First page should stay mapped");
+    ASSERT_EQ(priv[2 * PAGE_SIZE], contents[2 * PAGE_SIZE], "Last page should stay mapped");
+
+    // Freed ranges get handed out again
+    status = vfs.mmap(rw_fd, PAGE_SIZE, PAGE_SIZE, FS_PROT_READ, FS_MAP_PRIVATE, addr);
+    ASSERT_EQ(status, fs_error::success, "Mapping into the hole failed: %s", error_to_string(status));
+    ASSERT_TRUE(addr == priv + PAGE_SIZE, "The hole should be reused");
+    ASSERT_EQ(memcmp(static_cast<uint8_t*>(addr) + 8, "shared", 6), 0, "New mapping should see the file, not the old copy");
+
+    ASSERT_EQ(vfs.munmap(priv, 3 * PAGE_SIZE), fs_error::success, "Unmapping across mappings failed");
+    ASSERT_EQ(vfs.munmap(shared_rw, PAGE_SIZE), fs_error::success, "Failed to unmap shared writable mapping");
+    ASSERT_EQ(vfs.munmap(shared_ro, file_size), fs_error::success, "Failed to unmap read-only mapping");
+    vfs.close(rw_fd);
+
+    // Files that can't hand out their pages are mapped as copies, shared writes reach them on msync
+    auto device = kstl::make_shared<ram_block_device>(16);
+    ASSERT_TRUE(device->is_valid(), "RAM disk should be allocated");
+    ASSERT_EQ(vfs.mount("/ram0", kstl::make_shared<block_filesystem>(device)), fs_error::success, "Failed to mount RAM disk");
+
+    int disk_fd = vfs.open("/ram0", FS_O_RDWR);
+    ASSERT_TRUE(disk_fd >= FD_TABLE_FIRST_FD, "Failed to open RAM disk");
+    ASSERT_EQ(vfs.pwrite(disk_fd, "disk", 4, 0), (ssize_t)4, "Failed to write RAM disk");
+
+    status = vfs.mmap(disk_fd, 0, PAGE_SIZE, FS_PROT_READ | FS_PROT_WRITE, FS_MAP_SHARED, addr);
+    ASSERT_EQ(status, fs_error::success, "Mapping the RAM disk failed: %s", error_to_string(status));
+    uint8_t* disk = static_cast<uint8_t*>(addr);
+    ASSERT_EQ(memcmp(disk, "disk", 4), 0, "Copied mapping should hold the device's data");
+
+    memcpy(disk + 100, "synced", 6);
+    ASSERT_EQ(vfs.pread(disk_fd, readback, 6, 100), (ssize_t)6, "Failed to read RAM disk");
+    ASSERT_TRUE(memcmp(readback, "synced", 6) != 0, "Copied mappings should only reach the file on msync");
+
+    ASSERT_EQ(vfs.msync(disk, PAGE_SIZE), fs_error::success, "Sync failed");
+    ASSERT_EQ(vfs.pread(disk_fd, readback, 6, 100), (ssize_t)6, "Failed to read RAM disk");
+    ASSERT_EQ(strcmp(readback, "synced"), 0, "Sync should write the mapping back");
+
+    ASSERT_EQ(vfs.munmap(disk, PAGE_SIZE), fs_error::success, "Failed to unmap RAM disk");
+    vfs.close(disk_fd);
+
+    ASSERT_EQ(vfs.unmount("/ram0"), fs_error::success, "Failed to unmount RAM disk");
+    ASSERT_EQ(vfs.remove("/asset.bin"), fs_error::success, "Failed to remove file");
+    ASSERT_EQ(vfs.unmount("/"), fs_error::success, "Failed to unmount ramfs");
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test that mappings keep the pages of a removed file alive
+DECLARE_UNIT_TEST("vfs mapping of a removed file", test_vfs_mapping_removed_file) {
+    auto& vfs = virtual_filesystem::get();
+    fs_error status = vfs.mount("/", kstl::make_shared<ram_filesystem>());
+    ASSERT_EQ(status, fs_error::success, "Failed to mount ramfs: %s", error_to_string(status));
+
+    const size_t file_size = 2 * PAGE_SIZE;
+    static uint8_t contents[2 * PAGE_SIZE];
+    for (size_t i = 0; i < file_size; i++) {
+        contents[i] = static_cast<uint8_t>(i * 13 + 5);
+    }
+
+    ASSERT_EQ(vfs.create("/doomed.bin", vfs_node_type::file, 0644), fs_error::success, "Failed to create file");
+    ASSERT_EQ(vfs.write("/doomed.bin", contents, file_size, 0), (ssize_t)file_size, "Failed to write file");
+
+    int fd = vfs.open("/doomed.bin", FS_O_RDWR);
+    ASSERT_TRUE(fd >= FD_TABLE_FIRST_FD, "Failed to open file");
+
+    void* addr = nullptr;
+    status = vfs.mmap(fd, 0, file_size, FS_PROT_READ | FS_PROT_WRITE, FS_MAP_SHARED, addr);
+    ASSERT_EQ(status, fs_error::success, "Shared mapping failed: %s", error_to_string(status));
+    uint8_t* shared = static_cast<uint8_t*>(addr);
+
+    status = vfs.mmap(fd, 0, file_size, FS_PROT_READ | FS_PROT_WRITE, FS_MAP_PRIVATE, addr);
+    ASSERT_EQ(status, fs_error::success, "Private mapping failed: %s", error_to_string(status));
+    uint8_t* priv = static_cast<uint8_t*>(addr);
+
+    // Only the mappings refer to the file once it's closed and removed
+    ASSERT_EQ(vfs.close(fd), fs_error::success, "Failed to close descriptor");
+    ASSERT_EQ(vfs.remove("/doomed.bin"), fs_error::success, "Failed to remove mapped file");
+    ASSERT_TRUE(!vfs.path_exists("/doomed.bin"), "Removed file should be gone from the namespace");
+
+    // Reuse freed memory, the mapped pages must not be handed out
+    ASSERT_EQ(vfs.create("/reused.bin", vfs_node_type::file, 0644), fs_error::success, "Failed to create file");
+    static uint8_t filler[4 * PAGE_SIZE];
+    memset(filler, 0xAA, sizeof(filler));
+    ASSERT_EQ(vfs.write("/reused.bin", filler, sizeof(filler), 0), (ssize_t)sizeof(filler), "Failed to write file");
+
+    ASSERT_EQ(memcmp(shared, contents, file_size), 0, "Shared mapping should still hold the removed file's data");
+    ASSERT_EQ(memcmp(priv, contents, file_size), 0, "Private mapping should still hold the removed file's data");
+
+    // Both kinds of writes still work, the private one copies the page on the first write
+    memcpy(shared + PAGE_SIZE, "pinned", 6);
+    memcpy(priv, "copied", 6);
+    ASSERT_EQ(memcmp(priv + PAGE_SIZE, "pinned", 6), 0, "Mappings of the removed file should still share its pages");
+    ASSERT_EQ(memcmp(shared, contents, 6), 0, "Private writes should not reach the removed file's pages");
+
+    ASSERT_EQ(vfs.munmap(priv, file_size), fs_error::success, "Failed to unmap private mapping");
+    ASSERT_EQ(vfs.munmap(shared, file_size), fs_error::success, "Failed to unmap shared mapping");
+
+    ASSERT_EQ(vfs.remove("/reused.bin"), fs_error::success, "Failed to remove file");
+    ASSERT_EQ(vfs.unmount("/"), fs_error::success, "Failed to unmount ramfs");
+    return UNIT_TEST_SUCCESS;
+}
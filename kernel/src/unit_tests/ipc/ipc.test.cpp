@@ -0,0 +1,646 @@
+#include <unit_tests/unit_tests.h>
+#include <ipc/mq.h>
+#include <ipc/channel.h>
+#include <ipc/endpoint.h>
+#include <sched/sched.h>
+#include <time/time.h>
+
+using namespace sched;
+
+// Test in-place sending and receiving on a channel, including ring wraparound
+DECLARE_UNIT_TEST("ipc channel zero-copy send and receive", test_channel_zero_copy) {
+    ipc::channel_handle_t handle = ipc::channel::create("ipc_test_channel_basic", 4);
+    ASSERT_TRUE(handle != CHANNEL_ID_INVALID, "Channel should be created");
+    ASSERT_TRUE(ipc::channel::get(ipc::channel::open("ipc_test_channel_basic")).get() == ipc::channel::get(handle).get(), "Opening by name should resolve to the same channel");
+    ASSERT_EQ(ipc::channel::create("ipc_test_channel_basic"), (ipc::channel_handle_t)CHANNEL_ID_INVALID, "Duplicate names should be rejected");
+    ASSERT_EQ(ipc::channel::create("ipc_test_channel_bad_size", 3), (ipc::channel_handle_t)CHANNEL_ID_INVALID, "Slot counts must be a power of two");
+
+    ipc::object_ref<ipc::channel> chan = ipc::channel::get(handle);
+    ASSERT_TRUE(chan, "Handle should resolve to a channel");
+    ASSERT_FALSE(chan->can_receive(), "A new channel should be empty");
+
+    // Cycle through the ring a few times to cover index wraparound
+    for (uint64_t round = 0; round < 3; round++) {
+        for (uint64_t i = 0; i < 4; i++) {
+            uint64_t* slot = reinterpret_cast<uint64_t*>(chan->begin_send());
+            ASSERT_TRUE(slot != nullptr, "Ring should have a free slot");
+            *slot = round * 4 + i;
+            chan->commit_send(sizeof(uint64_t));
+        }
+
+        ASSERT_TRUE(chan->begin_send() == nullptr, "Ring should be full after filling every slot");
+        ASSERT_FALSE(chan->try_send("x", 1), "Sending into a full ring should fail");
+
+        for (uint64_t i = 0; i < 4; i++) {
+            size_t size = 0;
+            const uint64_t* msg = reinterpret_cast<const uint64_t*>(chan->begin_receive(&size));
+            ASSERT_TRUE(msg != nullptr, "Ring should hold a message");
+            ASSERT_EQ(size, sizeof(uint64_t), "Message size should be preserved");
+            ASSERT_EQ(*msg, round * 4 + i, "Messages should arrive in order");
+            chan->end_receive();
+        }
+
+        ASSERT_FALSE(chan->can_receive(), "Ring should be empty after draining it");
+    }
+
+    static uint8_t oversized[CHANNEL_MAX_MESSAGE_SIZE + 1];
+    ASSERT_FALSE(chan->try_send(oversized, sizeof(oversized)), "Messages larger than a slot should be rejected");
+
+    return UNIT_TEST_SUCCESS;
+}
+
+struct channel_bench_context {
+    ipc::object_ref<ipc::channel> chan;
+    int messages;
+    volatile uint64_t checksum;
+    volatile int finished;
+};
+
+// Drains the channel, parking on the doorbell whenever it runs empty
+void channel_consumer_task(void* data) {
+    auto ctx = reinterpret_cast<channel_bench_context*>(data);
+
+    for (int i = 0; i < ctx->messages; i++) {
+        uint64_t value = 0;
+        size_t size = 0;
+        ctx->chan->receive(&value, sizeof(value), &size);
+        ctx->checksum += value;
+    }
+
+    ctx->finished = 1;
+    exit_thread();
+}
+
+// Test that a blocked consumer gets woken up by the producer's doorbell
+DECLARE_UNIT_TEST("ipc channel doorbell wakes consumer", test_channel_doorbell) {
+    ipc::channel_handle_t handle = ipc::channel::create("ipc_test_channel_doorbell", 8);
+    ASSERT_TRUE(handle != CHANNEL_ID_INVALID, "Channel should be created");
+
+    auto ctx = new channel_bench_context();
+    ASSERT_TRUE(ctx != nullptr, "Context should be allocated");
+
+    ctx->chan = ipc::channel::get(handle);
+    ctx->messages = 5000;
+
+    task_control_block* task = create_priv_kernel_task(channel_consumer_task, ctx);
+    ASSERT_TRUE(task != nullptr, "Consumer task should be created");
+    scheduler::get().add_task(task);
+
+    // Send in bursts with pauses in between, so the consumer runs dry and parks
+    uint64_t expected = 0;
+    uint64_t start = kernel_timer::get_system_time_in_nanoseconds();
+    for (uint64_t i = 1; i <= (uint64_t)ctx->messages; i++) {
+        ASSERT_TRUE(ctx->chan->send(&i, sizeof(i)), "Send should succeed");
+        expected += i;
+
+        if ((i % 500) == 0) {
+            msleep(1);
+        }
+    }
+
+    // Wait for the consumer to finish with a 10 second timeout
+    while (!ctx->finished) {
+        if (kernel_timer::get_system_time_in_nanoseconds() - start > 10'000'000'000ull) {
+            break;
+        }
+        yield();
+    }
+
+    ASSERT_EQ(ctx->finished, 1, "Consumer should receive every message");
+    ASSERT_EQ(ctx->checksum, expected, "Consumer should see every message exactly once");
+
+    delete ctx;
+    return UNIT_TEST_SUCCESS;
+}
+
+// Compare the per-message cost of a channel against a message queue
+DECLARE_UNIT_TEST("ipc channel vs message queue benchmark", test_channel_mq_benchmark) {
+    const int iterations = 10000;
+
+    ipc::mq_handle_t mq = ipc::message_queue::create("ipc_test_bench_mq");
+    ipc::object_ref<ipc::channel> chan = ipc::channel::get(ipc::channel::create("ipc_test_bench_channel"));
+    ASSERT_TRUE(mq != MESSAGE_QUEUE_ID_INVALID && chan, "Benchmark queues should be created");
+
+    uint8_t payload[64] = { 0 };
+
+    uint64_t start = rdtsc();
+    for (int i = 0; i < iterations; i++) {
+        ipc::mq_message msg;
+        msg.payload_size = sizeof(payload);
+        msg.payload = payload;
+        ipc::message_queue::post_message(mq, &msg);
+
+        ipc::mq_message out;
+        ipc::message_queue::get_message(mq, &out);
+        delete[] out.payload;
+    }
+    uint64_t mq_cycles = rdtsc() - start;
+
+    start = rdtsc();
+    for (int i = 0; i < iterations; i++) {
+        void* slot = chan->begin_send();
+        memcpy(slot, payload, sizeof(payload));
+        chan->commit_send(sizeof(payload));
+
+        size_t size = 0;
+        chan->begin_receive(&size);
+        chan->end_receive();
+    }
+    uint64_t channel_cycles = rdtsc() - start;
+
+    ASSERT_FALSE(chan->can_receive(), "Channel should be drained");
+    ASSERT_FALSE(ipc::message_queue::peek_message(mq), "Message queue should be drained");
+
+    serial::printf(UNIT_TEST_PREFIX "ipc benchmark: %i send/receive pairs, %llu byte payload\n", iterations, sizeof(payload));
+    serial::printf(UNIT_TEST_PREFIX "  message queue  : %llu cycles/msg\n", mq_cycles / iterations);
+    serial::printf(UNIT_TEST_PREFIX "  channel        : %llu cycles/msg\n", channel_cycles / iterations);
+
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test that a blocking receive on an empty queue gives up after its timeout
+DECLARE_UNIT_TEST("ipc mq receive timeout", test_mq_receive_timeout) {
+    ipc::mq_handle_t mq = ipc::message_queue::create("ipc_test_timeout_mq");
+    ASSERT_TRUE(mq != MESSAGE_QUEUE_ID_INVALID, "Queue should be created");
+
+    ipc::mq_message msg;
+    ASSERT_FALSE(ipc::message_queue::receive(mq, &msg, 0), "A zero timeout should not block");
+
+    const uint64_t timeout_ns = 20'000'000ull;
+    uint64_t start = kernel_timer::get_system_time_in_nanoseconds();
+    ASSERT_FALSE(ipc::message_queue::receive(mq, &msg, timeout_ns), "Receive on an empty queue should time out");
+    uint64_t elapsed = kernel_timer::get_system_time_in_nanoseconds() - start;
+
+    ASSERT_TRUE(elapsed >= timeout_ns, "Receive should block for the whole timeout");
+
+    ipc::mq_handle_t invalid = MESSAGE_QUEUE_ID_INVALID;
+    ASSERT_EQ(ipc::message_queue::wait_any(&invalid, 1, 0), (int64_t)-1, "Invalid handles should be rejected");
+    return UNIT_TEST_SUCCESS;
+}
+
+struct mq_wakeup_context {
+    ipc::mq_handle_t handles[3];
+    volatile int64_t ready_index;
+    volatile int received;
+    volatile int finished;
+};
+
+// Blocks on a set of queues, then receives from whichever one became ready
+void mq_wait_any_task(void* data) {
+    auto ctx = reinterpret_cast<mq_wakeup_context*>(data);
+
+    ctx->ready_index = ipc::message_queue::wait_any(ctx->handles, 3, 5'000'000'000ull);
+    if (ctx->ready_index >= 0) {
+        ipc::mq_message msg;
+        if (ipc::message_queue::receive(ctx->handles[ctx->ready_index], &msg, 0)) {
+            ctx->received = *reinterpret_cast<int*>(msg.payload);
+            delete[] msg.payload;
+        }
+    }
+
+    ctx->finished = 1;
+    exit_thread();
+}
+
+// Test that posting to one of several queues wakes up a task blocked in wait_any
+DECLARE_UNIT_TEST("ipc mq wait_any wakeup", test_mq_wait_any) {
+    auto ctx = new mq_wakeup_context();
+    ASSERT_TRUE(ctx != nullptr, "Context should be allocated");
+
+    ctx->handles[0] = ipc::message_queue::create("ipc_test_wait_any_0");
+    ctx->handles[1] = ipc::message_queue::create("ipc_test_wait_any_1");
+    ctx->handles[2] = ipc::message_queue::create("ipc_test_wait_any_2");
+    ctx->ready_index = -2;
+
+    task_control_block* task = create_priv_kernel_task(mq_wait_any_task, ctx);
+    ASSERT_TRUE(task != nullptr, "Waiting task should be created");
+    scheduler::get().add_task(task);
+
+    // Give the task time to block before posting
+    msleep(20);
+
+    int value = 42;
+    ipc::mq_message msg;
+    msg.payload_size = sizeof(value);
+    msg.payload = reinterpret_cast<uint8_t*>(&value);
+    ASSERT_TRUE(ipc::message_queue::post_message(ctx->handles[2], &msg), "Post should succeed");
+
+    uint64_t start = kernel_timer::get_system_time_in_nanoseconds();
+    while (!ctx->finished) {
+        if (kernel_timer::get_system_time_in_nanoseconds() - start > 10'000'000'000ull) {
+            break;
+        }
+        yield();
+    }
+
+    ASSERT_EQ(ctx->finished, 1, "Waiting task should wake up and finish");
+    ASSERT_EQ(ctx->ready_index, (int64_t)2, "wait_any should report the queue that got the message");
+    ASSERT_EQ(ctx->received, 42, "The message should be received from the ready queue");
+
+    delete ctx;
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test that closed handles go stale and can't resolve whatever reuses their slot
+DECLARE_UNIT_TEST("ipc handle table generations", test_handle_table_generations) {
+    ipc::mq_handle_t first = ipc::message_queue::create("ipc_test_handle_gen_0");
+    ASSERT_TRUE(first != MESSAGE_QUEUE_ID_INVALID, "Queue should be created");
+
+    ipc::mq_handle_t opened = ipc::message_queue::open("ipc_test_handle_gen_0");
+    ASSERT_TRUE(opened != MESSAGE_QUEUE_ID_INVALID && opened != first, "Opening should install a second handle");
+
+    // Handles of one object type must not resolve as another
+    ASSERT_FALSE(ipc::channel::get(first), "A queue handle should not resolve to a channel");
+    ASSERT_FALSE(ipc::channel::close(first), "A queue handle should not be closable as a channel");
+
+    ASSERT_TRUE(ipc::message_queue::close(first), "Closing an open handle should succeed");
+    ASSERT_FALSE(ipc::message_queue::close(first), "Closing a handle twice should fail");
+    ASSERT_FALSE(ipc::message_queue::peek_message(first), "A closed handle should not resolve");
+    ASSERT_EQ(ipc::message_queue::open("ipc_test_handle_gen_0"), (ipc::mq_handle_t)MESSAGE_QUEUE_ID_INVALID, "Closing the creator's handle should withdraw the name");
+
+    // The remaining handle keeps the queue alive
+    int value = 7;
+    ipc::mq_message msg;
+    msg.payload_size = sizeof(value);
+    msg.payload = reinterpret_cast<uint8_t*>(&value);
+    ASSERT_TRUE(ipc::message_queue::post_message(opened, &msg), "The opened handle should still be usable");
+
+    // A new object landing in the freed slot gets a new generation
+    ipc::mq_handle_t second = ipc::message_queue::create("ipc_test_handle_gen_1");
+    ASSERT_TRUE(second != MESSAGE_QUEUE_ID_INVALID, "Queue should be created");
+    if (IPC_HANDLE_INDEX(second) == IPC_HANDLE_INDEX(first)) {
+        ASSERT_TRUE(IPC_HANDLE_GENERATION(second) != IPC_HANDLE_GENERATION(first), "A reused slot should get a new generation");
+    }
+    ASSERT_FALSE(ipc::message_queue::post_message(first, &msg), "A stale handle should not reach the slot's new queue");
+    ASSERT_FALSE(ipc::message_queue::peek_message(second), "The new queue should be empty");
+
+    ASSERT_TRUE(ipc::message_queue::close(opened), "Closing the last handle should succeed");
+    ASSERT_TRUE(ipc::message_queue::close(second), "Closing an open handle should succeed");
+    return UNIT_TEST_SUCCESS;
+}
+
+#define TEST_MQ_EVENT_MOTION  1
+#define TEST_MQ_EVENT_CLICK   2
+
+struct test_mq_event {
+    uint32_t type;
+    int32_t value;
+};
+
+// Pointer motion supersedes earlier motion, everything else is queued as is
+static uint64_t test_mq_coalesce_motion(const ipc::mq_message* message) {
+    auto evt = reinterpret_cast<const test_mq_event*>(message->payload);
+    return evt->type == TEST_MQ_EVENT_MOTION ? TEST_MQ_EVENT_MOTION : MQ_COALESCE_NONE;
+}
+
+// Test batched posting and retrieval together with coalescing of adjacent motion events
+DECLARE_UNIT_TEST("ipc mq batching and coalescing", test_mq_batch_coalesce) {
+    ipc::mq_handle_t mq = ipc::message_queue::create("ipc_test_batch_mq");
+    ASSERT_TRUE(mq != MESSAGE_QUEUE_ID_INVALID, "Queue should be created");
+    ASSERT_TRUE(ipc::message_queue::set_coalescing_rule(mq, test_mq_coalesce_motion), "Rule should be installed");
+
+    // motion x3, click, motion x2 should collapse to motion, click, motion
+    test_mq_event events[6] = {
+        { TEST_MQ_EVENT_MOTION, 1 }, { TEST_MQ_EVENT_MOTION, 2 }, { TEST_MQ_EVENT_MOTION, 3 },
+        { TEST_MQ_EVENT_CLICK, 4 }, { TEST_MQ_EVENT_MOTION, 5 }, { TEST_MQ_EVENT_MOTION, 6 }
+    };
+
+    ipc::mq_message messages[6];
+    for (int i = 0; i < 6; i++) {
+        messages[i].payload_size = sizeof(test_mq_event);
+        messages[i].payload = reinterpret_cast<uint8_t*>(&events[i]);
+    }
+
+    ASSERT_TRUE(ipc::message_queue::post_messages(mq, messages, 6), "Batch should be posted");
+
+    ipc::mq_message received[8];
+    size_t count = ipc::message_queue::get_messages(mq, received, 8);
+    ASSERT_EQ(count, (size_t)3, "Adjacent motion events should be coalesced");
+
+    int32_t expected_values[3] = { 3, 4, 6 };
+    for (size_t i = 0; i < count; i++) {
+        auto evt = reinterpret_cast<test_mq_event*>(received[i].payload);
+        ASSERT_EQ(evt->value, expected_values[i], "Only the latest event of a motion burst should be kept");
+        delete[] received[i].payload;
+    }
+
+    ASSERT_TRUE(received[0].message_id < received[1].message_id && received[1].message_id < received[2].message_id,
+                "Message ids should follow queue order");
+
+    // Without a rule every message is queued individually
+    ASSERT_TRUE(ipc::message_queue::set_coalescing_rule(mq, nullptr), "Rule should be removed");
+    ASSERT_TRUE(ipc::message_queue::post_messages(mq, messages, 3), "Batch should be posted");
+    ASSERT_EQ(ipc::message_queue::get_messages(mq, received, 2), (size_t)2, "Retrieval should stop at the requested count");
+    ASSERT_EQ(ipc::message_queue::get_messages(mq, received + 2, 8), (size_t)1, "The rest should be retrieved next");
+    ASSERT_FALSE(ipc::message_queue::peek_message(mq), "Queue should be drained");
+
+    for (size_t i = 0; i < 3; i++) {
+        delete[] received[i].payload;
+    }
+
+    ipc::message_queue::close(mq);
+    return UNIT_TEST_SUCCESS;
+}
+
+// Posts one message carrying an integer
+static bool test_mq_post_value(ipc::mq_handle_t mq, int value) {
+    ipc::mq_message msg;
+    msg.payload_size = sizeof(value);
+    msg.payload = reinterpret_cast<uint8_t*>(&value);
+    return ipc::message_queue::post_message(mq, &msg);
+}
+
+// Test the fail-fast and drop-oldest overflow policies and the statistics they leave behind
+DECLARE_UNIT_TEST("ipc mq overflow policies", test_mq_overflow_policies) {
+    ipc::mq_handle_t mq = ipc::message_queue::create("ipc_test_bounded_mq");
+    ASSERT_TRUE(mq != MESSAGE_QUEUE_ID_INVALID, "Queue should be created");
+
+    ipc::mq_limits limits = { 4, 4096, ipc::mq_overflow_policy::FAIL };
+    ASSERT_TRUE(ipc::message_queue::set_limits(mq, limits), "Limits should be applied");
+
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(test_mq_post_value(mq, i), "Posting below the limit should succeed");
+    }
+    ASSERT_FALSE(test_mq_post_value(mq, 4), "Posting to a full fail-fast queue should fail");
+
+    // Switch to dropping the oldest messages, two more posts push out 0 and 1
+    limits.policy = ipc::mq_overflow_policy::DROP_OLDEST;
+    ASSERT_TRUE(ipc::message_queue::set_limits(mq, limits), "Limits should be applied");
+    ASSERT_TRUE(test_mq_post_value(mq, 4), "Drop-oldest posts should always succeed");
+    ASSERT_TRUE(test_mq_post_value(mq, 5), "Drop-oldest posts should always succeed");
+
+    ipc::mq_stats stats;
+    ASSERT_TRUE(ipc::message_queue::get_stats(mq, &stats), "Stats should be readable");
+    ASSERT_EQ(stats.depth, (size_t)4, "Depth should stay at the limit");
+    ASSERT_EQ(stats.bytes, 4 * sizeof(int), "Byte usage should match the pending payloads");
+    ASSERT_EQ(stats.high_water_mark, (size_t)4, "High-water mark should be the limit");
+    ASSERT_EQ(stats.posted, (uint64_t)6, "Six messages should have been accepted");
+    ASSERT_EQ(stats.rejected, (uint64_t)1, "One message should have been rejected");
+    ASSERT_EQ(stats.dropped, (uint64_t)2, "Two messages should have been dropped");
+
+    ipc::mq_message received[4];
+    ASSERT_EQ(ipc::message_queue::get_messages(mq, received, 4), (size_t)4, "Every pending message should be received");
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(*reinterpret_cast<int*>(received[i].payload), i + 2, "The oldest messages should have been dropped");
+        delete[] received[i].payload;
+    }
+
+    // Messages that can never fit are refused regardless of the policy
+    limits.max_bytes = 2;
+    ASSERT_TRUE(ipc::message_queue::set_limits(mq, limits), "Limits should be applied");
+    ASSERT_FALSE(test_mq_post_value(mq, 6), "Messages above the byte limit should be refused");
+
+    ipc::mq_stats_info all[8];
+    size_t count = ipc::message_queue::get_all_stats(all, 8);
+    bool found = false;
+    for (size_t i = 0; i < count; i++) {
+        found |= strcmp(all[i].name, "ipc_test_bounded_mq") == 0;
+    }
+    ASSERT_TRUE(found, "Named queues should be listed in the global statistics");
+
+    ipc::message_queue::close(mq);
+    return UNIT_TEST_SUCCESS;
+}
+
+struct mq_backpressure_context {
+    ipc::mq_handle_t mq;
+    volatile int posted;
+    volatile int finished;
+};
+
+// Posts more messages than the queue holds, blocking whenever it is full
+void mq_blocking_poster_task(void* data) {
+    auto ctx = reinterpret_cast<mq_backpressure_context*>(data);
+
+    for (int i = 0; i < 8; i++) {
+        if (!test_mq_post_value(ctx->mq, i)) {
+            break;
+        }
+        ctx->posted = i + 1;
+    }
+
+    ctx->finished = 1;
+    exit_thread();
+}
+
+// Test that posters block on a full queue and resume once the consumer makes room
+DECLARE_UNIT_TEST("ipc mq blocking backpressure", test_mq_backpressure) {
+    auto ctx = new mq_backpressure_context();
+    ASSERT_TRUE(ctx != nullptr, "Context should be allocated");
+
+    ctx->mq = ipc::message_queue::create("ipc_test_backpressure_mq");
+    ASSERT_TRUE(ctx->mq != MESSAGE_QUEUE_ID_INVALID, "Queue should be created");
+
+    ipc::mq_limits limits = { 2, 4096, ipc::mq_overflow_policy::BLOCK };
+    ASSERT_TRUE(ipc::message_queue::set_limits(ctx->mq, limits), "Limits should be applied");
+
+    task_control_block* task = create_priv_kernel_task(mq_blocking_poster_task, ctx);
+    ASSERT_TRUE(task != nullptr, "Poster task should be created");
+    scheduler::get().add_task(task);
+
+    msleep(20);
+    ASSERT_EQ(ctx->posted, 2, "The poster should block once the queue is full");
+    ASSERT_EQ(ctx->finished, 0, "The poster should still be blocked");
+
+    int expected = 0;
+    uint64_t start = kernel_timer::get_system_time_in_nanoseconds();
+    while (expected < 8 && kernel_timer::get_system_time_in_nanoseconds() - start < 10'000'000'000ull) {
+        ipc::mq_message msg;
+        if (ipc::message_queue::receive(ctx->mq, &msg, 100'000'000ull)) {
+            ASSERT_EQ(*reinterpret_cast<int*>(msg.payload), expected, "Messages should arrive in order");
+            delete[] msg.payload;
+            ++expected;
+        }
+    }
+
+    while (!ctx->finished && kernel_timer::get_system_time_in_nanoseconds() - start < 10'000'000'000ull) {
+        yield();
+    }
+
+    ASSERT_EQ(expected, 8, "Every message should eventually be delivered");
+    ASSERT_EQ(ctx->finished, 1, "The poster should finish once the queue drained");
+
+    ipc::mq_stats stats;
+    ASSERT_TRUE(ipc::message_queue::get_stats(ctx->mq, &stats), "Stats should be readable");
+    ASSERT_TRUE(stats.blocked > 0, "The poster should have been counted as blocked");
+    ASSERT_EQ(stats.high_water_mark, (size_t)2, "The queue should never exceed its capacity");
+
+    ipc::message_queue::close(ctx->mq);
+    delete ctx;
+    return UNIT_TEST_SUCCESS;
+}
+
+struct endpoint_server_context {
+    ipc::endpoint_handle_t endpoint;
+    int calls;
+    volatile int served;
+    volatile int finished;
+};
+
+// Answers every request with its value incremented by one
+void endpoint_server_task(void* data) {
+    auto ctx = reinterpret_cast<endpoint_server_context*>(data);
+
+    for (int i = 0; i < ctx->calls; i++) {
+        size_t size = 0;
+        auto request = ipc::endpoint::receive(ctx->endpoint, &size, nullptr, 5'000'000'000ull);
+        if (!request || size != sizeof(uint64_t)) {
+            break;
+        }
+
+        uint64_t value = *reinterpret_cast<const uint64_t*>(request) + 1;
+        ipc::endpoint::reply(ctx->endpoint, &value, sizeof(value));
+        ctx->served = i + 1;
+    }
+
+    ctx->finished = 1;
+    exit_thread();
+}
+
+// Test request/reply calls against a server task and compare their cost to a message queue round-trip
+DECLARE_UNIT_TEST("ipc endpoint call and reply", test_endpoint_call) {
+    const int iterations = 10000;
+
+    auto ctx = new endpoint_server_context();
+    ASSERT_TRUE(ctx != nullptr, "Context should be allocated");
+
+    ctx->endpoint = ipc::endpoint::create("ipc_test_endpoint");
+    ctx->calls = iterations;
+    ASSERT_TRUE(ctx->endpoint != ENDPOINT_ID_INVALID, "Endpoint should be created");
+
+    ipc::endpoint_handle_t opened = ipc::endpoint::open("ipc_test_endpoint");
+    ASSERT_TRUE(opened != ENDPOINT_ID_INVALID, "Endpoint should be found by name");
+    ASSERT_TRUE(ipc::endpoint::close(opened), "Opened handle should close");
+
+    uint64_t value = 0;
+    ASSERT_FALSE(ipc::endpoint::reply(ctx->endpoint, &value, sizeof(value)), "Replying without a received request should fail");
+
+    static uint8_t oversized[IPC_CALL_MAX_MESSAGE_SIZE + 1];
+    ASSERT_FALSE(
+        ipc::endpoint::call(ctx->endpoint, oversized, sizeof(oversized), nullptr, 0, nullptr),
+        "Requests larger than the IPC buffer should be rejected"
+    );
+
+    task_control_block* task = create_priv_kernel_task(endpoint_server_task, ctx);
+    ASSERT_TRUE(task != nullptr, "Server task should be created");
+    scheduler::get().add_task(task);
+
+    uint64_t start = rdtsc();
+    for (uint64_t i = 0; i < (uint64_t)iterations; i++) {
+        uint64_t reply = 0;
+        size_t reply_size = 0;
+        ASSERT_TRUE(ipc::endpoint::call(ctx->endpoint, &i, sizeof(i), &reply, sizeof(reply), &reply_size), "Call should succeed");
+        ASSERT_EQ(reply_size, sizeof(uint64_t), "Reply should have the size the server sent");
+        ASSERT_EQ(reply, i + 1, "Reply should answer the matching request");
+    }
+    uint64_t call_cycles = rdtsc() - start;
+
+    uint64_t wait_start = kernel_timer::get_system_time_in_nanoseconds();
+    while (!ctx->finished && kernel_timer::get_system_time_in_nanoseconds() - wait_start < 10'000'000'000ull) {
+        yield();
+    }
+
+    ASSERT_EQ(ctx->served, iterations, "Server should have answered every call");
+
+    // Same round-trip over a pair of message queues, without a server task the
+    // message never leaves this CPU, so this is a lower bound for queue-based RPC.
+    ipc::mq_handle_t requests = ipc::message_queue::create("ipc_test_endpoint_mq_req");
+    ipc::mq_handle_t replies = ipc::message_queue::create("ipc_test_endpoint_mq_resp");
+    ASSERT_TRUE(requests != MESSAGE_QUEUE_ID_INVALID && replies != MESSAGE_QUEUE_ID_INVALID, "Benchmark queues should be created");
+
+    start = rdtsc();
+    for (uint64_t i = 0; i < (uint64_t)iterations; i++) {
+        ASSERT_TRUE(test_mq_post_value(requests, (int)i), "Request should be posted");
+
+        ipc::mq_message msg;
+        ipc::message_queue::receive(requests, &msg, 0);
+        delete[] msg.payload;
+
+        ASSERT_TRUE(test_mq_post_value(replies, (int)i + 1), "Reply should be posted");
+        ipc::message_queue::receive(replies, &msg, 0);
+        delete[] msg.payload;
+    }
+    uint64_t mq_cycles = rdtsc() - start;
+
+    serial::printf(UNIT_TEST_PREFIX "ipc call benchmark: %i round-trips\n", iterations);
+    serial::printf(UNIT_TEST_PREFIX "  endpoint call  : %llu cycles/call\n", call_cycles / iterations);
+    serial::printf(UNIT_TEST_PREFIX "  mq round-trip  : %llu cycles/call\n", mq_cycles / iterations);
+
+    ipc::message_queue::close(requests);
+    ipc::message_queue::close(replies);
+    ipc::endpoint::close(ctx->endpoint);
+    delete ctx;
+    return UNIT_TEST_SUCCESS;
+}
+
+struct endpoint_client_context {
+    ipc::endpoint_handle_t endpoint;
+    volatile int started;
+    volatile int result;
+    volatile int finished;
+};
+
+// Issues a single call that no server ever answers
+void endpoint_client_task(void* data) {
+    auto ctx = reinterpret_cast<endpoint_client_context*>(data);
+
+    uint64_t value = 1;
+    ctx->started = 1;
+    ctx->result = ipc::endpoint::call(ctx->endpoint, &value, sizeof(value), &value, sizeof(value), nullptr) ? 1 : 0;
+    ctx->finished = 1;
+    exit_thread();
+}
+
+// Test that calls give up after their timeout and fail once the server closes its handle
+DECLARE_UNIT_TEST("ipc endpoint call timeout and shutdown", test_endpoint_call_shutdown) {
+    ipc::endpoint_handle_t server = ipc::endpoint::create("ipc_test_endpoint_shutdown");
+    ASSERT_TRUE(server != ENDPOINT_ID_INVALID, "Endpoint should be created");
+
+    uint64_t value = 1;
+    uint64_t start = kernel_timer::get_system_time_in_nanoseconds();
+    ASSERT_FALSE(
+        ipc::endpoint::call(server, &value, sizeof(value), &value, sizeof(value), nullptr, 10'000'000ull),
+        "A call nobody receives should time out"
+    );
+    ASSERT_TRUE(kernel_timer::get_system_time_in_nanoseconds() - start < 1'000'000'000ull, "The call should return after its timeout");
+
+    size_t size = 0;
+    ASSERT_TRUE(ipc::endpoint::receive(server, &size, nullptr, 0) == nullptr, "A timed out call should be withdrawn");
+
+    auto ctx = new endpoint_client_context();
+    ASSERT_TRUE(ctx != nullptr, "Context should be allocated");
+
+    ctx->endpoint = ipc::endpoint::open("ipc_test_endpoint_shutdown");
+    ASSERT_TRUE(ctx->endpoint != ENDPOINT_ID_INVALID, "Endpoint should be found by name");
+
+    task_control_block* task = create_priv_kernel_task(endpoint_client_task, ctx);
+    ASSERT_TRUE(task != nullptr, "Client task should be created");
+    scheduler::get().add_task(task);
+
+    start = kernel_timer::get_system_time_in_nanoseconds();
+    while (!ctx->started && kernel_timer::get_system_time_in_nanoseconds() - start < 10'000'000'000ull) {
+        yield();
+    }
+    msleep(20);
+    ASSERT_EQ(ctx->finished, 0, "The client should be blocked in its call");
+
+    // Closing the creator's handle shuts the endpoint down
+    ASSERT_TRUE(ipc::endpoint::close(server), "Server handle should close");
+
+    while (!ctx->finished && kernel_timer::get_system_time_in_nanoseconds() - start < 10'000'000'000ull) {
+        yield();
+    }
+
+    // The client task may still be running, its context is leaked rather than freed under it
+    ASSERT_EQ(ctx->finished, 1, "The blocked call should return once the server is gone");
+    ASSERT_EQ(ctx->result, 0, "The blocked call should fail");
+
+    ASSERT_FALSE(
+        ipc::endpoint::call(ctx->endpoint, &value, sizeof(value), &value, sizeof(value), nullptr),
+        "Calls after the shutdown should fail right away"
+    );
+
+    ipc::endpoint::close(ctx->endpoint);
+    delete ctx;
+    return UNIT_TEST_SUCCESS;
+}
@@ -0,0 +1,65 @@
+#include <unit_tests/unit_tests.h>
+#include <kstl/atomic.h>
+
+using namespace kstl;
+
+// Test load and store
+DECLARE_UNIT_TEST("atomic load and store", test_atomic_load_store) {
+    atomic<uint64_t> value(5);
+    ASSERT_EQ(value.load(), (uint64_t)5, "Initial value should be 5");
+
+    value.store(10, memory_order::release);
+    ASSERT_EQ(value.load(memory_order::acquire), (uint64_t)10, "Value should be 10 after store");
+
+    value = 15;
+    ASSERT_EQ((uint64_t)value, (uint64_t)15, "Value should be 15 after assignment");
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test arithmetic and bitwise read-modify-write operations
+DECLARE_UNIT_TEST("atomic fetch operations", test_atomic_fetch_ops) {
+    atomic<uint32_t> value(0);
+
+    ASSERT_EQ(value.fetch_add(3), (uint32_t)0, "fetch_add should return the previous value");
+    ASSERT_EQ(value.fetch_sub(1), (uint32_t)3, "fetch_sub should return the previous value");
+    ASSERT_EQ(value.load(), (uint32_t)2, "Value should be 2 after add and sub");
+
+    ASSERT_EQ(++value, (uint32_t)3, "Pre-increment should return the new value");
+    ASSERT_EQ(value--, (uint32_t)3, "Post-decrement should return the previous value");
+
+    value.fetch_or(0xF0);
+    value.fetch_and(0x30);
+    value.fetch_xor(0x01);
+    ASSERT_EQ(value.load(), (uint32_t)0x31, "Bitwise operations should produce 0x31");
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test exchange and compare-exchange
+DECLARE_UNIT_TEST("atomic exchange and compare-exchange", test_atomic_cmpxchg) {
+    atomic<int32_t> value(1);
+
+    ASSERT_EQ(value.exchange(2), 1, "exchange should return the previous value");
+
+    int32_t expected = 5;
+    ASSERT_FALSE(value.compare_exchange_strong(expected, 7), "CAS with a stale expected value should fail");
+    ASSERT_EQ(expected, 2, "Failed CAS should update expected with the current value");
+
+    ASSERT_TRUE(value.compare_exchange_strong(expected, 7, memory_order::acq_rel), "CAS with the current value should succeed");
+    ASSERT_EQ(value.load(), 7, "Value should be 7 after a successful CAS");
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test pointer atomics and the free-standing helpers
+DECLARE_UNIT_TEST("atomic pointers and plain variables", test_atomic_pointers) {
+    int a = 1, b = 2;
+    atomic<int*> ptr(&a);
+
+    int* expected = &a;
+    ASSERT_TRUE(ptr.compare_exchange_strong(expected, &b), "Pointer CAS should succeed");
+    ASSERT_TRUE(ptr.load() == &b, "Pointer should point to b");
+
+    uint64_t plain = 0;
+    atomic_store(&plain, (uint64_t)42, memory_order::release);
+    ASSERT_EQ(atomic_load(&plain, memory_order::acquire), (uint64_t)42, "Plain variable should read back 42");
+    return UNIT_TEST_SUCCESS;
+}
@@ -3,15 +3,18 @@
 #include <memory/vmm.h>
 #include <sched/sched.h>
 #include <time/time.h>
+#include <rcu.h>
 
 using namespace sched;
 
 // Shared data for tests
 int global_counter = 0;
 int global_mutex_counter = 0;
+int g_preempt_test_increments = 5;
 
 DECLARE_GLOBAL_OBJECT(spinlock, g_multithreading_test_counter_lock);
 DECLARE_GLOBAL_OBJECT(mutex, g_multithreading_test_mutex);
+DECLARE_GLOBAL_OBJECT(mcs_spinlock, g_multithreading_test_mcs_lock);
 
 // A simple task function that increments a shared counter N times
 void increment_task(void* data) {
@@ -49,6 +52,146 @@ void mutex_increment_task(void* data) {
     exit_thread();
 }
 
+// A task that increments a shared counter under an MCS lock
+void mcs_increment_task(void* data) {
+    int increments = *(int*)data;
+    for (int i = 0; i < increments; i++) {
+        {
+            mcs_spinlock_guard guard(g_multithreading_test_mcs_lock);
+            global_counter++;
+        }
+        yield();
+    }
+    exit_thread();
+}
+
+// The previous mutex implementation, a cmpxchg loop that yields
+// on contention, kept around as a baseline for benchmarking.
+class legacy_yield_mutex {
+public:
+    void lock() {
+        while (__sync_val_compare_and_swap(&m_state, 0, 1) != 0) {
+            yield();
+        }
+    }
+
+    void unlock() {
+        __sync_synchronize();
+        m_state = 0;
+    }
+
+private:
+    volatile int m_state = 0;
+};
+
+template <typename MutexType>
+struct mutex_bench_context {
+    MutexType lock;
+    int iterations;
+    volatile uint64_t counter;
+    volatile int finished;
+};
+
+// Hammers the benchmarked lock with short critical sections
+template <typename MutexType>
+void mutex_bench_task(void* data) {
+    auto ctx = reinterpret_cast<mutex_bench_context<MutexType>*>(data);
+
+    for (int i = 0; i < ctx->iterations; i++) {
+        ctx->lock.lock();
+        ctx->counter = ctx->counter + 1;
+        ctx->lock.unlock();
+    }
+
+    __sync_fetch_and_add(&ctx->finished, 1);
+    exit_thread();
+}
+
+// Runs the contention benchmark, returns false if a task never started or is still running.
+// The context must not be freed in that case, the remaining tasks keep using it.
+template <typename MutexType>
+bool run_mutex_benchmark(mutex_bench_context<MutexType>* ctx, int num_tasks, uint64_t& elapsed_us) {
+    uint64_t start = (kernel_timer::get_system_time_in_nanoseconds() / 1000);
+    int started = 0;
+
+    for (; started < num_tasks; started++) {
+        task_control_block* task = create_priv_kernel_task(mutex_bench_task<MutexType>, ctx);
+        if (!task) {
+            break;
+        }
+        sched::scheduler::get().add_task(task);
+    }
+
+    // Wait for all the tasks to finish with a 10 second timeout
+    while (ctx->finished < started) {
+        if ((kernel_timer::get_system_time_in_nanoseconds() / 1000) - start > 10000000) {
+            break;
+        }
+        yield();
+    }
+
+    elapsed_us = (kernel_timer::get_system_time_in_nanoseconds() / 1000) - start;
+    return started == num_tasks && ctx->finished == num_tasks;
+}
+
+struct yield_bench_context {
+    bool use_irq_path;
+    int iterations;
+    volatile uint64_t switches;
+    volatile int finished;
+};
+
+// Bounces the CPU back and forth with its partner task
+void yield_bench_task(void* data) {
+    auto ctx = reinterpret_cast<yield_bench_context*>(data);
+
+    for (int i = 0; i < ctx->iterations; i++) {
+        if (ctx->use_irq_path) {
+            // The software interrupt path schedule() used for every yield before
+            asm volatile ("int $48");
+        } else {
+            sched::scheduler::get().schedule();
+        }
+        __sync_fetch_and_add(&ctx->switches, 1);
+    }
+
+    __sync_fetch_and_add(&ctx->finished, 1);
+    exit_thread();
+}
+
+// Runs two yielding tasks on the current CPU and measures the average cost of a switch in nanoseconds.
+// Returns false if a task never started or is still running, the context must not be freed then.
+bool run_yield_benchmark(yield_bench_context* ctx, uint64_t& ns_per_switch) {
+    const int num_tasks = 2;
+    int cpu = current->cpu;
+    uint64_t start = kernel_timer::get_system_time_in_nanoseconds();
+    int started = 0;
+
+    for (; started < num_tasks; started++) {
+        task_control_block* task = create_priv_kernel_task(yield_bench_task, ctx);
+        if (!task) {
+            break;
+        }
+
+        // Keep idle CPUs from stealing one of the partners
+        task->cpu_affinity = 1ull << cpu;
+        sched::scheduler::get().add_task(task, cpu);
+    }
+
+    // The waiting task takes part in the rotation, so its yields are counted as switches too
+    while (ctx->finished < started) {
+        if (kernel_timer::get_system_time_in_nanoseconds() - start > 10000000000ull) {
+            break;
+        }
+        yield();
+        __sync_fetch_and_add(&ctx->switches, 1);
+    }
+
+    uint64_t elapsed = kernel_timer::get_system_time_in_nanoseconds() - start;
+    ns_per_switch = ctx->switches ? elapsed / ctx->switches : 0;
+    return started == num_tasks && ctx->finished == num_tasks;
+}
+
 // Test creating a single task and letting it run and exit
 DECLARE_UNIT_TEST("multithread single task run and exit", test_single_task_run) {
     global_counter = 0;
@@ -224,3 +367,298 @@ DECLARE_UNIT_TEST("multithread exit_thread removal", test_exit_thread_removal) {
 
     return UNIT_TEST_SUCCESS;
 }
+
+// Test the ticket spinlock's try_lock semantics
+DECLARE_UNIT_TEST("spinlock ticket try_lock", test_spinlock_try_lock) {
+    spinlock lock;
+    ASSERT_FALSE(lock.is_locked(), "A new spinlock should be unlocked");
+
+    lock.lock();
+    ASSERT_TRUE(lock.is_locked(), "Spinlock should be locked after lock()");
+    ASSERT_FALSE(lock.try_lock(), "try_lock on a held spinlock should fail");
+    lock.unlock();
+
+    ASSERT_TRUE(lock.try_lock(), "try_lock on a free spinlock should succeed");
+    lock.unlock();
+    ASSERT_FALSE(lock.is_locked(), "Spinlock should be unlocked after unlock()");
+
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test using an MCS lock with multiple tasks incrementing a counter
+DECLARE_UNIT_TEST("multithread mcs spinlock test", test_mcs_spinlock_usage) {
+    global_counter = 0;
+    const int increments_per_task = 5;
+    const int num_tasks = 3;
+
+    for (int i = 0; i < num_tasks; i++) {
+        task_control_block* t = create_priv_kernel_task(mcs_increment_task, (void*)&increments_per_task);
+        ASSERT_TRUE(t != nullptr, "Should create mcs increment task");
+        sched::scheduler::get().add_task(t);
+    }
+
+    for (int i = 0; i < num_tasks * increments_per_task * 2; i++) {
+        yield();
+    }
+
+    // Make sure all the tasks on all cpus fully finish within a 1 second interval
+    sleep(1);
+
+    mcs_node node;
+    ASSERT_TRUE(g_multithreading_test_mcs_lock.try_lock(node), "MCS lock should be free after all tasks exit");
+    g_multithreading_test_mcs_lock.unlock(node);
+
+    ASSERT_EQ(global_counter, num_tasks * increments_per_task, "MCS-protected increments should match the total expected");
+    return UNIT_TEST_SUCCESS;
+}
+
+// Compare the throughput of the adaptive mutex against the yield-based one
+DECLARE_UNIT_TEST("multithread mutex contention benchmark", test_mutex_contention_benchmark) {
+    const int num_tasks = 4;
+    const int iterations = 2000;
+    const uint64_t expected = num_tasks * iterations;
+
+    auto legacy_ctx = new mutex_bench_context<legacy_yield_mutex>();
+    auto adaptive_ctx = new mutex_bench_context<mutex>();
+    if (!legacy_ctx || !adaptive_ctx) {
+        delete legacy_ctx;
+        delete adaptive_ctx;
+    }
+    ASSERT_TRUE(legacy_ctx && adaptive_ctx, "Benchmark contexts should be allocated");
+
+    legacy_ctx->iterations = iterations;
+    adaptive_ctx->iterations = iterations;
+
+    uint64_t legacy_us = 0;
+    uint64_t adaptive_us = 0;
+    bool legacy_done = run_mutex_benchmark(legacy_ctx, num_tasks, legacy_us);
+    bool adaptive_done = run_mutex_benchmark(adaptive_ctx, num_tasks, adaptive_us);
+
+    // Contexts of tasks that are still running get leaked, freeing them would pull them out from under the tasks
+    ASSERT_TRUE(legacy_done && adaptive_done, "Every benchmark task should finish within 10 seconds");
+
+    uint64_t legacy_counter = legacy_ctx->counter;
+    uint64_t adaptive_counter = adaptive_ctx->counter;
+    bool adaptive_unlocked = adaptive_ctx->lock.owner() == nullptr;
+
+    delete legacy_ctx;
+    delete adaptive_ctx;
+
+    ASSERT_EQ(legacy_counter, expected, "Legacy mutex should protect all increments");
+    ASSERT_EQ(adaptive_counter, expected, "Adaptive mutex should protect all increments");
+    ASSERT_TRUE(adaptive_unlocked, "Adaptive mutex should be unlocked after the benchmark");
+
+    serial::printf(UNIT_TEST_PREFIX "mutex benchmark: %llu lock/unlock pairs, %i tasks\n", expected, num_tasks);
+    serial::printf(UNIT_TEST_PREFIX "  yield mutex    : %llu us (%llu ops/ms)\n",
+        legacy_us, legacy_us ? (expected * 1000) / legacy_us : 0);
+    serial::printf(UNIT_TEST_PREFIX "  adaptive mutex : %llu us (%llu ops/ms)\n",
+        adaptive_us, adaptive_us ? (expected * 1000) / adaptive_us : 0);
+
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test that timer ticks are deferred while preemption is disabled
+DECLARE_UNIT_TEST("multithread preempt count defers reschedule", test_preempt_count_defer) {
+    auto& scheduler = sched::scheduler::get();
+
+    // Keep another task runnable on this CPU so that ticks would normally switch away
+    task_control_block* task = create_priv_kernel_task(increment_task, &g_preempt_test_increments);
+    ASSERT_TRUE(task != nullptr, "Should create the competing task");
+    task->cpu_affinity = 1ull << current->cpu;
+    scheduler.add_task(task, current->cpu);
+
+    scheduler.preempt_disable();
+    scheduler.preempt_disable();
+    uint64_t nested_count = this_cpu_read(preempt_count);
+
+    // Spin across several timer ticks and check that the task never gets switched out
+    task_control_block* self = current;
+    bool switched = false;
+    uint64_t start = kernel_timer::get_system_time_in_nanoseconds();
+    while (kernel_timer::get_system_time_in_nanoseconds() - start < 20000000) {
+        switched |= (current != self);
+    }
+
+    uint64_t deferred = this_cpu_read(need_resched);
+
+    scheduler.preempt_enable();
+    uint64_t still_deferred = this_cpu_read(need_resched);
+
+    scheduler.preempt_enable();
+    uint64_t final_count = this_cpu_read(preempt_count);
+
+    ASSERT_EQ(nested_count, (uint64_t)2, "Preemption count should nest");
+    ASSERT_FALSE(switched, "Task should not be preempted while preemption is disabled");
+    ASSERT_TRUE(deferred != 0, "Ticks should leave a deferred reschedule behind");
+    ASSERT_TRUE(still_deferred != 0, "Reschedule should stay deferred until the count drops to zero");
+    ASSERT_EQ(final_count, (uint64_t)0, "Preemption count should be zero again");
+
+    // Let the competing task finish
+    sleep(1);
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test that automatic CPU selection stays within the task's affinity mask
+DECLARE_UNIT_TEST("multithread affinity restricts cpu selection", test_affinity_cpu_selection) {
+    auto& scheduler = sched::scheduler::get();
+    global_counter = 0;
+
+    int increments = 3;
+    task_control_block* task = create_priv_kernel_task(increment_task, &increments);
+    ASSERT_TRUE(task != nullptr, "Should create the task");
+    ASSERT_EQ(task->cpu_affinity, CPU_AFFINITY_ALL, "New tasks should be allowed on every CPU");
+
+    ASSERT_FALSE(scheduler.set_task_affinity(task, 0), "An empty affinity mask should be rejected");
+    ASSERT_TRUE(scheduler.set_task_affinity(task, 1ull << BSP_CPU_ID), "Restricting to the BSP should succeed");
+
+    scheduler.add_task(task);
+    ASSERT_EQ((int)task->cpu, BSP_CPU_ID, "Task should be placed on the only allowed CPU");
+
+    // Let the task finish
+    sleep(1);
+
+    ASSERT_EQ(global_counter, increments, "The task should have run to completion");
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test that runtime and context switches get accounted to the task
+DECLARE_UNIT_TEST("multithread task cpu accounting", test_task_cpu_accounting) {
+    global_counter = 0;
+
+    int increments = 10;
+    task_control_block* task = create_priv_kernel_task(increment_task, &increments);
+    ASSERT_TRUE(task != nullptr, "Should create the task");
+    sched::scheduler::get().add_task(task);
+
+    // Make sure the task fully finishes
+    sleep(1);
+    ASSERT_EQ(global_counter, increments, "The task should have run to completion");
+
+    static task_stats_info stats[128];
+    size_t count = get_task_stats(stats, 128);
+
+    task_stats_info* info = nullptr;
+    for (size_t i = 0; i < count; i++) {
+        if (stats[i].pid == task->pid) {
+            info = &stats[i];
+            break;
+        }
+    }
+
+    ASSERT_TRUE(info != nullptr, "The task should be reported in the task statistics");
+    ASSERT_TRUE(info->runtime_ns > 0, "The task should have accumulated runtime");
+    ASSERT_TRUE(info->nr_voluntary_switches >= (uint64_t)increments, "Every yield should count as a voluntary switch");
+
+    static sched::cpu_stats_info cpus[MAX_SYSTEM_CPUS];
+    ASSERT_TRUE(get_cpu_stats(cpus, MAX_SYSTEM_CPUS) > 0, "At least the BSP should be reported");
+    ASSERT_EQ(cpus[0].cpu, (uint64_t)BSP_CPU_ID, "The BSP should be reported first");
+
+    return UNIT_TEST_SUCCESS;
+}
+
+// Compare the cost of a direct voluntary context switch against the software interrupt path
+DECLARE_UNIT_TEST("multithread yield ping-pong benchmark", test_yield_pingpong_benchmark) {
+    const int iterations = 5000;
+
+    auto irq_ctx = new yield_bench_context();
+    auto direct_ctx = new yield_bench_context();
+    if (!irq_ctx || !direct_ctx) {
+        delete irq_ctx;
+        delete direct_ctx;
+    }
+    ASSERT_TRUE(irq_ctx && direct_ctx, "Benchmark contexts should be allocated");
+
+    irq_ctx->use_irq_path = true;
+    irq_ctx->iterations = iterations;
+    direct_ctx->iterations = iterations;
+
+    uint64_t irq_ns = 0;
+    uint64_t direct_ns = 0;
+    bool irq_done = run_yield_benchmark(irq_ctx, irq_ns);
+    bool direct_done = run_yield_benchmark(direct_ctx, direct_ns);
+
+    // Contexts of tasks that are still running get leaked, freeing them would pull them out from under the tasks
+    ASSERT_TRUE(irq_done, "Both interrupt path tasks should finish");
+    ASSERT_TRUE(direct_done, "Both direct path tasks should finish");
+
+    delete irq_ctx;
+    delete direct_ctx;
+
+    serial::printf(UNIT_TEST_PREFIX "yield benchmark: %i yields per task, 2 tasks\n", iterations);
+    serial::printf(UNIT_TEST_PREFIX "  int $48 switch : %llu ns/switch\n", irq_ns);
+    serial::printf(UNIT_TEST_PREFIX "  direct switch  : %llu ns/switch\n", direct_ns);
+
+    return UNIT_TEST_SUCCESS;
+}
+
+// Test the shared/exclusive semantics of the reader-writer lock
+DECLARE_UNIT_TEST("rwlock shared and exclusive access", test_rwlock_semantics) {
+    rwlock lock;
+
+    ASSERT_TRUE(lock.try_read_lock(), "First reader should get the lock");
+    ASSERT_TRUE(lock.try_read_lock(), "Second reader should share the lock");
+    ASSERT_FALSE(lock.try_write_lock(), "Writer should be excluded while readers hold the lock");
+
+    lock.read_unlock();
+    lock.read_unlock();
+
+    ASSERT_TRUE(lock.try_write_lock(), "Writer should get the lock once readers are gone");
+    ASSERT_FALSE(lock.try_read_lock(), "Readers should be excluded while a writer holds the lock");
+    lock.write_unlock();
+
+    ASSERT_TRUE(lock.try_read_lock(), "Readers should get the lock after the writer is done");
+    lock.read_unlock();
+
+    return UNIT_TEST_SUCCESS;
+}
+
+int* g_rcu_test_ptr = nullptr;
+volatile int g_rcu_test_observed = 0;
+
+// Reads the RCU-protected pointer while yielding inside the critical section
+void rcu_reader_task(void*) {
+    for (int i = 0; i < 1000 && g_rcu_test_observed != 2; i++) {
+        rcu::read_guard guard;
+
+        int* value = rcu::dereference(g_rcu_test_ptr);
+        if (value) {
+            g_rcu_test_observed = *value;
+        }
+        yield();
+    }
+    exit_thread();
+}
+
+// Test that a grace period completes and readers observe published values
+DECLARE_UNIT_TEST("rcu publish and synchronize", test_rcu_synchronize) {
+    rcu::read_lock();
+    rcu::read_lock();
+    ASSERT_EQ(current->rcu_read_nesting, 2u, "Read-side critical sections should nest");
+    rcu::read_unlock();
+    rcu::read_unlock();
+    ASSERT_EQ(current->rcu_read_nesting, 0u, "Nesting should drop back to zero");
+
+    int* first = new int(1);
+    rcu::assign_pointer(g_rcu_test_ptr, first);
+
+    task_control_block* task = create_priv_kernel_task(rcu_reader_task, nullptr);
+    ASSERT_TRUE(task != nullptr, "Should create the RCU reader task");
+    sched::scheduler::get().add_task(task);
+
+    // Swap in a new version and reclaim the old one after a grace period
+    int* second = new int(2);
+    rcu::assign_pointer(g_rcu_test_ptr, second);
+    rcu::synchronize();
+    delete first;
+
+    // Make sure all the tasks on all cpus fully finish within a 1 second interval
+    sleep(1);
+
+    ASSERT_EQ(g_rcu_test_observed, 2, "Reader should observe the latest published value");
+
+    rcu::assign_pointer(g_rcu_test_ptr, static_cast<int*>(nullptr));
+    rcu::synchronize();
+    delete second;
+
+    return UNIT_TEST_SUCCESS;
+}
@@ -30,7 +30,7 @@ int main() {
             screen->draw_kernel_log_console();
             
             screen->end_frame();
-            msleep(128);
+            screen->wait_for_events(128);
         } else if (screen->active_mode == screen_manager_mode::compositor) {
             screen->set_background_color(stella_ui::color(0xff222222));
             screen->begin_frame();
@@ -41,7 +41,7 @@ int main() {
             screen->end_frame();
 
             // ~16 ms == ~60 FPS
-            msleep(8);
+            screen->wait_for_events(8);
         }
     }
 
@@ -24,8 +24,8 @@ bool screen_manager::initialize() {
         return false;
     }
 
-    m_incoming_event_queue = ipc::message_queue::create("gfx_manager_mq");
-    if (m_incoming_event_queue == MESSAGE_QUEUE_ID_INVALID) {
+    m_request_endpoint = ipc::endpoint::create(STELLA_COMPOSITOR_ENDPOINT_NAME);
+    if (m_request_endpoint == ENDPOINT_ID_INVALID) {
         return false;
     }
 
@@ -135,13 +135,40 @@ void screen_manager::draw_kernel_log_console() {
 }
 
 void screen_manager::poll_events() {
-    while (ipc::message_queue::peek_message(m_incoming_event_queue)) {
-        ipc::mq_message request;
-        if (!ipc::message_queue::get_message(m_incoming_event_queue, &request)) {
+    // Serve the calls that are already waiting without blocking, a client
+    // that keeps calling can't hold up the frame for more than a batch.
+    for (size_t i = 0; i < GFX_MANAGER_MAX_CALLS_PER_POLL; i++) {
+        size_t payload_size = 0;
+        pid_t client_pid = 0;
+
+        auto payload = ipc::endpoint::receive(m_request_endpoint, &payload_size, &client_pid, 0);
+        if (!payload) {
             break;
         }
 
-        _process_event(request.payload, request.payload_size);
+        _serve_call(client_pid, reinterpret_cast<const uint8_t*>(payload), payload_size);
+    }
+}
+
+void screen_manager::wait_for_events(uint64_t timeout_ms) {
+    // Sleeps until the next frame is due, serving calls as soon as they come in
+    uint64_t deadline = kernel_timer::get_system_time_in_nanoseconds() + timeout_ms * 1'000'000ull;
+
+    while (true) {
+        uint64_t now = kernel_timer::get_system_time_in_nanoseconds();
+        if (now >= deadline) {
+            break;
+        }
+
+        size_t payload_size = 0;
+        pid_t client_pid = 0;
+
+        auto payload = ipc::endpoint::receive(m_request_endpoint, &payload_size, &client_pid, deadline - now);
+        if (!payload) {
+            break;
+        }
+
+        _serve_call(client_pid, reinterpret_cast<const uint8_t*>(payload), payload_size);
     }
 }
 
@@ -232,19 +259,58 @@ void screen_manager::_draw_mouse_cursor() {
     }
 }
 
-void screen_manager::_process_event(uint8_t* payload, size_t payload_size) {
+user_session* screen_manager::_find_user_session(pid_t client_pid) {
+    for (auto session : m_user_sessions) {
+        if (session->client_pid == client_pid) {
+            return session;
+        }
+    }
+
+    return nullptr;
+}
+
+void screen_manager::_serve_call(pid_t client_pid, const uint8_t* payload, size_t payload_size) {
     using namespace stella_ui::internal;
 
-    auto hdr = reinterpret_cast<userlib_request_header*>(payload);
-    auto& user_session = m_user_sessions[hdr->session_id];
+    // Every call has to be replied to, otherwise the client stays blocked
+    if (payload_size < sizeof(userlib_request_header)) {
+        _reply_nack();
+        return;
+    }
 
-    switch (hdr->type) {
-    case STELLA_COMMAND_ID_CREATE_SESSION: {
-        _establish_user_session(reinterpret_cast<userlib_request_create_session*>(payload));
-        break;
+    auto hdr = reinterpret_cast<const userlib_request_header*>(payload);
+    if (hdr->type == STELLA_COMMAND_ID_CREATE_SESSION) {
+        if (payload_size == sizeof(userlib_request_create_session) &&
+            _establish_user_session(client_pid, reinterpret_cast<const userlib_request_create_session*>(payload))) {
+            _reply_ack();
+        } else {
+            _reply_nack();
+        }
+        return;
     }
+
+    user_session* session = _find_user_session(client_pid);
+    if (!session) {
+        kprint("[GFX_MANAGER] Request from pid %u without a session\n", static_cast<uint32_t>(client_pid));
+        _reply_nack();
+        return;
+    }
+
+    _process_event(session, payload, payload_size);
+}
+
+void screen_manager::_process_event(user_session* session, const uint8_t* payload, size_t payload_size) {
+    using namespace stella_ui::internal;
+
+    if (payload_size < sizeof(userlib_request_header)) {
+        return;
+    }
+
+    auto hdr = reinterpret_cast<const userlib_request_header*>(payload);
+
+    switch (hdr->type) {
     case STELLA_COMMAND_ID_CREATE_WINDOW: {
-        auto req = reinterpret_cast<userlib_request_create_window*>(payload);
+        auto req = reinterpret_cast<const userlib_request_create_window*>(payload);
 
         stella_ui::window_base* window = new stella_ui::window_base();
         window->position.x = 100;
@@ -258,16 +324,21 @@ void screen_manager::_process_event(uint8_t* payload, size_t payload_size) {
         if (window->setup()) {
             kprint("[GFX_MANAGER] Successfully created user window\n");
             m_window_list.push_back(window);
-            user_session.window = window;
+            session->window = window;
 
-            _send_ack_to_session(user_session.handle);
+            _reply_ack();
         } else {
-            _send_nack_to_session(user_session.handle);
+            _reply_nack();
         }
         break;
     }
     case STELLA_COMMAND_ID_MAP_CANVAS: {
-        auto window = user_session.window;
+        auto window = session->window;
+        if (!window) {
+            _reply_nack();
+            break;
+        }
+
         auto canvas = window->get_canvas();
         auto fb = canvas->get_native_framebuffer();
 
@@ -292,77 +363,50 @@ void screen_manager::_process_event(uint8_t* payload, size_t payload_size) {
         response.page_offset = (physical_fb_addr & (PAGE_SIZE - 1));
         response.page_count = pages_used;
 
-        ipc::mq_message response_msg;
-        response_msg.payload_size = sizeof(userlib_response_map_window_framebuffer);
-        response_msg.payload = reinterpret_cast<uint8_t*>(&response);
-
-        ipc::message_queue::post_message(user_session.handle, &response_msg);
+        ipc::endpoint::reply(m_request_endpoint, &response, sizeof(userlib_response_map_window_framebuffer));
         break;
     }
     default: {
         kprint("[GFX_MANAGER] Unknown command received: 0x%llx\n", hdr->type);
+        _reply_nack();
         break;
     }
     }
 }
 
-bool screen_manager::_establish_user_session(stella_ui::internal::userlib_request_create_session* req) {
-    // Connect to the user session message queue
-    uint32_t retries = 20;
-    ipc::mq_handle_t handle = MESSAGE_QUEUE_ID_INVALID;
-    while (handle == MESSAGE_QUEUE_ID_INVALID && retries > 0) {
-        handle = ipc::message_queue::open(req->name);
-
-        if (handle == MESSAGE_QUEUE_ID_INVALID) {
-            msleep(100);
-            --retries;
-        }
-    }
-
-    if (handle == MESSAGE_QUEUE_ID_INVALID) {
-        kprint("[GFX_MANAGER] Failed to connect to user session '%s'\n", req->name);
+bool screen_manager::_establish_user_session(pid_t client_pid, const stella_ui::internal::userlib_request_create_session* req) {
+    if (_find_user_session(client_pid)) {
+        kprint("[GFX_MANAGER] Process %u already has a session\n", static_cast<uint32_t>(client_pid));
         return false;
     }
 
-    user_session session;
-    zeromem(&session, sizeof(user_session));
-
-    session.handle = handle;
-    m_user_sessions[handle] = session;
+    // The client creates its event channel before calling in
+    kstl::string session_name = req->name;
+    ipc::object_ref<ipc::channel> events = ipc::channel::get(
+        ipc::channel::open(session_name + STELLA_SESSION_EVENT_CHANNEL_SUFFIX)
+    );
 
-    if (!_send_ack_to_session(handle)) {
-        kprint("[GFX_MANAGER] Failed to send ACK to user session '%s'\n", req->name);
+    if (!events) {
+        kprint("[GFX_MANAGER] Failed to connect to user session '%s'\n", req->name);
         return false;
     }
 
+    user_session* session = new user_session();
+    session->client_pid = client_pid;
+    session->events = static_cast<ipc::object_ref<ipc::channel>&&>(events);
+    session->window = nullptr;
+    m_user_sessions.push_back(session);
+
     kprint("[GFX_MANAGER] Connected to user session '%s'\n", req->name);
     return true;
 }
 
-bool screen_manager::_send_ack_to_session(ipc::mq_handle_t session_id) {
+bool screen_manager::_reply_ack() {
     char ack_str[4] = { 'A', 'C', 'K', '\0' };
-    
-    ipc::mq_message ack;
-    ack.payload_size = 4;
-    ack.payload = reinterpret_cast<uint8_t*>(ack_str);
-
-    if (!ipc::message_queue::post_message(session_id, &ack)) {
-        return false;
-    }
-
-    return true;
+    return ipc::endpoint::reply(m_request_endpoint, ack_str, sizeof(ack_str));
 }
 
-bool screen_manager::_send_nack_to_session(ipc::mq_handle_t session_id) {
+bool screen_manager::_reply_nack() {
     char nack_str[5] = { 'N', 'A', 'C', 'K', '\0' };
-    
-    ipc::mq_message nack;
-    nack.payload_size = 5;
-    nack.payload = reinterpret_cast<uint8_t*>(nack_str);
-
-    if (!ipc::message_queue::post_message(session_id, &nack)) {
-        return false;
-    }
-
-    return true;
+    return ipc::endpoint::reply(m_request_endpoint, nack_str, sizeof(nack_str));
 }
@@ -2,13 +2,18 @@
 #define SCREEN_MANAGER_H
 #include <stella_ui.h>
 #include <kstl/vector.h>
-#include <ipc/mq.h>
+#include <ipc/endpoint.h>
+#include <ipc/channel.h>
 
 #include <stella_user.h>
 #include <internal/commands.h>
 
+// Number of session requests served per poll before the frame gets drawn
+#define GFX_MANAGER_MAX_CALLS_PER_POLL 16
+
 struct user_session {
-    ipc::mq_handle_t handle;
+    pid_t client_pid;           // Process that connected the session
+    ipc::object_ref<ipc::channel> events; // Compositor to client
     stella_ui::window_base* window;
 };
 
@@ -35,16 +40,17 @@ public:
     void draw_kernel_log_console();
 
     void poll_events();
+    void wait_for_events(uint64_t timeout_ms);
 
     screen_manager_mode active_mode = screen_manager_mode::console;
 
 private:
     modules::module_base* m_gfx_module;
     kstl::shared_ptr<stella_ui::canvas> m_screen_canvas;
-    kstl::hashmap<ipc::mq_handle_t, user_session> m_user_sessions;
+    kstl::vector<user_session*> m_user_sessions;
     kstl::vector<stella_ui::window_base*> m_window_list;
 
-    ipc::mq_handle_t m_incoming_event_queue;
+    ipc::endpoint_handle_t m_request_endpoint;
 
     char* m_console_log_buffer;
     uint32_t m_max_displayable_console_lines;
@@ -52,11 +58,14 @@ private:
     bool _create_canvas(psf1_font* font);
     void _draw_mouse_cursor();
 
-    void _process_event(uint8_t* payload, size_t payload_size);
+    user_session* _find_user_session(pid_t client_pid);
+
+    void _serve_call(pid_t client_pid, const uint8_t* payload, size_t payload_size);
+    void _process_event(user_session* session, const uint8_t* payload, size_t payload_size);
 
-    bool _establish_user_session(stella_ui::internal::userlib_request_create_session* req);
-    bool _send_ack_to_session(ipc::mq_handle_t session_id);
-    bool _send_nack_to_session(ipc::mq_handle_t session_id);
+    bool _establish_user_session(pid_t client_pid, const stella_ui::internal::userlib_request_create_session* req);
+    bool _reply_ack();
+    bool _reply_nack();
 };
 
 #endif // SCREEN_MANAGER_H
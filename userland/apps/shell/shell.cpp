@@ -7,8 +7,13 @@
 #include <acpi/fadt.h>
 #include <arch/x86/cpuid.h>
 #include <arch/x86/msr.h>
+#include <syscall/syscalls.h>
+#include <ipc/mq.h>
 
 constexpr size_t MAX_COMMAND_LENGTH = 256;
+constexpr size_t TOP_MAX_TASKS = 64;
+constexpr uint64_t TOP_SAMPLE_INTERVAL_MS = 1000;
+constexpr size_t MQSTAT_MAX_QUEUES = 32;
 
 void print_cache_size(const char* level, uint32_t size) {
     if (size >= 1024 * 1024) {
@@ -20,6 +25,103 @@ void print_cache_size(const char* level, uint32_t size) {
     }
 }
 
+const char* task_state_name(uint32_t state) {
+    switch (static_cast<process_state>(state)) {
+    case process_state::NEW:        return "new";
+    case process_state::READY:      return "ready";
+    case process_state::RUNNING:    return "run";
+    case process_state::WAITING:    return "wait";
+    case process_state::TERMINATED: return "exit";
+    default:                        return "?";
+    }
+}
+
+// Samples scheduler statistics twice and prints per-CPU and per-task usage over the interval
+void print_top() {
+    static task_stats_info before[TOP_MAX_TASKS];
+    static task_stats_info after[TOP_MAX_TASKS];
+    static sched::cpu_stats_info cpus_before[MAX_SYSTEM_CPUS];
+    static sched::cpu_stats_info cpus_after[MAX_SYSTEM_CPUS];
+
+    int task_count_before = syscall(SYSCALL_SYS_TASK_STATS, (uint64_t)before, TOP_MAX_TASKS, 0, 0, 0, 0);
+    int cpu_count_before = syscall(SYSCALL_SYS_CPU_STATS, (uint64_t)cpus_before, MAX_SYSTEM_CPUS, 0, 0, 0, 0);
+
+    msleep(TOP_SAMPLE_INTERVAL_MS);
+
+    int task_count = syscall(SYSCALL_SYS_TASK_STATS, (uint64_t)after, TOP_MAX_TASKS, 0, 0, 0, 0);
+    int cpu_count = syscall(SYSCALL_SYS_CPU_STATS, (uint64_t)cpus_after, MAX_SYSTEM_CPUS, 0, 0, 0, 0);
+
+    const uint64_t interval_ns = TOP_SAMPLE_INTERVAL_MS * 1000000;
+
+    for (int i = 0; i < cpu_count; i++) {
+        uint64_t idle_ns = cpus_after[i].idle_time_ns;
+        for (int j = 0; j < cpu_count_before; j++) {
+            if (cpus_before[j].cpu == cpus_after[i].cpu) {
+                idle_ns -= cpus_before[j].idle_time_ns;
+                break;
+            }
+        }
+
+        uint64_t idle_pct = (idle_ns * 100) / interval_ns;
+        kprint("cpu%llu: %3llu%% busy, %llu queued%s\n",
+            cpus_after[i].cpu, idle_pct > 100 ? 0 : 100 - idle_pct, cpus_after[i].nr_queued,
+            cpus_after[i].isolated ? " (isolated)" : "");
+    }
+
+    kprint("\n  PID CPU  %%CPU    RUNTIME(ms)   WAIT(ms)    VOLSW  INVOLSW STATE NAME\n");
+    for (int i = 0; i < task_count; i++) {
+        const task_stats_info& task = after[i];
+        if (static_cast<process_state>(task.state) == process_state::TERMINATED) {
+            continue;
+        }
+
+        uint64_t runtime_ns = task.runtime_ns;
+        for (int j = 0; j < task_count_before; j++) {
+            if (before[j].pid == task.pid) {
+                runtime_ns -= before[j].runtime_ns;
+                break;
+            }
+        }
+
+        kprint("%5lli %3u %5llu %14llu %10llu %8llu %8llu %s %s\n",
+            task.pid, task.cpu, (runtime_ns * 100) / interval_ns,
+            task.runtime_ns / 1000000, task.wait_time_ns / 1000000,
+            task.nr_voluntary_switches, task.nr_involuntary_switches,
+            task_state_name(task.state), task.name);
+    }
+}
+
+const char* mq_policy_name(ipc::mq_overflow_policy policy) {
+    switch (policy) {
+    case ipc::mq_overflow_policy::BLOCK:        return "block";
+    case ipc::mq_overflow_policy::FAIL:         return "fail";
+    case ipc::mq_overflow_policy::DROP_OLDEST:  return "drop";
+    default:                                    return "?";
+    }
+}
+
+// Prints occupancy and traffic counters of every named message queue
+void print_mqstat() {
+    static ipc::mq_stats_info queues[MQSTAT_MAX_QUEUES];
+
+    size_t count = ipc::message_queue::get_all_stats(queues, MQSTAT_MAX_QUEUES);
+    if (count == 0) {
+        kprint("No message queues\n");
+        return;
+    }
+
+    kprint("      DEPTH   HWM            KB   POSTED COALESCED  DROPPED REJECTED  BLOCKED POLICY NAME\n");
+    for (size_t i = 0; i < count; i++) {
+        const ipc::mq_stats& stats = queues[i].stats;
+
+        kprint("%5llu/%-5llu %5llu %6llu/%-6llu %8llu %9llu %8llu %8llu %8llu %-6s %s\n",
+            stats.depth, stats.limits.max_messages, stats.high_water_mark,
+            stats.bytes / 1024, stats.limits.max_bytes / 1024,
+            stats.posted, stats.coalesced, stats.dropped, stats.rejected, stats.blocked,
+            mq_policy_name(stats.limits.policy), queues[i].name);
+    }
+}
+
 void process_command(const kstl::string& command) {
     if (command == "help") {
         kprint("Available commands:\n");
@@ -29,6 +131,9 @@ void process_command(const kstl::string& command) {
         kprint("  shutdown     - Shutdown the system\n");
         kprint("  reboot       - Reboot the system\n");
         kprint("  cpuinfo      - Prints the information about the system's CPU\n");
+        kprint("  lockstat     - Prints lock contention statistics ('lockstat reset' clears them)\n");
+        kprint("  top          - Prints per-CPU load and per-task scheduler statistics\n");
+        kprint("  mqstat       - Prints message queue depths, limits and drop counters\n");
     } else if (command.starts_with("echo ")) {
         kprint(command.substring(5).c_str());
         kprint("\n");
@@ -72,6 +177,15 @@ void process_command(const kstl::string& command) {
             print_cache_size("L2", l2_cache);
             print_cache_size("L3", l3_cache);
         });
+    } else if (command == "lockstat") {
+        lockstat::dump();
+    } else if (command == "lockstat reset") {
+        lockstat::reset();
+        kprint("Lock statistics cleared\n");
+    } else if (command == "top") {
+        print_top();
+    } else if (command == "mqstat") {
+        print_mqstat();
     } else if (command == "clear") {
         kprint("\033[2J\033[H"); // ANSI escape codes to clear screen and move cursor to home
     } else {
@@ -18,20 +18,25 @@ psf1_font* _load_system_font() {
         return nullptr;
     }
 
-    // Allocate a buffer for the font data
-    psf1_font* font = reinterpret_cast<psf1_font*>(zmalloc(stat.size));
-    if (!font) {
-        serial::printf("[!] screen_manager: failed to allocate font buffer\n");
+    int fd = vfs.open(font_filepath, FS_O_RDONLY);
+    if (fd < 0) {
+        serial::printf("[!] screen_manager: failed to open font file\n");
         return nullptr;
     }
 
-    // Read in the font data from the file
-    ssize_t bytes_read = vfs.read(font_filepath, font, stat.size, 0);
-    if (bytes_read != static_cast<ssize_t>(stat.size)) {
-        serial::printf("[!] screen_manager: failed to read font file into buffer\n");
+    // Map the font instead of copying it, the helper fields written
+    // below only touch the process's private copy of the first page.
+    void* font_data = nullptr;
+    fs::fs_error status = vfs.mmap(fd, 0, stat.size, FS_PROT_READ | FS_PROT_WRITE, FS_MAP_PRIVATE, font_data);
+    vfs.close(fd);
+
+    if (status != fs::fs_error::success) {
+        serial::printf("[!] screen_manager: failed to map font file\n");
         return nullptr;
     }
 
+    psf1_font* font = reinterpret_cast<psf1_font*>(font_data);
+
     // Verify the PSF font magic number
     if (font->header.magic[0] != 0x36 || font->header.magic[1] != 0x04) {
         serial::printf("[!] screen_manager: PSF font magic number was\n");
@@ -8,6 +8,12 @@
 
 #define STELLA_RESPONSE_ID_MAP_FRAMEBUFFER  0x400
 
+// Endpoint the compositor serves session requests on
+#define STELLA_COMPOSITOR_ENDPOINT_NAME         "gfx_manager_rpc"
+
+// Suffix appended to the session name to form the name of its event channel
+#define STELLA_SESSION_EVENT_CHANNEL_SUFFIX     ":evt"
+
 namespace stella_ui::internal {
 struct userlib_request_header {
     uint64_t type;
@@ -1,59 +1,59 @@
 #include "stella_user.h"
 #include "internal/commands.h"
-#include <ipc/mq.h>
+#include <ipc/endpoint.h>
+#include <ipc/channel.h>
 #include <time/time.h>
 #include <process/process.h>
 #include <serial/serial.h>
 #include <memory/vmm.h>
 
 namespace stella_ui {
-ipc::mq_handle_t g_outbound_connection_id = MESSAGE_QUEUE_ID_INVALID;
-ipc::mq_handle_t g_inbound_connection_id = MESSAGE_QUEUE_ID_INVALID;
+// Compositor's request endpoint, every request is a synchronous call answered by a reply
+ipc::endpoint_handle_t g_compositor_endpoint = ENDPOINT_ID_INVALID;
 
-bool _send_compositor_request(void* req, size_t size);
-bool _get_compositor_response(ipc::mq_message& resp);
-bool _wait_for_ack_response();
+// Session channel the compositor pushes events on, the reference keeps it
+// mapped for the rest of the process even if its handle gets closed.
+ipc::object_ref<ipc::channel> g_event_channel;
+
+bool _call_compositor(void* req, size_t size, void* resp, size_t resp_capacity, size_t* out_resp_size);
+bool _call_compositor_expect_ack(void* req, size_t size);
 
 bool connect_to_compositor() {
-    // Connect to the gfx_manager_process message queue
+    // Connect to the gfx_manager_process request endpoint
     uint32_t retries = 20;
-    while (g_outbound_connection_id == MESSAGE_QUEUE_ID_INVALID && retries > 0) {
-        g_outbound_connection_id = ipc::message_queue::open("gfx_manager_mq");
+    while (g_compositor_endpoint == ENDPOINT_ID_INVALID && retries > 0) {
+        g_compositor_endpoint = ipc::endpoint::open(STELLA_COMPOSITOR_ENDPOINT_NAME);
 
-        if (g_outbound_connection_id == MESSAGE_QUEUE_ID_INVALID) {
+        if (g_compositor_endpoint == ENDPOINT_ID_INVALID) {
             msleep(100);
             --retries;
         }
     }
 
-    // Now that we have connected, we can create a session message queue
+    if (g_compositor_endpoint == ENDPOINT_ID_INVALID) {
+        return false;
+    }
+
+    // Now that we have connected, we can create the session's event channel
     kstl::string session_name = "stella_session:";
     session_name += kstl::to_string(static_cast<uint32_t>(current->pid));
 
-    // Create an inbound message queue
-    g_inbound_connection_id = ipc::message_queue::create(session_name);
-    if (g_inbound_connection_id == MESSAGE_QUEUE_ID_INVALID) {
+    ipc::channel_handle_t event_channel_id = ipc::channel::create(session_name + STELLA_SESSION_EVENT_CHANNEL_SUFFIX);
+
+    g_event_channel = ipc::channel::get(event_channel_id);
+    if (!g_event_channel) {
         return false;
     }
 
-    // Now we need to notify the gfx manager process to connect to the session mq
+    // Now we need to ask the gfx manager process to connect to the session channel
     internal::userlib_request_create_session req;
     zeromem(&req, sizeof(internal::userlib_request_create_session));
 
     req.header.type = STELLA_COMMAND_ID_CREATE_SESSION;
     strcpy(req.name, session_name.c_str());
 
-    if (!_send_compositor_request(&req, sizeof(internal::userlib_request_create_session))) {
-        return false;
-    }
-
-    // At this point we've sent the request and need to wait for the ACK message
-    if (!_wait_for_ack_response()) {
-        return false;
-    }
-
-    // If all checks passed, the connection is now fully established and active
-    return true;
+    // The connection is established once the compositor ACKs the request
+    return _call_compositor_expect_ack(&req, sizeof(internal::userlib_request_create_session));
 }
 
 bool create_window(uint32_t width, uint32_t height, const kstl::string& title, const color& bg_color) {
@@ -66,15 +66,7 @@ bool create_window(uint32_t width, uint32_t height, const kstl::string& title, c
     req.bg_color = bg_color.to_argb();
     memcpy(req.title, title.data(), kstl::min(sizeof(req.title) - 1, title.length()));
 
-    if (!_send_compositor_request(&req, sizeof(internal::userlib_request_create_window))) {
-        return false;
-    }
-
-    if (!_wait_for_ack_response()) {
-        return false;
-    }
-
-    return true;
+    return _call_compositor_expect_ack(&req, sizeof(internal::userlib_request_create_window));
 }
 
 bool request_map_window_canvas(kstl::shared_ptr<canvas>& out_canvas) {
@@ -83,28 +75,21 @@ bool request_map_window_canvas(kstl::shared_ptr<canvas>& out_canvas) {
 
     req.type = STELLA_COMMAND_ID_MAP_CANVAS;
 
-    if (!_send_compositor_request(&req, sizeof(internal::userlib_request_header))) {
+    internal::userlib_response_map_window_framebuffer info;
+    size_t resp_size = 0;
+    if (!_call_compositor(&req, sizeof(internal::userlib_request_header), &info, sizeof(info), &resp_size)) {
         return false;
     }
 
-    ipc::mq_message resp;
-    if (!_get_compositor_response(resp)) {
-        return false;
-    }
-
-    if (resp.payload_size != sizeof(internal::userlib_response_map_window_framebuffer)) {
-        return false;
-    }
-
-    auto info = reinterpret_cast<internal::userlib_response_map_window_framebuffer*>(resp.payload);
-    if (info->header.type != STELLA_RESPONSE_ID_MAP_FRAMEBUFFER) {
+    if (resp_size != sizeof(internal::userlib_response_map_window_framebuffer) ||
+        info.header.type != STELLA_RESPONSE_ID_MAP_FRAMEBUFFER) {
         return false;
     }
 
     uintptr_t mapped_fb_page_start = 0;
     RUN_ELEVATED({
         mapped_fb_page_start = reinterpret_cast<uintptr_t>(
-            vmm::map_contiguous_physical_pages(info->physical_page_ptr, info->page_count, DEFAULT_UNPRIV_PAGE_FLAGS)
+            vmm::map_contiguous_physical_pages(info.physical_page_ptr, info.page_count, DEFAULT_UNPRIV_PAGE_FLAGS)
         );
     });
 
@@ -113,14 +98,14 @@ bool request_map_window_canvas(kstl::shared_ptr<canvas>& out_canvas) {
     }
 
     void* mapped_fb_start_addr = reinterpret_cast<void*>(
-        mapped_fb_page_start + info->page_offset
+        mapped_fb_page_start + info.page_offset
     );
 
     framebuffer_t fb;
-    fb.width = info->width;
-    fb.height = info->height;
-    fb.bpp = info->bpp;
-    fb.pitch = info->pitch;
+    fb.width = info.width;
+    fb.height = info.height;
+    fb.bpp = info.bpp;
+    fb.pitch = info.pitch;
     fb.data = reinterpret_cast<uint8_t*>(mapped_fb_start_addr);
 
     psf1_font* font = _load_system_font();
@@ -133,69 +118,47 @@ bool request_map_window_canvas(kstl::shared_ptr<canvas>& out_canvas) {
 }
 
 bool peek_compositor_events() {
-    return ipc::message_queue::peek_message(g_inbound_connection_id);
+    return g_event_channel && g_event_channel->can_receive();
 }
 
 compositor_event get_compositor_event() {
-    ipc::mq_message msg;
-    if (!ipc::message_queue::get_message(g_inbound_connection_id, &msg)) {
+    if (!g_event_channel) {
         return compositor_event::invalid;
     }
 
-    if (msg.payload_size != sizeof(compositor_event)) {
+    size_t size = 0;
+    auto payload = g_event_channel->begin_receive(&size);
+    if (!payload) {
         return compositor_event::invalid;
     }
 
     // Get the event code
-    uint64_t evt_code = *reinterpret_cast<uint64_t*>(msg.payload);
+    uint64_t evt_code = static_cast<uint64_t>(compositor_event::invalid);
+    if (size == sizeof(compositor_event)) {
+        evt_code = *reinterpret_cast<const uint64_t*>(payload);
+    }
 
+    g_event_channel->end_receive();
     return static_cast<compositor_event>(evt_code);
 }
 
-bool _send_compositor_request(void* req, size_t size) {
-    reinterpret_cast<internal::userlib_request_header*>(req)->session_id = g_inbound_connection_id;
-
-    ipc::mq_message msg;
-    msg.payload_size = size;
-    msg.payload = reinterpret_cast<uint8_t*>(req);
-
-    return ipc::message_queue::post_message(g_outbound_connection_id, &msg);
-}
-
-bool _get_compositor_response(ipc::mq_message& resp) {
-    uint32_t retries = 20;
-    while (retries > 0) {
-        if (!ipc::message_queue::peek_message(g_inbound_connection_id)) {
-            msleep(100);
-            --retries;
-            continue;
-        }
-
-        break;
-    }
-
-    // Read and verify the response
-    if (!ipc::message_queue::get_message(g_inbound_connection_id, &resp)) {
+bool _call_compositor(void* req, size_t size, void* resp, size_t resp_capacity, size_t* out_resp_size) {
+    if (g_compositor_endpoint == ENDPOINT_ID_INVALID) {
         return false;
     }
 
-    return true;
+    // The compositor identifies sessions by the calling process
+    reinterpret_cast<internal::userlib_request_header*>(req)->session_id = current->pid;
+    return ipc::endpoint::call(g_compositor_endpoint, req, size, resp, resp_capacity, out_resp_size);
 }
 
-bool _wait_for_ack_response() {
-    ipc::mq_message resp;
-    if (!_get_compositor_response(resp)) {
+bool _call_compositor_expect_ack(void* req, size_t size) {
+    char resp[8] = { 0 };
+    size_t resp_size = 0;
+    if (!_call_compositor(req, size, resp, sizeof(resp) - 1, &resp_size)) {
         return false;
     }
 
-    if (resp.payload_size != 4) {
-        return false;
-    }
-
-    if (strcmp((const char*)resp.payload, "ACK") != 0) {
-        return false;
-    }
-
-    return true;
+    return (resp_size == 4) && (strcmp(resp, "ACK") == 0);
 }
 } // namespace stella_ui